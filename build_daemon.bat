@@ -2,6 +2,10 @@
 set NDK_ROOT=D:\android-ndk-r27c
 set CLANG=%NDK_ROOT%\toolchains\llvm\prebuilt\windows-x86_64\bin\clang.exe
 
+rem ratectl is only shipped next to a freshly built rate_daemon: service.sh treats
+rem bin\ratectl as the sign that the daemon waits for boot itself
+if exist bin\ratectl del bin\ratectl
+
 echo Compiling rate_daemon...
 
 "%CLANG%" ^
@@ -9,7 +13,19 @@ echo Compiling rate_daemon...
     -O3 ^
     -static ^
     src\rate_daemon.c ^
+    src\rate_policy.c ^
     -o bin\rate_daemon
+if errorlevel 1 goto failed
+
+echo Compiling ratectl...
+
+"%CLANG%" ^
+    --target=aarch64-linux-android30 ^
+    -O3 ^
+    -static ^
+    src\ratectl.c ^
+    -o bin\ratectl
+if errorlevel 1 goto failed
 
 echo Compiling dts_tool...
 
@@ -18,10 +34,16 @@ echo Compiling dts_tool...
     -O3 ^
     -static ^
     src\dts_tool.c ^
+    src\dts_tree.c ^
+    src\dts_keys.c ^
+    src\dts_scan.c ^
+    src\fdt_edit.c ^
     -o bin\dts_tool
+if errorlevel 1 goto failed
+
+echo Build successful! Output: bin\rate_daemon, bin\ratectl, bin\dts_tool
+exit /b 0
 
-if %ERRORLEVEL% EQU 0 (
-    echo Build successful! Output: bin\rate_daemon, bin\dts_tool
-) else (
-    echo Build failed!
-)
+:failed
+echo Build failed!
+exit /b 1
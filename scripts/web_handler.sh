@@ -312,7 +312,7 @@ case "$1" in
         ;;
 
     "set_app_config")
-        # $2 is package, $3 is mode id (-1 to delete)
+        # $2 is package, $3 is mode id or fps range min-max[@width] (-1 to delete)
         PKG="$2"
         MODE="$3"
         
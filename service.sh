@@ -3,11 +3,17 @@ MODDIR=${0%/*}
 DAEMON_BIN="$MODDIR/bin/rate_daemon"
 
 # 等待系统启动完成
-until [ "$(getprop sys.boot_completed)" = "1" ]; do
-    sleep 1
-done
+# 新版守护进程自行等待 SurfaceFlinger 和开机完成，并与 ratectl 一同编译；
+# bin 中没有 ratectl 时仍是旧版守护进程，由这里等待
+if [ ! -f "$MODDIR/bin/ratectl" ]; then
+    until [ "$(getprop sys.boot_completed)" = "1" ]; do
+        sleep 1
+    done
+fi
 
 # 启动守护进程
 # 传入模块路径作为参数
 chmod +x "$DAEMON_BIN"
+# ratectl 随新版守护进程发布，缺失时 WebUI 回退到 mode.txt / dumpsys
+[ -f "$MODDIR/bin/ratectl" ] && chmod +x "$MODDIR/bin/ratectl"
 nohup "$DAEMON_BIN" "$MODDIR" > /dev/null 2>&1 &
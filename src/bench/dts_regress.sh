@@ -0,0 +1,107 @@
+#!/bin/sh
+# process_dts / dts_tool 回归测试
+#
+# 在主机上对 bench/dts/fixtures 中的样本运行两个工具，把修改后的文件和标准输出
+# 与 bench/dts/expected 中的期望结果逐字节比较。样本按 dtc 反编译格式生成:
+#   gt8.dts / op15.dts / op12.dts  RMX5200 / PLK110 / PJD110 的面板片段
+#                                  (project-id 0x1111 / 0x2222 / 0x5929)
+#   other_prj.dts                  project-id 不匹配 (0x9999)，应被跳过
+#   panel.dtb                      AE084 面板的 FDT，供 dtb_add / dtb_remove 使用
+# process_dts 通过 bench/dts/fake/getprop 读取机型和项目号。
+# 标准输出比较前去掉统计行 (Wrote ... / Run storage ...)；dtbo_dts 中有多个文件时
+# 处理顺序取决于 readdir，这时再按行排序。
+#
+# 编译 (主机，在 src 目录下):
+#   gcc -O2 -o process_dts_host process_dts.c dts_tree.c dts_keys.c dts_scan.c
+#   gcc -O2 -o dts_tool_host dts_tool.c dts_tree.c dts_keys.c dts_scan.c fdt_edit.c
+# 运行 (在 src 目录下):
+#   bench/dts_regress.sh ./process_dts_host ./dts_tool_host            有差异时打印 diff 并返回 1
+#   bench/dts_regress.sh ./process_dts_host ./dts_tool_host --update   用当前输出重写期望结果
+
+if [ $# -lt 2 ]; then
+    echo "用法: $0 <process_dts> <dts_tool> [--update]"
+    exit 1
+fi
+PD=$(realpath "$1") || exit 1
+TOOL=$(realpath "$2") || exit 1
+UPDATE=0
+[ "$3" = "--update" ] && UPDATE=1
+
+HERE=$(cd "$(dirname "$0")/dts" && pwd)
+FIX="$HERE/fixtures"
+EXP="$HERE/expected"
+WORK=$(mktemp -d /tmp/dts_regress.XXXXXX) || exit 1
+FAILED=0
+
+P_GT8=qcom,mdss_dsi_panel_AE084_P_3_A0033_dsc_cmd_dvt02
+P_OP12=qcom,mdss_dsi_panel_AA545_P_3_A0005_dsc_cmd
+
+# run_case <名称> <样本>... -- <命令>...
+# 样本写作 file 或 file=新名称；.dts 复制到 dtbo_dts/，.dtb 复制到工作目录
+run_case() {
+    name=$1
+    shift
+    dir="$WORK/$name"
+    mkdir -p "$dir/dtbo_dts"
+    files=0
+    while [ "$1" != "--" ]; do
+        src=${1%%=*}
+        dst=${1#*=}
+        case "$dst" in
+            *.dtb) cp "$FIX/$src" "$dir/$dst" ;;
+            *) cp "$FIX/$src" "$dir/dtbo_dts/$dst"; files=$((files + 1)) ;;
+        esac
+        shift
+    done
+    shift
+
+    (cd "$dir" && "$@" > out.raw 2>&1; echo "rc=$?" >> out.raw)
+    if [ $files -gt 1 ]; then
+        grep -v -e '^Wrote ' -e '^Run storage:' "$dir/out.raw" | LC_ALL=C sort > "$dir/stdout.txt"
+    else
+        grep -v -e '^Wrote ' -e '^Run storage:' "$dir/out.raw" > "$dir/stdout.txt"
+    fi
+    rm -f "$dir/out.raw"
+    rmdir "$dir/dtbo_dts" 2>/dev/null
+
+    if [ $UPDATE -eq 1 ]; then
+        rm -rf "$EXP/$name"
+        mkdir -p "$EXP"
+        cp -r "$dir" "$EXP/$name"
+        echo "更新: $name"
+    elif diff -r "$EXP/$name" "$dir" > "$WORK/$name.diff" 2>&1; then
+        echo "通过: $name"
+    else
+        echo "失败: $name"
+        cat "$WORK/$name.diff"
+        FAILED=1
+    fi
+}
+
+# process_dts <机型> <项目号>
+pd() {
+    env PATH="$HERE/fake:$PATH" DTS_MODEL="$1" DTS_PRJNAME="$2" "$PD"
+}
+
+run_case pd_RMX5200 gt8.dts other_prj.dts -- pd RMX5200 0x1111
+run_case pd_PLK110 op15.dts other_prj.dts -- pd PLK110 0x2222
+run_case pd_PJD110 op12.dts other_prj.dts -- pd PJD110 0x5929
+run_case pd_unknown_model op12.dts -- pd XXX0000 0x5929
+
+run_case scan op12.dts -- "$TOOL" scan $P_OP12 0x5929
+run_case scan_all op12.dts -- "$TOOL" scan "" ""
+run_case add op12.dts=a.dts op12.dts=c.dts -- "$TOOL" add timing@wqhd_sdc_120 144 $P_OP12 0x5929
+run_case add_existing op12.dts -- "$TOOL" add timing@wqhd_sdc_60 90 $P_OP12 0x5929
+run_case add_bad_fps op12.dts -- "$TOOL" add timing@wqhd_sdc_120 0 $P_OP12 0x5929
+# 节点名必须完整匹配 (含 timing@ 前缀)，只给后缀时不做任何修改
+run_case add_short_name op12.dts -- "$TOOL" add wqhd_sdc_120 144 $P_OP12 0x5929
+run_case smart_add op12.dts -- "$TOOL" smart_add 100 $P_OP12 0x5929
+run_case remove op12.dts -- "$TOOL" remove timing@wqhd_sdc_90 $P_OP12 0x5929
+run_case remove_short_name op12.dts -- "$TOOL" remove wqhd_sdc_90 $P_OP12 0x5929
+run_case remove_all_panels gt8.dts -- "$TOOL" remove timing@wqhd_sdc_60 "" ""
+run_case wrong_project op12.dts -- "$TOOL" remove timing@wqhd_sdc_90 $P_OP12 0x1111
+run_case dtb_add panel.dtb -- "$TOOL" dtb_add panel.dtb timing@wqhd_sdc_120 144 $P_GT8
+run_case dtb_remove panel.dtb -- "$TOOL" dtb_remove panel.dtb timing@wqhd_sdc_60 $P_GT8
+
+rm -rf "$WORK"
+exit $FAILED
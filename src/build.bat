@@ -5,7 +5,8 @@ set FLAGS=--target=aarch64-linux-android29 --sysroot="%NDK_ROOT%\toolchains\llvm
 
 echo.
 echo Building process_dts...
-%CLANG% %FLAGS% -o ..\bin\process_dts process_dts.c
+if exist ..\bin\process_dts del ..\bin\process_dts
+%CLANG% %FLAGS% -o ..\bin\process_dts process_dts.c dts_tree.c dts_keys.c dts_scan.c
 if exist ..\bin\process_dts (
     echo process_dts Built Successfully!
 ) else (
@@ -13,16 +14,38 @@ if exist ..\bin\process_dts (
 )
 
 echo Building dts_tool...
-%CLANG% %FLAGS% -o ..\bin\dts_tool dts_tool.c
+if exist ..\bin\dts_tool del ..\bin\dts_tool
+%CLANG% %FLAGS% -o ..\bin\dts_tool dts_tool.c dts_tree.c dts_keys.c dts_scan.c fdt_edit.c
 if exist ..\bin\dts_tool (
     echo dts_tool Built Successfully!
 ) else (
     echo dts_tool Build FAILED!
 )
 
+echo.
+echo Building dtb_bench...
+if exist ..\bin\dtb_bench del ..\bin\dtb_bench
+%CLANG% %FLAGS% -o ..\bin\dtb_bench dtb_bench.c fdt_edit.c dts_tree.c dts_keys.c dts_scan.c
+if exist ..\bin\dtb_bench (
+    echo dtb_bench Built Successfully!
+) else (
+    echo dtb_bench Build FAILED!
+)
+
+echo.
+echo Building dts_bench...
+if exist ..\bin\dts_bench del ..\bin\dts_bench
+%CLANG% %FLAGS% -o ..\bin\dts_bench dts_bench.c dts_tree.c dts_keys.c dts_scan.c
+if exist ..\bin\dts_bench (
+    echo dts_bench Built Successfully!
+) else (
+    echo dts_bench Build FAILED!
+)
+
 echo.
 echo Building pack_dtbo...
-%CLANG% %FLAGS% -o ..\bin\pack_dtbo pack_dtbo.c
+if exist ..\bin\pack_dtbo del ..\bin\pack_dtbo
+%CLANG% %FLAGS% -o ..\bin\pack_dtbo pack_dtbo.c dtbo_img.c dtc_pool.c
 if exist ..\bin\pack_dtbo (
     echo pack_dtbo Built Successfully!
 ) else (
@@ -31,7 +54,8 @@ if exist ..\bin\pack_dtbo (
 
 echo.
 echo Building unpack_dtbo...
-%CLANG% %FLAGS% -o ..\bin\unpack_dtbo unpack_dtbo.c
+if exist ..\bin\unpack_dtbo del ..\bin\unpack_dtbo
+%CLANG% %FLAGS% -o ..\bin\unpack_dtbo unpack_dtbo.c dtbo_img.c dtc_pool.c
 if exist ..\bin\unpack_dtbo (
     echo unpack_dtbo Built Successfully!
 ) else (
@@ -40,9 +64,24 @@ if exist ..\bin\unpack_dtbo (
 
 echo.
 echo Building rate_daemon...
-%CLANG% %FLAGS% -o ..\bin\rate_daemon rate_daemon.c
+rem ratectl is only built next to a fresh rate_daemon: service.sh treats bin\ratectl
+rem as the sign that the daemon waits for boot itself
+if exist ..\bin\ratectl del ..\bin\ratectl
+if exist ..\bin\rate_daemon del ..\bin\rate_daemon
+%CLANG% %FLAGS% -o ..\bin\rate_daemon rate_daemon.c rate_policy.c
 if exist ..\bin\rate_daemon (
     echo rate_daemon Built Successfully!
 ) else (
     echo rate_daemon Build FAILED!
 )
+
+echo.
+echo Building ratectl...
+if exist ..\bin\rate_daemon (
+    %CLANG% %FLAGS% -o ..\bin\ratectl ratectl.c
+)
+if exist ..\bin\ratectl (
+    echo ratectl Built Successfully!
+) else (
+    echo ratectl Build FAILED!
+)
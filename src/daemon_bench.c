@@ -0,0 +1,366 @@
+// rate_daemon 主机端基准测试
+//
+// 在 Linux 主机上运行真实的 rate_daemon 主循环，PATH 前置 bench/fake 中的
+// dumpsys / service / settings 替身。替身回放 bench/fixtures 中录制的输出，
+// 并把每次调用连同纳秒时间戳记录到 calls.log。本程序按脚本改写前台应用，
+// 结束后统计:
+//   - 每轮循环的 CPU 时间 (守护进程自身 / 其子进程)
+//   - 每分钟的外部命令调用次数
+//   - 从前台应用变化到最后一条 service/settings 调用的端到端切换延迟
+// 任一指标超过给定阈值时返回 2，可用于发布前的回归检查。
+//
+// 编译 (主机):
+//   gcc -O2 -o rate_daemon_host rate_daemon.c rate_policy.c
+//   gcc -O2 -o daemon_bench daemon_bench.c
+// 稳态零分配检查: 用分配检查构建替换守护进程，主循环一旦分配堆内存即以
+// 状态 3 退出，基准测试据此报告失败:
+//   gcc -O2 -DRATE_DAEMON_ALLOC_CHECK -o rate_daemon_alloc rate_daemon.c rate_policy.c
+//   ./daemon_bench ./rate_daemon_alloc
+// 运行 (在 src 目录下):
+//   ./daemon_bench ./rate_daemon_host [--bench-dir bench] [--script bench/fixtures/apps.txt]
+//                  [--duration 60] [--poll-ms 1000] [--max-cpu-us-per-loop N]
+//                  [--max-spawns-per-min N] [--max-switch-ms N] [--keep]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define MAX_EVENTS 256
+#define MAX_PATH 1024
+#define MAX_FOCUS 256
+
+typedef struct {
+    long long at_ms;        // 相对开始的时间
+    char focus[MAX_FOCUS];  // 包名/Activity
+    long long changed_ns;   // 实际写入 focus 的时间
+    long long latency_ns;   // 端到端切换延迟，-1 表示无需切换
+} AppEvent;
+
+AppEvent events[MAX_EVENTS];
+int event_count = 0;
+
+long long realtime_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int load_script(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        printf("错误: 无法打开脚本 %s\n", path);
+        return 0;
+    }
+
+    char line[512];
+    while (fgets(line, sizeof(line), fp) && event_count < MAX_EVENTS) {
+        double sec;
+        char focus[MAX_FOCUS];
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%lf %255s", &sec, focus) != 2) continue;
+        events[event_count].at_ms = (long long)(sec * 1000);
+        snprintf(events[event_count].focus, MAX_FOCUS, "%s", focus);
+        events[event_count].latency_ns = -1;
+        event_count++;
+    }
+    fclose(fp);
+    return event_count;
+}
+
+int write_file(const char *path, const char *content) {
+    char tmp[MAX_PATH + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *fp = fopen(tmp, "w");
+    if (!fp) return 0;
+    fputs(content, fp);
+    fclose(fp);
+    return rename(tmp, path) == 0;
+}
+
+int copy_file(const char *src, const char *dst) {
+    FILE *in = fopen(src, "rb");
+    if (!in) return 0;
+    FILE *out = fopen(dst, "wb");
+    if (!out) {
+        fclose(in);
+        return 0;
+    }
+    char buf[8192];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) fwrite(buf, 1, n, out);
+    fclose(in);
+    fclose(out);
+    return 1;
+}
+
+// 切换焦点: 原子地改写 focus 文件，供 dumpsys 替身读取
+void set_focus(const char *work_dir, const char *focus) {
+    char path[MAX_PATH];
+    snprintf(path, sizeof(path), "%s/focus", work_dir);
+    write_file(path, focus);
+}
+
+// 读取 /proc/<pid>/stat 中的 utime/stime/cutime/cstime (时钟滴答)
+int read_proc_cpu(pid_t pid, long *self_ticks, long *child_ticks) {
+    char path[64], buf[2048];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    FILE *fp = fopen(path, "r");
+    if (!fp) return 0;
+    size_t n = fread(buf, 1, sizeof(buf) - 1, fp);
+    fclose(fp);
+    buf[n] = '\0';
+
+    // comm 可能含空格，从最后一个 ')' 之后开始按字段解析
+    char *p = strrchr(buf, ')');
+    if (!p) return 0;
+    unsigned long utime, stime;
+    long cutime, cstime;
+    if (sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu %ld %ld",
+               &utime, &stime, &cutime, &cstime) != 4) return 0;
+    *self_ticks = (long)(utime + stime);
+    *child_ticks = cutime + cstime;
+    return 1;
+}
+
+// 从 metrics.json 中取出一个整数字段
+long long read_metric(const char *mod_dir, const char *key) {
+    char path[MAX_PATH], buf[16384], pattern[128];
+    snprintf(path, sizeof(path), "%s/metrics.json", mod_dir);
+    FILE *fp = fopen(path, "r");
+    if (!fp) return -1;
+    size_t n = fread(buf, 1, sizeof(buf) - 1, fp);
+    fclose(fp);
+    buf[n] = '\0';
+
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    char *p = strstr(buf, pattern);
+    return p ? atoll(p + strlen(pattern)) : -1;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("用法: %s <rate_daemon> [--bench-dir dir] [--script file] [--duration sec] [--poll-ms ms]\n"
+               "          [--max-cpu-us-per-loop N] [--max-spawns-per-min N] [--max-switch-ms N] [--keep]\n", argv[0]);
+        return 1;
+    }
+
+    const char *daemon = argv[1];
+    const char *bench_dir = "bench";
+    const char *script = NULL;
+    int duration = 0;
+    int poll_ms = 1000;
+    long max_cpu_us = -1, max_spawns = -1, max_switch_ms = -1;
+    int keep = 0;
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--keep") == 0) { keep = 1; continue; }
+        if (i + 1 >= argc) {
+            printf("错误: 参数 %s 缺少取值\n", argv[i]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--bench-dir") == 0) bench_dir = argv[++i];
+        else if (strcmp(argv[i], "--script") == 0) script = argv[++i];
+        else if (strcmp(argv[i], "--duration") == 0) duration = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--poll-ms") == 0) poll_ms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--max-cpu-us-per-loop") == 0) max_cpu_us = atol(argv[++i]);
+        else if (strcmp(argv[i], "--max-spawns-per-min") == 0) max_spawns = atol(argv[++i]);
+        else if (strcmp(argv[i], "--max-switch-ms") == 0) max_switch_ms = atol(argv[++i]);
+        else {
+            printf("错误: 未知参数 %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    char bench_abs[MAX_PATH], daemon_abs[MAX_PATH], script_path[MAX_PATH + 32];
+    if (!realpath(bench_dir, bench_abs)) {
+        printf("错误: 找不到基准目录 %s\n", bench_dir);
+        return 1;
+    }
+    if (!realpath(daemon, daemon_abs)) {
+        printf("错误: 找不到守护进程 %s\n", daemon);
+        return 1;
+    }
+    if (script) strncpy(script_path, script, sizeof(script_path) - 1);
+    else snprintf(script_path, sizeof(script_path), "%s/fixtures/apps.txt", bench_abs);
+
+    if (!load_script(script_path)) {
+        printf("错误: 脚本中没有事件\n");
+        return 1;
+    }
+    if (duration <= 0) duration = (int)(events[event_count - 1].at_ms / 1000) + 10;
+
+    // 1. 准备工作目录和模块目录
+    char work_dir[] = "/tmp/rd_bench.XXXXXX";
+    if (!mkdtemp(work_dir)) {
+        printf("错误: 无法创建临时目录: %s\n", strerror(errno));
+        return 1;
+    }
+    char mod_dir[64], path[MAX_PATH], src[MAX_PATH + 32], conf[256];
+    snprintf(mod_dir, sizeof(mod_dir), "%s/mod", work_dir);
+    mkdir(mod_dir, 0755);
+    snprintf(path, sizeof(path), "%s/config", mod_dir);
+    mkdir(path, 0755);
+
+    snprintf(src, sizeof(src), "%s/fixtures/mode.txt", bench_abs);
+    snprintf(path, sizeof(path), "%s/config/mode.txt", mod_dir);
+    if (!copy_file(src, path)) {
+        printf("错误: 无法复制 %s\n", src);
+        return 1;
+    }
+    snprintf(path, sizeof(path), "%s/config/daemon.conf", mod_dir);
+    snprintf(conf, sizeof(conf), "metrics_interval=1\npoll_interval_ms=%d\n", poll_ms);
+    write_file(path, conf);
+
+    set_focus(work_dir, events[0].focus);
+
+    // 2. 启动守护进程，PATH 指向替身
+    char fixtures[MAX_PATH + 16], fake_path[MAX_PATH * 2];
+    snprintf(fixtures, sizeof(fixtures), "%s/fixtures", bench_abs);
+    snprintf(fake_path, sizeof(fake_path), "%s/fake:%s", bench_abs, getenv("PATH") ? getenv("PATH") : "/usr/bin:/bin");
+
+    printf("工作目录: %s\n", work_dir);
+    printf("运行 %d 秒，%d 个应用切换事件...\n", duration, event_count);
+
+    fflush(stdout);
+    long long start_ns = realtime_ns();
+    pid_t pid = fork();
+    if (pid < 0) {
+        printf("错误: fork 失败\n");
+        return 1;
+    }
+    if (pid == 0) {
+        setenv("PATH", fake_path, 1);
+        setenv("RD_BENCH_DIR", work_dir, 1);
+        setenv("RD_BENCH_FIXTURES", fixtures, 1);
+        freopen("/dev/null", "w", stdout);
+        execl(daemon_abs, daemon_abs, mod_dir, (char *)NULL);
+        _exit(127);
+    }
+
+    // 3. 按脚本切换前台应用，晚于 --duration 的事件不再回放
+    long long end_due = start_ns + duration * 1000000000LL;
+    int replayed = 0;
+    for (int i = 0; i < event_count; i++) {
+        long long due = start_ns + events[i].at_ms * 1000000LL;
+        if (due > end_due) break;
+        long long wait = due - realtime_ns();
+        if (wait > 0) usleep((useconds_t)(wait / 1000));
+        if (i > 0) set_focus(work_dir, events[i].focus);
+        events[i].changed_ns = realtime_ns();
+        replayed++;
+    }
+    long long wait = end_due - realtime_ns();
+    if (wait > 0) usleep((useconds_t)(wait / 1000));
+    long long end_ns = realtime_ns();
+
+    // 守护进程不应自行退出 (分配检查构建在稳态分配时以状态 3 退出)
+    int status = 0;
+    if (waitpid(pid, &status, WNOHANG) == pid) {
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 3) {
+            printf("回归: 守护进程在稳态循环中分配了堆内存，详见 %s/daemon.log\n", mod_dir);
+            return 2;
+        }
+        printf("错误: 守护进程提前退出 (status=%d)，请检查 %s/daemon.log\n",
+               WIFEXITED(status) ? WEXITSTATUS(status) : -1, mod_dir);
+        return 1;
+    }
+
+    // 4. 采集 CPU 时间和循环次数后结束守护进程
+    long self_ticks = 0, child_ticks = 0;
+    int have_cpu = read_proc_cpu(pid, &self_ticks, &child_ticks);
+    long long loops = read_metric(mod_dir, "loop_iterations");
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+
+    if (!have_cpu || loops <= 0) {
+        printf("错误: 守护进程未正常运行 (loops=%lld)，请检查 %s/daemon.log\n", loops, mod_dir);
+        return 1;
+    }
+
+    // 5. 解析替身调用记录
+    snprintf(path, sizeof(path), "%s/calls.log", work_dir);
+    FILE *fp = fopen(path, "r");
+    long calls_dumpsys = 0, calls_service = 0, calls_settings = 0;
+    if (fp) {
+        char line[1024];
+        while (fgets(line, sizeof(line), fp)) {
+            long long ts;
+            char tool[32];
+            if (sscanf(line, "%lld %31s", &ts, tool) != 2) continue;
+
+            int is_switch = 0;
+            if (strcmp(tool, "dumpsys") == 0) calls_dumpsys++;
+            else if (strcmp(tool, "service") == 0) { calls_service++; is_switch = 1; }
+            else if (strcmp(tool, "settings") == 0) { calls_settings++; is_switch = 1; }
+            if (!is_switch) continue;
+
+            // 归属到此前最近的一次切换事件
+            for (int i = event_count - 1; i >= 0; i--) {
+                if (events[i].changed_ns > 0 && ts >= events[i].changed_ns) {
+                    if (i > 0 && ts - events[i].changed_ns > events[i].latency_ns) {
+                        events[i].latency_ns = ts - events[i].changed_ns;
+                    }
+                    break;
+                }
+            }
+        }
+        fclose(fp);
+    }
+
+    // 6. 报告
+    double minutes = (end_ns - start_ns) / 60e9;
+    long tck = sysconf(_SC_CLK_TCK);
+    double self_us = self_ticks * 1e6 / tck / loops;
+    double child_us = child_ticks * 1e6 / tck / loops;
+    long total_calls = calls_dumpsys + calls_service + calls_settings;
+    double spawns_per_min = total_calls / minutes;
+
+    printf("\n==== rate_daemon 基准结果 ====\n");
+    printf("运行时长: %.1fs (回放 %d/%d 个事件)\n", (end_ns - start_ns) / 1e9, replayed, event_count);
+    printf("循环次数: %lld (poll %dms)\n", loops, poll_ms);
+    printf("CPU/循环: 守护进程 %.1fus, 子进程 %.1fus\n", self_us, child_us);
+    printf("外部命令/分钟: %.1f (dumpsys %ld, service %ld, settings %ld)\n",
+           spawns_per_min, calls_dumpsys, calls_service, calls_settings);
+
+    double max_latency_ms = 0;
+    int switched = 0;
+    printf("切换延迟:\n");
+    for (int i = 1; i < replayed; i++) {
+        if (events[i].latency_ns < 0) {
+            printf("  %6.1fs %-60s 无需切换\n", events[i].at_ms / 1000.0, events[i].focus);
+            continue;
+        }
+        double ms = events[i].latency_ns / 1e6;
+        if (ms > max_latency_ms) max_latency_ms = ms;
+        switched++;
+        printf("  %6.1fs %-60s %8.1fms\n", events[i].at_ms / 1000.0, events[i].focus, ms);
+    }
+
+    int failed = 0;
+    if (max_cpu_us >= 0 && self_us > max_cpu_us) {
+        printf("回归: CPU/循环 %.1fus 超过阈值 %ldus\n", self_us, max_cpu_us);
+        failed = 1;
+    }
+    if (max_spawns >= 0 && spawns_per_min > max_spawns) {
+        printf("回归: 外部命令/分钟 %.1f 超过阈值 %ld\n", spawns_per_min, max_spawns);
+        failed = 1;
+    }
+    if (max_switch_ms >= 0 && switched > 0 && max_latency_ms > max_switch_ms) {
+        printf("回归: 最大切换延迟 %.1fms 超过阈值 %ldms\n", max_latency_ms, max_switch_ms);
+        failed = 1;
+    }
+
+    if (!keep) {
+        char cmd[MAX_PATH + 16];
+        snprintf(cmd, sizeof(cmd), "rm -rf \"%s\"", work_dir);
+        system(cmd);
+    }
+
+    return failed ? 2 : 0;
+}
@@ -0,0 +1,166 @@
+// DTB 编辑基准测试
+//
+// 对同一个 DTB 比较两种修改方式的耗时:
+//   - dtc 往返: ./dtc -I dtb -O dts 反编译，再 ./dtc -I dts -O dtb 编译回去
+//     (unpack_dtbo / pack_dtbo 目前的做法，不含文本修改本身)
+//   - fdt_edit: 载入 blob、复制一个 timing 节点并改写 framerate/clockrate、重新生成 blob
+// fdt_edit 每轮的输出都会重新载入并检查新节点，结果不对时返回 2。
+// 找不到 dtc 时只测 fdt_edit。
+//
+// 编译 (主机): gcc -O2 -o dtb_bench dtb_bench.c fdt_edit.c dts_tree.c dts_keys.c dts_scan.c
+// 运行: ./dtb_bench <file.dtb> [--iterations N] [--dtc ./dtc]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "fdt_edit.h"
+
+#define CLONE_NAME "timing@dtb_bench_clone"
+
+long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+uint8_t *read_blob(const char *path, size_t *size) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    fseek(fp, 0, SEEK_END);
+    long len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    uint8_t *blob = len > 0 ? malloc(len) : NULL;
+    if (blob && fread(blob, 1, len, fp) != (size_t)len) {
+        free(blob);
+        blob = NULL;
+    }
+    fclose(fp);
+    *size = blob ? (size_t)len : 0;
+    return blob;
+}
+
+// 第一个带 framerate 的节点，没有时退回第一个 timing@ 节点
+FdtNode *find_timing(const FdtTree *tree) {
+    FdtNode *fallback = NULL;
+    for (FdtNode *n = fdt_next(tree->root, tree->root); n; n = fdt_next(tree->root, n)) {
+        if (fdt_prop(n, "qcom,mdss-dsi-panel-framerate")) return n;
+        if (!fallback && strncmp(n->name, "timing@", 7) == 0) fallback = n;
+    }
+    return fallback;
+}
+
+// 一轮 fdt_edit 修改，返回新 blob 的长度，失败返回 0
+size_t edit_once(const uint8_t *blob, size_t size, uint8_t **out) {
+    FdtTree tree;
+    size_t len = 0;
+    *out = NULL;
+    if (fdt_load(&tree, blob, size)) {
+        FdtNode *base = find_timing(&tree);
+        FdtNode *node = base ? fdt_clone(&tree, base, CLONE_NAME) : NULL;
+        if (node) {
+            unsigned long long clock = 0;
+            fdt_prop_uint(fdt_prop(node, "qcom,mdss-dsi-panel-clockrate"), &clock);
+            fdt_set_uint(&tree, node, "qcom,mdss-dsi-panel-framerate", 144);
+            fdt_set_uint(&tree, node, "qcom,mdss-dsi-panel-clockrate", clock + 1);
+            len = fdt_emit(&tree, out);
+        }
+    }
+    fdt_free(&tree);
+    return len;
+}
+
+int verify(const uint8_t *blob, size_t size) {
+    FdtTree tree;
+    int ok = 0;
+    if (fdt_load(&tree, blob, size)) {
+        FdtNode *node = fdt_find_node(&tree, CLONE_NAME);
+        unsigned long long fps = 0;
+        ok = node && fdt_prop_uint(fdt_prop(node, "qcom,mdss-dsi-panel-framerate"), &fps) && fps == 144;
+    }
+    fdt_free(&tree);
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = NULL;
+    const char *dtc = "./dtc";
+    int iterations = 100;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 || strcmp(argv[i], "--dtc") == 0) {
+            if (i + 1 >= argc) {
+                printf("错误: 参数 %s 缺少取值\n", argv[i]);
+                return 1;
+            }
+            if (argv[i][2] == 'i') iterations = atoi(argv[++i]);
+            else dtc = argv[++i];
+        } else if (!path && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            printf("错误: 未知参数 %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (!path) {
+        printf("用法: %s <file.dtb> [--iterations N] [--dtc ./dtc]\n", argv[0]);
+        return 1;
+    }
+    if (iterations < 1) iterations = 1;
+
+    size_t size;
+    uint8_t *blob = read_blob(path, &size);
+    if (!blob) {
+        printf("错误: 无法读取 %s\n", path);
+        return 1;
+    }
+
+    // fdt_edit
+    size_t out_len = 0;
+    int failed = 0;
+    long long start = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        uint8_t *out;
+        out_len = edit_once(blob, size, &out);
+        if (!out_len || !verify(out, out_len)) failed++;
+        free(out);
+    }
+    double fdt_us = (now_ns() - start) / 1000.0 / iterations;
+
+    printf("==== DTB 编辑基准结果 ====\n");
+    printf("输入: %s (%zu 字节)，%d 轮\n", path, size, iterations);
+    printf("fdt_edit: %10.1fus/轮 (载入+复制+改写+生成+校验，输出 %zu 字节)\n", fdt_us, out_len);
+
+    // dtc 往返
+    if (access(dtc, X_OK) == 0) {
+        char dts_path[] = "/tmp/dtb_bench.XXXXXX";
+        int fd = mkstemp(dts_path);
+        if (fd >= 0) close(fd);
+        char cmd[2048];
+        int dtc_failed = 0;
+        start = now_ns();
+        for (int i = 0; i < iterations; i++) {
+            snprintf(cmd, sizeof(cmd), "%s -q -I dtb -O dts -o %s %s 2>/dev/null && %s -q -I dts -O dtb -o %s.dtb %s 2>/dev/null",
+                     dtc, dts_path, path, dtc, dts_path, dts_path);
+            if (system(cmd) != 0) dtc_failed++;
+        }
+        double dtc_us = (now_ns() - start) / 1000.0 / iterations;
+        remove(dts_path);
+        snprintf(cmd, sizeof(cmd), "%s.dtb", dts_path);
+        remove(cmd);
+
+        printf("dtc 往返: %10.1fus/轮%s\n", dtc_us, dtc_failed ? " (有失败)" : "");
+        if (fdt_us > 0) printf("加速比:   %10.1fx\n", dtc_us / fdt_us);
+    } else {
+        printf("dtc 往返: 跳过 (找不到 %s)\n", dtc);
+    }
+
+    free(blob);
+    if (failed) {
+        printf("错误: %d 轮 fdt_edit 输出校验失败\n", failed);
+        return 2;
+    }
+    return 0;
+}
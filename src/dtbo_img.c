@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "dtbo_img.h"
+
+static uint32_t be32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void put_be32(uint8_t *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static int open_fail(DtboImage *img, const char *what) {
+    snprintf(img->error, sizeof(img->error), "%s", what);
+    dtbo_close(img);
+    return 0;
+}
+
+int dtbo_open(DtboImage *img, const char *path) {
+    memset(img, 0, sizeof(*img));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return open_fail(img, "cannot open image");
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < DTBO_HEADER_SIZE) {
+        close(fd);
+        return open_fail(img, "image too small");
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return open_fail(img, "mmap failed");
+    img->map = map;
+    img->map_size = st.st_size;
+
+    const uint8_t *b = map;
+    if (be32(b) != DTBO_MAGIC) return open_fail(img, "bad magic");
+    uint32_t total = be32(b + 4);
+    uint32_t header_size = be32(b + 8);
+    uint32_t entry_size = be32(b + 12);
+    uint32_t count = be32(b + 16);
+    uint32_t entries_off = be32(b + 20);
+    img->page_size = be32(b + 24);
+    img->version = be32(b + 28);
+
+    // 镜像末尾可能带 AVB footer，所以只要求 total_size 不超过文件大小
+    if (total > img->map_size || header_size < DTBO_HEADER_SIZE) return open_fail(img, "bad header");
+    if (entry_size < DTBO_ENTRY_SIZE || count > 4096) return open_fail(img, "bad entry table");
+    if (entries_off > total || (uint64_t)count * entry_size > total - entries_off) {
+        return open_fail(img, "entry table out of range");
+    }
+
+    img->entries = calloc(count ? count : 1, sizeof(DtboEntry));
+    if (!img->entries) return open_fail(img, "out of memory");
+    for (uint32_t i = 0; i < count; i++) {
+        const uint8_t *e = b + entries_off + (size_t)i * entry_size;
+        DtboEntry *entry = &img->entries[i];
+        uint32_t offset = be32(e + 4);
+        entry->size = be32(e);
+        entry->id = be32(e + 8);
+        entry->rev = be32(e + 12);
+        for (int c = 0; c < 4; c++) entry->custom[c] = be32(e + 16 + c * 4);
+        if (offset > total || entry->size > total - offset) return open_fail(img, "entry data out of range");
+        if (img->version >= 1 && (entry->custom[0] & 0xf) != 0) return open_fail(img, "compressed entries are not supported");
+        entry->data = b + offset;
+    }
+    img->entry_count = (int)count;
+    return 1;
+}
+
+void dtbo_close(DtboImage *img) {
+    if (img->map) munmap(img->map, img->map_size);
+    free(img->entries);
+    img->map = NULL;
+    img->entries = NULL;
+    img->entry_count = 0;
+}
+
+int dtbo_write(const char *path, const DtboEntry *entries, int count, uint32_t page_size, uint32_t version) {
+    size_t table_size = DTBO_HEADER_SIZE + (size_t)count * DTBO_ENTRY_SIZE;
+    uint8_t *table = calloc(1, table_size);
+    uint32_t *offsets = calloc(count ? count : 1, sizeof(uint32_t));
+    if (!table || !offsets) {
+        free(table);
+        free(offsets);
+        return 0;
+    }
+
+    // 先排好偏移: 与前面某个条目内容相同时复用它的数据
+    uint64_t offset = table_size;
+    for (int i = 0; i < count; i++) {
+        offsets[i] = (uint32_t)offset;
+        for (int j = 0; j < i; j++) {
+            if (entries[j].size == entries[i].size && memcmp(entries[j].data, entries[i].data, entries[i].size) == 0) {
+                offsets[i] = offsets[j];
+                break;
+            }
+        }
+        if (offsets[i] == (uint32_t)offset) offset += entries[i].size;
+    }
+    if (offset > UINT32_MAX) {
+        free(table);
+        free(offsets);
+        return 0;
+    }
+
+    put_be32(table, DTBO_MAGIC);
+    put_be32(table + 4, (uint32_t)offset);
+    put_be32(table + 8, DTBO_HEADER_SIZE);
+    put_be32(table + 12, DTBO_ENTRY_SIZE);
+    put_be32(table + 16, (uint32_t)count);
+    put_be32(table + 20, DTBO_HEADER_SIZE);
+    put_be32(table + 24, page_size);
+    put_be32(table + 28, version);
+    for (int i = 0; i < count; i++) {
+        uint8_t *e = table + DTBO_HEADER_SIZE + (size_t)i * DTBO_ENTRY_SIZE;
+        put_be32(e, entries[i].size);
+        put_be32(e + 4, offsets[i]);
+        put_be32(e + 8, entries[i].id);
+        put_be32(e + 12, entries[i].rev);
+        for (int c = 0; c < 4; c++) put_be32(e + 16 + c * 4, entries[i].custom[c]);
+    }
+
+    char temp_path[1024];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    FILE *fp = fopen(temp_path, "wb");
+    int ok = fp && fwrite(table, 1, table_size, fp) == table_size;
+    uint64_t written = table_size;
+    for (int i = 0; ok && i < count; i++) {
+        if (offsets[i] != written) continue; // 复用的数据
+        ok = fwrite(entries[i].data, 1, entries[i].size, fp) == entries[i].size;
+        written += entries[i].size;
+    }
+    if (fp && fclose(fp) != 0) ok = 0;
+    free(table);
+    free(offsets);
+
+    if (!ok) {
+        remove(temp_path);
+        return 0;
+    }
+    remove(path);
+    return rename(temp_path, path) == 0;
+}
+
+int dtbo_save_info(const char *path, const DtboImage *img) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) return 0;
+    fprintf(fp, "PAGE_SIZE=%u\n", img->page_size);
+    fprintf(fp, "VERSION=%u\n", img->version);
+    for (int i = 0; i < img->entry_count; i++) {
+        const DtboEntry *e = &img->entries[i];
+        fprintf(fp, "ENTRY.%d=0x%x 0x%x 0x%x 0x%x 0x%x 0x%x\n", i, e->id, e->rev,
+                e->custom[0], e->custom[1], e->custom[2], e->custom[3]);
+    }
+    return fclose(fp) == 0;
+}
+
+int dtbo_load_info(const char *path, DtboEntry *entries, int count, uint32_t *page_size, uint32_t *version) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return 0;
+
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "PAGE_SIZE=", 10) == 0) {
+            *page_size = (uint32_t)strtoul(line + 10, NULL, 0);
+        } else if (strncmp(line, "VERSION=", 8) == 0) {
+            *version = (uint32_t)strtoul(line + 8, NULL, 0);
+        } else if (strncmp(line, "ENTRY.", 6) == 0) {
+            char *p;
+            long index = strtol(line + 6, &p, 10);
+            if (*p != '=' || index < 0 || index >= count) continue;
+            DtboEntry *e = &entries[index];
+            uint32_t v[6];
+            int n = 0;
+            for (p++; n < 6; n++) {
+                char *end;
+                v[n] = (uint32_t)strtoul(p, &end, 0);
+                if (end == p) break;
+                p = end;
+            }
+            if (n != 6) continue;
+            e->id = v[0];
+            e->rev = v[1];
+            for (int c = 0; c < 4; c++) e->custom[c] = v[2 + c];
+        }
+    }
+    fclose(fp);
+    return 1;
+}
@@ -0,0 +1,52 @@
+#ifndef DTBO_IMG_H
+#define DTBO_IMG_H
+
+// ==================== DTBO 镜像 (dt_table) ====================
+// Android DTBO 分区格式: 32 字节表头 + N 个 32 字节条目 + 各个 DTB，所有字段为大端。
+// 读取时 mmap 整个镜像，条目的 data 直接指向映射区 (零拷贝)，镜像关闭前有效。
+// 写出时先写表头和条目表，再依次写各个 DTB，一次顺序写完；内容相同的 DTB 只存一份
+// (与 mkdtimg create 相同)。
+//
+// 条目的 id/rev/custom 以及表头的 page_size/version 在解包时保存到
+// dtbo_dts/dtbo_info.cfg，打包时读回，避免重新打包后丢失。
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DTBO_MAGIC 0xd7b7ab1e
+#define DTBO_HEADER_SIZE 32
+#define DTBO_ENTRY_SIZE 32
+#define DTBO_DEFAULT_PAGE_SIZE 2048
+#define DTBO_INFO_FILE "dtbo_info.cfg"
+
+typedef struct {
+    const uint8_t *data;   // 指向镜像映射区或调用者的缓冲区
+    uint32_t size;
+    uint32_t id;
+    uint32_t rev;
+    uint32_t custom[4];    // version 1 中 custom[0] 为 flags (低 4 位为压缩方式)
+} DtboEntry;
+
+typedef struct {
+    void *map;
+    size_t map_size;
+    uint32_t page_size;
+    uint32_t version;
+    int entry_count;
+    DtboEntry *entries;
+    char error[128];
+} DtboImage;
+
+// 映射并校验镜像，失败时返回 0，原因在 img->error
+int dtbo_open(DtboImage *img, const char *path);
+void dtbo_close(DtboImage *img);
+
+// 写出镜像 (先写 path.tmp 再改名)
+int dtbo_write(const char *path, const DtboEntry *entries, int count, uint32_t page_size, uint32_t version);
+
+// 读写 dtbo_info.cfg: 表头字段和每个条目的 id/rev/custom
+int dtbo_save_info(const char *path, const DtboImage *img);
+// 按条目下标 N (ENTRY.N=) 把 id/rev/custom 填入 entries[N] (N < count)，返回是否找到配置文件
+int dtbo_load_info(const char *path, DtboEntry *entries, int count, uint32_t *page_size, uint32_t *version);
+
+#endif
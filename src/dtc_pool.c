@@ -0,0 +1,168 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#include "dtc_pool.h"
+
+#define MAX_JOBS 64
+
+int dtc_pool_jobs(int requested) {
+    int jobs = requested;
+    if (jobs <= 0) {
+        const char *env = getenv(DTC_JOBS_ENV);
+        if (env) jobs = atoi(env);
+    }
+    if (jobs <= 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = online > 0 ? (int)online : 1;
+    }
+    return jobs > MAX_JOBS ? MAX_JOBS : jobs;
+}
+
+typedef struct {
+    pthread_mutex_t lock;
+    int next;
+    int count;
+    int stop;
+    char *failed;          // 每个条目一个标志
+    int (*fn)(int index, void *ctx);
+    void *ctx;
+} Pool;
+
+static void *pool_worker(void *arg) {
+    Pool *pool = arg;
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        int index = pool->stop || pool->next >= pool->count ? -1 : pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+        if (index < 0) return NULL;
+
+        if (!pool->fn(index, pool->ctx)) {
+            pthread_mutex_lock(&pool->lock);
+            pool->failed[index] = 1;
+            pool->stop = 1;
+            pthread_mutex_unlock(&pool->lock);
+        }
+    }
+}
+
+int dtc_pool_run(int count, int jobs, int (*fn)(int index, void *ctx), void *ctx) {
+    if (count <= 0) return -1;
+    if (jobs > count) jobs = count;
+
+    Pool pool;
+    memset(&pool, 0, sizeof(pool));
+    pool.count = count;
+    pool.fn = fn;
+    pool.ctx = ctx;
+    pool.failed = calloc(count, 1);
+    if (!pool.failed) return DTC_POOL_NOMEM;
+    pthread_mutex_init(&pool.lock, NULL);
+
+    pthread_t threads[MAX_JOBS];
+    int started = 0;
+    for (int i = 1; i < jobs; i++) {
+        if (pthread_create(&threads[started], NULL, pool_worker, &pool) != 0) break;
+        started++;
+    }
+    pool_worker(&pool); // 当前线程也参与
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&pool.lock);
+
+    int first = -1;
+    for (int i = 0; i < count && first < 0; i++) {
+        if (pool.failed[i]) first = i;
+    }
+    free(pool.failed);
+    return first;
+}
+
+int dtc_run(const char *const argv[], const void *in, size_t in_len, uint8_t **out, size_t *out_len) {
+    int fds[2];
+    if ((in || out) && pipe2(fds, O_CLOEXEC) != 0) return 0;
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        if (in || out) {
+            close(fds[0]);
+            close(fds[1]);
+        }
+        return 0;
+    }
+    if (pid == 0) {
+        // dup2 得到的描述符不带 O_CLOEXEC
+        if (in) dup2(fds[0], STDIN_FILENO);
+        if (out) dup2(fds[1], STDOUT_FILENO);
+        execv(argv[0], (char *const *)argv);
+        _exit(127);
+    }
+
+    int ok = 1;
+    if (in) {
+        close(fds[0]);
+        const uint8_t *p = in;
+        while (in_len > 0) {
+            ssize_t n = write(fds[1], p, in_len);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                ok = 0;
+                break;
+            }
+            p += n;
+            in_len -= (size_t)n;
+        }
+        close(fds[1]);
+    } else if (out) {
+        close(fds[1]);
+        size_t len = 0, cap = 64 * 1024;
+        uint8_t *buf = malloc(cap);
+        while (buf) {
+            if (len == cap) {
+                uint8_t *grown = realloc(buf, cap * 2);
+                if (!grown) {
+                    free(buf);
+                    buf = NULL;
+                    break;
+                }
+                buf = grown;
+                cap *= 2;
+            }
+            ssize_t n = read(fds[0], buf + len, cap - len);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) {
+                free(buf);
+                buf = NULL;
+            }
+            if (n <= 0) break;
+            len += (size_t)n;
+        }
+        close(fds[0]);
+        if (!buf) ok = 0;
+        *out = buf;
+        *out_len = buf ? len : 0;
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return 0;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) ok = 0;
+    if (!ok && out && *out) {
+        free(*out);
+        *out = NULL;
+    }
+    return ok;
+}
+
+double dtc_pool_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
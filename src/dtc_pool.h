@@ -0,0 +1,34 @@
+#ifndef DTC_POOL_H
+#define DTC_POOL_H
+
+// ==================== 并行 dtc 转换 ====================
+// unpack_dtbo / pack_dtbo 共用: 用固定数量的工作线程并行处理每个条目，
+// 每个条目的结果写在调用者按下标准备的槽位里，输出顺序与线程调度无关。
+// 任一条目失败后不再开始新的条目 (已在运行的会执行完)。
+//
+// dtc 通过 fork/exec 启动，管道一律带 O_CLOEXEC，避免并发启动的 dtc
+// 继承别的条目的管道写端而互相等待 EOF。
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DTC_JOBS_ENV "DTBO_JOBS"
+
+// 线程数: requested > 0 时使用它，否则取环境变量 DTBO_JOBS，再否则取在线 CPU 数
+int dtc_pool_jobs(int requested);
+
+// dtc_pool_run 分配失败时的返回值 (没有执行任何条目)
+#define DTC_POOL_NOMEM (-2)
+
+// 对 0..count-1 并行执行 fn，返回第一个失败的下标 (按下标顺序)，全部成功返回 -1，
+// 内存不足返回 DTC_POOL_NOMEM
+int dtc_pool_run(int count, int jobs, int (*fn)(int index, void *ctx), void *ctx);
+
+// 运行命令 (argv[0] 为路径)。in 非 NULL 时写入子进程标准输入；
+// out 非 NULL 时读取子进程标准输出 (malloc)。二者不能同时使用。
+// 子进程正常退出且返回 0 时返回 1
+int dtc_run(const char *const argv[], const void *in, size_t in_len, uint8_t **out, size_t *out_len);
+
+double dtc_pool_now_ms(void);
+
+#endif
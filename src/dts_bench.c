@@ -0,0 +1,467 @@
+// DTS 处理基准测试
+//
+// 在内存中生成多面板的大 DTS (或读取指定文件)，测量 DTS 工具链各环节的耗时，
+// 用于确认改动后耗时随文件大小线性增长。
+//
+//   panels  每个 timing 节点查找所在面板:
+//           旧实现 (从节点位置逐字节向前扫描，process_dts 原来的 get_panel_id) 对比
+//           区间索引 (dts_span_index 建一次 + 每个节点一次二分查找)。
+//           两种方法的结果不一致时返回 2。
+//   keys    关键字扫描吞吐量 (MB/s): dts_keys_scan 一次扫描匹配全部关键字 对比
+//           每个关键字各 strstr 扫描一遍；两者找到的次数不一致时返回 2。
+//           另测在树上读取每个 timing 节点的帧率/时钟/传输时间/cell-index:
+//           按属性名 strcmp (dts_find_prop) 对比按解析时标好的关键字 (dts_find_key)。
+//   struct  结构字符扫描吞吐量 (MB/s): dts_scan_build 的各个实现 (scalar / swar / sse2 / avx2 / neon，
+//           只测当前 CPU 支持的)，位图与 scalar 不一致时返回 2；
+//           另比较统计行数和括号深度: 旧做法 (按行切分后逐字符数 '{' '}') 对比遍历位图，
+//           以及整个 dts_parse 的耗时。
+//
+// 编译 (主机): gcc -O2 -o dts_bench dts_bench.c dts_tree.c dts_keys.c dts_scan.c
+// 运行 (在 src 目录下):
+//   ./dts_bench panels [--scale N] [--timings M] [file.dts]
+//   ./dts_bench keys [--scale N] [--timings M] [file.dts]
+//   ./dts_bench struct [--scale N] [--timings M] [file.dts]
+//   不指定文件时按 N, 4N, 16N, 64N 个面板生成 (默认 N=2，每个面板 M=24 个 timing)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "dts_tree.h"
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} Buf;
+
+void buf_printf(Buf *b, const char *fmt, ...) {
+    for (;;) {
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(b->data + b->len, b->cap - b->len, fmt, ap);
+        va_end(ap);
+        if (n >= 0 && (size_t)n < b->cap - b->len) {
+            b->len += n;
+            return;
+        }
+        size_t cap = b->cap ? b->cap * 2 : 1 << 20;
+        while (n >= 0 && cap < b->len + n + 1) cap *= 2;
+        char *data = realloc(b->data, cap);
+        if (!data) {
+            printf("错误: 内存不足\n");
+            exit(1);
+        }
+        b->data = data;
+        b->cap = cap;
+    }
+}
+
+double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+void gen_timing(Buf *b, const char *indent, const char *name, int index, int fps) {
+    buf_printf(b, "%stiming@%s {\n", indent, name);
+    buf_printf(b, "%s\tcell-index = <0x%x>;\n", indent, index);
+    buf_printf(b, "%s\tqcom,mdss-dsi-panel-framerate = <0x%x>;\n", indent, fps);
+    buf_printf(b, "%s\tqcom,mdss-dsi-panel-clockrate = <0x%x>;\n", indent, fps * 9000000);
+    buf_printf(b, "%s\tqcom,mdss-mdp-transfer-time-us = <0x%x>;\n", indent, 1000000 / fps);
+    buf_printf(b, "%s\tqcom,mdss-dsi-on-command = [39 01 00 00 00 00 02 35 00 39 01 00 00 00 00 03 51 0f ff];\n", indent);
+    buf_printf(b, "%s\tqcom,mdss-dsi-timing-switch-command-state = \"dsi_lp_mode\";\n", indent);
+    buf_printf(b, "%s\tqcom,mdss-dsc-slice-height = <0x28>;\n", indent);
+    buf_printf(b, "%s};\n", indent);
+}
+
+// 先是 panels 个非面板的 display 节点，后面是 panels 个面板，二者都带 timings 个 timing 子节点。
+// 旧实现对面板之前的 timing 要一直扫描到文件开头，这部分随文件大小平方增长
+char *gen_dts(int panels, int timings, size_t *len) {
+    Buf b = {0};
+    buf_printf(&b, "/dts-v1/;\n\n/ {\n\tfragment@0 {\n\t\ttarget = <0xffffffff>;\n\t\t__overlay__ {\n");
+    buf_printf(&b, "\t\t\toplus,project-id = <0x5929>;\n");
+    for (int p = 0; p < panels; p++) {
+        buf_printf(&b, "\t\t\toplus,dsi-display-dev@%d {\n", p);
+        for (int t = 0; t < timings; t++) {
+            char name[32];
+            snprintf(name, sizeof(name), "dev_%d_%d", p, t);
+            gen_timing(&b, "\t\t\t\t", name, t, 60 + t);
+        }
+        buf_printf(&b, "\t\t\t};\n");
+    }
+    for (int p = 0; p < panels; p++) {
+        buf_printf(&b, "\t\t\tqcom,mdss_dsi_panel_BENCH%04d_dsc_cmd {\n", p);
+        buf_printf(&b, "\t\t\t\tqcom,mdss-dsi-panel-name = \"bench panel %d\";\n", p);
+        buf_printf(&b, "\t\t\t\tqcom,mdss-dsi-display-timings {\n");
+        for (int t = 0; t < timings; t++) {
+            char name[32];
+            snprintf(name, sizeof(name), "wqhd_sdc_%d", 60 + t);
+            gen_timing(&b, "\t\t\t\t\t", name, t, 60 + t);
+        }
+        buf_printf(&b, "\t\t\t\t};\n\t\t\t};\n");
+    }
+    buf_printf(&b, "\t\t};\n\t};\n};\n");
+    *len = b.len;
+    return b.data;
+}
+
+char *read_file(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *data = size >= 0 ? malloc(size + 1) : NULL;
+    if (data && fread(data, 1, size, fp) != (size_t)size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+    if (data) data[size] = '\0';
+    *len = data ? (size_t)size : 0;
+    return data;
+}
+
+// ==================== panels ====================
+
+// 旧实现: 从 current_pos 向前逐字节找 '{'，取其前面的节点名，遇到面板名即返回
+// (不跟踪 '}'，已关闭的面板也会被当成所在面板)。返回面板的 '{'，没有时返回 NULL
+const char *legacy_panel_of(const char *file_start, const char *current_pos) {
+    const char *p = current_pos;
+    while (p > file_start) {
+        if (*p == '{') {
+            const char *name_end = p;
+            while (name_end > file_start && isspace(*(name_end - 1))) name_end--;
+            const char *name_start = name_end;
+            while (name_start > file_start && !isspace(*(name_start - 1)) && *(name_start - 1) != ';' &&
+                   *(name_start - 1) != '}') {
+                name_start--;
+            }
+            if (name_end > name_start) {
+                char node_name[256];
+                int len = name_end - name_start;
+                if (len > 255) len = 255;
+                strncpy(node_name, name_start, len);
+                node_name[len] = 0;
+                if (strstr(node_name, "qcom,mdss_dsi_panel_")) return p;
+            }
+        }
+        p--;
+    }
+    return NULL;
+}
+
+int is_panel_node(const DtsNode *node) {
+    return (node->keys & DTS_KEY_BIT(DTS_KEY_PANEL)) != 0;
+}
+
+int is_timing_node(const DtsNode *node) {
+    return (node->keys & DTS_KEY_BIT(DTS_KEY_TIMING)) != 0;
+}
+
+// 返回不一致的节点数，-1 表示解析失败
+int bench_panels_once(char *src, size_t len, const char *label) {
+    DtsDoc doc;
+    double t0 = now_ms();
+    if (!dts_parse(&doc, src, len)) {
+        printf("错误: 解析失败 (%s)\n", doc.error);
+        dts_free(&doc);
+        return -1;
+    }
+    double parse_ms = now_ms() - t0;
+
+    int timing_count = 0;
+    for (DtsNode *n = dts_next(&doc.root, &doc.root); n; n = dts_next(&doc.root, n)) {
+        if (is_timing_node(n)) timing_count++;
+    }
+    const DtsNode **found = calloc(timing_count ? timing_count : 1, sizeof(DtsNode *));
+    const char **legacy = calloc(timing_count ? timing_count : 1, sizeof(char *));
+
+    t0 = now_ms();
+    int i = 0;
+    for (DtsNode *n = dts_next(&doc.root, &doc.root); n; n = dts_next(&doc.root, n)) {
+        if (is_timing_node(n)) legacy[i++] = legacy_panel_of(doc.src, doc.src + n->name_off);
+    }
+    double legacy_ms = now_ms() - t0;
+
+    t0 = now_ms();
+    DtsSpanIndex panels;
+    dts_span_index(&doc, &panels, is_panel_node);
+    i = 0;
+    for (DtsNode *n = dts_next(&doc.root, &doc.root); n; n = dts_next(&doc.root, n)) {
+        if (is_timing_node(n)) found[i++] = dts_span_find(&panels, n->name_off);
+    }
+    double index_ms = now_ms() - t0;
+
+    // 节点确实在面板内时两种方法必须一致；面板外的节点旧实现会误报前一个面板
+    int mismatches = 0, misattributed = 0;
+    i = 0;
+    for (DtsNode *n = dts_next(&doc.root, &doc.root); n; n = dts_next(&doc.root, n)) {
+        if (!is_timing_node(n)) continue;
+        const DtsNode *parent = n->parent;
+        while (parent && parent != &doc.root && !is_panel_node(parent)) parent = parent->parent;
+        const DtsNode *expect = parent && parent != &doc.root ? parent : NULL;
+        if (found[i] != expect) mismatches++;
+        if (expect && legacy[i] != doc.src + expect->open) mismatches++;
+        if (!expect && legacy[i]) misattributed++;
+        i++;
+    }
+
+    printf("%-10s %8.2f MB %6d 面板 %7d timing | 解析 %8.1f ms | 旧扫描 %10.1f ms | 索引 %7.2f ms (%5.0f ns/次)",
+           label, len / 1048576.0, panels.count, timing_count, parse_ms, legacy_ms, index_ms,
+           timing_count ? index_ms * 1e6 / timing_count : 0);
+    if (misattributed) printf(" | 旧实现误判 %d", misattributed);
+    printf("\n");
+
+    free(found);
+    free(legacy);
+    dts_free(&doc);
+    return mismatches;
+}
+
+// ==================== keys ====================
+
+void count_event(int key, size_t off, void *ctx) {
+    (void)off;
+    ((long *)ctx)[key]++;
+}
+
+// 返回次数不一致的关键字数
+int bench_keys_once(char *src, size_t len, const char *label) {
+    long automaton[DTS_KEY_COUNT] = {0};
+    long naive[DTS_KEY_COUNT] = {0};
+    int rounds = len < (16 << 20) ? (int)((16 << 20) / len) + 1 : 1;
+
+    double t0 = now_ms();
+    for (int r = 0; r < rounds; r++) {
+        memset(automaton, 0, sizeof(automaton));
+        dts_keys_scan(src, len, count_event, automaton);
+    }
+    double scan_ms = (now_ms() - t0) / rounds;
+
+    t0 = now_ms();
+    for (int r = 0; r < rounds; r++) {
+        memset(naive, 0, sizeof(naive));
+        for (int k = 1; k < DTS_KEY_COUNT; k++) {
+            for (const char *p = src; (p = strstr(p, dts_key_name(k))); p++) naive[k]++;
+        }
+    }
+    double naive_ms = (now_ms() - t0) / rounds;
+
+    // 树上的属性查找
+    DtsDoc doc;
+    char *copy = malloc(len + 1);
+    if (!copy) return -1;
+    memcpy(copy, src, len + 1);
+    if (!dts_parse(&doc, copy, len)) {
+        printf("错误: 解析失败 (%s)\n", doc.error);
+        dts_free(&doc);
+        return -1;
+    }
+    static const int keys[] = { DTS_KEY_FRAMERATE, DTS_KEY_CLOCKRATE, DTS_KEY_TRANSFER, DTS_KEY_CELL_INDEX };
+    unsigned long long sum_name = 0, sum_key = 0;
+    long lookups = 0;
+    t0 = now_ms();
+    for (DtsNode *n = dts_next(&doc.root, &doc.root); n; n = dts_next(&doc.root, n)) {
+        if (!dts_name_contains(n->name, n->name_len, "timing@")) continue;
+        for (int k = 0; k < 4; k++) sum_name += dts_prop_u64(&doc, dts_find_prop(n, dts_key_name(keys[k])));
+        lookups += 4;
+    }
+    double name_ms = now_ms() - t0;
+    t0 = now_ms();
+    for (DtsNode *n = dts_next(&doc.root, &doc.root); n; n = dts_next(&doc.root, n)) {
+        if (!is_timing_node(n)) continue;
+        for (int k = 0; k < 4; k++) sum_key += dts_prop_u64(&doc, dts_find_key(n, keys[k]));
+    }
+    double key_ms = now_ms() - t0;
+    dts_free(&doc);
+
+    long events = 0;
+    int mismatches = sum_name != sum_key;
+    for (int k = 1; k < DTS_KEY_COUNT; k++) {
+        events += automaton[k];
+        if (automaton[k] != naive[k]) {
+            printf("  %s: 自动机 %ld 次，strstr %ld 次\n", dts_key_name(k), automaton[k], naive[k]);
+            mismatches++;
+        }
+    }
+    double mb = len / 1048576.0;
+    printf("%-10s %8.2f MB %8ld 次匹配 | 自动机 %8.1f MB/s | 逐个 strstr (%d 遍) %8.1f MB/s\n",
+           label, mb, events, scan_ms > 0 ? mb * 1000 / scan_ms : 0, DTS_KEY_COUNT - 1,
+           naive_ms > 0 ? mb * 1000 / naive_ms : 0);
+    printf("%-10s %8ld 次属性读取 | 按名称 %8.2f ms | 按关键字 %8.2f ms\n", "", lookups, name_ms, key_ms);
+    return mismatches;
+}
+
+// ==================== struct ====================
+
+typedef struct {
+    long lines;
+    long braces;
+    int max_depth;
+} BraceStats;
+
+// 旧做法: 按行切分，每行 while (*p) 逐字符数括号
+void legacy_brace_stats(const char *src, size_t len, BraceStats *st) {
+    memset(st, 0, sizeof(*st));
+    int depth = 0;
+    const char *line = src, *end = src + len;
+    while (line < end) {
+        const char *p = line;
+        while (p < end && *p != '\n') p++;
+        for (const char *q = line; q < p; q++) {
+            if (*q == '{') {
+                st->braces++;
+                if (++depth > st->max_depth) st->max_depth = depth;
+            } else if (*q == '}') {
+                st->braces++;
+                depth--;
+            }
+        }
+        if (p < end) st->lines++;
+        line = p + 1;
+    }
+}
+
+// 只访问位图中的结构字符
+void scan_brace_stats(const DtsScan *scan, const char *src, BraceStats *st) {
+    memset(st, 0, sizeof(*st));
+    st->lines = (long)dts_scan_count_newlines(scan, scan->len);
+    int depth = 0;
+    for (size_t i = dts_scan_next(scan, 0); i < scan->len; i = dts_scan_next(scan, i + 1)) {
+        if (src[i] == '{') {
+            st->braces++;
+            if (++depth > st->max_depth) st->max_depth = depth;
+        } else if (src[i] == '}') {
+            st->braces++;
+            depth--;
+        }
+    }
+}
+
+// 返回位图或统计不一致的实现数
+int bench_struct_once(char *src, size_t len, const char *label) {
+    int rounds = len < (64 << 20) ? (int)((64 << 20) / len) + 1 : 1;
+    double mb = len / 1048576.0;
+    int mismatches = 0;
+
+    DtsScan ref;
+    if (!dts_scan_build(&ref, src, len, DTS_SCAN_SCALAR)) return -1;
+
+    printf("%-10s %8.2f MB |", label, mb);
+    for (int impl = DTS_SCAN_SCALAR; impl < DTS_SCAN_IMPL_COUNT; impl++) {
+        if (!dts_scan_supported(impl)) continue;
+        DtsScan scan;
+        double t0 = now_ms();
+        for (int r = 0; r < rounds; r++) {
+            if (r) dts_scan_free(&scan);
+            if (!dts_scan_build(&scan, src, len, impl)) return -1;
+        }
+        double ms = (now_ms() - t0) / rounds;
+        if (memcmp(scan.structural, ref.structural, ref.words * 2 * sizeof(uint64_t)) != 0) {
+            printf(" (%s 位图不一致)", dts_scan_impl_name(impl));
+            mismatches++;
+        }
+        printf(" %s %7.0f MB/s", dts_scan_impl_name(impl), ms > 0 ? mb * 1000 / ms : 0);
+        dts_scan_free(&scan);
+    }
+    printf("\n");
+
+    BraceStats legacy, bitmap;
+    double t0 = now_ms();
+    for (int r = 0; r < rounds; r++) legacy_brace_stats(src, len, &legacy);
+    double legacy_ms = (now_ms() - t0) / rounds;
+    t0 = now_ms();
+    for (int r = 0; r < rounds; r++) {
+        DtsScan scan;
+        if (!dts_scan_build(&scan, src, len, DTS_SCAN_AUTO)) return -1;
+        scan_brace_stats(&scan, src, &bitmap);
+        dts_scan_free(&scan);
+    }
+    double bitmap_ms = (now_ms() - t0) / rounds;
+    if (memcmp(&legacy, &bitmap, sizeof(legacy)) != 0) {
+        printf("  行/括号统计不一致: 旧 %ld/%ld/%d，位图 %ld/%ld/%d\n", legacy.lines, legacy.braces,
+               legacy.max_depth, bitmap.lines, bitmap.braces, bitmap.max_depth);
+        mismatches++;
+    }
+    dts_scan_free(&ref);
+
+    DtsDoc doc;
+    char *copy = malloc(len + 1);
+    if (!copy) return -1;
+    memcpy(copy, src, len + 1);
+    t0 = now_ms();
+    if (!dts_parse(&doc, copy, len)) {
+        printf("错误: 解析失败 (%s)\n", doc.error);
+        dts_free(&doc);
+        return -1;
+    }
+    double parse_ms = now_ms() - t0;
+    dts_free(&doc);
+
+    printf("%-10s %8ld 行 深度 %d | 逐行数括号 %8.2f ms | 扫描+遍历位图 (%s) %8.2f ms | dts_parse %8.2f ms\n", "",
+           bitmap.lines, bitmap.max_depth, legacy_ms, dts_scan_impl_name(dts_scan_best()), bitmap_ms, parse_ms);
+    return mismatches;
+}
+
+// 对指定文件或生成的 N, 4N, 16N, 64N 面板 DTS 运行 once
+int run_scaled(int argc, char *argv[], int (*once)(char *src, size_t len, const char *label), const char *what) {
+    int scale = 2, timings = 24;
+    const char *path = NULL;
+    for (int i = 0; i < argc; i++) {
+        if ((strcmp(argv[i], "--scale") == 0 || strcmp(argv[i], "--timings") == 0) && i + 1 < argc) {
+            if (argv[i][2] == 's') scale = atoi(argv[++i]);
+            else timings = atoi(argv[++i]);
+        } else if (argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            printf("错误: 未知参数 %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    int mismatches = 0;
+    if (path) {
+        size_t len;
+        char *src = read_file(path, &len);
+        if (!src) {
+            printf("错误: 无法读取 %s\n", path);
+            return 1;
+        }
+        int r = once(src, len, "file");
+        if (r < 0) return 1;
+        mismatches += r;
+    } else {
+        if (scale < 1) scale = 1;
+        for (int n = scale, step = 0; step < 4; n *= 4, step++) {
+            size_t len;
+            char *src = gen_dts(n, timings, &len);
+            char label[32];
+            snprintf(label, sizeof(label), "x%d", n);
+            int r = once(src, len, label);
+            if (r < 0) return 1;
+            mismatches += r;
+        }
+    }
+    if (mismatches) {
+        printf("错误: %d 处%s结果不一致\n", mismatches, what);
+        return 2;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("用法: %s panels|keys|struct [--scale N] [--timings M] [file.dts]\n", argv[0]);
+        return 1;
+    }
+    if (strcmp(argv[1], "panels") == 0) return run_scaled(argc - 2, argv + 2, bench_panels_once, "面板查找");
+    if (strcmp(argv[1], "keys") == 0) return run_scaled(argc - 2, argv + 2, bench_keys_once, "关键字计数");
+    if (strcmp(argv[1], "struct") == 0) return run_scaled(argc - 2, argv + 2, bench_struct_once, "结构字符扫描");
+    printf("错误: 未知命令 %s\n", argv[1]);
+    return 1;
+}
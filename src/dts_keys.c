@@ -0,0 +1,109 @@
+#include <string.h>
+#include <stdint.h>
+
+#include "dts_keys.h"
+
+#define KEY_STATES 256  // 须大于全部关键字的总长度 (状态号用 uint8_t)
+#define KEY_ALPHABET 128 // 关键字都是 ASCII，其他字节回到初始状态
+
+static const char *const key_names[DTS_KEY_COUNT] = {
+    [DTS_KEY_TIMING] = "timing@",
+    [DTS_KEY_PANEL] = "qcom,mdss_dsi_panel_",
+    [DTS_KEY_PANEL_ALT] = "qcom,mdss-dsi-panel-",
+    [DTS_KEY_EVT] = "_evt",
+    [DTS_KEY_FHD] = "fhd",
+    [DTS_KEY_QHD] = "qhd",
+    [DTS_KEY_FRAMERATE] = "qcom,mdss-dsi-panel-framerate",
+    [DTS_KEY_CLOCKRATE] = "qcom,mdss-dsi-panel-clockrate",
+    [DTS_KEY_TRANSFER] = "qcom,mdss-mdp-transfer-time-us",
+    [DTS_KEY_CELL_INDEX] = "cell-index",
+    [DTS_KEY_PROJECT_ID] = "oplus,project-id",
+};
+
+static uint8_t trie[KEY_STATES][KEY_ALPHABET];   // 只含关键字本身的边，0 表示无
+static uint8_t dfa[KEY_STATES][KEY_ALPHABET];    // 补全失败转移后的完整转移表
+static unsigned state_out[KEY_STATES];           // 在该状态结束的关键字 (含失败链上的)
+static uint8_t state_key[KEY_STATES];            // 恰好走完整个关键字的状态
+static size_t key_len[DTS_KEY_COUNT];
+static int built;
+
+const char *dts_key_name(int key) {
+    return key > DTS_KEY_NONE && key < DTS_KEY_COUNT ? key_names[key] : "";
+}
+
+static void build(void) {
+    int states = 1;
+    for (int k = 1; k < DTS_KEY_COUNT; k++) {
+        key_len[k] = strlen(key_names[k]);
+        int s = 0;
+        for (const char *p = key_names[k]; *p; p++) {
+            int c = (unsigned char)*p;
+            if (!trie[s][c]) trie[s][c] = (uint8_t)states++;
+            s = trie[s][c];
+        }
+        state_key[s] = (uint8_t)k;
+        state_out[s] |= DTS_KEY_BIT(k);
+    }
+
+    // 按层 (BFS) 计算失败转移，同时填好完整转移表
+    uint8_t fail[KEY_STATES] = {0};
+    uint8_t queue[KEY_STATES];
+    int head = 0, tail = 0;
+    for (int c = 0; c < KEY_ALPHABET; c++) {
+        dfa[0][c] = trie[0][c];
+        if (trie[0][c]) queue[tail++] = trie[0][c];
+    }
+    while (head < tail) {
+        int s = queue[head++];
+        state_out[s] |= state_out[fail[s]];
+        for (int c = 0; c < KEY_ALPHABET; c++) {
+            int t = trie[s][c];
+            if (t) {
+                fail[t] = dfa[fail[s]][c];
+                dfa[s][c] = (uint8_t)t;
+                queue[tail++] = (uint8_t)t;
+            } else {
+                dfa[s][c] = dfa[fail[s]][c];
+            }
+        }
+    }
+    built = 1;
+}
+
+void dts_keys_scan(const char *buf, size_t len, void (*event)(int key, size_t off, void *ctx), void *ctx) {
+    if (!built) build();
+    int s = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)buf[i];
+        s = c < KEY_ALPHABET ? dfa[s][c] : 0;
+        unsigned out = state_out[s];
+        while (out) {
+            int k = __builtin_ctz(out);
+            out &= out - 1;
+            event(k, i + 1 - key_len[k], ctx);
+        }
+    }
+}
+
+unsigned dts_keys_mask(const char *s, size_t len) {
+    if (!built) build();
+    unsigned mask = 0;
+    int st = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        st = c < KEY_ALPHABET ? dfa[st][c] : 0;
+        mask |= state_out[st];
+    }
+    return mask;
+}
+
+int dts_keys_exact(const char *s, size_t len) {
+    if (!built) build();
+    int st = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c >= KEY_ALPHABET || !trie[st][c]) return DTS_KEY_NONE;
+        st = trie[st][c];
+    }
+    return state_key[st];
+}
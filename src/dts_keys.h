@@ -0,0 +1,40 @@
+#ifndef DTS_KEYS_H
+#define DTS_KEYS_H
+
+// ==================== DTS 关键字自动机 ====================
+// dts_tool / process_dts 关心的关键字 (timing 节点、面板标记、帧率/时钟/传输时间等属性名)
+// 编成一个 Aho-Corasick 自动机，一次扫描同时匹配全部关键字，不再对每个关键字分别 strstr。
+// 解析器对每个节点名求出包含的关键字掩码 (DtsNode.keys)，对每个属性名求出其关键字 (DtsProp.key)，
+// 工具按整数比较即可；dts_keys_scan 对任意缓冲区逐个报告匹配 (类型 + 偏移)。
+// 自动机在第一次使用时构建 (不加锁，需在单线程中首次调用)。
+
+#include <stddef.h>
+
+enum {
+    DTS_KEY_NONE = 0,
+    DTS_KEY_TIMING,        // "timing@"
+    DTS_KEY_PANEL,         // "qcom,mdss_dsi_panel_"
+    DTS_KEY_PANEL_ALT,     // "qcom,mdss-dsi-panel-"
+    DTS_KEY_EVT,           // "_evt" (工程面板)
+    DTS_KEY_FHD,           // "fhd"
+    DTS_KEY_QHD,           // "qhd" (含 wqhd)
+    DTS_KEY_FRAMERATE,     // "qcom,mdss-dsi-panel-framerate"
+    DTS_KEY_CLOCKRATE,     // "qcom,mdss-dsi-panel-clockrate"
+    DTS_KEY_TRANSFER,      // "qcom,mdss-mdp-transfer-time-us"
+    DTS_KEY_CELL_INDEX,    // "cell-index"
+    DTS_KEY_PROJECT_ID,    // "oplus,project-id"
+    DTS_KEY_COUNT
+};
+
+#define DTS_KEY_BIT(key) (1u << (key))
+
+const char *dts_key_name(int key);
+
+// 报告 buf 中所有关键字出现的位置 (off 为匹配起点)，重叠的匹配都会报告
+void dts_keys_scan(const char *buf, size_t len, void (*event)(int key, size_t off, void *ctx), void *ctx);
+// s 中出现的关键字掩码
+unsigned dts_keys_mask(const char *s, size_t len);
+// s 恰好等于某个关键字时返回它，否则返回 DTS_KEY_NONE
+int dts_keys_exact(const char *s, size_t len);
+
+#endif
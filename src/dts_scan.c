@@ -0,0 +1,241 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "dts_scan.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#include <immintrin.h>
+#define SCAN_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define SCAN_NEON 1
+#endif
+
+// 每次处理 64 字节，正好对应位图的一个字
+typedef void (*ScanBlock)(const uint8_t *p, uint64_t *structural, uint64_t *newlines);
+
+static inline int is_structural(uint8_t c) {
+    return c == '{' || c == '}' || c == ';' || c == '"' || c == '\'' || c == '/' || c == '\\' || c == '\n';
+}
+
+static void block_scalar(const uint8_t *p, uint64_t *structural, uint64_t *newlines) {
+    uint64_t s = 0, n = 0;
+    for (int i = 0; i < 64; i++) {
+        s |= (uint64_t)is_structural(p[i]) << i;
+        n |= (uint64_t)(p[i] == '\n') << i;
+    }
+    *structural = s;
+    *newlines = n;
+}
+
+// 8 字节一组按 64 位整数比较 (SWAR)，没有 SIMD 指令时用。字节等于 c 时结果该字节为 0x80，否则为 0:
+// 先异或使相等字节变 0，低 7 位加 0x7f 后最高位表示"低 7 位非 0"，再并上原最高位即"非 0"
+#define SWAR_ONES 0x0101010101010101ULL
+#define SWAR_LOW7 0x7f7f7f7f7f7f7f7fULL
+#define SWAR_HIGH 0x8080808080808080ULL
+
+static inline uint64_t swar_nonzero(uint64_t x) {
+    return ((x & SWAR_LOW7) + SWAR_LOW7) | x;
+}
+
+// 每字节最高位收成 8 位掩码 (第 i 字节对应第 i 位)
+static inline uint64_t swar_movemask(uint64_t m) {
+    return ((m >> 7) * 0x0102040810204080ULL) >> 56;
+}
+
+static void block_swar(const uint8_t *p, uint64_t *structural, uint64_t *newlines) {
+    uint64_t s = 0, n = 0;
+    for (int k = 0; k < 8; k++) {
+        uint64_t x;
+        memcpy(&x, p + 8 * k, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        x = __builtin_bswap64(x);
+#endif
+        uint64_t not_nl = swar_nonzero(x ^ (SWAR_ONES * '\n'));
+        uint64_t none = not_nl & swar_nonzero(x ^ (SWAR_ONES * '{')) & swar_nonzero(x ^ (SWAR_ONES * '}'));
+        none &= swar_nonzero(x ^ (SWAR_ONES * ';')) & swar_nonzero(x ^ (SWAR_ONES * '"'));
+        none &= swar_nonzero(x ^ (SWAR_ONES * '\'')) & swar_nonzero(x ^ (SWAR_ONES * '/'));
+        none &= swar_nonzero(x ^ (SWAR_ONES * '\\'));
+        s |= swar_movemask(~none & SWAR_HIGH) << (8 * k);
+        n |= swar_movemask(~not_nl & SWAR_HIGH) << (8 * k);
+    }
+    *structural = s;
+    *newlines = n;
+}
+
+#ifdef SCAN_X86
+static void block_sse2(const uint8_t *p, uint64_t *structural, uint64_t *newlines) {
+    const __m128i lbrace = _mm_set1_epi8('{'), rbrace = _mm_set1_epi8('}'), semi = _mm_set1_epi8(';');
+    const __m128i dquote = _mm_set1_epi8('"'), squote = _mm_set1_epi8('\''), slash = _mm_set1_epi8('/');
+    const __m128i bslash = _mm_set1_epi8('\\'), nl = _mm_set1_epi8('\n');
+    uint64_t s = 0, n = 0;
+    for (int k = 0; k < 4; k++) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + 16 * k));
+        __m128i is_nl = _mm_cmpeq_epi8(v, nl);
+        __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, lbrace), _mm_cmpeq_epi8(v, rbrace));
+        m = _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(v, semi), _mm_cmpeq_epi8(v, dquote)));
+        m = _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(v, squote), _mm_cmpeq_epi8(v, slash)));
+        m = _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(v, bslash), is_nl));
+        s |= (uint64_t)(uint16_t)_mm_movemask_epi8(m) << (16 * k);
+        n |= (uint64_t)(uint16_t)_mm_movemask_epi8(is_nl) << (16 * k);
+    }
+    *structural = s;
+    *newlines = n;
+}
+
+__attribute__((target("avx2")))
+static void block_avx2(const uint8_t *p, uint64_t *structural, uint64_t *newlines) {
+    const __m256i lbrace = _mm256_set1_epi8('{'), rbrace = _mm256_set1_epi8('}'), semi = _mm256_set1_epi8(';');
+    const __m256i dquote = _mm256_set1_epi8('"'), squote = _mm256_set1_epi8('\''), slash = _mm256_set1_epi8('/');
+    const __m256i bslash = _mm256_set1_epi8('\\'), nl = _mm256_set1_epi8('\n');
+    uint64_t s = 0, n = 0;
+    for (int k = 0; k < 2; k++) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p + 32 * k));
+        __m256i is_nl = _mm256_cmpeq_epi8(v, nl);
+        __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(v, lbrace), _mm256_cmpeq_epi8(v, rbrace));
+        m = _mm256_or_si256(m, _mm256_or_si256(_mm256_cmpeq_epi8(v, semi), _mm256_cmpeq_epi8(v, dquote)));
+        m = _mm256_or_si256(m, _mm256_or_si256(_mm256_cmpeq_epi8(v, squote), _mm256_cmpeq_epi8(v, slash)));
+        m = _mm256_or_si256(m, _mm256_or_si256(_mm256_cmpeq_epi8(v, bslash), is_nl));
+        s |= (uint64_t)(uint32_t)_mm256_movemask_epi8(m) << (32 * k);
+        n |= (uint64_t)(uint32_t)_mm256_movemask_epi8(is_nl) << (32 * k);
+    }
+    *structural = s;
+    *newlines = n;
+}
+#endif
+
+#ifdef SCAN_NEON
+// 4 个比较结果 (每字节 0x00/0xff) 压成 64 位掩码: 每字节只留自己那一位，再两两相加三次
+static inline uint64_t neon_movemask(uint8x16_t m0, uint8x16_t m1, uint8x16_t m2, uint8x16_t m3) {
+    static const uint8_t weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    const uint8x16_t w = vld1q_u8(weights);
+    uint8x16_t a = vpaddq_u8(vandq_u8(m0, w), vandq_u8(m1, w));
+    uint8x16_t b = vpaddq_u8(vandq_u8(m2, w), vandq_u8(m3, w));
+    a = vpaddq_u8(a, b);
+    a = vpaddq_u8(a, a);
+    return vgetq_lane_u64(vreinterpretq_u64_u8(a), 0);
+}
+
+static inline uint8x16_t neon_classify(uint8x16_t v, uint8x16_t *is_nl) {
+    *is_nl = vceqq_u8(v, vdupq_n_u8('\n'));
+    uint8x16_t m = vorrq_u8(vceqq_u8(v, vdupq_n_u8('{')), vceqq_u8(v, vdupq_n_u8('}')));
+    m = vorrq_u8(m, vorrq_u8(vceqq_u8(v, vdupq_n_u8(';')), vceqq_u8(v, vdupq_n_u8('"'))));
+    m = vorrq_u8(m, vorrq_u8(vceqq_u8(v, vdupq_n_u8('\'')), vceqq_u8(v, vdupq_n_u8('/'))));
+    return vorrq_u8(m, vorrq_u8(vceqq_u8(v, vdupq_n_u8('\\')), *is_nl));
+}
+
+static void block_neon(const uint8_t *p, uint64_t *structural, uint64_t *newlines) {
+    uint8x16_t n0, n1, n2, n3;
+    uint8x16_t s0 = neon_classify(vld1q_u8(p), &n0);
+    uint8x16_t s1 = neon_classify(vld1q_u8(p + 16), &n1);
+    uint8x16_t s2 = neon_classify(vld1q_u8(p + 32), &n2);
+    uint8x16_t s3 = neon_classify(vld1q_u8(p + 48), &n3);
+    *structural = neon_movemask(s0, s1, s2, s3);
+    *newlines = neon_movemask(n0, n1, n2, n3);
+}
+#endif
+
+int dts_scan_supported(int impl) {
+    switch (impl) {
+    case DTS_SCAN_AUTO:
+    case DTS_SCAN_SCALAR:
+    case DTS_SCAN_SWAR:
+        return 1;
+#ifdef SCAN_X86
+    case DTS_SCAN_SSE2:
+        return 1;
+    case DTS_SCAN_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+#ifdef SCAN_NEON
+    case DTS_SCAN_NEON:
+        return 1;
+#endif
+    default:
+        return 0;
+    }
+}
+
+int dts_scan_best(void) {
+    if (dts_scan_supported(DTS_SCAN_AVX2)) return DTS_SCAN_AVX2;
+    if (dts_scan_supported(DTS_SCAN_SSE2)) return DTS_SCAN_SSE2;
+    // NEON 实现尚未在真机上对照验证 (dts_bench struct)，验证前 arm64 默认走 SWAR
+    return DTS_SCAN_SWAR;
+}
+
+const char *dts_scan_impl_name(int impl) {
+    static const char *const names[DTS_SCAN_IMPL_COUNT] = { "auto", "scalar", "swar", "sse2", "avx2", "neon" };
+    return impl >= 0 && impl < DTS_SCAN_IMPL_COUNT ? names[impl] : "";
+}
+
+static ScanBlock block_of(int impl) {
+    switch (impl) {
+    case DTS_SCAN_SWAR: return block_swar;
+#ifdef SCAN_X86
+    case DTS_SCAN_SSE2: return block_sse2;
+    case DTS_SCAN_AVX2: return block_avx2;
+#endif
+#ifdef SCAN_NEON
+    case DTS_SCAN_NEON: return block_neon;
+#endif
+    default: return block_scalar;
+    }
+}
+
+int dts_scan_build(DtsScan *scan, const char *src, size_t len, int impl) {
+    memset(scan, 0, sizeof(*scan));
+    if (impl == DTS_SCAN_AUTO) impl = dts_scan_best();
+    if (!dts_scan_supported(impl)) return 0;
+
+    size_t words = (len + 63) / 64;
+    uint64_t *bits = malloc((words ? words : 1) * 2 * sizeof(uint64_t));
+    if (!bits) return 0;
+    scan->structural = bits;
+    scan->newlines = bits + words;
+    scan->words = words;
+    scan->len = len;
+
+    ScanBlock block = block_of(impl);
+    const uint8_t *p = (const uint8_t *)src;
+    size_t full = len / 64;
+    for (size_t w = 0; w < full; w++) block(p + 64 * w, &scan->structural[w], &scan->newlines[w]);
+    if (full < words) {
+        // 尾部补 0 凑满一块 ('\0' 不是结构字符，位图超出 len 的位保持为 0)
+        uint8_t tail[64] = {0};
+        memcpy(tail, p + 64 * full, len - 64 * full);
+        block(tail, &scan->structural[full], &scan->newlines[full]);
+    }
+    return 1;
+}
+
+void dts_scan_free(DtsScan *scan) {
+    free(scan->structural);
+    memset(scan, 0, sizeof(*scan));
+}
+
+static size_t next_bit(const uint64_t *bits, size_t words, size_t len, size_t from) {
+    if (from >= len) return len;
+    size_t w = from / 64;
+    uint64_t m = bits[w] & (~0ULL << (from % 64));
+    while (!m) {
+        if (++w >= words) return len;
+        m = bits[w];
+    }
+    return w * 64 + (size_t)__builtin_ctzll(m);
+}
+
+size_t dts_scan_next(const DtsScan *scan, size_t from) {
+    return next_bit(scan->structural, scan->words, scan->len, from);
+}
+
+size_t dts_scan_next_newline(const DtsScan *scan, size_t from) {
+    return next_bit(scan->newlines, scan->words, scan->len, from);
+}
+
+size_t dts_scan_count_newlines(const DtsScan *scan, size_t off) {
+    if (off > scan->len) off = scan->len;
+    size_t count = 0, w = 0;
+    for (; w < off / 64; w++) count += (size_t)__builtin_popcountll(scan->newlines[w]);
+    if (off % 64) count += (size_t)__builtin_popcountll(scan->newlines[w] & ((1ULL << (off % 64)) - 1));
+    return count;
+}
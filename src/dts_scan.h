@@ -0,0 +1,46 @@
+#ifndef DTS_SCAN_H
+#define DTS_SCAN_H
+
+// ==================== DTS 结构字符扫描 ====================
+// 解析前对整个源文本做一次向量化扫描，把结构字符 ({ } ; " ' / \ 换行) 的位置记成位图
+// (第 i 位对应 src[i])，换行另记一张。解析器跳过属性值、字符串和行注释时按位图直接
+// 跳到下一个结构字符，不再逐字节判断；按偏移求行号用换行位图做 popcount。
+// x86 用 SSE2 (CPU 支持时自动改用 AVX2)，其他平台 (含 arm64) 用 SWAR。arm64 的 NEON
+// 实现待 dts_bench struct 在真机上验证后再设为默认，目前只能显式指定。
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum {
+    DTS_SCAN_AUTO = 0,     // 当前 CPU 可用的最快实现
+    DTS_SCAN_SCALAR,       // 逐字节，作为对照基准
+    DTS_SCAN_SWAR,         // 8 字节一组的 64 位整数运算，不依赖 SIMD
+    DTS_SCAN_SSE2,
+    DTS_SCAN_AVX2,
+    DTS_SCAN_NEON,
+    DTS_SCAN_IMPL_COUNT
+};
+
+typedef struct {
+    uint64_t *structural;  // 结构字符 (含换行)
+    uint64_t *newlines;
+    size_t words;          // 每张位图的 64 位字数
+    size_t len;
+} DtsScan;
+
+// 扫描 src[0, len)，位图用 malloc 分配；失败或该实现在当前 CPU 上不可用时返回 0
+int dts_scan_build(DtsScan *scan, const char *src, size_t len, int impl);
+void dts_scan_free(DtsScan *scan);
+
+// DTS_SCAN_AUTO 实际选用的实现 / 某个实现能否在当前 CPU 上运行
+int dts_scan_best(void);
+int dts_scan_supported(int impl);
+const char *dts_scan_impl_name(int impl);
+
+// [from, len) 中第一个结构字符 / 换行的位置，没有时返回 len
+size_t dts_scan_next(const DtsScan *scan, size_t from);
+size_t dts_scan_next_newline(const DtsScan *scan, size_t from);
+// [0, off) 中的换行数
+size_t dts_scan_count_newlines(const DtsScan *scan, size_t off);
+
+#endif
@@ -5,11 +5,18 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <ctype.h>
+#include <limits.h>
+
+#include "dts_tree.h"
+#include "fdt_edit.h"
 
-#define MAX_LINE 4096
-#define MAX_BLOCK 131072 // 128KB
 #define DIR_NAME "dtbo_dts"
 
+// Per-run storage: file/node names collected across documents are interned here,
+// paths and generated names are allocated here, all released at exit
+DtsArena g_run;
+DtsStrtab g_names;
+
 // Utils
 int is_regular_file(const char *path) {
     struct stat path_stat;
@@ -17,16 +24,6 @@ int is_regular_file(const char *path) {
     return S_ISREG(path_stat.st_mode);
 }
 
-void replace_str(char *str, const char *orig, const char *rep) {
-    char buffer[MAX_BLOCK];
-    char *p;
-    if (!(p = strstr(str, orig))) return;
-    strncpy(buffer, str, p - str);
-    buffer[p - str] = '\0';
-    sprintf(buffer + (p - str), "%s%s", rep, p + strlen(orig));
-    strcpy(str, buffer);
-}
-
 unsigned long long parse_hex_or_dec(const char *str) {
     if (strstr(str, "0x") || strstr(str, "0X")) {
         return strtoull(str, NULL, 16);
@@ -34,246 +31,245 @@ unsigned long long parse_hex_or_dec(const char *str) {
     return strtoull(str, NULL, 10);
 }
 
-// Helper: Check if line starts a panel definition
+// Parse a command-line refresh rate; returns 0 unless it is a positive decimal number
+// (fps is a divisor when recalculating the transfer time)
+int parse_fps(const char *str) {
+    char *end;
+    long fps = strtol(str, &end, 10);
+    if (end == str || *end != '\0' || fps <= 0 || fps > INT_MAX) return 0;
+    return (int)fps;
+}
+
+// Helper: Check if a node name's keywords (dts_keys_mask) mark a panel definition
 // Matches "qcom,mdss_dsi_panel_..."
-int is_panel_start(const char *line) {
+int is_panel_keys(unsigned keys) {
     // Explicitly ignore engineering panels
-    if (strstr(line, "_evt")) return 0;
+    if (keys & DTS_KEY_BIT(DTS_KEY_EVT)) return 0;
 
-    if (strstr(line, "qcom,mdss_dsi_panel_")) return 1;
     // Also support hyphens just in case
-    if (strstr(line, "qcom,mdss-dsi-panel-")) return 1;
-    return 0;
+    return (keys & (DTS_KEY_BIT(DTS_KEY_PANEL) | DTS_KEY_BIT(DTS_KEY_PANEL_ALT))) != 0;
 }
 
-// Helper: Extract panel name from line
-void extract_panel_name(const char *line, char *buffer) {
-    const char *start = strstr(line, "qcom,mdss");
-    if (!start) {
-        buffer[0] = '\0';
-        return;
-    }
-    
-    // Find end of name (space, :, {, or newline)
-    const char *p = start;
-    while (*p && !isspace((unsigned char)*p) && *p != ':' && *p != '{') {
-        p++;
+// Shared by the DTS and DTB paths
+int is_panel_name(const char *name, int name_len) {
+    return is_panel_keys(dts_keys_mask(name, name_len));
+}
+
+int is_panel_node(const DtsNode *node) {
+    return is_panel_keys(node->keys);
+}
+
+// Helper: Check if panel node matches target panel (empty target matches all panels)
+int panel_matches(const DtsNode *panel, const char *target_panel) {
+    if (!target_panel || strlen(target_panel) == 0) return 1;
+    return dts_name_eq(panel->name, panel->name_len, target_panel);
+}
+
+int is_timing_node(const DtsNode *node) {
+    return node->name_len > 7 && strncmp(node->name, "timing@", 7) == 0;
+}
+
+// Helper: Next matching panel after 'from' (NULL to start from the top)
+DtsNode *next_panel(DtsDoc *doc, DtsNode *from, const char *target_panel) {
+    DtsNode *n = from ? dts_skip(&doc->root, from) : dts_next(&doc->root, &doc->root);
+    while (n) {
+        if (is_panel_node(n)) {
+            if (panel_matches(n, target_panel)) return n;
+            n = dts_skip(&doc->root, n);
+        } else {
+            n = dts_next(&doc->root, n);
+        }
     }
-    
-    int len = p - start;
-    strncpy(buffer, start, len);
-    buffer[len] = '\0';
+    return NULL;
+}
+
+// Helper: Next timing node inside panel
+DtsNode *next_timing(DtsNode *panel, DtsNode *from) {
+    DtsNode *n = from ? dts_skip(panel, from) : dts_next(panel, panel);
+    while (n && !is_timing_node(n)) n = dts_next(panel, n);
+    return n;
+}
+
+unsigned long long timing_value(const DtsDoc *doc, const DtsNode *timing, int key) {
+    return dts_prop_u64(doc, dts_find_key(timing, key));
 }
 
 // Helper: Check if file contains matching project-id
-int check_project_id(const char *filepath, const char *target_id_str) {
+int check_project_id(const DtsDoc *doc, const char *target_id_str) {
     if (!target_id_str || strlen(target_id_str) == 0) return 1; // No check needed
-    
+
     unsigned long long target_id = parse_hex_or_dec(target_id_str);
-    FILE *fp = fopen(filepath, "r");
-    if (!fp) return 0;
-    
-    char line[MAX_LINE];
-    int matched = 0;
-    
-    while (fgets(line, sizeof(line), fp)) {
-        if (strstr(line, "oplus,project-id")) {
-            char *start = strchr(line, '<');
-            if (start) {
-                start++;
-                char *end = strchr(start, '>');
-                if (end) {
-                    *end = '\0';
-                    char *token = strtok(start, " ");
-                    while (token) {
-                        unsigned long long id = parse_hex_or_dec(token);
-                        if (id == target_id) {
-                            matched = 1;
-                            break;
-                        }
-                        token = strtok(NULL, " ");
-                    }
-                }
+    for (DtsNode *n = dts_next(&doc->root, &doc->root); n; n = dts_next(&doc->root, n)) {
+        for (DtsProp *p = n->props; p; p = p->next) {
+            if (p->key == DTS_KEY_PROJECT_ID && dts_prop_has_cell(doc, p, target_id)) {
+                return 1;
             }
         }
-        if (matched) break;
     }
-    
-    fclose(fp);
-    return matched;
+    return 0;
 }
 
 typedef struct {
-    char file[256];
-    char node[256];
-    unsigned long long fps;
-    unsigned long long clock;
-    unsigned long long transfer;
-} NodeInfo;
-
-// ---- Command: SCAN ----
-void cmd_scan(const char *target_panel, const char *project_id) {
+    const char *name;      // interned
+    const char *path;      // in g_run
+    DtsDoc doc;
+} DtsFile;
+
+// Load every .dts with matching project-id, each file is parsed exactly once.
+// The directory is listed first: parsed nodes point back at doc.root, so a DtsFile
+// must not move once its document is loaded
+int load_dts_files(const char *project_id, DtsFile **out) {
     DIR *d;
     struct dirent *dir;
-    char path[512];
-    FILE *fp;
-    char line[MAX_LINE];
-    
-    NodeInfo nodes[512];
-    int node_count = 0;
-    int has_2k = 0;
-    int scanned_any = 0;
+    DtsFile *files = NULL;
+    int total = 0, count = 0;
 
+    *out = NULL;
     d = opendir(DIR_NAME);
-    if (!d) {
-        d = opendir(".");
+    if (!d) d = opendir(".");
+    if (!d) return 0;
+
+    while ((dir = readdir(d)) != NULL) {
+        if (!strstr(dir->d_name, ".dts")) continue;
+
+        DtsFile *grown = realloc(files, (total + 1) * sizeof(DtsFile));
+        if (!grown) break;
+        files = grown;
+        DtsFile *f = &files[total];
+
+        f->name = dts_intern(&g_names, dir->d_name, strlen(dir->d_name));
+        f->path = dts_arena_printf(&g_run, "%s/%s", DIR_NAME, dir->d_name);
+        if (!f->name || !f->path) break;
+        if (access(f->path, F_OK) != 0) f->path = f->name;
+        total++;
     }
+    closedir(d);
 
-    if (d) {
-        while ((dir = readdir(d)) != NULL) {
-            if (!strstr(dir->d_name, ".dts")) continue;
-            
-            snprintf(path, sizeof(path), "%s/%s", DIR_NAME, dir->d_name);
-            if (access(path, F_OK) != 0) snprintf(path, sizeof(path), "%s", dir->d_name);
+    for (int i = 0; i < total; i++) {
+        DtsFile *f = &files[count];
+        f->name = files[i].name;
+        f->path = files[i].path;
 
-            // Project ID Check
-            if (!check_project_id(path, project_id)) {
-                continue;
-            }
-            
-            // Only scan one valid DTS file
-            if (scanned_any) {
-                 continue;
+        if (!dts_load(&f->doc, f->path)) {
+            printf("Error: failed to parse %s (%s), skipped\n", f->name, f->doc.error);
+            dts_free(&f->doc);
+            continue;
+        }
+
+        // Project ID Check
+        if (!check_project_id(&f->doc, project_id)) {
+            dts_free(&f->doc);
+            continue;
+        }
+        count++;
+    }
+
+    *out = files;
+    return count;
+}
+
+void free_dts_files(DtsFile *files, int count) {
+    for (int i = 0; i < count; i++) dts_free(&files[i].doc);
+    free(files);
+}
+
+int save_dts_file(DtsFile *f) {
+    const char *temp_path = dts_arena_printf(&g_run, "%s.tmp", f->path);
+    if (!temp_path || !dts_write_file(&f->doc, temp_path)) {
+        printf("Error: failed to write %s\n", temp_path);
+        remove(temp_path);
+        return 0;
+    }
+    remove(f->path);
+    rename(temp_path, f->path);
+    return 1;
+}
+
+// Renumber cell-index of the panel's timings in document order.
+// Nodes named skip_name are being removed; a new node inserted after insert_after takes the next index,
+// which is returned (-1 if none)
+int renumber_cell_index(DtsDoc *doc, DtsNode *panel, const char *skip_name, const DtsNode *insert_after) {
+    int index = 0;
+    int new_index = -1;
+    DtsNode *n = dts_next(panel, panel);
+    while (n) {
+        if (skip_name && dts_name_eq(n->name, n->name_len, skip_name)) {
+            n = dts_skip(panel, n);
+            continue;
+        }
+        DtsProp *p = dts_find_key(n, DTS_KEY_CELL_INDEX);
+        if (p) {
+            unsigned long long cur = 0;
+            if (!dts_prop_cell(doc, p, 0, &cur) || cur != (unsigned long long)index) {
+                char cells[32];
+                snprintf(cells, sizeof(cells), "0x%x", index);
+                dts_set_cells(doc, p, cells);
             }
+            index++;
+        }
+        if (n == insert_after) new_index = index++;
+        n = dts_next(panel, n);
+    }
+    return new_index;
+}
 
-            fp = fopen(path, "r");
-            if (!fp) continue;
-
-            char current_node[256] = "";
-            unsigned long long fps = 0;
-            unsigned long long clock = 0;
-            unsigned long long transfer = 0;
-            int in_timing = 0;
-            int timing_brace_depth = 0;
-            
-            // Filtering vars
-            int in_panel = 0;
-            int panel_brace_depth = 0;
-
-            while (fgets(line, sizeof(line), fp)) {
-                // Check for Panel Block Entry
-                if (!in_panel && is_panel_start(line)) {
-                    if (target_panel && strlen(target_panel) > 0) {
-                        char panel_name[256];
-                        extract_panel_name(line, panel_name);
-                        if (strcmp(panel_name, target_panel) != 0) {
-                            // Skip this panel if it doesn't match target
-                            continue;
-                        }
-                    }
-                    in_panel = 1;
-                    panel_brace_depth = 0;
-                }
+typedef struct NodeInfo {
+    const char *file;      // interned
+    const char *node;      // interned
+    unsigned long long fps;
+    unsigned long long clock;
+    unsigned long long transfer;
+    unsigned keys;
+    struct NodeInfo *next;
+} NodeInfo;
 
-                // Track Panel Block Braces
-                if (in_panel) {
-                    char *p = line;
-                    while (*p) {
-                        if (*p == '{') panel_brace_depth++;
-                        if (*p == '}') panel_brace_depth--;
-                        p++;
-                    }
-                    
-                    // If we closed the panel block
-                    if (panel_brace_depth <= 0 && strstr(line, "};")) {
-                        in_panel = 0;
-                    }
-                }
+// ---- Command: SCAN ----
+void cmd_scan(const char *target_panel, const char *project_id) {
+    DtsFile *files;
+    int file_count = load_dts_files(project_id, &files);
 
-                // Only scan timings if inside panel
-                if (in_panel) {
-                    if (strstr(line, "timing@")) {
-                        char *start = strstr(line, "timing@");
-                        char *end = start + strlen("timing@");
-                        
-                        // Find end of node name (space, {, or newline)
-                        while (*end && !isspace((unsigned char)*end) && *end != '{') {
-                            end++;
-                        }
-                        
-                        if (end > start) {
-                            int len = end - start;
-                            if (len >= sizeof(current_node)) len = sizeof(current_node) - 1;
-                            strncpy(current_node, start, len);
-                            current_node[len] = '\0';
-                            
-                            in_timing = 1;
-                            timing_brace_depth = 0;
-                            fps = 0; clock = 0; transfer = 0;
-                        }
-                    }
+    // Kept after the documents are freed, so strings are interned rather than pointing into them
+    NodeInfo *nodes = NULL, **tail = &nodes;
+    int has_2k = 0;
 
-                    if (in_timing) {
-                        char *p = line;
-                        while (*p) {
-                            if (*p == '{') timing_brace_depth++;
-                            if (*p == '}') timing_brace_depth--;
-                            p++;
-                        }
-
-                        char *val_start;
-                        if ((val_start = strstr(line, "qcom,mdss-dsi-panel-framerate"))) {
-                            char *v = strchr(val_start, '<');
-                            if (v) fps = parse_hex_or_dec(v + 1);
-                        }
-                        if ((val_start = strstr(line, "qcom,mdss-dsi-panel-clockrate"))) {
-                            char *v = strchr(val_start, '<');
-                            if (v) clock = parse_hex_or_dec(v + 1);
-                        }
-                        if ((val_start = strstr(line, "qcom,mdss-mdp-transfer-time-us"))) {
-                            char *v = strchr(val_start, '<');
-                            if (v) transfer = parse_hex_or_dec(v + 1);
-                        }
-
-                        if (timing_brace_depth == 0 && strstr(line, "};")) {
-                            // Filter 1: Only show standard display modes (WQHD/FHD/QHD) to avoid AOD/Test nodes
-                            int is_display_mode = 0;
-                            if (strstr(current_node, "wqhd") || strstr(current_node, "fhd") || strstr(current_node, "qhd")) {
-                                is_display_mode = 1;
-                            }
-
-                            // Filter 2: Exclude low FPS (<48Hz)
-                            if (is_display_mode && fps >= 48) {
-                                if (node_count < 512) {
-                                    strncpy(nodes[node_count].file, dir->d_name, 255);
-                                    strncpy(nodes[node_count].node, current_node, 255);
-                                    nodes[node_count].fps = fps;
-                                    nodes[node_count].clock = clock;
-                                    nodes[node_count].transfer = transfer;
-                                    
-                                    if (strstr(current_node, "wqhd") || strstr(current_node, "qhd")) {
-                                        has_2k = 1;
-                                    }
-                                    node_count++;
-                                }
-                            }
-                            
-                            in_timing = 0;
-                        }
+    // Only scan one valid DTS file
+    if (file_count > 0) {
+        DtsDoc *doc = &files[0].doc;
+        for (DtsNode *panel = next_panel(doc, NULL, target_panel); panel; panel = next_panel(doc, panel, target_panel)) {
+            for (DtsNode *t = next_timing(panel, NULL); t; t = next_timing(panel, t)) {
+                unsigned long long fps = timing_value(doc, t, DTS_KEY_FRAMERATE);
+
+                // Filter 1: Only show standard display modes (WQHD/FHD/QHD) to avoid AOD/Test nodes
+                // ("qhd" also covers "wqhd")
+                int is_display_mode = (t->keys & (DTS_KEY_BIT(DTS_KEY_FHD) | DTS_KEY_BIT(DTS_KEY_QHD))) != 0;
+
+                // Filter 2: Exclude low FPS (<48Hz)
+                if (is_display_mode && fps >= 48) {
+                    NodeInfo *info = dts_arena_alloc(&g_run, sizeof(NodeInfo));
+                    if (!info) break;
+                    info->file = files[0].name;
+                    info->node = dts_intern(&g_names, t->name, t->name_len);
+                    info->fps = fps;
+                    info->clock = timing_value(doc, t, DTS_KEY_CLOCKRATE);
+                    info->transfer = timing_value(doc, t, DTS_KEY_TRANSFER);
+                    info->keys = t->keys;
+                    *tail = info;
+                    tail = &info->next;
+
+                    if (t->keys & DTS_KEY_BIT(DTS_KEY_QHD)) {
+                        has_2k = 1;
                     }
                 }
             }
-            fclose(fp);
-            scanned_any = 1;
         }
-        closedir(d);
     }
-    
+    free_dts_files(files, file_count);
+
     // Output JSON
     printf("[\n");
     int first = 1;
-    for (int i = 0; i < node_count; i++) {
-        int is_fhd = (strstr(nodes[i].node, "fhd") != NULL);
+    for (NodeInfo *info = nodes; info; info = info->next) {
+        int is_fhd = (info->keys & DTS_KEY_BIT(DTS_KEY_FHD)) != 0;
         
         // If 2K exists, hide FHD
         if (has_2k && is_fhd) {
@@ -282,710 +278,371 @@ void cmd_scan(const char *target_panel, const char *project_id) {
         
         if (!first) printf(",\n");
         printf("  {\"file\": \"%s\", \"node\": \"%s\", \"fps\": %llu, \"clock\": %llu, \"transfer\": %llu}",
-               nodes[i].file, nodes[i].node, nodes[i].fps, nodes[i].clock, nodes[i].transfer);
+               info->file, info->node, info->fps, info->clock, info->transfer);
         first = 0;
     }
     printf("\n]\n");
 }
 
 void cmd_remove(const char *target_node, const char *target_panel, const char *project_id) {
-    DIR *d;
-    struct dirent *dir;
-    char path[512];
-    char temp_path[512];
-    
-    d = opendir(DIR_NAME);
-    if (!d) d = opendir(".");
-
-    if (d) {
-        while ((dir = readdir(d)) != NULL) {
-            if (!strstr(dir->d_name, ".dts")) continue;
-            
-            snprintf(path, sizeof(path), "%s/%s", DIR_NAME, dir->d_name);
-            if (access(path, F_OK) != 0) snprintf(path, sizeof(path), "%s", dir->d_name);
-            
-            // Project ID Check
-            if (!check_project_id(path, project_id)) {
-                continue;
-            }
-
-            snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
-
-            FILE *in = fopen(path, "r");
-            FILE *out = fopen(temp_path, "w");
-            if (!in || !out) continue;
-
-            char line[MAX_LINE];
-            int skipping = 0;
-            int brace_depth = 0; 
-            int modified = 0;
-            
-            // Scope filtering
-            int in_panel = 0;
-            int panel_brace_depth = 0;
-            int panel_matched = 1; // Default to match if no target_panel
-            int current_index = 0;
-
-            while (fgets(line, sizeof(line), in)) {
-                if (!in_panel && is_panel_start(line)) {
-                    if (target_panel && strlen(target_panel) > 0) {
-                        char panel_name[256];
-                        extract_panel_name(line, panel_name);
-                        if (strcmp(panel_name, target_panel) != 0) {
-                            panel_matched = 0;
-                        } else {
-                            panel_matched = 1;
-                        }
-                    } else {
-                        panel_matched = 1;
-                    }
-
-                    in_panel = 1;
-                    panel_brace_depth = 0;
-                    current_index = 0;
-                }
-
-                if (in_panel) {
-                    char *p = line;
-                    while (*p) {
-                        if (*p == '{') panel_brace_depth++;
-                        if (*p == '}') panel_brace_depth--;
-                        p++;
-                    }
-                    if (panel_brace_depth <= 0 && strstr(line, "};")) {
-                        in_panel = 0;
-                        panel_matched = 0; // Reset match status outside panel
-                    }
-                }
-
-                if (!skipping) {
-                    int match = 0;
-                    // Only match nodes if we are inside the CORRECT panel
-                    if (in_panel && panel_matched) {
-                        char *loc = strstr(line, target_node);
-                        if (loc) {
-                            char *after = loc + strlen(target_node);
-                            int is_valid_end = 0;
-                            while (*after && isspace((unsigned char)*after)) after++;
-                            if (*after == '{' || *after == '\0' || *after == '\r' || *after == '\n') {
-                                is_valid_end = 1;
-                            }
-                            if (is_valid_end) {
-                                match = 1;
-                            }
-                        }
-                    }
-
-                    if (match) {
-                        skipping = 1;
-                        brace_depth = 0;
-                        char *p = line;
-                        while (*p) {
-                            if (*p == '{') brace_depth++;
-                            if (*p == '}') brace_depth--;
-                            p++;
-                        }
-                        if (brace_depth <= 0 && strstr(line, "};")) {
-                            skipping = 0; 
-                        }
-                        modified = 1;
-                        printf("Removing node: %s from %s (Panel Match: Yes)\n", target_node, dir->d_name);
-                        continue; 
-                    }
-                    
-                    // Re-indexing logic for REMOVE
-                    if (in_panel && panel_matched && strstr(line, "cell-index")) {
-                        char *start = strchr(line, '<');
-                        if (start) {
-                            char *end = strchr(start, '>');
-                            if (end) {
-                                *end = '\0';
-                                char prefix[MAX_LINE];
-                                strncpy(prefix, line, start - line + 1);
-                                prefix[start - line + 1] = '\0';
-                                
-                                char suffix[MAX_LINE];
-                                strcpy(suffix, end + 1);
-                                
-                                fprintf(out, "%s0x%x>%s", prefix, current_index++, suffix);
-                                continue; 
-                            }
-                        }
-                    }
+    DtsFile *files;
+    int file_count = load_dts_files(project_id, &files);
+
+    for (int i = 0; i < file_count; i++) {
+        DtsDoc *doc = &files[i].doc;
+        int modified = 0;
+
+        // Only match nodes if we are inside the CORRECT panel
+        for (DtsNode *panel = next_panel(doc, NULL, target_panel); panel; panel = next_panel(doc, panel, target_panel)) {
+            int removed = 0;
+            for (DtsNode *n = dts_next(panel, panel); n; ) {
+                if (dts_name_eq(n->name, n->name_len, target_node)) {
+                    dts_remove_node(doc, n);
+                    removed = 1;
+                    printf("Removing node: %s from %s (Panel Match: Yes)\n", target_node, files[i].name);
+                    n = dts_skip(panel, n);
                 } else {
-                    char *p = line;
-                    while (*p) {
-                        if (*p == '{') brace_depth++;
-                        if (*p == '}') brace_depth--;
-                        p++;
-                    }
-                    if (brace_depth <= 0 && strstr(line, "};")) {
-                        skipping = 0;
-                    }
-                    continue; 
+                    n = dts_next(panel, n);
                 }
-
-                fputs(line, out);
             }
 
-            fclose(in);
-            fclose(out);
-
-            if (modified) {
-                remove(path); 
-                rename(temp_path, path);
-            } else {
-                remove(temp_path);
+            // Re-indexing logic for REMOVE
+            if (removed) {
+                renumber_cell_index(doc, panel, target_node, NULL);
+                modified = 1;
             }
         }
-        closedir(d);
+
+        if (modified) save_dts_file(&files[i]);
     }
+    free_dts_files(files, file_count);
 }
 
-// ---- Command: ADD (Internal) ----
-void internal_add_node(const char *filename, const char *base_node, int target_fps, const char *target_panel) {
-    char path[512];
-    char temp_path[512];
-    snprintf(path, sizeof(path), "%s/%s", DIR_NAME, filename);
-    if (access(path, F_OK) != 0) snprintf(path, sizeof(path), "%s", filename);
-    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
-
-    FILE *in = fopen(path, "r");
-    if (!in) return;
-
-    // 1. Capture Base Node Content
-    char base_content[MAX_BLOCK] = "";
-    unsigned long long base_clock = 0;
-    unsigned long long base_transfer = 0;
-    unsigned long long base_fps = 0;
-    
-    char line[MAX_LINE];
-    int capturing = 0;
-    int brace_depth = 0;
-    int found_base = 0;
-    
-    int in_panel = 0;
-    int panel_brace_depth = 0;
-    int panel_matched = 1;
-
-    int target_exists = 0;
-    char target_node_name[128];
-    
-    // Predict target node name based on base_node
-    strcpy(target_node_name, base_node);
-    char *last_underscore = strrchr(target_node_name, '_');
+// Name of the node generated from base_node: its last "_<n>" suffix becomes the target fps
+const char *target_node_name_of(const char *base_node, int target_fps) {
+    const char *last_underscore = strrchr(base_node, '_');
     if (last_underscore) {
-        sprintf(last_underscore + 1, "%d", target_fps);
-    } else {
-        sprintf(target_node_name, "%s_%d", base_node, target_fps);
+        return dts_arena_printf(&g_run, "%.*s%d", (int)(last_underscore + 1 - base_node), base_node, target_fps);
     }
+    return dts_arena_printf(&g_run, "%s_%d", base_node, target_fps);
+}
+
+// ---- Command: ADD (Internal) ----
+// Returns 1 if the node was added
+int internal_add_node(DtsFile *f, const char *base_node, int target_fps, const char *target_panel) {
+    DtsDoc *doc = &f->doc;
+
+    // Predict target node name based on base_node
+    const char *target_node_name = target_node_name_of(base_node, target_fps);
+    if (!target_node_name) return 0;
 
     // Pre-check for existence
-    FILE *pre_check = fopen(path, "r");
-    if (pre_check) {
-        char pre_buf[MAX_LINE];
-        while (fgets(pre_buf, sizeof(pre_buf), pre_check)) {
-             if (strstr(pre_buf, "timing@") && strstr(pre_buf, target_node_name)) {
-                 target_exists = 1;
-                 break;
-             }
-        }
-        fclose(pre_check);
+    if (dts_find_node(doc, target_node_name)) {
+        printf("Skipping: %s already exists in %s\n", target_node_name, f->name);
+        return 0;
     }
 
-    if (target_exists) {
-        printf("Skipping: %s already exists in %s\n", target_node_name, filename);
-        fclose(in);
-        return;
+    // 1. Find Base Node (only in the correct panel)
+    DtsNode *panel = NULL;
+    DtsNode *base = NULL;
+    for (panel = next_panel(doc, NULL, target_panel); panel && !base; ) {
+        for (DtsNode *n = dts_next(panel, panel); n; n = dts_next(panel, n)) {
+            if (dts_name_eq(n->name, n->name_len, base_node)) {
+                base = n;
+                break;
+            }
+        }
+        if (!base) panel = next_panel(doc, panel, target_panel);
+    }
+    if (!base) {
+        // printf("Error: Base node %s not found in %s (or wrong panel)\n", base_node, f->name);
+        return 0;
     }
 
-    while (fgets(line, sizeof(line), in)) {
-        if (!in_panel && is_panel_start(line)) {
-            if (target_panel && strlen(target_panel) > 0) {
-                char panel_name[256];
-                extract_panel_name(line, panel_name);
-                if (strcmp(panel_name, target_panel) != 0) {
-                    panel_matched = 0;
-                } else {
-                    panel_matched = 1;
-                }
+    unsigned long long base_fps = timing_value(doc, base, DTS_KEY_FRAMERATE);
+    unsigned long long base_clock = timing_value(doc, base, DTS_KEY_CLOCKRATE);
+    unsigned long long base_transfer = timing_value(doc, base, DTS_KEY_TRANSFER);
+
+    // 2. Auto-sort cell-index for existing nodes, the new node goes right after the base node
+    int new_index = renumber_cell_index(doc, panel, NULL, base);
+
+    // 3. Generate New Node Content: base node with new name and recalculated values,
+    // kept as spans of the base node's text and written out on its own line after it
+    DtsPieces pcs = {0};
+    const char *lead = dts_arena_printf(&doc->arena, "\n%s", dts_line_indent(doc, base->start));
+    if (!lead || !dts_pieces_text(doc, &pcs, lead) || !dts_pieces_node(doc, &pcs, base, target_node_name)) return 0;
+
+    if (base_fps > 0) {
+        unsigned long long new_clock = base_clock * target_fps / base_fps;
+        unsigned long long new_transfer = base_transfer * base_fps / target_fps;
+        char cells[32];
+
+        for (DtsProp *p = base->props; p; p = p->next) {
+            if (p->key == DTS_KEY_CLOCKRATE) {
+                snprintf(cells, sizeof(cells), "%llu", new_clock);
+            } else if (p->key == DTS_KEY_FRAMERATE) {
+                snprintf(cells, sizeof(cells), "0x%x", target_fps);
+            } else if (p->key == DTS_KEY_TRANSFER) {
+                snprintf(cells, sizeof(cells), "%llu", new_transfer);
+            } else if (p->key == DTS_KEY_CELL_INDEX && new_index >= 0) {
+                snprintf(cells, sizeof(cells), "0x%x", new_index);
             } else {
-                panel_matched = 1;
+                continue;
             }
-
-            in_panel = 1;
-            panel_brace_depth = 0;
+            dts_pieces_set_cells(doc, &pcs, p, cells);
         }
+    }
+    if (!dts_insert_pieces(doc, base->end, &pcs)) return 0;
 
-        if (in_panel) {
-            char *p = line;
-            while (*p) {
-                if (*p == '{') panel_brace_depth++;
-                if (*p == '}') panel_brace_depth--;
-                p++;
-            }
-            if (panel_brace_depth <= 0 && strstr(line, "};")) {
-                in_panel = 0;
-                panel_matched = 0;
-            }
-        }
-        
-        // Only process if we are in the correct panel
-        if (in_panel && panel_matched) {
-            if (strstr(line, base_node)) {
-                char *loc = strstr(line, base_node);
-                 if (loc) {
-                     char *after = loc + strlen(base_node);
-                     while (*after && isspace((unsigned char)*after)) after++;
-                     if (*after == '{' || *after == '\0' || *after == '\r' || *after == '\n') {
-                         capturing = 1;
-                         found_base = 1;
-                         
-                         // Fix target node name to match base node pattern
-                         strcpy(target_node_name, base_node);
-                         char *last_underscore = strrchr(target_node_name, '_');
-                         if (last_underscore) {
-                             sprintf(last_underscore + 1, "%d", target_fps);
-                         } else {
-                             // Fallback
-                             sprintf(target_node_name, "%s_%d", base_node, target_fps);
-                         }
-                     }
-                 }
-            }
-        }
-        
-        if (capturing) {
-            if (strlen(base_content) + strlen(line) < MAX_BLOCK) {
-                strcat(base_content, line);
-            }
-            
-            char *p = line;
-            while (*p) {
-                if (*p == '{') brace_depth++;
-                if (*p == '}') brace_depth--;
-                p++;
-            }
+    printf("Added node %s (%dHz) to %s (Panel Match: Yes)\n", target_node_name, target_fps, f->name);
+    return 1;
+}
 
-            char *val;
-            if ((val = strstr(line, "qcom,mdss-dsi-panel-framerate"))) {
-                char *v = strchr(val, '<'); if(v) base_fps = parse_hex_or_dec(v+1);
-            }
-            if ((val = strstr(line, "qcom,mdss-dsi-panel-clockrate"))) {
-                char *v = strchr(val, '<'); if(v) base_clock = parse_hex_or_dec(v+1);
-            }
-            if ((val = strstr(line, "qcom,mdss-mdp-transfer-time-us"))) {
-                char *v = strchr(val, '<'); if(v) base_transfer = parse_hex_or_dec(v+1);
-            }
 
-            if (brace_depth <= 0 && strstr(line, "};")) {
-                capturing = 0;
-            }
+void cmd_add(const char *base_node, int target_fps, const char *target_panel, const char *project_id) {
+    DtsFile *files;
+    int file_count = load_dts_files(project_id, &files);
+
+    for (int i = 0; i < file_count; i++) {
+        if (internal_add_node(&files[i], base_node, target_fps, target_panel)) {
+            save_dts_file(&files[i]);
         }
     }
-    rewind(in); 
+    free_dts_files(files, file_count);
+}
 
-    if (!found_base) {
-        // printf("Error: Base node %s not found in %s (or wrong panel)\n", base_node, filename);
-        fclose(in);
-        remove(temp_path);
-        return;
-    }
+// ---- Command: SMART ADD ----
+void cmd_smart_add(int target_fps, const char *target_panel, const char *project_id) {
+    DtsFile *files;
+    int file_count = load_dts_files(project_id, &files);
 
-    // 2. Write new file with appended node
-    FILE *out = fopen(temp_path, "w");
-    if (!out) { fclose(in); return; }
-
-    int inserted = 0;
-    in_panel = 0;
-    panel_brace_depth = 0;
-    panel_matched = 1;
-    
-    int in_base_node = 0;
-    int base_node_brace_depth = 0;
-    int current_index = 0;
-
-    while (fgets(line, sizeof(line), in)) {
-        if (!in_panel && is_panel_start(line)) {
-            if (target_panel && strlen(target_panel) > 0) {
-                char panel_name[256];
-                extract_panel_name(line, panel_name);
-                if (strcmp(panel_name, target_panel) != 0) {
-                    panel_matched = 0;
-                } else {
-                    panel_matched = 1;
+    // 1. Scan for best base node
+    const char *best_base_node = NULL;
+    long long best_diff = 999999;
+    const char *best_file = NULL;
+
+    for (int i = 0; i < file_count; i++) {
+        DtsDoc *doc = &files[i].doc;
+        // Only scan timings if in correct panel
+        for (DtsNode *panel = next_panel(doc, NULL, target_panel); panel; panel = next_panel(doc, panel, target_panel)) {
+            for (DtsNode *t = next_timing(panel, NULL); t; t = next_timing(panel, t)) {
+                unsigned long long fps = timing_value(doc, t, DTS_KEY_FRAMERATE);
+                // Candidate found
+                if (fps > 0) {
+                    long long diff = (long long)fps - target_fps;
+                    if (diff < 0) diff = -diff;
+
+                    // Heuristic: Find closest FPS
+                    if (diff < best_diff) {
+                        best_diff = diff;
+                        best_base_node = dts_intern(&g_names, t->name, t->name_len);
+                        best_file = files[i].name;
+                    }
                 }
-            } else {
-                panel_matched = 1;
             }
-
-            in_panel = 1;
-            panel_brace_depth = 0;
-            current_index = 0;
         }
+    }
 
-        if (in_panel) {
-            char *p = line;
-            while (*p) {
-                if (*p == '{') panel_brace_depth++;
-                if (*p == '}') panel_brace_depth--;
-                p++;
-            }
-            if (panel_brace_depth <= 0 && strstr(line, "};")) {
-                in_panel = 0;
-                // panel_matched reset below
-            }
-        }
+    if (best_base_node) {
+        printf("Smart Add: Best base node %s found in %s\n", best_base_node, best_file);
 
-        // Auto-sort cell-index for existing nodes
-        if (in_panel && panel_matched && strstr(line, "cell-index")) {
-            char *start = strchr(line, '<');
-            if (start) {
-                char *end = strchr(start, '>');
-                if (end) {
-                    *end = '\0';
-                    char prefix[MAX_LINE];
-                    strncpy(prefix, line, start - line + 1);
-                    prefix[start - line + 1] = '\0';
-                    
-                    char suffix[MAX_LINE];
-                    strcpy(suffix, end + 1);
-                    
-                    fprintf(out, "%s0x%x>%s", prefix, current_index++, suffix);
-                    
-                    // Logic to insert AFTER the base node closes (check if this was the base node's cell-index - usually inside node)
-                    // We handle insertion check below
-                    // BUT we must continue to skip fputs
-                    goto check_insertion;
-                }
+        // Apply to ALL matching files, not just the best file
+        for (int i = 0; i < file_count; i++) {
+            if (internal_add_node(&files[i], best_base_node, target_fps, target_panel)) {
+                save_dts_file(&files[i]);
             }
         }
+    } else {
+        printf("Smart Add: No suitable base node found.\n");
+    }
+    free_dts_files(files, file_count);
+}
 
-        fputs(line, out);
-
-check_insertion:
-        // Logic to insert AFTER the base node closes
-        if (in_panel && panel_matched && !inserted && found_base) {
-            if (!in_base_node) {
-                 if (strstr(line, base_node)) {
-                     char *loc = strstr(line, base_node);
-                     char *after = loc + strlen(base_node);
-                     while (*after && isspace((unsigned char)*after)) after++;
-                     if (*after == '{' || *after == '\0' || *after == '\r' || *after == '\n') {
-                         in_base_node = 1;
-                         base_node_brace_depth = 0;
-                     }
-                 }
-            }
-            
-            if (in_base_node) {
-                 char *p = line;
-                 while (*p) {
-                     if (*p == '{') base_node_brace_depth++;
-                     if (*p == '}') base_node_brace_depth--;
-                     p++;
-                 }
-                 
-                 if (base_node_brace_depth <= 0 && strstr(line, "};")) {
-                    // Base node closed. Insert new node here.
-                    
-                    // Generate New Node Content
-                    replace_str(base_content, base_node, target_node_name);
-                    
-                    // Calc new values
-                    if (base_fps > 0) {
-                        unsigned long long new_clock = base_clock * target_fps / base_fps;
-                        unsigned long long new_transfer = base_transfer * base_fps / target_fps;
-                        
-                        // Line-by-line replacement for safety and correctness
-                        char *ptr = base_content;
-                        char new_block[MAX_BLOCK] = "";
-                        char line_buf[MAX_LINE];
-                        
-                        while (ptr && *ptr) {
-                            char *eol = strchr(ptr, '\n');
-                            int len;
-                            if (eol) {
-                                len = eol - ptr + 1;
-                            } else {
-                                len = strlen(ptr);
-                            }
-                            
-                            strncpy(line_buf, ptr, len);
-                            line_buf[len] = '\0';
-                            
-                            // Check for keys to replace
-                            if (strstr(line_buf, "qcom,mdss-dsi-panel-clockrate")) {
-                                char *start = strchr(line_buf, '<');
-                                if (start) {
-                                    char *end = strchr(start, '>');
-                                    if (end) {
-                                        *end = '\0';
-                                        char prefix[MAX_LINE];
-                                        strncpy(prefix, line_buf, start - line_buf + 1);
-                                        prefix[start - line_buf + 1] = '\0';
-                                        
-                                        char suffix[MAX_LINE];
-                                        strcpy(suffix, end + 1);
-                                        
-                                        sprintf(line_buf, "%s%llu>%s", prefix, new_clock, suffix);
-                                    }
-                                }
-                            } else if (strstr(line_buf, "qcom,mdss-dsi-panel-framerate")) {
-                                char *start = strchr(line_buf, '<');
-                                if (start) {
-                                    char *end = strchr(start, '>');
-                                    if (end) {
-                                        *end = '\0';
-                                        char prefix[MAX_LINE];
-                                        strncpy(prefix, line_buf, start - line_buf + 1);
-                                        prefix[start - line_buf + 1] = '\0';
-                                        
-                                        char suffix[MAX_LINE];
-                                        strcpy(suffix, end + 1);
-                                        
-                                        sprintf(line_buf, "%s0x%x>%s", prefix, target_fps, suffix);
-                                    }
-                                }
-                            } else if (strstr(line_buf, "qcom,mdss-mdp-transfer-time-us")) {
-                                char *start = strchr(line_buf, '<');
-                                if (start) {
-                                    char *end = strchr(start, '>');
-                                    if (end) {
-                                        *end = '\0';
-                                        char prefix[MAX_LINE];
-                                        strncpy(prefix, line_buf, start - line_buf + 1);
-                                        prefix[start - line_buf + 1] = '\0';
-                                        
-                                        char suffix[MAX_LINE];
-                                        strcpy(suffix, end + 1);
-                                        
-                                        sprintf(line_buf, "%s%llu>%s", prefix, new_transfer, suffix);
-                                    }
-                                }
-                            } else if (strstr(line_buf, "cell-index")) {
-                                // Already handled? No, we need to handle it here too for the new node content
-                                char *start = strchr(line_buf, '<');
-                                if (start) {
-                                    char *end = strchr(start, '>');
-                                    if (end) {
-                                        *end = '\0';
-                                        char prefix[MAX_LINE];
-                                        strncpy(prefix, line_buf, start - line_buf + 1);
-                                        prefix[start - line_buf + 1] = '\0';
-                                        
-                                        char suffix[MAX_LINE];
-                                        strcpy(suffix, end + 1);
-                                        
-                                        sprintf(line_buf, "%s0x%x>%s", prefix, current_index++, suffix);
-                                    }
-                                }
-                            }
-
-                            strcat(new_block, line_buf);
-                            
-                            if (eol) ptr = eol + 1;
-                            else break;
-                        }
-                        strcpy(base_content, new_block);
-                    }
-                    
-                    fprintf(out, "\n%s", base_content);
-                    inserted = 1;
-                    printf("Added node %s (%dHz) to %s (Panel Match: Yes)\n", target_node_name, target_fps, filename);
-                    
-                    in_base_node = 0;
-                 }
-            }
-        }
+// ==================== DTB commands ====================
+// Same edits as add/remove, applied directly to a compiled overlay (.dtb) through fdt_edit,
+// so no dtc decompile/recompile round-trip is needed
+
+// Read the whole file; the blob must outlive the FdtTree built on it
+uint8_t *read_blob(const char *path, size_t *size) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    fseek(fp, 0, SEEK_END);
+    long len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    uint8_t *blob = len > 0 ? malloc(len) : NULL;
+    if (blob && fread(blob, 1, len, fp) != (size_t)len) {
+        free(blob);
+        blob = NULL;
+    }
+    fclose(fp);
+    *size = blob ? (size_t)len : 0;
+    return blob;
+}
+
+int save_dtb(const FdtTree *tree, const char *path) {
+    uint8_t *out;
+    size_t len = fdt_emit(tree, &out);
+    if (!len) {
+        printf("Error: failed to build %s\n", path);
+        return 0;
+    }
+    const char *temp_path = dts_arena_printf(&g_run, "%s.tmp", path);
+    FILE *fp = temp_path ? fopen(temp_path, "wb") : NULL;
+    int ok = fp && fwrite(out, 1, len, fp) == len;
+    if (fp && fclose(fp) != 0) ok = 0;
+    free(out);
+    if (!ok) {
+        printf("Error: failed to write %s\n", temp_path);
+        remove(temp_path);
+        return 0;
     }
-    
-    fclose(in);
-    fclose(out);
-    
     remove(path);
     rename(temp_path, path);
+    return 1;
 }
 
-
-void cmd_add(const char *base_node, int target_fps, const char *target_panel, const char *project_id) {
-    DIR *d;
-    struct dirent *dir;
-    char path[512];
-    d = opendir(DIR_NAME);
-    if (!d) d = opendir(".");
-    if (d) {
-        while ((dir = readdir(d)) != NULL) {
-            if (!strstr(dir->d_name, ".dts")) continue;
-            snprintf(path, sizeof(path), "%s/%s", DIR_NAME, dir->d_name);
-            if (access(path, F_OK) != 0) snprintf(path, sizeof(path), "%s", dir->d_name);
-            
-            // Project ID Check
-            if (!check_project_id(path, project_id)) {
-                continue;
-            }
-            
-            internal_add_node(dir->d_name, base_node, target_fps, target_panel);
+FdtNode *next_dtb_panel(FdtTree *tree, FdtNode *from, const char *target_panel) {
+    FdtNode *n = from ? fdt_skip(tree->root, from) : fdt_next(tree->root, tree->root);
+    while (n) {
+        if (is_panel_name(n->name, (int)strlen(n->name))) {
+            if (!target_panel || strlen(target_panel) == 0 || strcmp(n->name, target_panel) == 0) return n;
+            n = fdt_skip(tree->root, n);
+        } else {
+            n = fdt_next(tree->root, n);
         }
+    }
+    return NULL;
+}
 
-        closedir(d);
+// Renumber cell-index of the panel's nodes in tree order
+void renumber_dtb_cell_index(FdtTree *tree, FdtNode *panel) {
+    uint32_t index = 0;
+    for (FdtNode *n = fdt_next(panel, panel); n; n = fdt_next(panel, n)) {
+        FdtProp *p = fdt_prop(n, "cell-index");
+        if (!p) continue;
+        uint32_t cur;
+        if (!fdt_prop_u32(p, 0, &cur) || cur != index || p->len != 4) fdt_set_u32(tree, n, "cell-index", index);
+        index++;
     }
 }
 
-// ---- Command: SMART ADD ----
-void cmd_smart_add(int target_fps, const char *target_panel, const char *project_id) {
-    // 1. Scan for best base node
-    DIR *d;
-    struct dirent *dir;
-    char path[512];
-    
-    char best_base_node[128] = "";
-    unsigned long long best_diff = 999999;
-    char best_file[256] = "";
+unsigned long long dtb_timing_value(const FdtNode *timing, const char *prop_name) {
+    unsigned long long value = 0;
+    fdt_prop_uint(fdt_prop(timing, prop_name), &value);
+    return value;
+}
 
-    d = opendir(DIR_NAME);
-    if (!d) d = opendir(".");
-    if (d) {
-        while ((dir = readdir(d)) != NULL) {
-            if (!strstr(dir->d_name, ".dts")) continue;
-            snprintf(path, sizeof(path), "%s/%s", DIR_NAME, dir->d_name);
-            if (access(path, F_OK) != 0) snprintf(path, sizeof(path), "%s", dir->d_name);
-            
-            // Project ID Check
-            if (!check_project_id(path, project_id)) {
-                continue;
+int cmd_dtb_add(const char *path, const char *base_node, int target_fps, const char *target_panel) {
+    size_t size;
+    uint8_t *blob = read_blob(path, &size);
+    if (!blob) {
+        printf("Error: cannot read %s\n", path);
+        return 1;
+    }
+    FdtTree tree;
+    if (!fdt_load(&tree, blob, size)) {
+        printf("Error: failed to parse %s (%s)\n", path, tree.error);
+        fdt_free(&tree);
+        free(blob);
+        return 1;
+    }
+
+    int ret = 1;
+    const char *target_node_name = target_node_name_of(base_node, target_fps);
+    FdtNode *panel = NULL;
+    FdtNode *base = NULL;
+    if (!target_node_name) goto out;
+    if (fdt_find_node(&tree, target_node_name)) {
+        printf("Skipping: %s already exists in %s\n", target_node_name, path);
+        ret = 0;
+        goto out;
+    }
+    for (panel = next_dtb_panel(&tree, NULL, target_panel); panel && !base; ) {
+        for (FdtNode *n = fdt_next(panel, panel); n; n = fdt_next(panel, n)) {
+            if (strcmp(n->name, base_node) == 0) {
+                base = n;
+                break;
             }
-            
-            FILE *fp = fopen(path, "r");
-            if (!fp) continue;
-            
-            char line[MAX_LINE];
-            int in_panel = 0;
-            int panel_brace_depth = 0;
-            int in_timing = 0;
-            int timing_brace_depth = 0;
-            char current_node[256];
-            unsigned long long fps = 0;
-            int panel_matched = 1;
-
-            while (fgets(line, sizeof(line), fp)) {
-                if (!in_panel && is_panel_start(line)) {
-                    if (target_panel && strlen(target_panel) > 0) {
-                        char panel_name[256];
-                        extract_panel_name(line, panel_name);
-                        if (strcmp(panel_name, target_panel) != 0) {
-                            panel_matched = 0;
-                        } else {
-                            panel_matched = 1;
-                        }
-                    } else {
-                        panel_matched = 1;
-                    }
+        }
+        if (!base) panel = next_dtb_panel(&tree, panel, target_panel);
+    }
+    if (!base) {
+        printf("Error: Base node %s not found in %s\n", base_node, path);
+        goto out;
+    }
 
-                    in_panel = 1;
-                    panel_brace_depth = 0;
-                }
-                
-                if (in_panel) {
-                    char *p = line;
-                    while (*p) {
-                        if (*p == '{') panel_brace_depth++;
-                        if (*p == '}') panel_brace_depth--;
-                        p++;
-                    }
-                    if (panel_brace_depth <= 0 && strstr(line, "};")) {
-                        in_panel = 0;
-                        panel_matched = 0;
-                    }
-                }
-                
-                // Only scan timings if in correct panel
-                if (in_panel && panel_matched) {
-                     if (strstr(line, "timing@")) {
-                        char *start = strstr(line, "timing@");
-                        char *end = start + strlen("timing@");
-                        while (*end && !isspace((unsigned char)*end) && *end != '{') end++;
-                        if (end > start) {
-                            int len = end - start;
-                            if (len >= sizeof(current_node)) len = sizeof(current_node) - 1;
-                            strncpy(current_node, start, len);
-                            current_node[len] = '\0';
-                            
-                            in_timing = 1;
-                            timing_brace_depth = 0;
-                            fps = 0;
-                        }
-                    }
+    unsigned long long base_fps = dtb_timing_value(base, "qcom,mdss-dsi-panel-framerate");
+    unsigned long long base_clock = dtb_timing_value(base, "qcom,mdss-dsi-panel-clockrate");
+    unsigned long long base_transfer = dtb_timing_value(base, "qcom,mdss-mdp-transfer-time-us");
 
-                    if (in_timing) {
-                        char *p = line;
-                        while (*p) {
-                            if (*p == '{') timing_brace_depth++;
-                            if (*p == '}') timing_brace_depth--;
-                            p++;
-                        }
-                        
-                        char *val_start;
-                        if ((val_start = strstr(line, "qcom,mdss-dsi-panel-framerate"))) {
-                            char *v = strchr(val_start, '<');
-                            if (v) fps = parse_hex_or_dec(v + 1);
-                        }
-                        
-                        if (timing_brace_depth == 0 && strstr(line, "};")) {
-                            // Candidate found
-                            if (fps > 0) {
-                                long long diff = (long long)fps - target_fps;
-                                if (diff < 0) diff = -diff;
-                                
-                                // Prefer WQHD/FHD nodes
-                                // int bonus = 0;
-                                // if (strstr(current_node, "wqhd")) bonus = 50;
-                                // if (strstr(current_node, "fhd")) bonus = 30;
-                                
-                                // Heuristic: Find closest FPS, prefer standard nodes
-                                if (diff < best_diff) { // Simple logic for now
-                                    best_diff = diff;
-                                    strcpy(best_base_node, current_node);
-                                    strcpy(best_file, dir->d_name);
-                                }
-                            }
-                            in_timing = 0;
-                        }
-                    }
-                }
-            }
-            fclose(fp);
+    FdtNode *node = fdt_clone(&tree, base, target_node_name);
+    if (!node) {
+        printf("Error: failed to clone %s\n", base_node);
+        goto out;
+    }
+    if (base_fps > 0) {
+        fdt_set_uint(&tree, node, "qcom,mdss-dsi-panel-framerate", target_fps);
+        if (fdt_prop(node, "qcom,mdss-dsi-panel-clockrate")) {
+            fdt_set_uint(&tree, node, "qcom,mdss-dsi-panel-clockrate", base_clock * target_fps / base_fps);
+        }
+        if (fdt_prop(node, "qcom,mdss-mdp-transfer-time-us")) {
+            fdt_set_uint(&tree, node, "qcom,mdss-mdp-transfer-time-us", base_transfer * base_fps / target_fps);
         }
-        closedir(d);
     }
-    
-    if (strlen(best_base_node) > 0) {
-        printf("Smart Add: Best base node %s found in %s\n", best_base_node, best_file);
-        
-        // Apply to ALL matching files, not just the best file
-        // Re-scan directory to find all matching files and apply
-        DIR *d2 = opendir(DIR_NAME);
-        if (!d2) d2 = opendir(".");
-        if (d2) {
-            struct dirent *dir2;
-            char path2[512];
-            while ((dir2 = readdir(d2)) != NULL) {
-                if (!strstr(dir2->d_name, ".dts")) continue;
-                snprintf(path2, sizeof(path2), "%s/%s", DIR_NAME, dir2->d_name);
-                if (access(path2, F_OK) != 0) snprintf(path2, sizeof(path2), "%s", dir2->d_name);
-                
-                if (check_project_id(path2, project_id)) {
-                    internal_add_node(dir2->d_name, best_base_node, target_fps, target_panel);
-                }
+    renumber_dtb_cell_index(&tree, panel);
+
+    if (save_dtb(&tree, path)) {
+        printf("Added node %s (%dHz) to %s (Panel Match: Yes)\n", target_node_name, target_fps, path);
+        ret = 0;
+    }
+out:
+    fdt_free(&tree);
+    free(blob);
+    return ret;
+}
+
+int cmd_dtb_remove(const char *path, const char *target_node, const char *target_panel) {
+    size_t size;
+    uint8_t *blob = read_blob(path, &size);
+    if (!blob) {
+        printf("Error: cannot read %s\n", path);
+        return 1;
+    }
+    FdtTree tree;
+    if (!fdt_load(&tree, blob, size)) {
+        printf("Error: failed to parse %s (%s)\n", path, tree.error);
+        fdt_free(&tree);
+        free(blob);
+        return 1;
+    }
+
+    int modified = 0;
+    for (FdtNode *panel = next_dtb_panel(&tree, NULL, target_panel); panel; panel = next_dtb_panel(&tree, panel, target_panel)) {
+        int removed = 0;
+        for (FdtNode *n = fdt_next(panel, panel); n; ) {
+            FdtNode *next = fdt_skip(panel, n);
+            if (strcmp(n->name, target_node) == 0) {
+                fdt_delete(&tree, n);
+                removed = 1;
+                printf("Removing node: %s from %s (Panel Match: Yes)\n", target_node, path);
+            } else {
+                next = fdt_next(panel, n);
             }
-            closedir(d2);
+            n = next;
+        }
+        if (removed) {
+            renumber_dtb_cell_index(&tree, panel);
+            modified = 1;
         }
-    } else {
-        printf("Smart Add: No suitable base node found.\n");
     }
+
+    int ret = modified && !save_dtb(&tree, path);
+    fdt_free(&tree);
+    free(blob);
+    return ret;
 }
 
-int main(int argc, char *argv[]) {
+int run_command(int argc, char *argv[]) {
     if (argc < 2) {
         printf("Usage: %s <command> [args]\n", argv[0]);
         printf("Commands:\n");
@@ -993,6 +650,8 @@ int main(int argc, char *argv[]) {
         printf("  add <base_node> <fps> [target_panel] [project_id]\n");
         printf("  smart_add <fps> [target_panel] [project_id]\n");
         printf("  remove <node_name> [target_panel] [project_id]\n");
+        printf("  dtb_add <dtb_file> <base_node> <fps> [target_panel]\n");
+        printf("  dtb_remove <dtb_file> <node_name> [target_panel]\n");
         return 1;
     }
 
@@ -1001,21 +660,23 @@ int main(int argc, char *argv[]) {
         const char *prj = (argc >= 4) ? argv[3] : NULL;
         cmd_scan(panel, prj);
     } else if (strcmp(argv[1], "add") == 0) {
-        if (argc < 4) {
+        int fps = (argc >= 4) ? parse_fps(argv[3]) : 0;
+        if (fps <= 0) {
             printf("Usage: add <base_node> <fps> [target_panel] [project_id]\n");
             return 1;
         }
         const char *panel = (argc >= 5) ? argv[4] : NULL;
         const char *prj = (argc >= 6) ? argv[5] : NULL;
-        cmd_add(argv[2], atoi(argv[3]), panel, prj);
+        cmd_add(argv[2], fps, panel, prj);
     } else if (strcmp(argv[1], "smart_add") == 0) {
-        if (argc < 3) {
+        int fps = (argc >= 3) ? parse_fps(argv[2]) : 0;
+        if (fps <= 0) {
             printf("Usage: smart_add <fps> [target_panel] [project_id]\n");
             return 1;
         }
         const char *panel = (argc >= 4) ? argv[3] : NULL;
         const char *prj = (argc >= 5) ? argv[4] : NULL;
-        cmd_smart_add(atoi(argv[2]), panel, prj);
+        cmd_smart_add(fps, panel, prj);
     } else if (strcmp(argv[1], "remove") == 0) {
         if (argc < 3) {
             printf("Usage: remove <node_name> [target_panel] [project_id]\n");
@@ -1024,6 +685,19 @@ int main(int argc, char *argv[]) {
         const char *panel = (argc >= 4) ? argv[3] : NULL;
         const char *prj = (argc >= 5) ? argv[4] : NULL;
         cmd_remove(argv[2], panel, prj);
+    } else if (strcmp(argv[1], "dtb_add") == 0) {
+        int fps = (argc >= 5) ? parse_fps(argv[4]) : 0;
+        if (fps <= 0) {
+            printf("Usage: dtb_add <dtb_file> <base_node> <fps> [target_panel]\n");
+            return 1;
+        }
+        return cmd_dtb_add(argv[2], argv[3], fps, (argc >= 6) ? argv[5] : NULL);
+    } else if (strcmp(argv[1], "dtb_remove") == 0) {
+        if (argc < 4) {
+            printf("Usage: dtb_remove <dtb_file> <node_name> [target_panel]\n");
+            return 1;
+        }
+        return cmd_dtb_remove(argv[2], argv[3], (argc >= 5) ? argv[4] : NULL);
     } else {
         printf("Unknown command: %s\n", argv[1]);
         return 1;
@@ -1031,3 +705,11 @@ int main(int argc, char *argv[]) {
 
     return 0;
 }
+
+int main(int argc, char *argv[]) {
+    dts_strtab_init(&g_names, &g_run);
+    int ret = run_command(argc, argv);
+    dts_strtab_free(&g_names);
+    dts_arena_free(&g_run);
+    return ret;
+}
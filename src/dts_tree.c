@@ -0,0 +1,758 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+
+#include "dts_tree.h"
+
+#define ARENA_BLOCK_SIZE 65536
+
+// ==================== Arena ====================
+
+void *dts_arena_alloc(DtsArena *arena, size_t size) {
+    size = (size + 7) & ~(size_t)7;
+    DtsArenaBlock *b = arena->head;
+    if (!b || b->size - b->used < size) {
+        size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        b = malloc(sizeof(DtsArenaBlock) + block_size);
+        if (!b) return NULL;
+        b->size = block_size;
+        b->used = 0;
+        b->next = arena->head;
+        arena->head = b;
+    }
+    void *p = b->data + b->used;
+    b->used += size;
+    arena->total += size;
+    memset(p, 0, size);
+    return p;
+}
+
+char *dts_arena_strndup(DtsArena *arena, const char *str, size_t len) {
+    char *p = dts_arena_alloc(arena, len + 1);
+    if (!p) return NULL;
+    memcpy(p, str, len);
+    p[len] = '\0';
+    return p;
+}
+
+char *dts_arena_printf(DtsArena *arena, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    if (len < 0) return NULL;
+    char *p = dts_arena_alloc(arena, (size_t)len + 1);
+    if (!p) return NULL;
+    va_start(ap, fmt);
+    vsnprintf(p, (size_t)len + 1, fmt, ap);
+    va_end(ap);
+    return p;
+}
+
+void dts_arena_free(DtsArena *arena) {
+    DtsArenaBlock *b = arena->head;
+    while (b) {
+        DtsArenaBlock *next = b->next;
+        free(b);
+        b = next;
+    }
+    arena->head = NULL;
+    arena->total = 0;
+}
+
+// ==================== 字符串驻留 ====================
+
+static size_t hash_str(const char *str, size_t len) {
+    size_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) h = (h ^ (unsigned char)str[i]) * 16777619u;
+    return h;
+}
+
+void dts_strtab_init(DtsStrtab *tab, DtsArena *arena) {
+    memset(tab, 0, sizeof(*tab));
+    tab->arena = arena;
+}
+
+static int strtab_grow(DtsStrtab *tab) {
+    size_t cap = tab->cap ? tab->cap * 2 : 256;
+    const char **slots = calloc(cap, sizeof(*slots));
+    if (!slots) return 0;
+    for (size_t k = 0; k < tab->cap; k++) {
+        const char *str = tab->slots[k];
+        if (!str) continue;
+        size_t i = hash_str(str, strlen(str)) & (cap - 1);
+        while (slots[i]) i = (i + 1) & (cap - 1);
+        slots[i] = str;
+    }
+    free(tab->slots);
+    tab->slots = slots;
+    tab->cap = cap;
+    return 1;
+}
+
+const char *dts_intern(DtsStrtab *tab, const char *str, size_t len) {
+    if ((tab->count + 1) * 2 > tab->cap && !strtab_grow(tab)) return NULL;
+    size_t i = hash_str(str, len) & (tab->cap - 1);
+    for (; tab->slots[i]; i = (i + 1) & (tab->cap - 1)) {
+        const char *e = tab->slots[i];
+        if (strncmp(e, str, len) == 0 && e[len] == '\0') return e;
+    }
+    char *copy = dts_arena_strndup(tab->arena, str, len);
+    if (!copy) return NULL;
+    tab->slots[i] = copy;
+    tab->count++;
+    return copy;
+}
+
+void dts_strtab_free(DtsStrtab *tab) {
+    free(tab->slots);
+    memset(tab, 0, sizeof(*tab));
+}
+
+// ==================== 解析 ====================
+
+int dts_line_of(const DtsDoc *doc, size_t off) {
+    if (doc->scan.structural) return 1 + (int)dts_scan_count_newlines(&doc->scan, off);
+    int line = 1;
+    for (size_t i = 0; i < off && i < doc->len; i++) {
+        if (doc->src[i] == '\n') line++;
+    }
+    return line;
+}
+
+static int parse_fail(DtsDoc *doc, size_t off, const char *what) {
+    snprintf(doc->error, sizeof(doc->error), "line %d: %s", dts_line_of(doc, off), what);
+    return 0;
+}
+
+// 预处理指令 (#include 等)，与 #address-cells 这类属性区分开
+static int is_cpp_directive(const char *s, size_t len, size_t i) {
+    static const char *words[] = { "include", "define", "undef", "ifdef", "ifndef", "if", "elif",
+                                   "else", "endif", "pragma", "error", "line" };
+    for (size_t w = 0; w < sizeof(words) / sizeof(words[0]); w++) {
+        size_t n = strlen(words[w]);
+        if (i + 1 + n <= len && strncmp(s + i + 1, words[w], n) == 0 &&
+            (i + 1 + n == len || (!isalnum((unsigned char)s[i + 1 + n]) && s[i + 1 + n] != '-'))) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 跳过空白、注释和预处理行
+static size_t skip_ws(const DtsScan *scan, const char *s, size_t len, size_t i) {
+    while (i < len) {
+        char c = s[i];
+        if (isspace((unsigned char)c)) {
+            i++;
+        } else if (c == '/' && i + 1 < len && s[i + 1] == '*') {
+            const char *e = strstr(s + i + 2, "*/");
+            i = e ? (size_t)(e - s) + 2 : len;
+        } else if (c == '/' && i + 1 < len && s[i + 1] == '/') {
+            i = dts_scan_next_newline(scan, i);
+        } else if (c == '#' && is_cpp_directive(s, len, i)) {
+            while (i < len && s[i] != '\n') {
+                if (s[i] == '\\' && i + 1 < len && s[i + 1] == '\n') i++;
+                i++;
+            }
+        } else {
+            break;
+        }
+    }
+    return i;
+}
+
+// 扫描到语句结尾的 ';'，跳过字符串、字符常量和注释中的 ';'，返回 ';' 的位置。
+// 值中间 (cell、字节串) 只按结构字符位图跳转，不逐字节判断
+static size_t scan_value(const DtsScan *scan, const char *s, size_t len, size_t i) {
+    while ((i = dts_scan_next(scan, i)) < len) {
+        char c = s[i];
+        if (c == ';') return i;
+        if (c == '"' || c == '\'') {
+            i++;
+            while ((i = dts_scan_next(scan, i)) < len && s[i] != c) {
+                if (s[i] == '\\') i++;
+                i++;
+            }
+            i++;
+        } else if (c == '/' && i + 1 < len && (s[i + 1] == '*' || s[i + 1] == '/')) {
+            i = skip_ws(scan, s, len, i);
+        } else {
+            i++;
+        }
+    }
+    return len;
+}
+
+// 名称/标签由除空白和 {};= 以外的字符组成，&{/path} 引用整体算一个名称
+static const unsigned char name_stop[256] = {
+    [' '] = 1, ['\t'] = 1, ['\n'] = 1, ['\v'] = 1, ['\f'] = 1, ['\r'] = 1,
+    ['{'] = 1, ['}'] = 1, [';'] = 1, ['='] = 1,
+};
+
+static size_t scan_name(const char *s, size_t len, size_t i) {
+    if (s[i] == '&' && i + 1 < len && s[i + 1] == '{') {
+        while (i < len && s[i] != '}') i++;
+        return i < len ? i + 1 : len;
+    }
+    while (i < len) {
+        char c = s[i];
+        if (name_stop[(unsigned char)c]) break;
+        i++;
+        if (c == ':') break; // 标签结束
+    }
+    return i;
+}
+
+static void add_child(DtsNode *parent, DtsNode *node) {
+    node->parent = parent;
+    node->depth = parent->depth + 1;
+    if (parent->last_child) parent->last_child->next = node;
+    else parent->children = node;
+    parent->last_child = node;
+}
+
+static void add_prop(DtsNode *node, DtsProp *prop) {
+    if (node->last_prop) node->last_prop->next = prop;
+    else node->props = prop;
+    node->last_prop = prop;
+}
+
+int dts_parse(DtsDoc *doc, char *src, size_t len) {
+    memset(doc, 0, sizeof(*doc));
+    doc->src = src;
+    doc->len = len;
+    doc->root.name = "";
+    doc->root.depth = -1;
+    doc->root.end = len;
+    if (!dts_scan_build(&doc->scan, src, len, DTS_SCAN_AUTO)) return parse_fail(doc, 0, "out of memory");
+
+    const char *s = src;
+    DtsNode *cur = &doc->root;
+    size_t i = 0;
+
+    for (;;) {
+        i = skip_ws(&doc->scan, s, len, i);
+        if (i >= len) break;
+        char c = s[i];
+
+        if (c == '}') {
+            if (cur == &doc->root) return parse_fail(doc, i, "unbalanced '}'");
+            cur->close = i;
+            i = skip_ws(&doc->scan, s, len, i + 1);
+            if (i < len && s[i] == ';') i++;
+            cur->end = i;
+            cur = cur->parent;
+            continue;
+        }
+        if (c == ';') {
+            i++;
+            continue;
+        }
+
+        size_t stmt = i;
+
+        // /dts-v1/; /plugin/; /memreserve/ ...; /delete-node/ x; /include/ "x"
+        if (c == '/' && i + 1 < len && s[i + 1] != '{' && !isspace((unsigned char)s[i + 1])) {
+            const char *e = memchr(s + i + 1, '/', len - i - 1);
+            if (!e) return parse_fail(doc, i, "bad directive");
+            if ((size_t)(e - s) - i - 1 == 7 && strncmp(s + i + 1, "include", 7) == 0) {
+                i = skip_ws(&doc->scan, s, len, (size_t)(e - s) + 1);
+                if (i < len && s[i] == '"') {
+                    i++;
+                    while (i < len && s[i] != '"') i++;
+                    i++;
+                }
+                continue;
+            }
+            i = scan_value(&doc->scan, s, len, (size_t)(e - s) + 1);
+            if (i >= len) return parse_fail(doc, stmt, "unterminated directive");
+            i++;
+            continue;
+        }
+
+        // 标签
+        const char *label = NULL;
+        int label_len = 0;
+        size_t name_start = i;
+        size_t name_end = scan_name(s, len, i);
+        while (name_end > name_start && s[name_end - 1] == ':') {
+            if (!label) {
+                label = s + name_start;
+                label_len = (int)(name_end - name_start - 1);
+            }
+            name_start = skip_ws(&doc->scan, s, len, name_end);
+            if (name_start >= len) return parse_fail(doc, stmt, "label without node");
+            name_end = scan_name(s, len, name_start);
+        }
+        if (name_end == name_start) return parse_fail(doc, i, "unexpected character");
+
+        size_t j = skip_ws(&doc->scan, s, len, name_end);
+        if (j >= len) return parse_fail(doc, stmt, "unexpected end of file");
+
+        if (s[j] == '{') {
+            DtsNode *node = dts_arena_alloc(&doc->arena, sizeof(DtsNode));
+            if (!node) return parse_fail(doc, stmt, "out of memory");
+            node->name = s + name_start;
+            node->name_len = (int)(name_end - name_start);
+            node->keys = dts_keys_mask(node->name, node->name_len);
+            node->label = label;
+            node->label_len = label_len;
+            node->start = stmt;
+            node->name_off = name_start;
+            node->open = j;
+            add_child(cur, node);
+            cur = node;
+            i = j + 1;
+        } else if (s[j] == '=' || s[j] == ';') {
+            if (cur == &doc->root) return parse_fail(doc, stmt, "property outside of node");
+            DtsProp *prop = dts_arena_alloc(&doc->arena, sizeof(DtsProp));
+            if (!prop) return parse_fail(doc, stmt, "out of memory");
+            prop->name = s + name_start;
+            prop->name_len = (int)(name_end - name_start);
+            prop->key = dts_keys_exact(prop->name, prop->name_len);
+            prop->start = name_start;
+            if (s[j] == '=') {
+                size_t v = skip_ws(&doc->scan, s, len, j + 1);
+                size_t semi = scan_value(&doc->scan, s, len, v);
+                if (semi >= len) return parse_fail(doc, stmt, "missing ';'");
+                size_t ve = semi;
+                while (ve > v && isspace((unsigned char)s[ve - 1])) ve--;
+                prop->value_start = v;
+                prop->value_end = ve;
+                prop->end = semi + 1;
+            } else {
+                prop->value_start = prop->value_end = j;
+                prop->end = j + 1;
+            }
+            add_prop(cur, prop);
+            i = prop->end;
+        } else {
+            return parse_fail(doc, j, "expected '{', '=' or ';'");
+        }
+    }
+
+    if (cur != &doc->root) return parse_fail(doc, cur->open, "unterminated node");
+    return 1;
+}
+
+int dts_load(DtsDoc *doc, const char *path) {
+    memset(doc, 0, sizeof(*doc));
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        snprintf(doc->error, sizeof(doc->error), "cannot open file");
+        return 0;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *buf = size >= 0 ? malloc((size_t)size + 1) : NULL;
+    if (!buf) {
+        fclose(fp);
+        snprintf(doc->error, sizeof(doc->error), "out of memory");
+        return 0;
+    }
+    size_t n = fread(buf, 1, (size_t)size, fp);
+    fclose(fp);
+    buf[n] = '\0';
+    return dts_parse(doc, buf, n);
+}
+
+void dts_free(DtsDoc *doc) {
+    dts_arena_free(&doc->arena);
+    dts_scan_free(&doc->scan);
+    free(doc->edits);
+    free(doc->src);
+    memset(doc, 0, sizeof(*doc));
+}
+
+// ==================== 查询 ====================
+
+DtsNode *dts_next(const DtsNode *top, const DtsNode *node) {
+    if (node->children) return node->children;
+    return dts_skip(top, node);
+}
+
+DtsNode *dts_skip(const DtsNode *top, const DtsNode *node) {
+    while (node && node != top) {
+        if (node->next) return node->next;
+        node = node->parent;
+    }
+    return NULL;
+}
+
+int dts_name_eq(const char *name, int name_len, const char *str) {
+    return (int)strlen(str) == name_len && memcmp(name, str, name_len) == 0;
+}
+
+int dts_name_contains(const char *name, int name_len, const char *str) {
+    int n = (int)strlen(str);
+    for (int i = 0; i + n <= name_len; i++) {
+        if (memcmp(name + i, str, n) == 0) return 1;
+    }
+    return 0;
+}
+
+DtsProp *dts_find_prop(const DtsNode *node, const char *name) {
+    for (DtsProp *p = node->props; p; p = p->next) {
+        if (dts_name_eq(p->name, p->name_len, name)) return p;
+    }
+    return NULL;
+}
+
+DtsProp *dts_find_key(const DtsNode *node, int key) {
+    for (DtsProp *p = node->props; p; p = p->next) {
+        if (p->key == key) return p;
+    }
+    return NULL;
+}
+
+DtsNode *dts_find_child(const DtsNode *node, const char *name) {
+    for (DtsNode *c = node->children; c; c = c->next) {
+        if (dts_name_eq(c->name, c->name_len, name)) return c;
+    }
+    return NULL;
+}
+
+DtsNode *dts_find_node(const DtsDoc *doc, const char *name) {
+    for (DtsNode *n = dts_next(&doc->root, &doc->root); n; n = dts_next(&doc->root, n)) {
+        if (dts_name_eq(n->name, n->name_len, name)) return n;
+    }
+    return NULL;
+}
+
+DtsProp *dts_first_prop(const DtsDoc *doc, const char *name) {
+    for (DtsNode *n = dts_next(&doc->root, &doc->root); n; n = dts_next(&doc->root, n)) {
+        DtsProp *p = dts_find_prop(n, name);
+        if (p) return p;
+    }
+    return NULL;
+}
+
+int dts_span_index(DtsDoc *doc, DtsSpanIndex *index, int (*match)(const DtsNode *node)) {
+    index->spans = NULL;
+    index->count = 0;
+    int count = 0;
+    for (DtsNode *n = dts_next(&doc->root, &doc->root); n; ) {
+        if (match(n)) {
+            count++;
+            n = dts_skip(&doc->root, n);
+        } else {
+            n = dts_next(&doc->root, n);
+        }
+    }
+    if (count == 0) return 1;
+
+    index->spans = dts_arena_alloc(&doc->arena, count * sizeof(DtsSpan));
+    if (!index->spans) return 0;
+    // 先序遍历的顺序就是 open 递增的顺序
+    for (DtsNode *n = dts_next(&doc->root, &doc->root); n; ) {
+        if (match(n)) {
+            DtsSpan *span = &index->spans[index->count++];
+            span->open = n->open;
+            span->close = n->close;
+            span->node = n;
+            n = dts_skip(&doc->root, n);
+        } else {
+            n = dts_next(&doc->root, n);
+        }
+    }
+    return 1;
+}
+
+const DtsNode *dts_span_find(const DtsSpanIndex *index, size_t off) {
+    // 最后一个 open <= off 的区间
+    int lo = 0, hi = index->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (index->spans[mid].open <= off) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == 0) return NULL;
+    const DtsSpan *span = &index->spans[lo - 1];
+    return off <= span->close ? span->node : NULL;
+}
+
+int dts_prop_cell(const DtsDoc *doc, const DtsProp *prop, int index, unsigned long long *out) {
+    if (!prop) return 0;
+    const char *p = doc->src + prop->value_start;
+    const char *end = doc->src + prop->value_end;
+    while (p < end && *p != '<') p++;
+    if (p >= end) return 0;
+    p++;
+    for (int k = 0; p < end && *p != '>'; k++) {
+        while (p < end && isspace((unsigned char)*p)) p++;
+        if (p >= end || *p == '>') break;
+        const char *tok = p;
+        while (p < end && !isspace((unsigned char)*p) && *p != '>') p++;
+        if (k == index) {
+            char num[32];
+            int n = (int)(p - tok);
+            if (n >= (int)sizeof(num)) n = sizeof(num) - 1;
+            memcpy(num, tok, n);
+            num[n] = '\0';
+            if (num[0] == '0' && (num[1] == 'x' || num[1] == 'X')) *out = strtoull(num, NULL, 16);
+            else *out = strtoull(num, NULL, 10);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+unsigned long long dts_prop_u64(const DtsDoc *doc, const DtsProp *prop) {
+    unsigned long long v = 0;
+    if (!dts_prop_cell(doc, prop, 0, &v)) return 0;
+    return v;
+}
+
+int dts_prop_has_cell(const DtsDoc *doc, const DtsProp *prop, unsigned long long value) {
+    unsigned long long v;
+    for (int k = 0; dts_prop_cell(doc, prop, k, &v); k++) {
+        if (v == value) return 1;
+    }
+    return 0;
+}
+
+const char *dts_line_indent(DtsDoc *doc, size_t off) {
+    size_t ls = off;
+    while (ls > 0 && doc->src[ls - 1] != '\n') ls--;
+    size_t n = 0;
+    for (size_t k = ls; k < off; k++) {
+        if (doc->src[k] != ' ' && doc->src[k] != '\t') {
+            n = 0;
+            break;
+        }
+        n++;
+    }
+    const char *indent = dts_arena_strndup(&doc->arena, doc->src + ls, n);
+    return indent ? indent : "";
+}
+
+void dts_node_line_span(const DtsDoc *doc, const DtsNode *node, size_t *start, size_t *end) {
+    size_t s = node->start;
+    while (s > 0 && (doc->src[s - 1] == ' ' || doc->src[s - 1] == '\t')) s--;
+    if (s > 0 && doc->src[s - 1] != '\n') s = node->start;
+
+    size_t e = node->end;
+    while (e < doc->len && (doc->src[e] == ' ' || doc->src[e] == '\t')) e++;
+    if (e < doc->len && doc->src[e] == '\r') e++;
+    if (e < doc->len && doc->src[e] == '\n') e++;
+    else if (e < doc->len) e = node->end;
+
+    *start = s;
+    *end = e;
+}
+
+// ==================== 编辑 ====================
+
+// 检查与已有编辑是否重叠，不重叠时追加一条空编辑
+static DtsEdit *add_edit(DtsDoc *doc, size_t start, size_t end) {
+    if (start > end || end > doc->len) return NULL;
+    for (int k = 0; k < doc->edit_count; k++) {
+        const DtsEdit *e = &doc->edits[k];
+        // 两段替换有交集，或插入点落在另一段替换内部
+        if (start < e->end && e->start < end) return NULL;
+        if (start == end && e->start < start && start < e->end) return NULL;
+        if (e->start == e->end && start < e->start && e->start < end) return NULL;
+    }
+    if (doc->edit_count == doc->edit_cap) {
+        int cap = doc->edit_cap ? doc->edit_cap * 2 : 32;
+        DtsEdit *edits = realloc(doc->edits, cap * sizeof(DtsEdit));
+        if (!edits) return NULL;
+        doc->edits = edits;
+        doc->edit_cap = cap;
+    }
+    DtsEdit *e = &doc->edits[doc->edit_count];
+    memset(e, 0, sizeof(*e));
+    e->start = start;
+    e->end = end;
+    e->text = "";
+    e->seq = doc->edit_count;
+    return e;
+}
+
+int dts_replace(DtsDoc *doc, size_t start, size_t end, const char *text, size_t text_len) {
+    if (!text) text_len = 0;
+    char *copy = dts_arena_strndup(&doc->arena, text ? text : "", text_len);
+    if (!copy) return 0;
+    DtsEdit *e = add_edit(doc, start, end);
+    if (!e) return 0;
+    e->text = copy;
+    e->text_len = text_len;
+    doc->edit_count++;
+    return 1;
+}
+
+int dts_insert(DtsDoc *doc, size_t at, const char *text) {
+    return dts_replace(doc, at, at, text, strlen(text));
+}
+
+int dts_remove_node(DtsDoc *doc, const DtsNode *node) {
+    size_t s, e;
+    dts_node_line_span(doc, node, &s, &e);
+    return dts_replace(doc, s, e, NULL, 0);
+}
+
+int dts_set_value(DtsDoc *doc, const DtsProp *prop, const char *text) {
+    return dts_replace(doc, prop->value_start, prop->value_end, text, strlen(text));
+}
+
+int dts_set_cells(DtsDoc *doc, const DtsProp *prop, const char *cells) {
+    const char *v = doc->src + prop->value_start;
+    const char *lt = memchr(v, '<', prop->value_end - prop->value_start);
+    if (!lt) return 0;
+    const char *gt = memchr(lt, '>', doc->src + prop->value_end - lt);
+    if (!gt) return 0;
+    return dts_replace(doc, (size_t)(lt - doc->src) + 1, (size_t)(gt - doc->src), cells, strlen(cells));
+}
+
+int dts_set_prop(DtsDoc *doc, const DtsProp *prop, const char *text) {
+    return dts_replace(doc, prop->start, prop->end, text, strlen(text));
+}
+
+// ==================== 片段链 ====================
+
+static DtsPiece *append_piece(DtsDoc *doc, DtsPieces *pcs) {
+    DtsPiece *pc = dts_arena_alloc(&doc->arena, sizeof(DtsPiece));
+    if (!pc) return NULL;
+    if (pcs->tail) pcs->tail->next = pc;
+    else pcs->head = pc;
+    pcs->tail = pc;
+    return pc;
+}
+
+int dts_pieces_src(DtsDoc *doc, DtsPieces *pcs, size_t start, size_t end) {
+    if (start > end || end > doc->len) return 0;
+    DtsPiece *pc = append_piece(doc, pcs);
+    if (!pc) return 0;
+    pc->start = start;
+    pc->end = end;
+    return 1;
+}
+
+int dts_pieces_text(DtsDoc *doc, DtsPieces *pcs, const char *text) {
+    size_t len = strlen(text);
+    char *copy = dts_arena_strndup(&doc->arena, text, len);
+    DtsPiece *pc = copy ? append_piece(doc, pcs) : NULL;
+    if (!pc) return 0;
+    pc->text = copy;
+    pc->text_len = len;
+    return 1;
+}
+
+int dts_pieces_node(DtsDoc *doc, DtsPieces *pcs, const DtsNode *node, const char *new_name) {
+    if (!dts_pieces_src(doc, pcs, node->name_off, node->end)) return 0;
+    if (!new_name) return 1;
+    return dts_pieces_replace(doc, pcs, node->name_off, node->name_off + node->name_len, new_name);
+}
+
+int dts_pieces_replace(DtsDoc *doc, DtsPieces *pcs, size_t start, size_t end, const char *text) {
+    for (DtsPiece *pc = pcs->head; pc; pc = pc->next) {
+        if (pc->text || start < pc->start || end > pc->end) continue;
+        // [pc->start, start) text [end, pc->end)
+        DtsPiece *lit = dts_arena_alloc(&doc->arena, sizeof(DtsPiece));
+        DtsPiece *rest = dts_arena_alloc(&doc->arena, sizeof(DtsPiece));
+        size_t len = strlen(text);
+        char *copy = dts_arena_strndup(&doc->arena, text, len);
+        if (!lit || !rest || !copy) return 0;
+        lit->text = copy;
+        lit->text_len = len;
+        lit->next = rest;
+        rest->start = end;
+        rest->end = pc->end;
+        rest->next = pc->next;
+        pc->end = start;
+        pc->next = lit;
+        if (pcs->tail == pc) pcs->tail = rest;
+        return 1;
+    }
+    return 0;
+}
+
+int dts_pieces_set_value(DtsDoc *doc, DtsPieces *pcs, const DtsProp *prop, const char *text) {
+    return dts_pieces_replace(doc, pcs, prop->value_start, prop->value_end, text);
+}
+
+int dts_pieces_set_cells(DtsDoc *doc, DtsPieces *pcs, const DtsProp *prop, const char *cells) {
+    const char *v = doc->src + prop->value_start;
+    const char *lt = memchr(v, '<', prop->value_end - prop->value_start);
+    if (!lt) return 0;
+    const char *gt = memchr(lt, '>', doc->src + prop->value_end - lt);
+    if (!gt) return 0;
+    return dts_pieces_replace(doc, pcs, (size_t)(lt - doc->src) + 1, (size_t)(gt - doc->src), cells);
+}
+
+int dts_replace_pieces(DtsDoc *doc, size_t start, size_t end, const DtsPieces *pcs) {
+    DtsEdit *e = add_edit(doc, start, end);
+    if (!e) return 0;
+    e->pieces = pcs->head;
+    doc->edit_count++;
+    return 1;
+}
+
+int dts_insert_pieces(DtsDoc *doc, size_t at, const DtsPieces *pcs) {
+    return dts_replace_pieces(doc, at, at, pcs);
+}
+
+// ==================== 写出 ====================
+
+static int edit_cmp(const void *a, const void *b) {
+    const DtsEdit *x = a, *y = b;
+    if (x->start != y->start) return x->start < y->start ? -1 : 1;
+    // 同一位置: 插入在替换之前，插入之间按登记顺序
+    int xi = x->start == x->end, yi = y->start == y->end;
+    if (xi != yi) return xi ? -1 : 1;
+    return x->seq - y->seq;
+}
+
+static void sort_edits(const DtsDoc *doc) {
+    if (doc->edit_count > 1) {
+        qsort(doc->edits, doc->edit_count, sizeof(DtsEdit), edit_cmp);
+    }
+}
+
+void dts_write_stats(const DtsDoc *doc, DtsWriteStats *st) {
+    memset(st, 0, sizeof(*st));
+    sort_edits(doc);
+    size_t pos = 0;
+    for (int k = 0; k < doc->edit_count; k++) {
+        const DtsEdit *e = &doc->edits[k];
+        if (e->start > pos) st->src_bytes += e->start - pos;
+        st->text_bytes += e->text_len;
+        for (const DtsPiece *pc = e->pieces; pc; pc = pc->next) {
+            if (pc->text) st->text_bytes += pc->text_len;
+            else st->src_bytes += pc->end - pc->start;
+        }
+        if (e->end > pos) pos = e->end;
+    }
+    if (pos < doc->len) st->src_bytes += doc->len - pos;
+    st->out_len = st->src_bytes + st->text_bytes;
+    st->edits = doc->edit_count;
+}
+
+int dts_write(const DtsDoc *doc, FILE *out) {
+    sort_edits(doc);
+    size_t pos = 0;
+    for (int k = 0; k < doc->edit_count; k++) {
+        const DtsEdit *e = &doc->edits[k];
+        if (e->start > pos) fwrite(doc->src + pos, 1, e->start - pos, out);
+        if (e->text_len) fwrite(e->text, 1, e->text_len, out);
+        for (const DtsPiece *pc = e->pieces; pc; pc = pc->next) {
+            if (pc->text) fwrite(pc->text, 1, pc->text_len, out);
+            else fwrite(doc->src + pc->start, 1, pc->end - pc->start, out);
+        }
+        if (e->end > pos) pos = e->end;
+    }
+    if (pos < doc->len) fwrite(doc->src + pos, 1, doc->len - pos, out);
+    return !ferror(out);
+}
+
+int dts_write_file(const DtsDoc *doc, const char *path) {
+    FILE *out = fopen(path, "wb");
+    if (!out) return 0;
+    int ok = dts_write(doc, out);
+    if (fclose(out) != 0) ok = 0;
+    return ok;
+}
@@ -0,0 +1,207 @@
+#ifndef DTS_TREE_H
+#define DTS_TREE_H
+
+// ==================== DTS 语法树 ====================
+// dts_tool 与 process_dts 共用的 DTS 解析器: 一次扫描把整个文件解析成节点/属性树，
+// 每个节点和属性都记录在源文本中的位置 (偏移)，节点和属性都分配在 arena 上。
+// 修改不直接改源文本，而是登记为 "把 [start, end) 替换为 text" 的编辑，
+// 写出时按偏移把编辑和未改动的原文拼接起来，未改动部分的格式 (缩进、空行、注释)
+// 原样保留。
+//
+// 支持 dtc 反编译输出和常见的手写写法: 标签 (label:)、/dts-v1/ 等指令、
+// &label 引用、字符串/字节串/cell 值、/* */ 与 // 注释。
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "dts_keys.h"
+#include "dts_scan.h"
+
+// 简单的分块 arena: 只分配不释放，整个文档处理完一起释放
+typedef struct DtsArenaBlock {
+    struct DtsArenaBlock *next;
+    size_t size;
+    size_t used;
+    char data[];
+} DtsArenaBlock;
+
+typedef struct {
+    DtsArenaBlock *head;
+    size_t total;          // 已分配的字节数 (统计用)
+} DtsArena;
+
+void *dts_arena_alloc(DtsArena *arena, size_t size);
+char *dts_arena_strndup(DtsArena *arena, const char *str, size_t len);
+// 按 printf 格式生成字符串，长度不设上限
+char *dts_arena_printf(DtsArena *arena, const char *fmt, ...);
+void dts_arena_free(DtsArena *arena);
+
+// 字符串驻留表: 相同内容只在 arena 上存一份，驻留后的字符串可以按指针比较。
+// 工具用一个跨文件的表保存节点名/文件名，不再为每条记录复制定长数组
+typedef struct {
+    DtsArena *arena;       // 字符串所在的 arena (由调用方管理)
+    const char **slots;    // 开放寻址哈希表
+    size_t cap;
+    size_t count;
+} DtsStrtab;
+
+void dts_strtab_init(DtsStrtab *tab, DtsArena *arena);
+const char *dts_intern(DtsStrtab *tab, const char *str, size_t len);
+void dts_strtab_free(DtsStrtab *tab);
+
+typedef struct DtsProp {
+    const char *name;      // 指向源文本，长度 name_len
+    int name_len;
+    int key;               // 属性名对应的关键字 (DTS_KEY_*)，不是关键字时为 DTS_KEY_NONE
+    size_t start;          // 语句起点 (属性名第一个字符)
+    size_t value_start;    // '=' 之后第一个非空白字符，无值属性等于 value_end
+    size_t value_end;      // 值的结尾 (不含尾随空白)
+    size_t end;            // ';' 之后
+    struct DtsProp *next;
+} DtsProp;
+
+typedef struct DtsNode {
+    const char *name;      // 指向源文本，根节点为 "/"
+    int name_len;
+    unsigned keys;         // 节点名中出现的关键字掩码 (DTS_KEY_BIT)
+    const char *label;     // 第一个标签 (不含 ':')，没有时为 NULL
+    int label_len;
+    size_t start;          // 语句起点 (标签或节点名第一个字符)
+    size_t name_off;       // 节点名起点
+    size_t open;           // '{'
+    size_t close;          // '}'
+    size_t end;            // "};" 之后
+    int depth;
+    struct DtsNode *parent;
+    struct DtsNode *children;
+    struct DtsNode *last_child;
+    struct DtsNode *next;
+    DtsProp *props;
+    DtsProp *last_prop;
+} DtsNode;
+
+// 片段: 原文 [start, end) 或一段字面文本。生成的节点 (复制模板再改几个值) 表示成片段链，
+// 只引用原文而不复制，写出时才展开
+typedef struct DtsPiece {
+    size_t start;          // 原文片段
+    size_t end;
+    const char *text;      // 非 NULL 时是字面文本 (在 arena 上)，start/end 不用
+    size_t text_len;
+    struct DtsPiece *next;
+} DtsPiece;
+
+typedef struct {
+    DtsPiece *head;
+    DtsPiece *tail;
+} DtsPieces;
+
+typedef struct {
+    size_t start;
+    size_t end;
+    const char *text;      // 在 arena 上
+    size_t text_len;
+    const DtsPiece *pieces; // 非 NULL 时替换内容是这条片段链 (text 为空)
+    int seq;               // 登记顺序，同一位置的插入按登记顺序输出
+} DtsEdit;
+
+// root 直接嵌在 DtsDoc 里，顶层节点的 parent 指向 &doc->root：dts_parse 之后不能移动 DtsDoc
+// (memcpy / realloc 含 DtsDoc 的数组)，否则这些指针悬空
+typedef struct {
+    char *src;             // 源文本 (以 '\0' 结尾)
+    size_t len;
+    DtsScan scan;          // 源文本的结构字符位图，解析前建立
+    DtsArena arena;
+    DtsNode root;          // 虚拟顶层，子节点是文件中的顶层节点 (通常只有 "/")
+    DtsEdit *edits;
+    int edit_count;
+    int edit_cap;
+    char error[128];
+} DtsDoc;
+
+// 读取并解析文件，失败时返回 0，原因在 doc->error
+int dts_load(DtsDoc *doc, const char *path);
+// 解析已有的文本，src 归 doc 所有 (dts_free 时 free)
+int dts_parse(DtsDoc *doc, char *src, size_t len);
+void dts_free(DtsDoc *doc);
+
+// 先序遍历: for (n = dts_next(top, top); n; n = dts_next(top, n))
+DtsNode *dts_next(const DtsNode *top, const DtsNode *node);
+// 同上，但跳过 node 的子树
+DtsNode *dts_skip(const DtsNode *top, const DtsNode *node);
+
+int dts_name_eq(const char *name, int name_len, const char *str);
+int dts_name_contains(const char *name, int name_len, const char *str);
+DtsProp *dts_find_prop(const DtsNode *node, const char *name);
+// 按关键字查找属性 (整数比较，不比较字符串)
+DtsProp *dts_find_key(const DtsNode *node, int key);
+DtsNode *dts_find_child(const DtsNode *node, const char *name);
+// 整个文档中 (先序) 第一个同名节点/属性
+DtsNode *dts_find_node(const DtsDoc *doc, const char *name);
+DtsProp *dts_first_prop(const DtsDoc *doc, const char *name);
+
+// 区间索引: 满足 match 的节点按 [open, close] 排序存放，匹配节点的子树不再收集 (区间互不嵌套)。
+// 加载后建一次，之后 "偏移 off 落在哪个节点内" 用二分查找回答
+typedef struct {
+    size_t open;
+    size_t close;
+    const DtsNode *node;
+} DtsSpan;
+
+typedef struct {
+    DtsSpan *spans;        // 在 doc->arena 上
+    int count;
+} DtsSpanIndex;
+
+int dts_span_index(DtsDoc *doc, DtsSpanIndex *index, int (*match)(const DtsNode *node));
+// 包含 off 的节点，没有时返回 NULL
+const DtsNode *dts_span_find(const DtsSpanIndex *index, size_t off);
+
+// <...> 中第 index 个 cell，十六进制 (0x) 或十进制；不存在时返回 0
+int dts_prop_cell(const DtsDoc *doc, const DtsProp *prop, int index, unsigned long long *out);
+unsigned long long dts_prop_u64(const DtsDoc *doc, const DtsProp *prop);
+int dts_prop_has_cell(const DtsDoc *doc, const DtsProp *prop, unsigned long long value);
+
+// 行首到 off 之间只有空白时返回该缩进 (在 doc->arena 上)，否则返回空串
+const char *dts_line_indent(DtsDoc *doc, size_t off);
+// 节点占据的整行范围: 起点扩展到行首缩进，终点扩展到行尾换行之后
+void dts_node_line_span(const DtsDoc *doc, const DtsNode *node, size_t *start, size_t *end);
+int dts_line_of(const DtsDoc *doc, size_t off);
+
+// 编辑: 登记替换，范围与已有编辑重叠时返回 0
+int dts_replace(DtsDoc *doc, size_t start, size_t end, const char *text, size_t text_len);
+int dts_insert(DtsDoc *doc, size_t at, const char *text);
+int dts_remove_node(DtsDoc *doc, const DtsNode *node);
+// 替换属性的整个值 / <...> 内的内容 / 整条语句
+int dts_set_value(DtsDoc *doc, const DtsProp *prop, const char *text);
+int dts_set_cells(DtsDoc *doc, const DtsProp *prop, const char *cells);
+int dts_set_prop(DtsDoc *doc, const DtsProp *prop, const char *text);
+
+// 片段链 (初始化为 {0})，片段和字面文本都分配在 doc->arena 上
+int dts_pieces_src(DtsDoc *doc, DtsPieces *pcs, size_t start, size_t end);
+int dts_pieces_text(DtsDoc *doc, DtsPieces *pcs, const char *text);
+// 节点从名称到 "};" 的原文，new_name 非 NULL 时换掉名称
+int dts_pieces_node(DtsDoc *doc, DtsPieces *pcs, const DtsNode *node, const char *new_name);
+// 把链中原文 [start, end) 换成 text，范围必须落在同一个原文片段内
+int dts_pieces_replace(DtsDoc *doc, DtsPieces *pcs, size_t start, size_t end, const char *text);
+// 同 dts_set_value / dts_set_cells，作用在片段链中该属性的原文上
+int dts_pieces_set_value(DtsDoc *doc, DtsPieces *pcs, const DtsProp *prop, const char *text);
+int dts_pieces_set_cells(DtsDoc *doc, DtsPieces *pcs, const DtsProp *prop, const char *cells);
+// 登记替换/插入，内容为片段链 (登记后不要再修改该链)
+int dts_replace_pieces(DtsDoc *doc, size_t start, size_t end, const DtsPieces *pcs);
+int dts_insert_pieces(DtsDoc *doc, size_t at, const DtsPieces *pcs);
+
+// 写出结果的组成: 总长度、其中引用原文的字节、编辑带来的新文本字节
+typedef struct {
+    size_t out_len;
+    size_t src_bytes;
+    size_t text_bytes;
+    int edits;
+} DtsWriteStats;
+
+void dts_write_stats(const DtsDoc *doc, DtsWriteStats *st);
+
+// 把原文与编辑拼接写出
+int dts_write(const DtsDoc *doc, FILE *out);
+int dts_write_file(const DtsDoc *doc, const char *path);
+
+#endif
@@ -0,0 +1,590 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fdt_edit.h"
+
+#define FDT_MAX_DEPTH 64
+#define FDT_ALIGN(x) (((x) + 3) & ~(size_t)3)
+
+static uint32_t be32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void put_be32(uint8_t *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static int load_fail(FdtTree *tree, const char *what, size_t off) {
+    snprintf(tree->error, sizeof(tree->error), "%s (offset 0x%zx)", what, off);
+    return 0;
+}
+
+// ==================== 载入 ====================
+
+int fdt_load(FdtTree *tree, const void *blob, size_t size) {
+    memset(tree, 0, sizeof(*tree));
+    const uint8_t *b = blob;
+    if (size < FDT_HEADER_SIZE) return load_fail(tree, "blob too small", 0);
+    if (be32(b) != FDT_MAGIC) return load_fail(tree, "bad magic", 0);
+
+    uint32_t total = be32(b + 4);
+    uint32_t off_struct = be32(b + 8);
+    uint32_t off_strings = be32(b + 12);
+    uint32_t off_rsvmap = be32(b + 16);
+    uint32_t version = be32(b + 20);
+    tree->boot_cpuid = be32(b + 28);
+    uint32_t size_strings = be32(b + 32);
+    uint32_t size_struct = version >= 17 ? be32(b + 36) : total - off_struct;
+
+    if (total > size) return load_fail(tree, "truncated blob", size);
+    if (version < 16) return load_fail(tree, "unsupported version", 20);
+    if (off_struct > total || size_struct > total - off_struct) return load_fail(tree, "bad struct block", 8);
+    if (off_strings > total || size_strings > total - off_strings) return load_fail(tree, "bad strings block", 12);
+    if (off_rsvmap > total || (off_rsvmap & 7)) return load_fail(tree, "bad reserve map", 16);
+
+    // 内存保留表以 address = size = 0 结束
+    size_t r = off_rsvmap;
+    for (;;) {
+        if (r + 16 > total) return load_fail(tree, "unterminated reserve map", r);
+        int last = be32(b + r) == 0 && be32(b + r + 4) == 0 && be32(b + r + 8) == 0 && be32(b + r + 12) == 0;
+        r += 16;
+        if (last) break;
+    }
+    tree->rsvmap = b + off_rsvmap;
+    tree->rsvmap_len = r - off_rsvmap;
+
+    const char *strings = (const char *)b + off_strings;
+    size_t p = off_struct;
+    size_t end = (size_t)off_struct + size_struct;
+    FdtNode *stack[FDT_MAX_DEPTH];
+    FdtNode *tail_child[FDT_MAX_DEPTH];
+    FdtProp *tail_prop[FDT_MAX_DEPTH];
+    int depth = 0;
+
+    for (;;) {
+        if (p + 4 > end) return load_fail(tree, "missing FDT_END", p);
+        uint32_t token = be32(b + p);
+        p += 4;
+
+        if (token == FDT_BEGIN_NODE) {
+            const char *name = (const char *)b + p;
+            size_t len = strnlen(name, end - p);
+            if (p + len >= end) return load_fail(tree, "unterminated node name", p);
+            if (depth == FDT_MAX_DEPTH) return load_fail(tree, "nesting too deep", p);
+            if (depth == 0 && tree->root) return load_fail(tree, "multiple root nodes", p);
+            p += FDT_ALIGN(len + 1);
+
+            FdtNode *node = dts_arena_alloc(&tree->arena, sizeof(FdtNode));
+            if (!node) return load_fail(tree, "out of memory", p);
+            node->name = name;
+            if (depth == 0) {
+                tree->root = node;
+            } else {
+                FdtNode *parent = stack[depth - 1];
+                node->parent = parent;
+                if (tail_child[depth - 1]) tail_child[depth - 1]->next = node;
+                else parent->children = node;
+                tail_child[depth - 1] = node;
+            }
+            stack[depth] = node;
+            tail_child[depth] = NULL;
+            tail_prop[depth] = NULL;
+            depth++;
+        } else if (token == FDT_END_NODE) {
+            if (depth == 0) return load_fail(tree, "unbalanced FDT_END_NODE", p - 4);
+            depth--;
+        } else if (token == FDT_PROP) {
+            if (depth == 0) return load_fail(tree, "property outside of node", p - 4);
+            if (p + 8 > end) return load_fail(tree, "truncated property", p);
+            uint32_t len = be32(b + p);
+            uint32_t nameoff = be32(b + p + 4);
+            p += 8;
+            if (len > end - p) return load_fail(tree, "property data out of range", p);
+            if (nameoff >= size_strings || !memchr(strings + nameoff, '\0', size_strings - nameoff)) {
+                return load_fail(tree, "bad property name offset", p - 4);
+            }
+
+            FdtProp *prop = dts_arena_alloc(&tree->arena, sizeof(FdtProp));
+            if (!prop) return load_fail(tree, "out of memory", p);
+            prop->name = strings + nameoff;
+            prop->data = b + p;
+            prop->len = len;
+            if (tail_prop[depth - 1]) tail_prop[depth - 1]->next = prop;
+            else stack[depth - 1]->props = prop;
+            tail_prop[depth - 1] = prop;
+            p += FDT_ALIGN(len);
+        } else if (token == FDT_NOP) {
+            continue;
+        } else if (token == FDT_END) {
+            break;
+        } else {
+            return load_fail(tree, "bad token", p - 4);
+        }
+    }
+
+    if (depth != 0 || !tree->root) return load_fail(tree, "unterminated root node", p);
+    return 1;
+}
+
+void fdt_free(FdtTree *tree) {
+    dts_arena_free(&tree->arena);
+    memset(tree, 0, sizeof(*tree));
+}
+
+// ==================== 查询 ====================
+
+FdtNode *fdt_skip(const FdtNode *top, const FdtNode *node) {
+    while (node && node != top) {
+        if (node->next) return node->next;
+        node = node->parent;
+    }
+    return NULL;
+}
+
+FdtNode *fdt_next(const FdtNode *top, const FdtNode *node) {
+    if (node->children) return node->children;
+    return fdt_skip(top, node);
+}
+
+FdtNode *fdt_child(const FdtNode *node, const char *name) {
+    for (FdtNode *c = node->children; c; c = c->next) {
+        if (strcmp(c->name, name) == 0) return c;
+    }
+    return NULL;
+}
+
+FdtNode *fdt_find_path(const FdtTree *tree, const char *path) {
+    FdtNode *node = tree->root;
+    const char *p = path;
+    while (node && *p) {
+        while (*p == '/') p++;
+        if (!*p) break;
+        const char *slash = strchr(p, '/');
+        size_t len = slash ? (size_t)(slash - p) : strlen(p);
+        FdtNode *c;
+        for (c = node->children; c; c = c->next) {
+            if (strlen(c->name) == len && memcmp(c->name, p, len) == 0) break;
+        }
+        node = c;
+        p += len;
+    }
+    return node;
+}
+
+FdtNode *fdt_find_node(const FdtTree *tree, const char *name) {
+    for (FdtNode *n = fdt_next(tree->root, tree->root); n; n = fdt_next(tree->root, n)) {
+        if (strcmp(n->name, name) == 0) return n;
+    }
+    return NULL;
+}
+
+int fdt_path_of(const FdtNode *node, char *buf, size_t size) {
+    if (!node->parent) return snprintf(buf, size, "/") < (int)size;
+    int len = 0;
+    if (node->parent->parent) {
+        if (!fdt_path_of(node->parent, buf, size)) return 0;
+        len = (int)strlen(buf);
+    }
+    int n = snprintf(buf + len, size - len, "/%s", node->name);
+    return n >= 0 && n < (int)(size - len);
+}
+
+FdtProp *fdt_prop(const FdtNode *node, const char *name) {
+    for (FdtProp *p = node->props; p; p = p->next) {
+        if (strcmp(p->name, name) == 0) return p;
+    }
+    return NULL;
+}
+
+int fdt_prop_u32(const FdtProp *prop, int index, uint32_t *out) {
+    if (!prop || index < 0 || (size_t)(index + 1) * 4 > prop->len) return 0;
+    *out = be32(prop->data + index * 4);
+    return 1;
+}
+
+int fdt_prop_uint(const FdtProp *prop, unsigned long long *out) {
+    if (!prop) return 0;
+    if (prop->len == 4) {
+        *out = be32(prop->data);
+        return 1;
+    }
+    if (prop->len == 8) {
+        *out = ((unsigned long long)be32(prop->data) << 32) | be32(prop->data + 4);
+        return 1;
+    }
+    return 0;
+}
+
+// ==================== 修改 ====================
+
+int fdt_set_prop(FdtTree *tree, FdtNode *node, const char *name, const void *data, uint32_t len) {
+    uint8_t *copy = dts_arena_alloc(&tree->arena, len ? len : 1);
+    if (!copy) return 0;
+    if (len) memcpy(copy, data, len);
+
+    FdtProp *prop = fdt_prop(node, name);
+    if (!prop) {
+        prop = dts_arena_alloc(&tree->arena, sizeof(FdtProp));
+        if (!prop) return 0;
+        prop->name = dts_arena_strndup(&tree->arena, name, strlen(name));
+        if (!prop->name) return 0;
+        FdtProp **tail = &node->props;
+        while (*tail) tail = &(*tail)->next;
+        *tail = prop;
+    }
+    prop->data = copy;
+    prop->len = len;
+    return 1;
+}
+
+int fdt_set_u32(FdtTree *tree, FdtNode *node, const char *name, uint32_t value) {
+    uint8_t data[4];
+    put_be32(data, value);
+    return fdt_set_prop(tree, node, name, data, 4);
+}
+
+int fdt_set_u64(FdtTree *tree, FdtNode *node, const char *name, unsigned long long value) {
+    uint8_t data[8];
+    put_be32(data, (uint32_t)(value >> 32));
+    put_be32(data + 4, (uint32_t)value);
+    return fdt_set_prop(tree, node, name, data, 8);
+}
+
+int fdt_set_string(FdtTree *tree, FdtNode *node, const char *name, const char *value) {
+    return fdt_set_prop(tree, node, name, value, (uint32_t)strlen(value) + 1);
+}
+
+int fdt_set_uint(FdtTree *tree, FdtNode *node, const char *name, unsigned long long value) {
+    FdtProp *prop = fdt_prop(node, name);
+    if (prop && prop->len == 8) return fdt_set_u64(tree, node, name, value);
+    return fdt_set_u32(tree, node, name, (uint32_t)value);
+}
+
+int fdt_delete_prop(FdtNode *node, const char *name) {
+    for (FdtProp **pp = &node->props; *pp; pp = &(*pp)->next) {
+        if (strcmp((*pp)->name, name) == 0) {
+            *pp = (*pp)->next;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int unlink_node(FdtNode *node) {
+    if (!node->parent) return 0;
+    for (FdtNode **pp = &node->parent->children; *pp; pp = &(*pp)->next) {
+        if (*pp == node) {
+            *pp = node->next;
+            node->next = NULL;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 复制子树，去掉 phandle (必须唯一，引用仍指向原节点)
+static FdtNode *copy_subtree(FdtTree *tree, const FdtNode *src, FdtNode *parent) {
+    FdtNode *node = dts_arena_alloc(&tree->arena, sizeof(FdtNode));
+    if (!node) return NULL;
+    node->name = src->name;
+    node->parent = parent;
+
+    FdtProp **tail_prop = &node->props;
+    for (const FdtProp *p = src->props; p; p = p->next) {
+        if (strcmp(p->name, "phandle") == 0 || strcmp(p->name, "linux,phandle") == 0) continue;
+        FdtProp *copy = dts_arena_alloc(&tree->arena, sizeof(FdtProp));
+        if (!copy) return NULL;
+        *copy = *p;
+        copy->next = NULL;
+        *tail_prop = copy;
+        tail_prop = &copy->next;
+    }
+
+    FdtNode **tail_child = &node->children;
+    for (const FdtNode *c = src->children; c; c = c->next) {
+        FdtNode *copy = copy_subtree(tree, c, node);
+        if (!copy) return NULL;
+        *tail_child = copy;
+        tail_child = &copy->next;
+    }
+    return node;
+}
+
+// __local_fixups__ 下与 path 对应的镜像节点
+static FdtNode *local_fixup_mirror(const FdtTree *tree, const char *path) {
+    FdtNode *lf = fdt_child(tree->root, "__local_fixups__");
+    if (!lf) return NULL;
+    FdtNode *node = lf;
+    const char *p = path;
+    while (node && *p) {
+        while (*p == '/') p++;
+        if (!*p) break;
+        const char *slash = strchr(p, '/');
+        size_t len = slash ? (size_t)(slash - p) : strlen(p);
+        FdtNode *c;
+        for (c = node->children; c; c = c->next) {
+            if (strlen(c->name) == len && memcmp(c->name, p, len) == 0) break;
+        }
+        node = c;
+        p += len;
+    }
+    return node == lf ? NULL : node;
+}
+
+static int path_under(const char *entry, size_t entry_len, const char *path) {
+    size_t n = strlen(path);
+    return entry_len >= n && memcmp(entry, path, n) == 0 && (entry_len == n || entry[n] == '/' || entry[n] == ':');
+}
+
+// 改写 __fixups__ 中 "path:prop:offset" 条目: new_path 为 NULL 时删除 path 下的条目，
+// 否则为这些条目追加一份把 path 换成 new_path 的副本
+static int rewrite_fixups(FdtTree *tree, const char *path, const char *new_path) {
+    FdtNode *fx = fdt_child(tree->root, "__fixups__");
+    if (!fx) return 1;
+    size_t path_len = strlen(path);
+    size_t new_len = new_path ? strlen(new_path) : 0;
+
+    for (FdtProp *p = fx->props, *next; p; p = next) {
+        next = p->next;
+        // 最坏情况: 每条都复制一份
+        size_t cap = (size_t)p->len * 2 + (new_len > path_len ? (new_len - path_len) * p->len : 0) + 1;
+        uint8_t *out = NULL;
+        size_t out_len = 0;
+        int changed = 0;
+
+        for (int pass = 0; pass < 2; pass++) {
+            for (size_t i = 0; i < p->len; ) {
+                const char *entry = (const char *)p->data + i;
+                size_t len = strnlen(entry, p->len - i);
+                int hit = path_under(entry, len, path);
+                if (pass == 0 && !(hit && !new_path)) {
+                    if (!out) {
+                        out = dts_arena_alloc(&tree->arena, cap);
+                        if (!out) return 0;
+                    }
+                    memcpy(out + out_len, entry, len);
+                    out[out_len + len] = '\0';
+                    out_len += len + 1;
+                }
+                if (pass == 1 && hit) {
+                    memcpy(out + out_len, new_path, new_len);
+                    memcpy(out + out_len + new_len, entry + path_len, len - path_len);
+                    out[out_len + new_len + len - path_len] = '\0';
+                    out_len += new_len + len - path_len + 1;
+                }
+                if (hit) changed = 1;
+                i += len + 1;
+            }
+            if (!new_path) break;
+        }
+
+        if (!changed) continue;
+        if (out_len == 0) {
+            fdt_delete_prop(fx, p->name);
+        } else {
+            p->data = out;
+            p->len = (uint32_t)out_len;
+        }
+    }
+    return 1;
+}
+
+// 删除 __symbols__ 中指向 path 或其子节点的标签
+static void drop_symbols(FdtTree *tree, const char *path) {
+    FdtNode *sym = fdt_child(tree->root, "__symbols__");
+    if (!sym) return;
+    for (FdtProp *p = sym->props, *next; p; p = next) {
+        next = p->next;
+        size_t len = p->len ? strnlen((const char *)p->data, p->len) : 0;
+        if (path_under((const char *)p->data, len, path)) fdt_delete_prop(sym, p->name);
+    }
+}
+
+FdtNode *fdt_clone(FdtTree *tree, FdtNode *node, const char *new_name) {
+    if (!node->parent) return NULL;
+    char path[1024], new_path[1024];
+    if (!fdt_path_of(node, path, sizeof(path)) || !fdt_path_of(node->parent, new_path, sizeof(new_path))) return NULL;
+    size_t n = strlen(new_path);
+    if (snprintf(new_path + n, sizeof(new_path) - n, "%s%s", n > 1 ? "/" : "", new_name) >= (int)(sizeof(new_path) - n)) {
+        return NULL;
+    }
+
+    FdtNode *copy = copy_subtree(tree, node, node->parent);
+    if (!copy) return NULL;
+    copy->name = dts_arena_strndup(&tree->arena, new_name, strlen(new_name));
+    if (!copy->name) return NULL;
+    copy->next = node->next;
+    node->next = copy;
+
+    FdtNode *mirror = local_fixup_mirror(tree, path);
+    if (mirror) {
+        FdtNode *mcopy = copy_subtree(tree, mirror, mirror->parent);
+        if (!mcopy) return NULL;
+        mcopy->name = copy->name;
+        mcopy->next = mirror->next;
+        mirror->next = mcopy;
+    }
+    if (!rewrite_fixups(tree, path, new_path)) return NULL;
+    return copy;
+}
+
+int fdt_delete(FdtTree *tree, FdtNode *node) {
+    char path[1024];
+    if (!node->parent || !fdt_path_of(node, path, sizeof(path))) return 0;
+    if (!unlink_node(node)) return 0;
+
+    FdtNode *mirror = local_fixup_mirror(tree, path);
+    if (mirror) unlink_node(mirror);
+    rewrite_fixups(tree, path, NULL);
+    drop_symbols(tree, path);
+    return 1;
+}
+
+// ==================== 写出 ====================
+
+typedef struct {
+    const char **names;
+    uint32_t *offsets;
+    size_t mask;
+    char *data;
+    size_t len;
+    size_t cap;
+} StringTable;
+
+static uint32_t hash_name(const char *s) {
+    uint32_t h = 2166136261u;
+    while (*s) h = (h ^ (uint8_t)*s++) * 16777619u;
+    return h;
+}
+
+// 返回名称在字符串表中的偏移，相同名称只存一份
+static int intern_name(StringTable *st, const char *name, uint32_t *off) {
+    size_t i = hash_name(name) & st->mask;
+    while (st->names[i]) {
+        if (strcmp(st->names[i], name) == 0) {
+            *off = st->offsets[i];
+            return 1;
+        }
+        i = (i + 1) & st->mask;
+    }
+    size_t len = strlen(name) + 1;
+    if (st->len + len > st->cap) {
+        size_t cap = st->cap ? st->cap * 2 : 1024;
+        while (cap < st->len + len) cap *= 2;
+        char *data = realloc(st->data, cap);
+        if (!data) return 0;
+        st->data = data;
+        st->cap = cap;
+    }
+    memcpy(st->data + st->len, name, len);
+    st->names[i] = name;
+    st->offsets[i] = (uint32_t)st->len;
+    *off = (uint32_t)st->len;
+    st->len += len;
+    return 1;
+}
+
+size_t fdt_emit(const FdtTree *tree, uint8_t **out) {
+    *out = NULL;
+    if (!tree->root) return 0;
+
+    // 第一遍: 结构块大小和属性数
+    size_t struct_size = 4; // FDT_END
+    size_t prop_count = 0;
+    for (const FdtNode *n = tree->root; n; n = fdt_next(tree->root, n)) {
+        struct_size += 8 + FDT_ALIGN(strlen(n->name) + 1); // BEGIN_NODE + name + END_NODE
+        for (const FdtProp *p = n->props; p; p = p->next) {
+            struct_size += 12 + FDT_ALIGN(p->len);
+            prop_count++;
+        }
+    }
+
+    StringTable st = {0};
+    size_t slots = 64;
+    while (slots < prop_count * 2) slots *= 2;
+    st.names = calloc(slots, sizeof(char *));
+    st.offsets = calloc(slots, sizeof(uint32_t));
+    st.mask = slots - 1;
+    if (!st.names || !st.offsets) goto fail;
+    for (const FdtNode *n = tree->root; n; n = fdt_next(tree->root, n)) {
+        for (const FdtProp *p = n->props; p; p = p->next) {
+            uint32_t off;
+            if (!intern_name(&st, p->name, &off)) goto fail;
+        }
+    }
+
+    size_t rsv_len = tree->rsvmap_len ? tree->rsvmap_len : 16;
+    size_t off_rsvmap = FDT_HEADER_SIZE;
+    size_t off_struct = off_rsvmap + rsv_len;
+    size_t off_strings = off_struct + struct_size;
+    size_t total = off_strings + st.len;
+
+    uint8_t *blob = calloc(1, total);
+    if (!blob) goto fail;
+    put_be32(blob, FDT_MAGIC);
+    put_be32(blob + 4, (uint32_t)total);
+    put_be32(blob + 8, (uint32_t)off_struct);
+    put_be32(blob + 12, (uint32_t)off_strings);
+    put_be32(blob + 16, (uint32_t)off_rsvmap);
+    put_be32(blob + 20, FDT_VERSION);
+    put_be32(blob + 24, FDT_LAST_COMP_VERSION);
+    put_be32(blob + 28, tree->boot_cpuid);
+    put_be32(blob + 32, (uint32_t)st.len);
+    put_be32(blob + 36, (uint32_t)struct_size);
+    if (tree->rsvmap_len) memcpy(blob + off_rsvmap, tree->rsvmap, tree->rsvmap_len);
+
+    // 第二遍: 按先序写出，每离开一个节点补一个 END_NODE
+    uint8_t *w = blob + off_struct;
+    const FdtNode *n = tree->root;
+    while (n) {
+        put_be32(w, FDT_BEGIN_NODE);
+        w += 4;
+        size_t name_len = strlen(n->name) + 1;
+        memcpy(w, n->name, name_len);
+        w += FDT_ALIGN(name_len);
+        for (const FdtProp *p = n->props; p; p = p->next) {
+            uint32_t off = 0;
+            intern_name(&st, p->name, &off);
+            put_be32(w, FDT_PROP);
+            put_be32(w + 4, p->len);
+            put_be32(w + 8, off);
+            if (p->len) memcpy(w + 12, p->data, p->len);
+            w += 12 + FDT_ALIGN(p->len);
+        }
+        if (n->children) {
+            n = n->children;
+            continue;
+        }
+        for (;;) {
+            put_be32(w, FDT_END_NODE);
+            w += 4;
+            if (n == tree->root) {
+                n = NULL;
+                break;
+            }
+            if (n->next) {
+                n = n->next;
+                break;
+            }
+            n = n->parent;
+        }
+    }
+    put_be32(w, FDT_END);
+    memcpy(blob + off_strings, st.data, st.len);
+
+    free(st.names);
+    free(st.offsets);
+    free(st.data);
+    *out = blob;
+    return total;
+
+fail:
+    free(st.names);
+    free(st.offsets);
+    free(st.data);
+    return 0;
+}
@@ -0,0 +1,89 @@
+#ifndef FDT_EDIT_H
+#define FDT_EDIT_H
+
+// ==================== FDT (DTB) 直接编辑 ====================
+// 在进程内读取扁平设备树 (DTB) 并修改，不再经过 dtc 反编译成文本再编译回去。
+// 载入时把结构块解析成节点/属性树，节点名和属性值直接指向原始 blob (零拷贝)，
+// 只有新写入的值才在 arena 上分配，所以 blob 在树释放前必须保持有效。
+// 写出时重新生成结构块和字符串表 (属性名去重)，保留原有的内存保留表。
+//
+// DTBO 中的 overlay 会带 __symbols__ / __fixups__ / __local_fixups__:
+// 复制节点时同步复制 __local_fixups__ 中的镜像节点和 __fixups__ 中的条目，
+// 并去掉副本中的 phandle；删除节点时一并删除引用它的这些条目。
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dts_tree.h"
+
+#define FDT_MAGIC 0xd00dfeed
+#define FDT_BEGIN_NODE 0x1
+#define FDT_END_NODE 0x2
+#define FDT_PROP 0x3
+#define FDT_NOP 0x4
+#define FDT_END 0x9
+#define FDT_HEADER_SIZE 40
+#define FDT_VERSION 17
+#define FDT_LAST_COMP_VERSION 16
+
+typedef struct FdtProp {
+    const char *name;
+    const uint8_t *data;   // 大端原始数据
+    uint32_t len;
+    struct FdtProp *next;
+} FdtProp;
+
+typedef struct FdtNode {
+    const char *name;      // 根节点为 ""
+    struct FdtNode *parent;
+    struct FdtNode *children;
+    struct FdtNode *next;
+    FdtProp *props;
+} FdtNode;
+
+typedef struct {
+    DtsArena arena;
+    FdtNode *root;
+    const uint8_t *rsvmap; // 内存保留表 (含结尾的 0,0 项)，原样写回
+    size_t rsvmap_len;
+    uint32_t boot_cpuid;
+    char error[128];
+} FdtTree;
+
+// 解析 blob，失败时返回 0，原因在 tree->error
+int fdt_load(FdtTree *tree, const void *blob, size_t size);
+void fdt_free(FdtTree *tree);
+
+// 先序遍历，用法同 dts_next / dts_skip
+FdtNode *fdt_next(const FdtNode *top, const FdtNode *node);
+FdtNode *fdt_skip(const FdtNode *top, const FdtNode *node);
+FdtNode *fdt_child(const FdtNode *node, const char *name);
+// "/a/b@1/c" 形式的绝对路径
+FdtNode *fdt_find_path(const FdtTree *tree, const char *path);
+// 整棵树中 (先序) 第一个同名节点
+FdtNode *fdt_find_node(const FdtTree *tree, const char *name);
+int fdt_path_of(const FdtNode *node, char *buf, size_t size);
+
+FdtProp *fdt_prop(const FdtNode *node, const char *name);
+// 第 index 个 32 位 cell
+int fdt_prop_u32(const FdtProp *prop, int index, uint32_t *out);
+// 单个 cell 的值 (长度 4 或 8)
+int fdt_prop_uint(const FdtProp *prop, unsigned long long *out);
+
+// 修改属性，不存在时追加到节点末尾
+int fdt_set_prop(FdtTree *tree, FdtNode *node, const char *name, const void *data, uint32_t len);
+int fdt_set_u32(FdtTree *tree, FdtNode *node, const char *name, uint32_t value);
+int fdt_set_u64(FdtTree *tree, FdtNode *node, const char *name, unsigned long long value);
+int fdt_set_string(FdtTree *tree, FdtNode *node, const char *name, const char *value);
+// 按原属性的宽度 (4 或 8 字节) 写入单个 cell，属性不存在时按 32 位新建
+int fdt_set_uint(FdtTree *tree, FdtNode *node, const char *name, unsigned long long value);
+int fdt_delete_prop(FdtNode *node, const char *name);
+
+// 深拷贝 node 为同级的 new_name，插在 node 之后
+FdtNode *fdt_clone(FdtTree *tree, FdtNode *node, const char *new_name);
+int fdt_delete(FdtTree *tree, FdtNode *node);
+
+// 生成新的 blob (malloc)，返回长度，失败返回 0
+size_t fdt_emit(const FdtTree *tree, uint8_t **out);
+
+#endif
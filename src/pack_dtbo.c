@@ -5,10 +5,18 @@
 #include <unistd.h>
 #include <sys/stat.h>
 
-#define MAX_CMD 131072 // 128KB for command line
+#include "dtbo_img.h"
+#include "dtc_pool.h"
+
 #define MAX_PATH 1024
 #define INPUT_DIR "dtbo_dts"
 
+typedef struct {
+    char name[256];
+    long index;             // dtb_temp.N.dts 中的 N，其他文件名为 -1
+    DtboEntry entry;
+} DtsSource;
+
 void load_avb_config(char *partition_size, char *hash_alg, char *partition_name, 
                      char *salt, char *algorithm, char *rollback_index, 
                      char *release_string, char *prop);
@@ -17,7 +25,37 @@ int is_file_exist(const char *path) {
     return access(path, F_OK) == 0;
 }
 
-int main() {
+// dtb_temp.N.dts 按 N 排序 (保持原镜像中的条目顺序)，其他文件按名称排在后面
+int compare_source(const void *a, const void *b) {
+    const DtsSource *x = a, *y = b;
+    if (x->index >= 0 && y->index >= 0) return x->index < y->index ? -1 : x->index > y->index;
+    if (x->index >= 0 || y->index >= 0) return x->index >= 0 ? -1 : 1;
+    return strcmp(x->name, y->name);
+}
+
+// 编译第 index 个 DTS，从 dtc 的标准输出读取 DTB (malloc)
+int compile_dts(int index, void *ctx) {
+    DtsSource *src = &((DtsSource *)ctx)[index];
+    char dts_path[MAX_PATH];
+    snprintf(dts_path, sizeof(dts_path), "%s/%s", INPUT_DIR, src->name);
+    const char *args[] = { "./dtc", "-I", "dts", "-O", "dtb", "-o", "-", dts_path, NULL };
+    uint8_t *dtb = NULL;
+    size_t len = 0;
+    if (!dtc_run(args, NULL, 0, &dtb, &len) || len == 0 || len > UINT32_MAX) {
+        free(dtb);
+        return 0;
+    }
+    src->entry.data = dtb;
+    src->entry.size = (uint32_t)len;
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    // 用法: pack_dtbo [-j 线程数]
+    int jobs = 0;
+    if (argc > 2 && strcmp(argv[1], "-j") == 0) jobs = atoi(argv[2]);
+    jobs = dtc_pool_jobs(jobs);
+
     printf("开始打包DTBO镜像...\n");
 
     // 检查工具
@@ -25,71 +63,91 @@ int main() {
         printf("错误: 找不到 ./dtc 工具\n");
         return 1;
     }
-    if (!is_file_exist("./mkdtimg")) {
-        printf("错误: 找不到 ./mkdtimg 工具\n");
-        return 1;
-    }
 
     DIR *d;
     struct dirent *dir;
-    char mkdtimg_cmd[MAX_CMD];
-    snprintf(mkdtimg_cmd, sizeof(mkdtimg_cmd), "./mkdtimg create new_dtbo.img");
+    DtsSource *sources = NULL;
+    int count = 0;
 
     d = opendir(INPUT_DIR);
     if (!d) {
         printf("错误: 无法打开目录 %s\n", INPUT_DIR);
         return 1;
     }
-
-    int dtb_count = 0;
-    char cmd[MAX_PATH * 2];
-
-    printf("步骤1: 编译DTS为DTB...\n");
-
     while ((dir = readdir(d)) != NULL) {
         char *dot = strrchr(dir->d_name, '.');
-        if (dot && strcmp(dot, ".dts") == 0) {
-            char base_name[MAX_PATH];
-            strncpy(base_name, dir->d_name, dot - dir->d_name);
-            base_name[dot - dir->d_name] = '\0';
-
-            // DTB 生成在当前目录
-            char dtb_name[MAX_PATH];
-            snprintf(dtb_name, sizeof(dtb_name), "%s.dtb", base_name);
-            
-            // DTS 路径
-            char dts_path[MAX_PATH];
-            snprintf(dts_path, sizeof(dts_path), "%s/%s", INPUT_DIR, dir->d_name);
-
-            printf("编译: %s -> %s\n", dts_path, dtb_name);
-            
-            snprintf(cmd, sizeof(cmd), "./dtc -I dts -O dtb -o \"%s\" \"%s\"", dtb_name, dts_path);
-            if (system(cmd) != 0) {
-                printf("错误: 编译 %s 失败\n", dir->d_name);
-                closedir(d);
-                return 1;
-            }
-
-            // Append to mkdtimg command
-            strncat(mkdtimg_cmd, " \"", sizeof(mkdtimg_cmd) - strlen(mkdtimg_cmd) - 1);
-            strncat(mkdtimg_cmd, dtb_name, sizeof(mkdtimg_cmd) - strlen(mkdtimg_cmd) - 1);
-            strncat(mkdtimg_cmd, "\"", sizeof(mkdtimg_cmd) - strlen(mkdtimg_cmd) - 1);
-            dtb_count++;
+        if (!dot || strcmp(dot, ".dts") != 0) continue;
+        DtsSource *grown = realloc(sources, (count + 1) * sizeof(DtsSource));
+        if (!grown) break;
+        sources = grown;
+        DtsSource *src = &sources[count++];
+        memset(src, 0, sizeof(*src));
+        snprintf(src->name, sizeof(src->name), "%s", dir->d_name);
+        char *end;
+        src->index = -1;
+        if (strncmp(dir->d_name, "dtb_temp.", 9) == 0) {
+            long index = strtol(dir->d_name + 9, &end, 10);
+            if (end != dir->d_name + 9 && end == dot) src->index = index;
         }
     }
     closedir(d);
 
-    if (dtb_count == 0) {
+    if (count == 0) {
         printf("错误: 没有找到DTS文件\n");
+        free(sources);
         return 1;
     }
+    qsort(sources, count, sizeof(DtsSource), compare_source);
 
-    printf("步骤2: 打包DTB文件为DTBO镜像...\n");
-    if (system(mkdtimg_cmd) != 0) {
-        printf("错误: 打包DTBO失败\n");
-        return 1;
+    printf("步骤1: 编译DTS为DTB (%d 线程)...\n", jobs);
+    double t0 = dtc_pool_now_ms();
+    int first_failed = dtc_pool_run(count, jobs, compile_dts, sources);
+    int compiled = first_failed == -1 ? count : first_failed == DTC_POOL_NOMEM ? 0 : first_failed;
+    for (int i = 0; i < compiled; i++) printf("编译: %s/%s\n", INPUT_DIR, sources[i].name);
+    int failed = first_failed != -1;
+    if (first_failed == DTC_POOL_NOMEM) printf("错误: 内存不足\n");
+    else if (failed) printf("错误: 编译 %s 失败\n", sources[first_failed].name);
+    double t1 = dtc_pool_now_ms();
+    printf("步骤1 耗时: %.1f ms\n", t1 - t0);
+
+    if (!failed) {
+        // 还原解包时记录的表头字段和条目 id/rev/custom
+        uint32_t page_size = DTBO_DEFAULT_PAGE_SIZE;
+        uint32_t version = 0;
+        long max_index = -1;
+        for (int i = 0; i < count; i++) {
+            if (sources[i].index > max_index) max_index = sources[i].index;
+        }
+        DtboEntry *info = calloc(max_index + 2, sizeof(DtboEntry));
+        if (info && dtbo_load_info(INPUT_DIR "/" DTBO_INFO_FILE, info, (int)max_index + 1, &page_size, &version)) {
+            for (int i = 0; i < count; i++) {
+                if (sources[i].index < 0) continue;
+                DtboEntry *e = &info[sources[i].index];
+                sources[i].entry.id = e->id;
+                sources[i].entry.rev = e->rev;
+                memcpy(sources[i].entry.custom, e->custom, sizeof(e->custom));
+            }
+        } else {
+            printf("提示: 未找到 %s/%s，条目 id/rev 使用默认值 0\n", INPUT_DIR, DTBO_INFO_FILE);
+        }
+        free(info);
+
+        printf("步骤2: 打包DTB文件为DTBO镜像...\n");
+        DtboEntry *entries = malloc(count * sizeof(DtboEntry));
+        if (!entries) failed = 1;
+        for (int i = 0; entries && i < count; i++) entries[i] = sources[i].entry;
+        if (entries && !dtbo_write("new_dtbo.img", entries, count, page_size, version)) {
+            printf("错误: 打包DTBO失败\n");
+            failed = 1;
+        }
+        free(entries);
+        printf("步骤2 耗时: %.1f ms\n", dtc_pool_now_ms() - t1);
     }
 
+    for (int i = 0; i < count; i++) free((void *)sources[i].entry.data);
+    free(sources);
+    if (failed) return 1;
+
     printf("打包成功! 输出文件: new_dtbo.img\n");
 
     // AVB Signing Logic
@@ -162,28 +220,6 @@ int main() {
         }
     }
 
-    // 清理DTB文件
-    printf("清理临时DTB文件...\n");
-    // 我们只清理刚才生成的那些dtb
-    // 由于我们不知道之前是否有名为 .dtb 的文件，最好只清理我们编译的。
-    // 这里简单地重新扫描一遍 dts 目录来确定要删除哪些 dtb
-    d = opendir(INPUT_DIR);
-    if (d) {
-        while ((dir = readdir(d)) != NULL) {
-            char *dot = strrchr(dir->d_name, '.');
-            if (dot && strcmp(dot, ".dts") == 0) {
-                char base_name[MAX_PATH];
-                strncpy(base_name, dir->d_name, dot - dir->d_name);
-                base_name[dot - dir->d_name] = '\0';
-                
-                char dtb_name[MAX_PATH];
-                snprintf(dtb_name, sizeof(dtb_name), "%s.dtb", base_name);
-                remove(dtb_name);
-            }
-        }
-        closedir(d);
-    }
-
     printf("完成!\n");
     return 0;
 }
@@ -27,8 +27,13 @@
 #include <dirent.h>
 #include <unistd.h>
 #include <sys/stat.h>
-#include <ctype.h>
+#ifdef __ANDROID__
 #include <sys/system_properties.h>
+#else
+#define PROP_VALUE_MAX 92
+#endif
+
+#include "dts_tree.h"
 
 #define MODEL_UNKNOWN 0
 #define MODEL_RMX5200 1 // Realme GT8 Pro
@@ -39,9 +44,24 @@ int g_current_model = MODEL_UNKNOWN;
 unsigned long long g_target_project_id = 0;
 int g_has_project_id = 0;
 
+// Read a system property; host builds (bench/dts_regress.sh) ask the getprop found in PATH
+void get_prop(const char *name, char *value) {
+    value[0] = '\0';
+#ifdef __ANDROID__
+    __system_property_get(name, value);
+#else
+    char cmd[160];
+    snprintf(cmd, sizeof(cmd), "getprop %s 2>/dev/null", name);
+    FILE *fp = popen(cmd, "r");
+    if (!fp) return;
+    if (fgets(value, PROP_VALUE_MAX, fp)) value[strcspn(value, "\r\n")] = '\0';
+    pclose(fp);
+#endif
+}
+
 void detect_device_model() {
     char model[PROP_VALUE_MAX] = {0};
-    __system_property_get("ro.product.vendor.model", model);
+    get_prop("ro.product.vendor.model", model);
     
     printf("Detected Device Model: %s\n", model);
     
@@ -62,7 +82,7 @@ void detect_device_model() {
 
     // Get Project ID
     char prj_prop[PROP_VALUE_MAX] = {0};
-    __system_property_get("ro.boot.prjname", prj_prop);
+    get_prop("ro.boot.prjname", prj_prop);
     
     if (strlen(prj_prop) > 0) {
         // Auto-detect base (0x for hex, others for decimal)
@@ -77,18 +97,19 @@ void detect_device_model() {
 }
 
 
-#define MAX_LINE 4096
-#define MAX_BLOCK 131072 // 128KB buffer for blocks
 #define DIR_NAME "dtbo_dts"
 
-// Structure to hold timing node info
+// Per-run storage: paths live in g_run, node names are interned once for all files
+// (the same timing names repeat across dtbo entries); per-file text goes on each doc's arena
+DtsArena g_run;
+DtsStrtab g_names;
+
+// Structure to hold timing node info, the template text stays in the parsed source
 typedef struct {
-    char name[128];
-    char content[MAX_BLOCK];
+    const DtsNode *node;
     unsigned long long clock;
     unsigned int fps;
     unsigned int transfer_time;
-    unsigned int cell_index;
     int valid;
 } TimingNode;
 
@@ -99,400 +120,146 @@ int is_regular_file(const char *path) {
     return S_ISREG(path_stat.st_mode);
 }
 
-// Robust property finder
-// Finds "prop_name =" or "prop_name=" handling whitespace
-// Returns pointer to the start of prop_name
-char *find_prop(const char *content, const char *prop_name) {
-    const char *p = content;
-    size_t name_len = strlen(prop_name);
-    
-    while ((p = strstr(p, prop_name))) {
-        // Check start boundary (ensure not a suffix)
-        if (p > content) {
-            char prev = *(p - 1);
-            if (isalnum(prev) || prev == '-' || prev == '_') {
-                p += name_len;
-                continue;
-            }
-        }
-        
-        // Check end boundary and look for '='
-        const char *curr = p + name_len;
-        while (isspace(*curr)) curr++;
-        
-        if (*curr == '=') {
-            return (char*)p;
-        }
-        
-        p += name_len;
-    }
-    return NULL;
-}
-
-// Simple string replacement (first occurrence)
-void replace_str(char *str, const char *orig, const char *rep) {
-    char buffer[MAX_BLOCK];
-    char *p;
-
-    if (!(p = strstr(str, orig)))
-        return;
-
-    strncpy(buffer, str, p - str);
-    buffer[p - str] = '\0';
-
-    sprintf(buffer + (p - str), "%s%s", rep, p + strlen(orig));
-    strcpy(str, buffer);
-}
+#define PANEL_GT8_PRO "qcom,mdss_dsi_panel_AE084_P_3_A0033_dsc_cmd_dvt02"
+#define PANEL_ONEPLUS_15 "qcom,mdss_dsi_panel_AD296_P_3_A0020_dsc_cmd"
+#define PANEL_ONEPLUS_12 "qcom,mdss_dsi_panel_AA545_P_3_A0005_dsc_cmd"
 
-// Extract hex/int property value (e.g., <0x123> or <123>)
-unsigned long long get_prop_u64(const char *content, const char *prop_name) {
-    char *p = find_prop(content, prop_name);
-    if (!p) return 0;
-    
-    // Safety: Ensure we find < before ; or }
-    char *end_stmt = strpbrk(p, ";}");
-    char *start = strchr(p, '<');
-    
-    if (!start) return 0;
-    if (end_stmt && start > end_stmt) return 0; // Found < but it's in next property
-    
-    start++; // skip <
-    
-    unsigned long long val = 0;
-    // Handle hex and decimal
-    while(isspace(*start)) start++;
-    
-    if (strstr(start, "0x") == start || strstr(start, "0X") == start) {
-        sscanf(start, "%llx", &val);
-    } else {
-        sscanf(start, "%lld", &val);
-    }
-    return val;
+int is_panel_node(const DtsNode *node) {
+    return (node->keys & DTS_KEY_BIT(DTS_KEY_PANEL)) != 0;
 }
 
-// Update existing property value (u64/u32)
-int update_prop_u64(char *content, const char *prop_name, unsigned long long new_val) {
-    char *p = find_prop(content, prop_name);
-    if (!p) {
-        // printf("Warning: Property '%s' not found for update.\n", prop_name);
+// Which target panel contains offset off, answered from the panel index built once per file
+// 0: None, 1: GT8 Pro, 2: OnePlus 15, 3: OnePlus 12
+// Optional: out_panel returns the enclosing panel node
+int get_panel_id(const DtsSpanIndex *panels, size_t off, const DtsNode **out_panel) {
+    const DtsNode *panel = dts_span_find(panels, off);
+    if (out_panel) *out_panel = panel;
+    if (!panel) return 0;
+
+    // Explicitly ignore engineering panels (evt)
+    if (panel->keys & DTS_KEY_BIT(DTS_KEY_EVT)) {
         return 0;
     }
-    
-    // Safety: Find ;
-    char *end_stmt = strchr(p, ';');
-    if (!end_stmt) return 0;
-    
-    char *start = strchr(p, '<'); // Find <
-    char *end = strchr(p, '>');   // Find >
-    
-    // Bounds check
-    if (!start || !end) return 0;
-    if (start > end_stmt || end > end_stmt) return 0;
-    
-    // Construct new value string
-    char new_str[64];
-    sprintf(new_str, "<0x%llx>", new_val);
-    int new_len = strlen(new_str);
-    int old_len = end - start + 1;
-    
-    int shift = new_len - old_len;
-    
-    // If we need to shift memory
-    if (shift != 0) {
-        // Check buffer bounds (risky without knowing max size, but typically we operate on local large buffers)
-        // Move the rest of the string including null terminator
-        memmove(end + 1 + shift, end + 1, strlen(end + 1) + 1);
-    }
-    
-    memcpy(start, new_str, new_len);
-    return 1;
-}
 
-void update_prop_hex_or_str(char *content, const char *prop_name, unsigned long long new_val) {
-    char *p = find_prop(content, prop_name);
-    if (!p) return;
+    // GT8 Pro Detection
+    if (dts_name_eq(panel->name, panel->name_len, PANEL_GT8_PRO)) {
+        return g_current_model == MODEL_RMX5200 ? 1 : 0;
+    }
 
-    // Safety: Find ;
-    char *end_stmt = strchr(p, ';');
-    if (!end_stmt) return;
+    // OnePlus 15 Detection
+    if (dts_name_eq(panel->name, panel->name_len, PANEL_ONEPLUS_15)) {
+        return g_current_model == MODEL_PLK110 ? 2 : 0;
+    }
 
-    char *angle = strchr(p, '<');
-    char *quote = strchr(p, '"');
-    
-    // Must be before ;
-    if (angle && angle > end_stmt) angle = NULL;
-    if (quote && quote > end_stmt) quote = NULL;
-    
-    if (angle) {
-        update_prop_u64(content, prop_name, new_val);
-        return;
+    // OnePlus 12 Detection
+    if (dts_name_eq(panel->name, panel->name_len, PANEL_ONEPLUS_12)) {
+        if (g_current_model == MODEL_PJD110) {
+            printf("Match Found: OnePlus 12 Panel (%.*s)\n", panel->name_len, panel->name);
+            return 3;
+        }
+        return 0;
     }
-    if (!quote) return;
 
-    char *endq = strchr(quote + 1, '"');
-    if (!endq || endq > end_stmt) return;
+    // It's a different panel, ignore it
+    return 0;
+}
 
-    char new_str[64];
-    sprintf(new_str, "0x%llx", new_val);
-    int new_len = (int)strlen(new_str);
-    int old_len = endq - (quote + 1);
-    int shift = new_len - old_len;
-    if (shift != 0) {
-        memmove(endq + shift, endq, strlen(endq) + 1);
-    }
-    memcpy(quote + 1, new_str, new_len);
+// Remember a timing node as a template (its text is referenced, not copied)
+void capture_template(TimingNode *t, const DtsDoc *doc, const DtsNode *node) {
+    t->node = node;
+    t->clock = dts_prop_u64(doc, dts_find_key(node, DTS_KEY_CLOCKRATE));
+    t->fps = dts_prop_u64(doc, dts_find_key(node, DTS_KEY_FRAMERATE));
+    t->transfer_time = dts_prop_u64(doc, dts_find_key(node, DTS_KEY_TRANSFER));
+    t->valid = 1;
 }
 
-// Replaces the entire line containing prop_name with "prop_name = <0xHEX>;"
-int replace_prop_line_u64(char *content, const char *prop_name, unsigned long long new_val) {
-    char *p = find_prop(content, prop_name);
+// Replace the <...> value of a property of an existing node
+int set_node_u64(DtsDoc *doc, const DtsNode *node, const char *prop_name, unsigned long long new_val) {
+    DtsProp *p = dts_find_prop(node, prop_name);
     if (!p) return 0;
-    
-    // Find line start (previous \n or start of string)
-    char *line_start = p;
-    while (line_start > content && *(line_start - 1) != '\n') {
-        line_start--;
-    }
-    
-    // Find line end (after ;)
-    char *line_end = strchr(p, ';');
-    if (!line_end) return 0;
-    line_end++; // Include ;
-    
-    // Capture indentation
-    char indent[64] = {0};
-    int i = 0;
-    char *k = line_start;
-    while (k < p && isspace(*k) && i < 63) {
-        indent[i++] = *k;
-        k++;
-    }
-    indent[i] = 0;
-    
-    // Construct new line
-    char new_line[256];
-    sprintf(new_line, "%s%s = <0x%llx>;", indent, prop_name, new_val);
-    
-    int old_len = line_end - line_start;
-    int new_len = strlen(new_line);
-    
-    int shift = new_len - old_len;
-    if (shift != 0) {
-        memmove(line_end + shift, line_end, strlen(line_end) + 1);
-    }
-    
-    memcpy(line_start, new_line, new_len);
-    return 1;
+    char new_str[64];
+    sprintf(new_str, "<0x%llx>", new_val);
+    return dts_set_value(doc, p, new_str);
 }
 
-// Replaces ALL lines containing prop_name with "prop_name = <0xHEX>;"
-void replace_all_prop_u64(char *content, const char *prop_name, unsigned long long new_val) {
-    char *p = content;
+// Replaces ALL properties named prop_name with "prop_name = <0xHEX>;"
+void replace_all_prop_u64(DtsDoc *doc, const char *prop_name, unsigned long long new_val) {
     int count = 0;
-    while ((p = find_prop(p, prop_name))) {
-        // Find line start
-        char *line_start = p;
-        while (line_start > content && *(line_start - 1) != '\n') {
-            line_start--;
+    const char *new_line = dts_arena_printf(&doc->arena, "%s = <0x%llx>;", prop_name, new_val);
+    if (!new_line) return;
+    for (DtsNode *n = dts_next(&doc->root, &doc->root); n; n = dts_next(&doc->root, n)) {
+        for (DtsProp *p = n->props; p; p = p->next) {
+            if (dts_name_eq(p->name, p->name_len, prop_name) && dts_set_prop(doc, p, new_line)) count++;
         }
-        
-        // Find line end
-        char *line_end = strchr(p, ';');
-        if (!line_end) break;
-        line_end++; // Include ;
-        
-        // Check indentation
-        char indent[64] = {0};
-        int i = 0;
-        char *k = line_start;
-        while (k < p && isspace(*k) && i < 63) {
-            indent[i++] = *k;
-            k++;
-        }
-        indent[i] = 0;
-        
-        // Construct new line
-        char new_line[256];
-        sprintf(new_line, "%s%s = <0x%llx>;", indent, prop_name, new_val);
-        
-        int old_len = line_end - line_start;
-        int new_len = strlen(new_line);
-        int shift = new_len - old_len;
-        
-        if (shift != 0) {
-            memmove(line_end + shift, line_end, strlen(line_end) + 1);
-        }
-        memcpy(line_start, new_line, new_len);
-        
-        count++;
-        // Advance pointer to avoid infinite loop on same line
-        p = line_start + new_len;
     }
     if (count > 0) printf("Replaced %d occurrences of %s with 0x%llx\n", count, prop_name, new_val);
 }
 
-// Get raw property string value (e.g. "<0x123>" or "\"B`0\"")
-// Returns 1 if found, 0 otherwise
-int get_prop_val_str(const char *content, const char *prop_name, char *out_val) {
-    char *p = find_prop(content, prop_name);
-    if (!p) return 0;
-    
-    char *end_stmt = strchr(p, ';');
-    if (!end_stmt) return 0;
-    
-    char *val_start = strchr(p, '=');
-    if (!val_start) return 0;
-    val_start++; // skip =
-    
-    // Trim leading whitespace
-    while (val_start < end_stmt && isspace(*val_start)) val_start++;
-    if (val_start >= end_stmt) return 0;
-    
-    int len = end_stmt - val_start;
-    if (len >= 63) len = 63;
-    
-    strncpy(out_val, val_start, len);
-    out_val[len] = 0;
-    return 1;
+int is_timing_node(const DtsNode *node) {
+    return (node->keys & DTS_KEY_BIT(DTS_KEY_TIMING)) != 0;
 }
 
-// Update property with raw string
-int update_prop_val_str(char *content, const char *prop_name, const char *new_val) {
-    char *p = find_prop(content, prop_name);
-    if (!p) return 0;
-    
-    char *end_stmt = strchr(p, ';');
-    if (!end_stmt) return 0;
-    
-    char *val_start = strchr(p, '=');
-    if (!val_start) return 0;
-    val_start++; // skip =
-    
-    while (val_start < end_stmt && isspace(*val_start)) val_start++;
-    
-    int old_len = end_stmt - val_start;
-    int new_len = strlen(new_val);
-    
-    int shift = new_len - old_len;
-    if (shift != 0) {
-        memmove(end_stmt + shift, end_stmt, strlen(end_stmt) + 1);
+// A copy of src renamed to new_name, recorded as spans of the original text.
+// With an indent the copy starts on a new line, ready to be inserted after a node
+DtsPieces clone_timing(DtsDoc *doc, const DtsNode *src, const char *new_name, const char *indent) {
+    DtsPieces pcs = {0};
+    if (indent) {
+        const char *lead = dts_arena_printf(&doc->arena, "\n%s", indent);
+        if (lead) dts_pieces_text(doc, &pcs, lead);
     }
-    memcpy(val_start, new_val, new_len);
-    return 1;
+    dts_pieces_node(doc, &pcs, src, new_name);
+    return pcs;
 }
 
-#define PANEL_GT8_PRO "qcom,mdss_dsi_panel_AE084_P_3_A0033_dsc_cmd_dvt02"
-#define PANEL_ONEPLUS_15 "qcom,mdss_dsi_panel_AD296_P_3_A0020_dsc_cmd"
-#define PANEL_ONEPLUS_12 "qcom,mdss_dsi_panel_AA545_P_3_A0005_dsc_cmd"
-
-// Check if current position is inside a target panel node and return ID
-// 0: None, 1: GT8 Pro, 2: OnePlus 15, 3: OnePlus 12
-// Optional: out_panel_start returns the position of the panel's opening brace
-int get_panel_id(const char *file_start, const char *current_pos, const char **out_panel_start) {
-    // Search backwards for the last opened brace that hasn't been closed
-    const char *p = current_pos;
-    while (p > file_start) {
-        if (*p == '{') {
-            // Check the name preceding this brace
-            const char *name_end = p;
-            while (name_end > file_start && isspace(*(name_end - 1))) name_end--;
-            
-            const char *name_start = name_end;
-            while (name_start > file_start && !isspace(*(name_start - 1)) && *(name_start - 1) != ';' && *(name_start - 1) != '}') {
-                name_start--;
-            }
-            
-            if (name_end > name_start) {
-                char node_name[256];
-                int len = name_end - name_start;
-                if (len > 255) len = 255;
-                strncpy(node_name, name_start, len);
-                node_name[len] = 0;
-                
-                // Debug print for PJD110 relevant nodes
-                if (g_current_model == MODEL_PJD110 && strstr(node_name, "panel")) {
-                     // printf("Debug: Checking parent node: %s\n", node_name);
-                }
-                
-                // Return start position if requested
-                if (out_panel_start) *out_panel_start = p;
-
-                // Explicitly ignore engineering panels (evt)
-                if (strstr(node_name, "_evt")) {
-                    return 0; 
-                }
-
-                // GT8 Pro Detection
-                if (strcmp(node_name, PANEL_GT8_PRO) == 0) {
-                    if (g_current_model == MODEL_RMX5200) {
-                        return 1;
-                    }
-                    return 0;
-                }
-                
-                // OnePlus 15 Detection
-                if (strcmp(node_name, PANEL_ONEPLUS_15) == 0) {
-                     if (g_current_model == MODEL_PLK110) {
-                         return 2;
-                     }
-                     return 0;
-                }
-
-                // OnePlus 12 Detection
-                if (strcmp(node_name, PANEL_ONEPLUS_12) == 0) {
-                     if (g_current_model == MODEL_PJD110) {
-                         printf("Match Found: OnePlus 12 Panel (%s)\n", node_name);
-                         return 3;
-                     }
-                     return 0;
-                }
-                
-                // Heuristic: If it starts with "qcom,mdss_dsi_panel_", it's a panel node.
-                if (strstr(node_name, "qcom,mdss_dsi_panel_")) {
-                    return 0; // It's a different panel, ignore it
-                }
-            }
-        }
-        p--;
-    }
-    return 0;
+// Replace the <...> value of a property in a clone of src
+int set_clone_u64(DtsDoc *doc, DtsPieces *pcs, const DtsNode *src, int key, unsigned long long new_val) {
+    DtsProp *p = dts_find_key(src, key);
+    if (!p) return 0;
+    char cells[32];
+    sprintf(cells, "0x%llx", new_val);
+    return dts_pieces_set_cells(doc, pcs, p, cells);
 }
 
 // Process single file
 void process_file(const char *filename) {
-    char input_path[512];
-    snprintf(input_path, sizeof(input_path), "%s/%s", DIR_NAME, filename);
+    const char *input_path = dts_arena_printf(&g_run, "%s/%s", DIR_NAME, filename);
+    if (!input_path) return;
 
     printf("Processing file: %s\n", input_path);
 
-    FILE *in = fopen(input_path, "r");
-    if (!in) {
-        perror("Cannot open file");
+    // Parse the whole file once, all patches below are recorded as edits on the tree
+    DtsDoc doc;
+    if (!dts_load(&doc, input_path)) {
+        printf("Cannot parse %s: %s\n", input_path, doc.error);
+        dts_free(&doc);
         return;
     }
-
-    // Read entire file into memory
-    fseek(in, 0, SEEK_END);
-    long fsize = ftell(in);
-    fseek(in, 0, SEEK_SET);
-
-    char *buffer = malloc(fsize + 1);
-    if (!buffer) {
-        perror("Memory allocation failed");
-        fclose(in);
+    // Panel open/close offsets, so every timing node finds its panel with a binary search
+    DtsSpanIndex panels;
+    if (!dts_span_index(&doc, &panels, is_panel_node)) {
+        printf("Cannot index panels in %s\n", input_path);
+        dts_free(&doc);
         return;
     }
-    fread(buffer, 1, fsize, in);
-    buffer[fsize] = 0;
-    fclose(in);
+
+    // GT8 Pro specific filtering
+    if (g_current_model == MODEL_RMX5200) {
+        if (dts_find_node(&doc, PANEL_GT8_PRO)) {
+            printf("Target panel found in %s. Processing...\n", filename);
+        } else {
+            printf("Skipping %s (Target panel not found)\n", filename);
+            dts_free(&doc);
+            return;
+        }
+    }
 
     // Project ID Check & Enforcement
-    unsigned long long file_prj_id = get_prop_u64(buffer, "oplus,project-id");
+    unsigned long long file_prj_id = dts_prop_u64(&doc, dts_first_prop(&doc, "oplus,project-id"));
     
     // If file has no project ID, skip it (safety first)
     if (file_prj_id == 0) {
         printf("Skipping %s (No oplus,project-id found)\n", filename);
-        free(buffer);
+        dts_free(&doc);
         return;
     }
     
@@ -507,7 +274,7 @@ void process_file(const char *filename) {
         if (!allowed) {
             printf("Skipping %s (Project ID mismatch: File=0x%llx, Device=0x%llx)\n", 
                    filename, file_prj_id, g_target_project_id);
-            free(buffer);
+            dts_free(&doc);
             return;
         } else {
              printf("Allowing File ID 0x%llx for Device ID 0x%llx (Compatible Variant)\n", file_prj_id, g_target_project_id);
@@ -518,56 +285,26 @@ void process_file(const char *filename) {
 
     if (g_current_model == MODEL_PJD110) {
         // Global Replacements for PJD110
-        replace_all_prop_u64(buffer, "oplus,batt_capacity_mah", 0x1770);
-        replace_all_prop_u64(buffer, "oplus_spec,vbat_uv_thr_mv", 0xaf0);
-        replace_all_prop_u64(buffer, "oplus,reserve_chg_soc", 0x1);
+        replace_all_prop_u64(&doc, "oplus,batt_capacity_mah", 0x1770);
+        replace_all_prop_u64(&doc, "oplus_spec,vbat_uv_thr_mv", 0xaf0);
+        replace_all_prop_u64(&doc, "oplus,reserve_chg_soc", 0x1);
         printf("Applied global battery config changes for PJD110\n");
     }
 
     // GT8 Pro HMBIRD Patch
-    if (g_current_model == MODEL_RMX5200 && strstr(buffer, "oplus_sim_detect") && !strstr(buffer, "oplus,hmbird")) {
-        char *ins_point = strstr(buffer, "oplus_sim_detect");
-        // Try to keep indentation
-        char *line_start = ins_point;
-        while (line_start > buffer && *(line_start - 1) != '\n') line_start--;
-        
-        char indent[64] = {0};
-        int i = 0;
-        char *k = line_start;
-        while (k < ins_point && isspace(*k) && i < 63) {
-            indent[i++] = *k;
-            k++;
-        }
-        indent[i] = 0;
+    DtsNode *sim_detect = dts_find_node(&doc, "oplus_sim_detect");
+    if (g_current_model == MODEL_RMX5200 && sim_detect && !dts_find_node(&doc, "oplus,hmbird")) {
+        // Keep indentation: the new node goes right before oplus_sim_detect at the same level
+        const char *indent = dts_line_indent(&doc, sim_detect->start);
 
-        char new_node[512];
-        sprintf(new_node, "oplus,hmbird {\n%s\tconfig_type {\n%s\t\ttype = \"HMBIRD_EXT\";\n%s\t};\n%s};\n\n%s", 
+        const char *new_node = dts_arena_printf(&doc.arena,
+                "oplus,hmbird {\n%s\tconfig_type {\n%s\t\ttype = \"HMBIRD_EXT\";\n%s\t};\n%s};\n\n%s", 
                 indent, indent, indent, indent, indent);
-
-        long prefix_len = line_start - buffer;
-        long new_len = strlen(buffer) + strlen(new_node) + 1;
-        char *new_buffer = malloc(new_len);
-        if (new_buffer) {
-            strncpy(new_buffer, buffer, prefix_len);
-            new_buffer[prefix_len] = 0;
-            strcat(new_buffer, new_node);
-            strcat(new_buffer, line_start); // Append the rest starting from oplus_sim_detect line
-            
-            free(buffer);
-            buffer = new_buffer;
+        if (new_node && dts_insert(&doc, sim_detect->start, new_node)) {
             printf("Applied HMBIRD Patch for GT8 Pro\n");
         }
     }
 
-    char temp_path[512];
-    snprintf(temp_path, sizeof(temp_path), "%s/%s.tmp", DIR_NAME, filename);
-    FILE *out = fopen(temp_path, "w");
-    if (!out) {
-        perror("Cannot create temp file");
-        free(buffer);
-        return;
-    }
-
     // Pass 1: Find Templates
     // GT8 Templates
     TimingNode template_wqhd = {0};
@@ -577,148 +314,69 @@ void process_file(const char *filename) {
     TimingNode template_sdc_144 = {0};
     TimingNode template_sdc_165 = {0};
     
-    char *p = buffer;
-    while ((p = strstr(p, "timing@"))) {
-        char *block_start = p;
-        char *block_end = strchr(block_start, '}');
-        if (!block_end) break;
-        block_end = strchr(block_end, ';'); // };
-        if (!block_end) break;
-        block_end++; // Include ;
-        
+    for (DtsNode *n = dts_next(&doc.root, &doc.root); n; n = dts_next(&doc.root, n)) {
+        if (!is_timing_node(n)) continue;
+
         // Check if inside any target panel
-        if (get_panel_id(buffer, block_start, NULL) == 0) {
-            p = block_end;
-            continue;
-        }
-        
-        int len = block_end - block_start;
-        if (len >= MAX_BLOCK) { p++; continue; }
-        
-        char node_name[128];
-        sscanf(block_start, "%127s", node_name);
-        // Clean name (remove {)
-        char *brace = strchr(node_name, '{');
-        if (brace) *brace = 0;
+        if (get_panel_id(&panels, n->name_off, NULL) == 0) continue;
+
+        const char *node_name = dts_intern(&g_names, n->name, n->name_len);
+        if (!node_name) continue;
         
         // GT8 Templates
         if (strstr(node_name, "wqhd_sdc_144")) {
-            strncpy(template_wqhd.content, block_start, len);
-            template_wqhd.content[len] = 0;
-            template_wqhd.clock = get_prop_u64(template_wqhd.content, "qcom,mdss-dsi-panel-clockrate");
-            template_wqhd.fps = get_prop_u64(template_wqhd.content, "qcom,mdss-dsi-panel-framerate");
-            template_wqhd.transfer_time = get_prop_u64(template_wqhd.content, "qcom,mdss-mdp-transfer-time-us");
-            template_wqhd.valid = 1;
+            capture_template(&template_wqhd, &doc, n);
             printf("Found GT8 WQHD Template: %s (Clock: 0x%llx)\n", node_name, template_wqhd.clock);
         }
         
         if (strstr(node_name, "fhd_sdc_144") || strstr(node_name, "fhd_sdc_120")) {
-             int current_fps = get_prop_u64(block_start, "qcom,mdss-dsi-panel-framerate");
+             unsigned int current_fps = dts_prop_u64(&doc, dts_find_key(n, DTS_KEY_FRAMERATE));
              if (current_fps > template_fhd.fps) {
-                 strncpy(template_fhd.content, block_start, len);
-                 template_fhd.content[len] = 0;
-                 template_fhd.clock = get_prop_u64(template_fhd.content, "qcom,mdss-dsi-panel-clockrate");
-                 template_fhd.fps = current_fps;
-                 template_fhd.transfer_time = get_prop_u64(template_fhd.content, "qcom,mdss-mdp-transfer-time-us");
-                 template_fhd.valid = 1;
+                 capture_template(&template_fhd, &doc, n);
                  printf("Found GT8 FHD Template: %s (FPS: %d)\n", node_name, template_fhd.fps);
              }
         }
 
         // New Model Templates
         if (strstr(node_name, "timing@sdc_fhd_120")) {
-            strncpy(template_sdc_120.content, block_start, len);
-            template_sdc_120.content[len] = 0;
-            template_sdc_120.clock = get_prop_u64(template_sdc_120.content, "qcom,mdss-dsi-panel-clockrate");
-            template_sdc_120.fps = get_prop_u64(template_sdc_120.content, "qcom,mdss-dsi-panel-framerate");
-            template_sdc_120.transfer_time = get_prop_u64(template_sdc_120.content, "qcom,mdss-mdp-transfer-time-us");
-            template_sdc_120.valid = 1;
+            capture_template(&template_sdc_120, &doc, n);
             printf("Found New 120Hz Template: %s\n", node_name);
         }
         if (strstr(node_name, "timing@sdc_fhd_144")) {
-            strncpy(template_sdc_144.content, block_start, len);
-            template_sdc_144.content[len] = 0;
-            template_sdc_144.clock = get_prop_u64(template_sdc_144.content, "qcom,mdss-dsi-panel-clockrate");
-            template_sdc_144.fps = get_prop_u64(template_sdc_144.content, "qcom,mdss-dsi-panel-framerate");
-            template_sdc_144.transfer_time = get_prop_u64(template_sdc_144.content, "qcom,mdss-mdp-transfer-time-us");
-            template_sdc_144.valid = 1;
+            capture_template(&template_sdc_144, &doc, n);
             printf("Found New 144Hz Template: %s\n", node_name);
         }
         if (strstr(node_name, "timing@sdc_fhd_165") || (g_current_model == MODEL_PLK110 && strstr(node_name, "_165"))) {
-            strncpy(template_sdc_165.content, block_start, len);
-            template_sdc_165.content[len] = 0;
-            template_sdc_165.clock = get_prop_u64(template_sdc_165.content, "qcom,mdss-dsi-panel-clockrate");
-            template_sdc_165.fps = get_prop_u64(template_sdc_165.content, "qcom,mdss-dsi-panel-framerate");
-            template_sdc_165.transfer_time = get_prop_u64(template_sdc_165.content, "qcom,mdss-mdp-transfer-time-us");
-            template_sdc_165.valid = 1;
+            capture_template(&template_sdc_165, &doc, n);
             printf("Found New 165Hz Template: %s\n", node_name);
         }
-        
-        p = block_end;
     }
 
-    // Pass 2: Process and Write
-    p = buffer;
-    char *cursor = buffer;
-    
+    // Pass 2: Process
     // Counter for PJD110 cell-index
     int pjd110_cell_index = 0;
-    const char *last_panel_start = NULL;
+    const DtsNode *last_panel = NULL;
 
     // Track generated nodes in this session to prevent duplicates
     int generated_wqhd_123 = 0;
     int generated_wqhd_high[7] = {0}; // 150, 155, 160, 165, 170, 175, 180
     int generated_fhd_high[7] = {0};  // 170-199 (OnePlus 15)
 
-    while ((p = strstr(cursor, "timing@"))) {
-        // Write everything before this block
-        fwrite(cursor, 1, p - cursor, out);
-        
-        char *block_start = p;
-        char *block_end = strchr(block_start, '}');
-        if (!block_end) { cursor = p + 1; continue; } 
-        block_end = strchr(block_end, ';');
-        if (!block_end) { cursor = p + 1; continue; }
-        block_end++;
-        
-        int block_len = block_end - block_start;
-        char current_block[MAX_BLOCK];
-        if (block_len >= MAX_BLOCK) {
-            fwrite(block_start, 1, block_len, out);
-            cursor = block_end;
-            continue;
-        }
-        
-        strncpy(current_block, block_start, block_len);
-        current_block[block_len] = 0;
-        
-        char node_name[128];
-        sscanf(current_block, "%127s", node_name);
-        char *brace = strchr(node_name, '{');
-        if (brace) *brace = 0;
+    for (DtsNode *n = dts_next(&doc.root, &doc.root); n; n = dts_next(&doc.root, n)) {
+        if (!is_timing_node(n)) continue;
+
+        const char *node_name = dts_intern(&g_names, n->name, n->name_len);
+        if (!node_name) continue;
 
         // Check context
-        const char *current_panel_start = NULL;
-        int panel_id = get_panel_id(buffer, block_start, &current_panel_start);
+        const DtsNode *current_panel = NULL;
+        int panel_id = get_panel_id(&panels, n->name_off, &current_panel);
         if (panel_id == 0) {
-            // Just write original
-            fputs(current_block, out);
-            cursor = block_end;
+            // Keep original
             continue;
         }
 
-        char indent[64];
-        int indent_len = 0;
-        char *ls = block_start;
-        while (ls > buffer && *(ls - 1) != '\n') ls--;
-        char *q = ls;
-        while (*q == ' ' || *q == '\t') {
-            if (indent_len < (int)sizeof(indent) - 1) {
-                indent[indent_len++] = *q;
-            }
-            q++;
-        }
-        indent[indent_len] = 0;
+        const char *indent = dts_line_indent(&doc, n->start);
         
         // Logic Dispatch
         if (panel_id == 1) {
@@ -727,84 +385,64 @@ void process_file(const char *filename) {
             if (strstr(node_name, "wqhd_sdc_60") && template_wqhd.valid) {
                 printf("Applying LTPO Fix to %s\n", node_name);
                 
-                // Extract raw values from original 60Hz node to preserve them
-                char orig_index_str[64] = {0};
-                
-                get_prop_val_str(current_block, "cell-index", orig_index_str);
-                
-                // Start with template
-                char new_block[MAX_BLOCK];
-                strcpy(new_block, template_wqhd.content);
-                
-                // Replace name safely
-                char template_name[128];
-                sscanf(template_wqhd.content, "%127s", template_name); 
-                char search_str[128];
-                sprintf(search_str, "%s {", template_name);
-                replace_str(new_block, search_str, "timing@wqhd_sdc_60 {");
+                // Start with template, renamed
+                DtsPieces pcs = clone_timing(&doc, template_wqhd.node, "timing@wqhd_sdc_60", NULL);
                 
                 // Restore original 60Hz cell-index ONLY. Use Template's Clock/Transfer!
-                if (strlen(orig_index_str) > 0) update_prop_val_str(new_block, "cell-index", orig_index_str);
+                DtsProp *orig_index = dts_find_key(n, DTS_KEY_CELL_INDEX);
+                DtsProp *tmpl_index = dts_find_key(template_wqhd.node, DTS_KEY_CELL_INDEX);
+                if (orig_index && tmpl_index && orig_index->value_end > orig_index->value_start) {
+                    char *orig_index_str = dts_arena_strndup(&doc.arena, doc.src + orig_index->value_start,
+                                                             orig_index->value_end - orig_index->value_start);
+                    if (orig_index_str) dts_pieces_set_value(&doc, &pcs, tmpl_index, orig_index_str);
+                }
                 
                 // Force framerate to 60
-                update_prop_u64(new_block, "qcom,mdss-dsi-panel-framerate", 60); 
+                set_clone_u64(&doc, &pcs, template_wqhd.node, DTS_KEY_FRAMERATE, 60);
                 
-                fputs(new_block, out);
-                fputs("\n", out);
+                dts_replace_pieces(&doc, n->name_off, n->end, &pcs);
             } 
             // 3. WQHD 120Hz -> Add 123Hz (Auto Calc)
             else if (strstr(node_name, "wqhd_sdc_120")) {
-                fputs(current_block, out);
-                fputs("\n", out);
-                
                 // Check if target node already exists
-                if (strstr(buffer, "timing@wqhd_sdc_123") || generated_wqhd_123) {
+                if (dts_find_node(&doc, "timing@wqhd_sdc_123") || generated_wqhd_123) {
                     printf("Node timing@wqhd_sdc_123 already exists, skipping generation.\n");
                 } else {
                     // Generate 123Hz
                     generated_wqhd_123 = 1;
                     printf("Generating 123Hz node...\n");
-                    char new_block[MAX_BLOCK];
-                    strcpy(new_block, current_block);
+                    DtsPieces pcs = clone_timing(&doc, n, "timing@wqhd_sdc_123", indent);
                     
-                    replace_str(new_block, "timing@wqhd_sdc_120 {", "timing@wqhd_sdc_123 {");
-                    
-                    unsigned long long base_clock = get_prop_u64(current_block, "qcom,mdss-dsi-panel-clockrate");
-                    unsigned int base_fps = get_prop_u64(current_block, "qcom,mdss-dsi-panel-framerate");
+                    unsigned long long base_clock = dts_prop_u64(&doc, dts_find_key(n, DTS_KEY_CLOCKRATE));
+                    unsigned int base_fps = dts_prop_u64(&doc, dts_find_key(n, DTS_KEY_FRAMERATE));
                     if (base_fps < 110 || base_fps > 130) base_fps = 120;
                     
                     int target_fps = 123;
                     unsigned long long new_clock = base_clock * target_fps / base_fps;
-                    unsigned int base_transfer = get_prop_u64(current_block, "qcom,mdss-mdp-transfer-time-us");
+                    unsigned int base_transfer = dts_prop_u64(&doc, dts_find_key(n, DTS_KEY_TRANSFER));
                     unsigned int new_transfer = 0;
                     if (base_transfer > 0) new_transfer = base_transfer * base_fps / target_fps;
                     
-                    update_prop_u64(new_block, "qcom,mdss-dsi-panel-clockrate", new_clock);
-                    update_prop_u64(new_block, "qcom,mdss-dsi-panel-framerate", target_fps);
-                    if (new_transfer > 0) update_prop_u64(new_block, "qcom,mdss-mdp-transfer-time-us", new_transfer);
-                    update_prop_u64(new_block, "cell-index", 0x8);
+                    set_clone_u64(&doc, &pcs, n, DTS_KEY_CLOCKRATE, new_clock);
+                    set_clone_u64(&doc, &pcs, n, DTS_KEY_FRAMERATE, target_fps);
+                    if (new_transfer > 0) set_clone_u64(&doc, &pcs, n, DTS_KEY_TRANSFER, new_transfer);
+                    set_clone_u64(&doc, &pcs, n, DTS_KEY_CELL_INDEX, 0x8);
                     
-                    fputs("\n", out);
-                    fputs(indent, out);
-                    fputs(new_block, out);
-                    fputs("\n", out);
+                    dts_insert_pieces(&doc, n->end, &pcs);
                 }
             }
             // 4. WQHD 144Hz -> Add 150-180Hz (Auto Calc)
             else if (strstr(node_name, "wqhd_sdc_144")) {
-                fputs(current_block, out);
-                fputs("\n", out);
-                
                 if (template_wqhd.valid) {
                     int freqs[] = {150, 155, 160, 165, 170, 175, 180};
                     int indexes[] = {0x9, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15};
                     
                     for (int i=0; i<7; i++) {
                         int target_fps = freqs[i];
-                        char target_node_name[64];
-                        sprintf(target_node_name, "timing@wqhd_sdc_%d", target_fps);
+                        const char *target_node_name = dts_arena_printf(&doc.arena, "timing@wqhd_sdc_%d", target_fps);
+                        if (!target_node_name) continue;
                         
-                        if (strstr(buffer, target_node_name) || generated_wqhd_high[i]) {
+                        if (dts_find_node(&doc, target_node_name) || generated_wqhd_high[i]) {
                              printf("Node %s already exists, skipping generation.\n", target_node_name);
                              continue;
                         }
@@ -812,89 +450,67 @@ void process_file(const char *filename) {
                         generated_wqhd_high[i] = 1;
                         printf("Generating %dHz node...\n", target_fps);
                         
-                        char new_block[MAX_BLOCK];
-                        strcpy(new_block, template_wqhd.content);
-                        
-                        char header_old[128], header_new[128];
-                        sscanf(template_wqhd.content, "%127s", header_old);
-                        char *b = strchr(header_old, '{'); if(b) *b=0;
-                        sprintf(header_new, "timing@wqhd_sdc_%d {", target_fps);
-                        
-                        char header_old_full[128];
-                        sprintf(header_old_full, "%s {", header_old);
-                        replace_str(new_block, header_old_full, header_new);
+                        DtsPieces pcs = clone_timing(&doc, template_wqhd.node, target_node_name, indent);
                         
                         unsigned long long new_clock = template_wqhd.clock * target_fps / template_wqhd.fps;
                         unsigned int new_transfer = template_wqhd.transfer_time * template_wqhd.fps / target_fps;
                         
-                        update_prop_u64(new_block, "qcom,mdss-dsi-panel-clockrate", new_clock);
-                        update_prop_u64(new_block, "qcom,mdss-dsi-panel-framerate", target_fps);
-                        update_prop_u64(new_block, "qcom,mdss-mdp-transfer-time-us", new_transfer);
-                        update_prop_u64(new_block, "cell-index", indexes[i]);
+                        const DtsNode *t = template_wqhd.node;
+                        set_clone_u64(&doc, &pcs, t, DTS_KEY_CLOCKRATE, new_clock);
+                        set_clone_u64(&doc, &pcs, t, DTS_KEY_FRAMERATE, target_fps);
+                        set_clone_u64(&doc, &pcs, t, DTS_KEY_TRANSFER, new_transfer);
+                        set_clone_u64(&doc, &pcs, t, DTS_KEY_CELL_INDEX, indexes[i]);
                         
-                        fputs("\n", out);
-                        fputs(indent, out);
-                        fputs(new_block, out);
-                        fputs("\n", out);
+                        dts_insert_pieces(&doc, n->end, &pcs);
                     }
                 }
             }
             // 5. Force WQHD 90 clockrate to 2K template clock (Disabled FHD)
             else if (strstr(node_name, "wqhd_sdc_90")) {
-                char mod_block[MAX_BLOCK];
-                strcpy(mod_block, current_block);
-                if (template_wqhd.valid) {
-                    replace_prop_line_u64(mod_block, "qcom,mdss-dsi-panel-clockrate", template_wqhd.clock);
+                DtsProp *clock = dts_find_key(n, DTS_KEY_CLOCKRATE);
+                if (template_wqhd.valid && clock) {
+                    char new_line[256];
+                    sprintf(new_line, "qcom,mdss-dsi-panel-clockrate = <0x%llx>;", template_wqhd.clock);
+                    dts_set_prop(&doc, clock, new_line);
                 }
-                fputs(mod_block, out);
             }
-            else {
-                // Keep original
-                fputs(current_block, out);
-            }
-            cursor = block_end;
             continue;
         } else if (panel_id == 3) {
             // PJD110 Logic
             
             // Check for panel switch (reset cell-index)
-            if (current_panel_start != last_panel_start) {
-                if (last_panel_start != NULL) {
+            if (current_panel != last_panel) {
+                if (last_panel != NULL) {
                      printf("New panel detected (Address change), resetting cell-index to 0.\n");
                 }
                 pjd110_cell_index = 0;
-                last_panel_start = current_panel_start;
+                last_panel = current_panel;
             }
 
             // 1. Remove 60Hz and 90Hz
-            unsigned int fps = get_prop_u64(current_block, "qcom,mdss-dsi-panel-framerate");
+            unsigned int fps = dts_prop_u64(&doc, dts_find_key(n, DTS_KEY_FRAMERATE));
             
             if (fps == 60 || fps == 90) {
                  printf("Removing %dHz node for PJD110: %s\n", fps, node_name);
-                 cursor = block_end; // Skip writing
+                 dts_remove_node(&doc, n);
                  continue;
             }
             
             // 2. Renumber cell-index
             printf("Renumbering cell-index for %s to: %d\n", node_name, pjd110_cell_index);
-            if (!update_prop_u64(current_block, "cell-index", pjd110_cell_index)) {
+            if (!set_node_u64(&doc, n, "cell-index", pjd110_cell_index)) {
                 printf("ERROR: Failed to update cell-index for %s. Property missing or malformed?\n", node_name);
-                // Try to find it manually to see what's wrong
-                char *debug_p = strstr(current_block, "cell-index");
+                // Show what the parser found to see what's wrong
+                DtsProp *debug_p = dts_find_key(n, DTS_KEY_CELL_INDEX);
                 if (debug_p) {
-                    char debug_buf[100];
-                    strncpy(debug_buf, debug_p, 99);
-                    debug_buf[99] = 0;
-                    printf("DEBUG: Found string: %s\n", debug_buf);
+                    int debug_len = (int)(debug_p->end - debug_p->start);
+                    printf("DEBUG: Found string: %.*s\n", debug_len > 99 ? 99 : debug_len, doc.src + debug_p->start);
                 } else {
                     printf("DEBUG: 'cell-index' string not found in block.\n");
                 }
             } else {
                 pjd110_cell_index++;
             }
-            
-            fputs(current_block, out);
-            cursor = block_end;
             continue;
         }
         else if (panel_id == 2) {
@@ -904,39 +520,31 @@ void process_file(const char *filename) {
             // 1. Modify 120Hz -> 123Hz (Direct Replace)
             if (strstr(node_name, "timing@sdc_fhd_120")) {
                 printf("Modifying 120Hz node to 123Hz (Direct Replace)...\n");
-                char new_block[MAX_BLOCK];
-                strcpy(new_block, current_block);
-                
-                replace_str(new_block, "timing@sdc_fhd_120 {", "timing@sdc_fhd_123 {");
+                const char *new_name = "timing@sdc_fhd_123";
+                dts_replace(&doc, n->name_off, n->name_off + n->name_len, new_name, strlen(new_name));
                 
-                unsigned long long base_clock = get_prop_u64(current_block, "qcom,mdss-dsi-panel-clockrate");
+                unsigned long long base_clock = dts_prop_u64(&doc, dts_find_key(n, DTS_KEY_CLOCKRATE));
                 unsigned int base_fps = 120;
                 int target_fps = 123;
                 unsigned long long new_clock = base_clock * target_fps / base_fps;
-                unsigned int base_transfer = get_prop_u64(current_block, "qcom,mdss-mdp-transfer-time-us");
+                unsigned int base_transfer = dts_prop_u64(&doc, dts_find_key(n, DTS_KEY_TRANSFER));
                 unsigned int new_transfer = 0;
                 if (base_transfer > 0) new_transfer = base_transfer * base_fps / target_fps;
                 
-                update_prop_u64(new_block, "qcom,mdss-dsi-panel-clockrate", new_clock);
-                update_prop_u64(new_block, "qcom,mdss-dsi-panel-framerate", target_fps);
-                if (new_transfer > 0) update_prop_u64(new_block, "qcom,mdss-mdp-transfer-time-us", new_transfer);
-                
-                fputs(new_block, out);
-                fputs("\n", out);
+                set_node_u64(&doc, n, "qcom,mdss-dsi-panel-clockrate", new_clock);
+                set_node_u64(&doc, n, "qcom,mdss-dsi-panel-framerate", target_fps);
+                if (new_transfer > 0) set_node_u64(&doc, n, "qcom,mdss-mdp-transfer-time-us", new_transfer);
             }
             // 2. 165Hz -> Generate 170-199Hz
             else if (strstr(node_name, "timing@sdc_fhd_165")) {
-                fputs(current_block, out);
-                fputs("\n", out);
-                
                 int freqs[] = {170, 175, 180, 185, 190, 195, 199};
                 
                 for (int i=0; i<7; i++) {
                     int target_fps = freqs[i];
-                    char target_node_name[64];
-                    sprintf(target_node_name, "timing@sdc_fhd_%d", target_fps);
+                    const char *target_node_name = dts_arena_printf(&doc.arena, "timing@sdc_fhd_%d", target_fps);
+                    if (!target_node_name) continue;
                     
-                    if (strstr(buffer, target_node_name) || generated_fhd_high[i]) {
+                    if (dts_find_node(&doc, target_node_name) || generated_fhd_high[i]) {
                          printf("Node %s already exists, skipping generation.\n", target_node_name);
                          continue;
                     }
@@ -944,77 +552,66 @@ void process_file(const char *filename) {
                     generated_fhd_high[i] = 1;
                     printf("Generating %dHz node (New)...\n", target_fps);
                     
-                    char new_block[MAX_BLOCK];
-                    strcpy(new_block, current_block);
-                    
-                    char header_new[128];
-                    sprintf(header_new, "timing@sdc_fhd_%d {", target_fps);
-                    replace_str(new_block, "timing@sdc_fhd_165 {", header_new);
+                    DtsPieces pcs = clone_timing(&doc, n, target_node_name, indent);
                     
-                    unsigned long long base_clock = get_prop_u64(current_block, "qcom,mdss-dsi-panel-clockrate");
+                    unsigned long long base_clock = dts_prop_u64(&doc, dts_find_key(n, DTS_KEY_CLOCKRATE));
                     unsigned int base_fps = 165;
                     unsigned long long new_clock = base_clock * target_fps / base_fps;
-                    unsigned int base_transfer = get_prop_u64(current_block, "qcom,mdss-mdp-transfer-time-us");
+                    unsigned int base_transfer = dts_prop_u64(&doc, dts_find_key(n, DTS_KEY_TRANSFER));
                     unsigned int new_transfer = 0;
                     if (base_transfer > 0) new_transfer = base_transfer * base_fps / target_fps;
                     
-                    update_prop_u64(new_block, "qcom,mdss-dsi-panel-clockrate", new_clock);
-                    update_prop_u64(new_block, "qcom,mdss-dsi-panel-framerate", target_fps);
-                    if (new_transfer > 0) update_prop_u64(new_block, "qcom,mdss-mdp-transfer-time-us", new_transfer);
+                    set_clone_u64(&doc, &pcs, n, DTS_KEY_CLOCKRATE, new_clock);
+                    set_clone_u64(&doc, &pcs, n, DTS_KEY_FRAMERATE, target_fps);
+                    if (new_transfer > 0) set_clone_u64(&doc, &pcs, n, DTS_KEY_TRANSFER, new_transfer);
                     
-                    fputs("\n", out);
-                    fputs(indent, out);
-                    fputs(new_block, out);
-                    fputs("\n", out);
+                    dts_insert_pieces(&doc, n->end, &pcs);
                 }
             }
             // 3. Replace 60Hz with 165Hz template (Force 60Hz FPS)
             else if (strstr(node_name, "timing@sdc_fhd_60")) {
                 if (template_sdc_165.valid) {
                     printf("Replacing 60Hz with 165Hz Template (New)...\n");
-                    char new_block[MAX_BLOCK];
-                    strcpy(new_block, template_sdc_165.content);
+                    DtsPieces pcs = clone_timing(&doc, template_sdc_165.node, "timing@sdc_fhd_60", NULL);
                     
-                    replace_str(new_block, "timing@sdc_fhd_165 {", "timing@sdc_fhd_60 {");
+                    set_clone_u64(&doc, &pcs, template_sdc_165.node, DTS_KEY_FRAMERATE, 60);
                     
-                    update_prop_u64(new_block, "qcom,mdss-dsi-panel-framerate", 60);
-                    
-                    fputs(new_block, out);
-                    fputs("\n", out);
-                } else {
-                    fputs(current_block, out);
+                    dts_replace_pieces(&doc, n->name_off, n->end, &pcs);
                 }
             }
             // 4. Delete specific nodes (sdc_fhd_90 & oplus_fhd_120)
             else if (strstr(node_name, "timing@sdc_fhd_90") || strstr(node_name, "timing@oplus_fhd_120")) {
                 printf("Deleting node (Skipping): %s\n", node_name);
+                dts_remove_node(&doc, n);
             }
-            else {
-                fputs(current_block, out);
-            }
-        }
-        else {
-            fputs(current_block, out);
         }
-        
-        cursor = block_end;
     }
-    
-    // Write remaining
-    fprintf(out, "%s", cursor);
 
-    free(buffer);
-    fclose(out);
+    // Write everything once; generated nodes are expanded from the source text only here
+    const char *temp_path = dts_arena_printf(&g_run, "%s/%s.tmp", DIR_NAME, filename);
+    if (!temp_path || !dts_write_file(&doc, temp_path)) {
+        perror("Cannot create temp file");
+        if (temp_path) remove(temp_path);
+        dts_free(&doc);
+        return;
+    }
+
+    DtsWriteStats st;
+    dts_write_stats(&doc, &st);
+    size_t work = doc.arena.total + doc.scan.words * 2 * sizeof(uint64_t) + doc.edit_cap * sizeof(DtsEdit);
+    printf("Wrote %s: %zu bytes (%zu from source, %zu new) with %d edits; memory: %zu KB source + %zu KB tree/edits\n",
+           filename, st.out_len, st.src_bytes, st.text_bytes, st.edits, doc.len / 1024, work / 1024);
+    dts_free(&doc);
 
     if (rename(temp_path, input_path) != 0) {
-        char cmd[1024];
-        sprintf(cmd, "mv -f \"%s\" \"%s\"", temp_path, input_path);
-        system(cmd);
+        const char *cmd = dts_arena_printf(&g_run, "mv -f \"%s\" \"%s\"", temp_path, input_path);
+        if (cmd) system(cmd);
     }
 }
 
 int main() {
     detect_device_model();
+    dts_strtab_init(&g_names, &g_run);
 
     DIR *d;
     struct dirent *dir;
@@ -1024,34 +621,9 @@ int main() {
         while ((dir = readdir(d)) != NULL) {
             char *dot = strrchr(dir->d_name, '.');
             if (dot && strcmp(dot, ".dts") == 0) {
-                char full_path[512];
-                snprintf(full_path, sizeof(full_path), "%s/%s", DIR_NAME, dir->d_name);
-                if (is_regular_file(full_path)) {
-                    // GT8 Pro specific filtering
-                    if (g_current_model == MODEL_RMX5200) {
-                        FILE *fp = fopen(full_path, "r");
-                        if (fp) {
-                            fseek(fp, 0, SEEK_END);
-                            long sz = ftell(fp);
-                            fseek(fp, 0, SEEK_SET);
-                            char *buf = malloc(sz + 1);
-                            if (buf) {
-                                fread(buf, 1, sz, fp);
-                                buf[sz] = 0;
-                                if (strstr(buf, PANEL_GT8_PRO)) {
-                                    printf("Target panel found in %s. Processing...\n", dir->d_name);
-                                    process_file(dir->d_name);
-                                } else {
-                                    printf("Skipping %s (Target panel not found)\n", dir->d_name);
-                                }
-                                free(buf);
-                            }
-                            fclose(fp);
-                        }
-                    } else {
-                        // Other models process all DTS files (with internal checks)
-                        process_file(dir->d_name);
-                    }
+                const char *full_path = dts_arena_printf(&g_run, "%s/%s", DIR_NAME, dir->d_name);
+                if (full_path && is_regular_file(full_path)) {
+                    process_file(dir->d_name);
                 }
             }
         }
@@ -1061,5 +633,8 @@ int main() {
         return 1;
     }
     printf("All files processed.\n");
+    printf("Run storage: %zu KB, %zu distinct node names\n", g_run.total / 1024, g_names.count);
+    dts_strtab_free(&g_names);
+    dts_arena_free(&g_run);
     return 0;
 }
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,59 +9,111 @@
 #include <ctype.h>
 #include <sys/inotify.h>
 #include <sys/select.h>
+#include <sys/resource.h>
+#include <sched.h>
 #include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <stddef.h>
+#ifdef __ANDROID__
+#include <sys/system_properties.h>
+#endif
+#ifndef PROP_VALUE_MAX
+#define PROP_VALUE_MAX 92  // 与 bionic 相同，主机编译时使用
+#endif
 
-#define MAX_MODES 50
-#define MAX_APPS 200
-#define MAX_PKG_LEN 128
+#include "rate_policy.h"
+#include "rate_shm.h"
 
-typedef struct {
-    int id;
-    int fps;
-    int width;
-    int height;
-} DisplayMode;
+#define BATTERY_DIR "/sys/class/power_supply/battery"
+
+// 自学习: 交付帧率直方图 (每档 10Hz, 0~200Hz)
+#define LEARN_OFF 0
+#define LEARN_SUGGEST 1
+#define LEARN_AUTO 2
+#define LEARN_FPS_BUCKETS 21
+#define LEARN_BUCKET_HZ 10
+#define LEARN_MIN_SAMPLES 30
+#define LEARN_MAX_JANK_PCT 10
+#define LEARN_LOG_MAX_BYTES (64 * 1024)
+#define LEARN_EXPORT_INTERVAL_MS 60000
+
+AppConfig active_policy; // 当前前台应用生效的策略
+int current_mode_id = -1;
+
+// 前台应用、窗口的 Activity 和屏幕方向 (随前台检测一起解析)
+char foreground_pkg[MAX_PKG_LEN] = "";
+char current_activity[MAX_PATTERN_LEN] = "";
+int display_rotation = 0;
 
 typedef struct {
     char package[MAX_PKG_LEN];
-    int mode_id;
-} AppConfig;
+    unsigned int hist[LEARN_FPS_BUCKETS]; // 按交付帧率分档的采样次数
+    unsigned int samples;
+    unsigned int jank_samples;            // 卡顿率超过阈值的采样次数
+    int saturated_fps;                    // 交付帧率顶满时的最高模式帧率
+    int unsaturated_fps;                  // 未顶满时的最高模式帧率
+} LearnedProfile;
 
-DisplayMode modes[MAX_MODES];
-int mode_count = 0;
+LearnedProfile learned[MAX_APPS];
+int learned_count = 0;
 
-AppConfig app_configs[MAX_APPS];
-int app_config_count = 0;
-int default_mode_id = 1;
+// 运行选项 (config/daemon.conf)
+int learn_mode = LEARN_OFF;
+int learn_interval = 10; // 帧数据采样间隔 (秒)，学习与遥测共用
+int telemetry_enabled = 0;
+int metrics_interval = 30; // 指标导出间隔 (秒)，0 为关闭
+int residency_enabled = 1;
+int trace_enabled = 0;
+int poll_interval_ms = 1000; // 前台应用检查间隔
+int reconcile_interval = 30; // 核对系统实际模式的间隔 (秒)，0 为关闭
 
-int current_mode_id = -1;
+// 调度选项: 轮询期间的调度类、nice、CPU 绑定，以及切换期间是否临时提升优先级
+#define SCHED_MODE_NORMAL 0
+#define SCHED_MODE_NICE 1
+#define SCHED_MODE_IDLE 2
+const char *sched_mode_names[] = { "normal", "nice", "idle" };
+int sched_mode = SCHED_MODE_NORMAL;
+int sched_nice = 10;
+int switch_boost = 1;
+char cpu_affinity[64] = "all"; // all / little / CPU 列表 (如 0-3,6)
 
 // Function Prototypes
 void set_surface_flinger(int id);
 void sync_android_settings(int id);
-int get_mode_width(int id);
-void get_sorted_fps_modes(int width, int *out_ids, int *out_count);
-int is_valid_mode(int id);
+void smooth_switch_steps(int target_id);
 
 #define LOG_FILE "/data/adb/modules/murongchaopin/daemon.log"
 
+// 日志写在模块目录下，启动时按传入的模块路径设置 (便于在主机上运行基准测试)
+char log_path[512] = LOG_FILE;
+
 void log_msg(const char *fmt, ...) {
-    FILE *fp = fopen(LOG_FILE, "a");
-    if (fp) {
-        va_list args;
-        va_start(args, fmt);
-        
-        // Add timestamp
-        time_t now = time(NULL);
-        struct tm *t = localtime(&now);
-        fprintf(fp, "[%02d-%02d %02d:%02d:%02d] ", 
-            t->tm_mon + 1, t->tm_mday, t->tm_hour, t->tm_min, t->tm_sec);
-        
-        vfprintf(fp, fmt, args);
-        fprintf(fp, "\n");
-        
-        va_end(args);
-        fclose(fp);
+    // 格式化到静态缓冲区后一次 write，避免每条日志 fopen 分配 FILE
+    static char buf[1024];
+    va_list args;
+    va_start(args, fmt);
+
+    // Add timestamp
+    time_t now = time(NULL);
+    struct tm t;
+    localtime_r(&now, &t);
+    int n = snprintf(buf, sizeof(buf), "[%02d-%02d %02d:%02d:%02d] ",
+        t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec);
+    n += vsnprintf(buf + n, sizeof(buf) - n - 1, fmt, args);
+    if (n > (int)sizeof(buf) - 2) n = sizeof(buf) - 2;
+    buf[n++] = '\n';
+    va_end(args);
+
+    int fd = open(log_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd >= 0) {
+        write(fd, buf, n);
+        close(fd);
     }
     
     // Also print to stdout for debugging if running manually
@@ -71,463 +124,2546 @@ void log_msg(const char *fmt, ...) {
     va_end(args2);
 }
 
-// 工具函数：去除字符串两端空白
-char* trim(char* str) {
-    char* end;
-    while(isspace((unsigned char)*str)) str++;
-    if(*str == 0) return str;
-    end = str + strlen(str) - 1;
-    while(end > str && isspace((unsigned char)*end)) end--;
-    *(end+1) = 0;
-    return str;
+// ==================== 外部命令与文件 I/O ====================
+// 守护进程常驻运行，主循环稳态下不做任何堆分配: 外部命令用 fork/exec +
+// 管道代替 popen/system，输出按行读入静态缓冲区；导出文件先在静态缓冲区中
+// 拼好，再一次性写入临时文件并 rename。
+
+#ifdef __ANDROID__
+#define SHELL_PATH "/system/bin/sh"
+#else
+#define SHELL_PATH "/bin/sh"
+#endif
+
+#define CMD_BUF_SIZE 8192
+#define IO_BUF_SIZE (256 * 1024)
+
+typedef struct {
+    pid_t pid;
+    int fd;
+    int start;           // buf 中未消费数据的起点
+    int end;
+    int eof;
+    char buf[CMD_BUF_SIZE];
+} CmdReader;
+
+typedef struct {
+    char *data;
+    int cap;
+    int len;
+    int overflow;
+} OutBuf;
+
+// 命令不会嵌套执行，读取器和输出缓冲区全局复用
+CmdReader cmd_reader;
+char io_storage[IO_BUF_SIZE];
+
+pid_t spawn_shell(const char *cmd, int out_fd) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (out_fd >= 0) {
+            dup2(out_fd, STDOUT_FILENO);
+        } else {
+            int null_fd = open("/dev/null", O_WRONLY);
+            if (null_fd >= 0) dup2(null_fd, STDOUT_FILENO);
+        }
+        execl(SHELL_PATH, "sh", "-c", cmd, (char *)NULL);
+        _exit(127);
+    }
+    return pid;
+}
+
+int wait_child(pid_t pid) {
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return -1;
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// 执行命令并丢弃输出 (代替 system)
+int run_cmd(const char *cmd) {
+    pid_t pid = spawn_shell(cmd, -1);
+    if (pid < 0) return -1;
+    return wait_child(pid);
+}
+
+// 执行命令并通过 cmd_read_line 逐行读取输出 (代替 popen)
+CmdReader* cmd_open(const char *cmd) {
+    int fds[2];
+    if (pipe(fds) < 0) return NULL;
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);  // dup2 到子进程 stdout 后会清除该标志
+
+    pid_t pid = spawn_shell(cmd, fds[1]);
+    close(fds[1]);
+    if (pid < 0) {
+        close(fds[0]);
+        return NULL;
+    }
+
+    CmdReader *r = &cmd_reader;
+    r->pid = pid;
+    r->fd = fds[0];
+    r->start = r->end = 0;
+    r->eof = 0;
+    return r;
+}
+
+// 读取下一行 (不含换行符)，超长部分丢弃；读完返回 0
+int cmd_read_line(CmdReader *r, char *line, int size) {
+    int skipping = 0;
+    int len = 0;
+
+    for (;;) {
+        char *nl = memchr(r->buf + r->start, '\n', r->end - r->start);
+        int avail = (nl ? (int)(nl - (r->buf + r->start)) : r->end - r->start);
+
+        if (!skipping) {
+            int n = avail < size - 1 - len ? avail : size - 1 - len;
+            memcpy(line + len, r->buf + r->start, n);
+            len += n;
+        }
+
+        if (nl) {
+            r->start += avail + 1;
+            line[len] = '\0';
+            return 1;
+        }
+
+        r->start = r->end = 0;
+        if (len >= size - 1) skipping = 1;
+
+        if (r->eof) break;
+        ssize_t n = read(r->fd, r->buf, CMD_BUF_SIZE);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            r->eof = 1;
+            continue;
+        }
+        r->end = (int)n;
+    }
+
+    line[len] = '\0';
+    return len > 0;
+}
+
+// 读完剩余输出 (避免子进程收到 SIGPIPE) 并回收子进程
+int cmd_close(CmdReader *r) {
+    while (!r->eof) {
+        ssize_t n = read(r->fd, r->buf, CMD_BUF_SIZE);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) r->eof = 1;
+    }
+    close(r->fd);
+    return wait_child(r->pid);
+}
+
+OutBuf ob_begin() {
+    OutBuf ob = {io_storage, IO_BUF_SIZE, 0, 0};
+    return ob;
+}
+
+void ob_printf(OutBuf *ob, const char *fmt, ...) {
+    if (ob->overflow) return;
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(ob->data + ob->len, ob->cap - ob->len, fmt, args);
+    va_end(args);
+    if (n < 0 || n >= ob->cap - ob->len) ob->overflow = 1;
+    else ob->len += n;
+}
+
+void ob_write(OutBuf *ob, const void *data, int len) {
+    if (ob->overflow || len > ob->cap - ob->len) {
+        ob->overflow = 1;
+        return;
+    }
+    memcpy(ob->data + ob->len, data, len);
+    ob->len += len;
+}
+
+int write_all(int fd, const char *data, int len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        data += n;
+        len -= (int)n;
+    }
+    return 1;
+}
+
+// 把缓冲区写入 path.tmp 后 rename 覆盖，保证读取方不会看到半个文件
+int ob_commit(OutBuf *ob, const char *path) {
+    if (ob->overflow) {
+        log_msg("Output too large, skipped / 输出超出缓冲区，已跳过: %s", path);
+        return 0;
+    }
+
+    char tmp_path[600];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return 0;
+    int ok = write_all(fd, ob->data, ob->len);
+    close(fd);
+    return ok && rename(tmp_path, path) == 0;
+}
+
+// 追加写入，返回追加后的文件大小 (失败返回 -1)
+long append_file(const char *path, const char *data, int len) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+    long size = -1;
+    if (write_all(fd, data, len)) size = (long)lseek(fd, 0, SEEK_END);
+    close(fd);
+    return size;
+}
+
+// 把小文件整个读入 buf 并以 '\0' 结尾，返回长度 (失败返回 -1)
+int read_small_file(const char *path, char *buf, int size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    int len = 0;
+    while (len < size - 1) {
+        ssize_t n = read(fd, buf + len, size - 1 - len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        len += (int)n;
+    }
+    close(fd);
+    buf[len] = '\0';
+    return len;
+}
+
+// 读取 sysfs 中的整数，失败返回 0
+int read_sysfs_long(const char *path, long *out) {
+    char buf[32];
+    if (read_small_file(path, buf, sizeof(buf)) <= 0) return 0;
+    char *end;
+    *out = strtol(buf, &end, 10);
+    return end != buf;
+}
+
+// ==================== 状态检查点 ====================
+// 运行状态以共享映射写入模块目录下的 state.bin，状态变化时直接改写映射页。
+// 进程崩溃或被 pkill 后内核仍会把页面写回文件，重启时校验通过即沿用其中的
+// 当前模式、前台应用和设置缓存，跳过初始切换和重复的 settings 写入。
+
+#define CHECKPOINT_MAGIC 0x4B434452 // "RDCK"
+#define CHECKPOINT_VERSION 2
+#define BOOT_ID_LEN 40
+
+typedef struct {
+    unsigned int magic;
+    unsigned int version;
+    char boot_id[BOOT_ID_LEN];  // 重启设备后检查点作废
+    int pid;
+    int current_mode_id;
+    int settings_fps;           // 上次写入 settings 的峰值/最低帧率
+    int settings_min_fps;
+    long long saved_at;
+    char last_pkg[MAX_PKG_LEN];
+    unsigned int checksum;      // 覆盖之前所有字段，写到一半崩溃时校验失败
+} Checkpoint;
+
+Checkpoint *checkpoint = NULL;
+char boot_id[BOOT_ID_LEN] = "";
+int settings_synced_fps = -1; // 设置缓存: 已同步到 settings 的峰值帧率，-1 为未知
+int settings_synced_min_fps = -1;
+int lock_fd = -1;
+
+unsigned int checkpoint_checksum(const Checkpoint *c) {
+    // FNV-1a
+    const unsigned char *p = (const unsigned char *)c;
+    unsigned int h = 2166136261u;
+    for (size_t i=0; i<offsetof(Checkpoint, checksum); i++) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+// 单实例锁: 对 rate_daemon.pid 加 flock 并写入 pid。
+// 允许短暂等待，以覆盖 "pkill 后立即重启" 时旧进程尚未退出的情况。
+// 无法确认持有锁时 (打不开 pid 文件、flock 出错) 一律退出: 控制套接字和检查点
+// 都假定只有一个实例，宁可不运行也不能与另一个实例争用
+int acquire_instance_lock(const char *base_path) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/rate_daemon.pid", base_path);
+
+    lock_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lock_fd < 0) {
+        log_msg("Cannot open pidfile, exiting / 无法打开 pid 文件 %s，退出: %s", path, strerror(errno));
+        return 0;
+    }
+
+    for (int i=0; i<20; i++) {
+        if (flock(lock_fd, LOCK_EX | LOCK_NB) == 0) {
+            char pid_str[16];
+            int len = snprintf(pid_str, sizeof(pid_str), "%d\n", (int)getpid());
+            if (ftruncate(lock_fd, 0) == 0) write_all(lock_fd, pid_str, len);
+            return 1;
+        }
+        if (errno == EINTR) continue;
+        if (errno != EWOULDBLOCK) {
+            log_msg("Cannot lock pidfile, exiting / 无法锁定 pid 文件，退出: %s", strerror(errno));
+            close(lock_fd);
+            lock_fd = -1;
+            return 0;
+        }
+        usleep(100000);
+    }
+
+    char other[16] = "";
+    lseek(lock_fd, 0, SEEK_SET);
+    int n = read(lock_fd, other, sizeof(other) - 1);
+    if (n > 0) other[n] = '\0';
+    char *other_pid = trim(other);
+    log_msg("Another rate_daemon is running (pid %s), exiting / 已有守护进程在运行 (pid %s)，退出",
+            other_pid, other_pid);
+    close(lock_fd);
+    lock_fd = -1;
+    return 0;
+}
+
+// 每次状态变化时调用，pkg 为 NULL 时保留原前台应用
+void checkpoint_save(const char *pkg) {
+    if (checkpoint == NULL) return;
+    checkpoint->current_mode_id = current_mode_id;
+    checkpoint->settings_fps = settings_synced_fps;
+    checkpoint->settings_min_fps = settings_synced_min_fps;
+    checkpoint->saved_at = (long long)time(NULL);
+    if (pkg) snprintf(checkpoint->last_pkg, sizeof(checkpoint->last_pkg), "%s", pkg);
+    checkpoint->checksum = checkpoint_checksum(checkpoint);
+}
+
+// 映射检查点文件，旧内容有效时拷贝到 restored 并返回 1
+int checkpoint_open(const char *base_path, Checkpoint *restored) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/state.bin", base_path);
+
+    read_small_file("/proc/sys/kernel/random/boot_id", boot_id, sizeof(boot_id));
+    trim(boot_id);
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return 0;
+    struct stat st;
+    int had_data = fstat(fd, &st) == 0 && st.st_size == (off_t)sizeof(Checkpoint);
+    if (!had_data && ftruncate(fd, sizeof(Checkpoint)) != 0) {
+        close(fd);
+        return 0;
+    }
+    void *map = mmap(NULL, sizeof(Checkpoint), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        log_msg("Checkpoint mmap failed / 检查点映射失败: %s", strerror(errno));
+        return 0;
+    }
+    checkpoint = (Checkpoint *)map;
+
+    int valid = had_data &&
+                checkpoint->magic == CHECKPOINT_MAGIC &&
+                checkpoint->version == CHECKPOINT_VERSION &&
+                checkpoint->checksum == checkpoint_checksum(checkpoint) &&
+                boot_id[0] && strncmp(checkpoint->boot_id, boot_id, BOOT_ID_LEN) == 0;
+    if (valid) *restored = *checkpoint;
+
+    memset(checkpoint, 0, sizeof(*checkpoint));
+    checkpoint->magic = CHECKPOINT_MAGIC;
+    checkpoint->version = CHECKPOINT_VERSION;
+    snprintf(checkpoint->boot_id, BOOT_ID_LEN, "%s", boot_id);
+    checkpoint->pid = (int)getpid();
+    checkpoint->current_mode_id = -1;
+    checkpoint->settings_fps = -1;
+    checkpoint->settings_min_fps = -1;
+    checkpoint_save(valid ? restored->last_pkg : "");
+    return valid;
+}
+
+// ==================== 分配检查构建 ====================
+// 用 -DRATE_DAEMON_ALLOC_CHECK 在主机 (glibc) 上编译时，包装 malloc 系列函数
+// 计数，主循环预热若干轮后一旦再出现堆分配就记录日志并以状态 3 退出，
+// 供 daemon_bench 检查稳态零分配。
+
+#ifdef RATE_DAEMON_ALLOC_CHECK
+#define ALLOC_CHECK_WARMUP 5
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+volatile unsigned long alloc_count = 0;
+
+void *malloc(size_t size) { alloc_count++; return __libc_malloc(size); }
+void *calloc(size_t n, size_t size) { alloc_count++; return __libc_calloc(n, size); }
+void *realloc(void *ptr, size_t size) { alloc_count++; return __libc_realloc(ptr, size); }
+void free(void *ptr) { __libc_free(ptr); }
+
+void alloc_check_iteration() {
+    static int iterations = 0;
+    static unsigned long last_count = 0;
+
+    unsigned long count = alloc_count;
+    if (++iterations > ALLOC_CHECK_WARMUP && count != last_count) {
+        log_msg("Heap allocation in steady state / 稳态出现堆分配: %lu (loop %d)",
+                count - last_count, iterations);
+        _exit(3);
+    }
+    last_count = alloc_count;
+}
+#else
+#define alloc_check_iteration() ((void)0)
+#endif
+
+// ==================== 指标 ====================
+// 进程内指标注册表: 计数器、仪表和固定分档直方图。
+// 主循环按 metrics_interval 把快照写入 metrics.json 供 WebUI 读取。
+
+#define METRIC_COUNTER 0
+#define METRIC_GAUGE 1
+#define METRIC_HISTOGRAM 2
+#define METRIC_MAX_BUCKETS 12
+
+// 耗时分档上界 (us)，步数分档上界 (次)
+const long long latency_bounds_us[METRIC_MAX_BUCKETS - 1] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000
+};
+const long long step_bounds[METRIC_MAX_BUCKETS - 1] = {
+    0, 1, 2, 3, 4, 5, 6, 8, 10, 12, 16
+};
+
+typedef struct {
+    const char *name;
+    int type;
+    const long long *bounds; // 直方图分档上界，最后一档为溢出
+    long long value;         // 计数器/仪表的值
+    long long sum;
+    long long max;
+    unsigned int count;
+    unsigned int hist[METRIC_MAX_BUCKETS];
+} Metric;
+
+enum {
+    M_LOOP_ITERATIONS,
+    M_FG_DETECT_US,
+    M_CMD_SF_DUMP_US,
+    M_CMD_WINDOW_DUMP_US,
+    M_CMD_GFXINFO_US,
+    M_CMD_SERVICE_CALL_US,
+    M_CMD_SETTINGS_US,
+    M_SWITCHES,
+    M_SWITCH_STEPS,
+    M_SETTINGS_WRITES,
+    M_CONFIG_RELOADS,
+    M_CURRENT_MODE,
+    M_RECONCILE_CHECKS,
+    M_DRIFTS,
+    M_BOOT_FIRST_MODE_MS,
+    M_BOOT_COMPLETED_MS,
+    M_WAKEUP_LATENCY_US,
+    M_COUNT
+};
+
+Metric metrics[M_COUNT] = {
+    [M_LOOP_ITERATIONS]     = {"loop_iterations",     METRIC_COUNTER,   NULL},
+    [M_FG_DETECT_US]        = {"fg_detect_us",        METRIC_HISTOGRAM, latency_bounds_us},
+    [M_CMD_SF_DUMP_US]      = {"cmd_sf_dump_us",      METRIC_HISTOGRAM, latency_bounds_us},
+    [M_CMD_WINDOW_DUMP_US]  = {"cmd_window_dump_us",  METRIC_HISTOGRAM, latency_bounds_us},
+    [M_CMD_GFXINFO_US]      = {"cmd_gfxinfo_us",      METRIC_HISTOGRAM, latency_bounds_us},
+    [M_CMD_SERVICE_CALL_US] = {"cmd_service_call_us", METRIC_HISTOGRAM, latency_bounds_us},
+    [M_CMD_SETTINGS_US]     = {"cmd_settings_us",     METRIC_HISTOGRAM, latency_bounds_us},
+    [M_SWITCHES]            = {"switches",            METRIC_COUNTER,   NULL},
+    [M_SWITCH_STEPS]        = {"switch_steps",        METRIC_HISTOGRAM, step_bounds},
+    [M_SETTINGS_WRITES]     = {"settings_writes",     METRIC_COUNTER,   NULL},
+    [M_CONFIG_RELOADS]      = {"config_reloads",      METRIC_COUNTER,   NULL},
+    [M_CURRENT_MODE]        = {"current_mode",        METRIC_GAUGE,     NULL},
+    [M_RECONCILE_CHECKS]    = {"reconcile_checks",    METRIC_COUNTER,   NULL},
+    [M_DRIFTS]              = {"drifts",              METRIC_COUNTER,   NULL},
+    [M_BOOT_FIRST_MODE_MS]  = {"boot_first_mode_ms",  METRIC_GAUGE,     NULL},
+    [M_BOOT_COMPLETED_MS]   = {"boot_completed_ms",   METRIC_GAUGE,     NULL},
+    [M_WAKEUP_LATENCY_US]   = {"wakeup_latency_us",   METRIC_HISTOGRAM, latency_bounds_us},
+};
+
+// 最近一小时的切换次数 (按分钟分槽)
+unsigned int switch_minutes[60];
+long long switch_minute_stamp[60];
+
+// 各显示模式的累计驻留时间，下标与 modes[] 一致
+long long mode_time_ms[MAX_MODES];
+long long mode_time_last_ms = 0;
+long long metrics_start_ms = 0;
+long long metrics_last_export_ms = 0;
+
+long long monotonic_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+long long monotonic_ms() {
+    return monotonic_us() / 1000;
+}
+
+// 守护进程 (RUSAGE_SELF) 或已回收子进程 (RUSAGE_CHILDREN) 的 CPU 时间 (ms)
+long long process_cpu_ms(int who) {
+    struct rusage ru;
+    getrusage(who, &ru);
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000LL +
+           (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000;
+}
+
+long long total_cpu_ms() {
+    return process_cpu_ms(RUSAGE_SELF) + process_cpu_ms(RUSAGE_CHILDREN);
+}
+
+// 当前调度配置的统计起点，配置变化时重置
+long long sched_since_ms = 0;
+long long sched_cpu_base_ms = 0;
+// 唤醒延迟直方图在整个运行期间累计，换配置时只记下起点用于对比
+unsigned int sched_wakeup_base_count = 0;
+long long sched_wakeup_base_sum = 0;
+
+// 从当前调度配置生效起每小时的 CPU 时间 (含子进程)
+long long sched_cpu_ms_per_hour() {
+    long long elapsed = monotonic_ms() - sched_since_ms;
+    if (elapsed <= 0) return 0;
+    return (total_cpu_ms() - sched_cpu_base_ms) * 3600000LL / elapsed;
+}
+
+void metric_inc(int id, long long delta) {
+    metrics[id].value += delta;
+}
+
+void metric_set(int id, long long value) {
+    metrics[id].value = value;
+}
+
+void metric_observe(int id, long long v) {
+    Metric *m = &metrics[id];
+    int b = 0;
+    while (b < METRIC_MAX_BUCKETS - 1 && v > m->bounds[b]) b++;
+    m->hist[b]++;
+    m->count++;
+    m->sum += v;
+    if (v > m->max) m->max = v;
+}
+
+void metrics_note_switch(int steps) {
+    metric_inc(M_SWITCHES, 1);
+    metric_observe(M_SWITCH_STEPS, steps);
+
+    long long minute = monotonic_ms() / 60000;
+    int slot = (int)(minute % 60);
+    if (switch_minute_stamp[slot] != minute) {
+        switch_minute_stamp[slot] = minute;
+        switch_minutes[slot] = 0;
+    }
+    switch_minutes[slot]++;
+}
+
+// 把距上次结算的时间计入当前模式
+void metrics_account_mode() {
+    long long now = monotonic_ms();
+    if (mode_time_last_ms > 0) {
+        for (int i=0; i<mode_count; i++) {
+            if (modes[i].id == current_mode_id) {
+                mode_time_ms[i] += now - mode_time_last_ms;
+                break;
+            }
+        }
+    }
+    mode_time_last_ms = now;
+}
+
+unsigned int switches_last_hour() {
+    long long minute = monotonic_ms() / 60000;
+    unsigned int total = 0;
+    for (int i=0; i<60; i++) {
+        if (minute - switch_minute_stamp[i] < 60) total += switch_minutes[i];
+    }
+    return total;
+}
+
+// 指标快照 JSON (导出文件和控制套接字共用)
+void metrics_format_json(OutBuf *ob) {
+    metrics_account_mode();
+
+    long long now = monotonic_ms();
+    ob_printf(ob, "{\"uptime_ms\":%lld,\"cpu_ms\":%lld,\"child_cpu_ms\":%lld,\"switches_last_hour\":%u",
+            now - metrics_start_ms, process_cpu_ms(RUSAGE_SELF), process_cpu_ms(RUSAGE_CHILDREN),
+            switches_last_hour());
+    // 当前调度配置及其生效以来的开销
+    ob_printf(ob, ",\"sched\":{\"mode\":\"%s\",\"nice\":%d,\"affinity\":\"%s\",\"boost\":%d,"
+            "\"since_ms\":%lld,\"cpu_ms_per_hour\":%lld}",
+            sched_mode_names[sched_mode], sched_mode == SCHED_MODE_NICE ? sched_nice : 0,
+            cpu_affinity, switch_boost,
+            now - sched_since_ms, sched_cpu_ms_per_hour());
+
+    for (int i=0; i<M_COUNT; i++) {
+        Metric *m = &metrics[i];
+        if (m->type != METRIC_HISTOGRAM) {
+            ob_printf(ob, ",\"%s\":%lld", m->name, m->value);
+            continue;
+        }
+        ob_printf(ob, ",\"%s\":{\"count\":%u,\"sum\":%lld,\"max\":%lld,\"bounds\":[",
+                m->name, m->count, m->sum, m->max);
+        for (int b=0; b<METRIC_MAX_BUCKETS - 1; b++) ob_printf(ob, "%s%lld", b ? "," : "", m->bounds[b]);
+        ob_printf(ob, "],\"hist\":[");
+        for (int b=0; b<METRIC_MAX_BUCKETS; b++) ob_printf(ob, "%s%u", b ? "," : "", m->hist[b]);
+        ob_printf(ob, "]}");
+    }
+
+    ob_printf(ob, ",\"mode_time_ms\":{");
+    for (int i=0; i<mode_count; i++) {
+        ob_printf(ob, "%s\"%d\":%lld", i ? "," : "", modes[i].id, mode_time_ms[i]);
+    }
+    ob_printf(ob, "}}");
+}
+
+void metrics_export_json(const char *base_path) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/metrics.json", base_path);
+
+    OutBuf ob = ob_begin();
+    metrics_format_json(&ob);
+    ob_printf(&ob, "\n");
+    ob_commit(&ob, path);
+}
+
+// 每轮主循环调用，按 metrics_interval 导出快照
+void metrics_tick(const char *base_path) {
+    metric_inc(M_LOOP_ITERATIONS, 1);
+    if (metrics_interval <= 0) return;
+
+    long long now = monotonic_ms();
+    if (now - metrics_last_export_ms >= (long long)metrics_interval * 1000) {
+        metrics_export_json(base_path);
+        metrics_last_export_ms = now;
+    }
+}
+
+// ==================== 追踪 ====================
+// 可选的 ATrace 格式事件 (B|pid|name / E|pid / C|pid|name|value)，写入 tracefs 的
+// trace_marker，可与 SurfaceFlinger 一起在 Perfetto/systrace 中查看；没有 tracefs
+// 时退回到模块目录下的 trace.log (行首附带单调时钟微秒)。
+// 关闭时 trace_fd 为 -1，TRACE_* 宏只有一次比较的开销。
+
+#define TRACE_BEGIN(...) do { if (trace_fd >= 0) trace_begin(__VA_ARGS__); } while (0)
+#define TRACE_END() do { if (trace_fd >= 0) trace_end(); } while (0)
+#define TRACE_COUNTER(name, value) do { if (trace_fd >= 0) trace_counter(name, value); } while (0)
+
+int trace_fd = -1;
+int trace_to_file = 0;
+
+void trace_write(const char *buf, int len) {
+    if (trace_to_file) {
+        char line[320];
+        int n = snprintf(line, sizeof(line), "%lld %.*s\n", monotonic_us(), len, buf);
+        if (n > (int)sizeof(line)) n = sizeof(line);
+        write(trace_fd, line, n);
+    } else {
+        write(trace_fd, buf, len);
+    }
+}
+
+void trace_begin(const char *fmt, ...) {
+    char name[200];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(name, sizeof(name), fmt, args);
+    va_end(args);
+
+    char buf[256];
+    int n = snprintf(buf, sizeof(buf), "B|%d|%s", getpid(), name);
+    if (n > (int)sizeof(buf) - 1) n = sizeof(buf) - 1;
+    trace_write(buf, n);
+}
+
+void trace_end() {
+    char buf[32];
+    int n = snprintf(buf, sizeof(buf), "E|%d", getpid());
+    trace_write(buf, n);
+}
+
+void trace_counter(const char *name, long long value) {
+    char buf[256];
+    int n = snprintf(buf, sizeof(buf), "C|%d|%s|%lld", getpid(), name, value);
+    if (n > (int)sizeof(buf) - 1) n = sizeof(buf) - 1;
+    trace_write(buf, n);
+}
+
+// 按选项打开或关闭追踪输出
+void trace_setup(const char *base_path) {
+    if (!trace_enabled) {
+        if (trace_fd >= 0) {
+            close(trace_fd);
+            trace_fd = -1;
+            log_msg("Tracing disabled / 追踪已关闭");
+        }
+        return;
+    }
+    if (trace_fd >= 0) return;
+
+    const char *markers[] = {
+        "/sys/kernel/tracing/trace_marker",
+        "/sys/kernel/debug/tracing/trace_marker",
+    };
+    for (int i=0; i<2; i++) {
+        trace_fd = open(markers[i], O_WRONLY | O_CLOEXEC);
+        if (trace_fd >= 0) {
+            trace_to_file = 0;
+            log_msg("Tracing to / 追踪输出到 %s", markers[i]);
+            return;
+        }
+    }
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/trace.log", base_path);
+    trace_fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (trace_fd >= 0) {
+        trace_to_file = 1;
+        log_msg("Tracing to / 追踪输出到 %s", path);
+    } else {
+        log_msg("Tracing unavailable / 无法开启追踪: %s", strerror(errno));
+    }
+}
+
+// ==================== 调度与 CPU 放置 ====================
+// 守护进程每秒唤醒一次，默认调度下可能落在大核上让它无法进入空闲。
+// 轮询期间可以绑定到小核、降为 SCHED_IDLE 或调低 nice；真正切换刷新率时
+// 临时提升优先级 (子进程 service/settings 随 fork 继承)，避免逐档被拖慢。
+// 每种配置的唤醒延迟和每小时 CPU 时间从配置生效时起重新统计。
+
+#define SCHED_BOOST_NICE -10
+
+// 当前生效的配置，只有变化时才重新设置
+int sched_applied_mode = -1;
+int sched_applied_nice = 0;
+char sched_applied_affinity[64] = "";
+int sched_boosted = 0;
+int sched_boost_warned = 0;
+
+// 解析 CPU 列表 "0-3,6"，返回 CPU 数
+int cpu_parse_list(const char *list, cpu_set_t *set) {
+    CPU_ZERO(set);
+    const char *p = list;
+    while (*p) {
+        char *end;
+        long lo = strtol(p, &end, 10);
+        if (end == p) return 0;
+        long hi = lo;
+        p = end;
+        if (*p == '-') {
+            hi = strtol(p + 1, &end, 10);
+            if (end == p + 1) return 0;
+            p = end;
+        }
+        for (long c = lo; c <= hi && c < CPU_SETSIZE; c++) {
+            if (c >= 0) CPU_SET(c, set);
+        }
+        if (*p == ',') p++;
+        else if (*p) return 0;
+    }
+    return CPU_COUNT(set);
+}
+
+// 小核: cpu_capacity 最小的一组 CPU，没有该节点时按 cpuinfo_max_freq。
+// 各核相同 (非异构) 时返回 0
+int cpu_little_set(cpu_set_t *set) {
+    const char *attrs[] = { "cpu_capacity", "cpufreq/cpuinfo_max_freq" };
+    CPU_ZERO(set);
+    for (int a=0; a<2; a++) {
+        long values[CPU_SETSIZE];
+        long min = 0, max = 0;
+        int n = 0;
+        for (; n < CPU_SETSIZE; n++) {
+            char path[128];
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/%s", n, attrs[a]);
+            if (!read_sysfs_long(path, &values[n])) break;
+            if (n == 0 || values[n] < min) min = values[n];
+            if (n == 0 || values[n] > max) max = values[n];
+        }
+        if (n == 0) continue;
+        if (min == max) return 0;
+        for (int c=0; c<n; c++) {
+            if (values[c] == min) CPU_SET(c, set);
+        }
+        return CPU_COUNT(set);
+    }
+    return 0;
+}
+
+void sched_set_affinity(const char *spec) {
+    cpu_set_t set;
+    int n;
+    if (strcmp(spec, "little") == 0) {
+        n = cpu_little_set(&set);
+        if (n == 0) log_msg("No little cores found, affinity unchanged / 未识别到小核，不绑定 CPU");
+    } else if (strcmp(spec, "all") == 0) {
+        n = 0;
+    } else {
+        n = cpu_parse_list(spec, &set);
+        if (n == 0) log_msg("Bad cpu_affinity / CPU 列表无效: %s", spec);
+    }
+    if (n == 0) {
+        // 恢复为所有在线 CPU
+        CPU_ZERO(&set);
+        long online = sysconf(_SC_NPROCESSORS_CONF);
+        for (long c = 0; c < online && c < CPU_SETSIZE; c++) CPU_SET(c, &set);
+    }
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        log_msg("sched_setaffinity failed / 绑定 CPU 失败: %s", strerror(errno));
+    } else if (n > 0) {
+        log_msg("CPU affinity / 绑定 CPU: %s (%d cpus)", spec, n);
+    }
+}
+
+// 设置调度类，失败返回 0
+int sched_set_class(int mode, int nice_value) {
+    struct sched_param sp;
+    memset(&sp, 0, sizeof(sp));
+    if (mode == SCHED_MODE_IDLE) return sched_setscheduler(0, SCHED_IDLE, &sp) == 0;
+    if (sched_setscheduler(0, SCHED_OTHER, &sp) != 0) return 0;
+    return setpriority(PRIO_PROCESS, 0, mode == SCHED_MODE_NICE ? nice_value : 0) == 0;
+}
+
+// 按选项设置轮询期间的调度 (加载配置时调用，未变化时不做任何事)
+void sched_setup() {
+    if (sched_mode == sched_applied_mode && sched_nice == sched_applied_nice &&
+        strcmp(cpu_affinity, sched_applied_affinity) == 0) return;
+
+    if (sched_applied_mode != -1) {
+        // 换配置前记下上一种配置的结果，便于对比
+        const Metric *w = &metrics[M_WAKEUP_LATENCY_US];
+        unsigned int count = w->count - sched_wakeup_base_count;
+        log_msg("Sched %s/%s: wakeup avg %lldus, cpu %lldms/h / 调度配置统计",
+                sched_mode_names[sched_applied_mode], sched_applied_affinity,
+                count ? (w->sum - sched_wakeup_base_sum) / count : 0, sched_cpu_ms_per_hour());
+    }
+
+    if (strcmp(cpu_affinity, sched_applied_affinity) != 0) sched_set_affinity(cpu_affinity);
+    if (!sched_set_class(sched_mode, sched_nice)) {
+        log_msg("Failed to set sched %s / 设置调度失败: %s", sched_mode_names[sched_mode], strerror(errno));
+    }
+    sched_applied_mode = sched_mode;
+    sched_applied_nice = sched_nice;
+    snprintf(sched_applied_affinity, sizeof(sched_applied_affinity), "%s", cpu_affinity);
+    sched_boosted = 0;
+
+    sched_wakeup_base_count = metrics[M_WAKEUP_LATENCY_US].count;
+    sched_wakeup_base_sum = metrics[M_WAKEUP_LATENCY_US].sum;
+    sched_since_ms = monotonic_ms();
+    sched_cpu_base_ms = total_cpu_ms();
+    log_msg("Sched / 调度: %s (nice %d), affinity %s, switch boost %s",
+            sched_mode_names[sched_mode], sched_mode == SCHED_MODE_NICE ? sched_nice : 0,
+            cpu_affinity, switch_boost ? "on" : "off");
+}
+
+void wakeup_observe(long long late_us) {
+    metric_observe(M_WAKEUP_LATENCY_US, late_us > 0 ? late_us : 0);
+}
+
+// 切换期间临时提升优先级
+void sched_boost_begin() {
+    if (!switch_boost || sched_boosted) return;
+    if (!sched_set_class(SCHED_MODE_NICE, SCHED_BOOST_NICE) &&
+        !sched_set_class(SCHED_MODE_NORMAL, 0)) {
+        if (!sched_boost_warned) {
+            log_msg("Switch boost unavailable / 无法提升切换优先级: %s", strerror(errno));
+            sched_boost_warned = 1;
+        }
+        return;
+    }
+    sched_boosted = 1;
+}
+
+void sched_boost_end() {
+    if (!sched_boosted) return;
+    sched_set_class(sched_applied_mode, sched_applied_nice);
+    sched_boosted = 0;
 }
 
 // 解析 dumpsys SurfaceFlinger 获取模式
 void init_display_modes() {
-    FILE *fp;
+    CmdReader *cr;
     char line[1024];
     
     // 直接读取 dumpsys SurfaceFlinger 输出，手动解析以提高兼容性
-    fp = popen("dumpsys SurfaceFlinger", "r");
-    if (fp == NULL) {
+    long long t0 = monotonic_us();
+    cr = cmd_open("dumpsys SurfaceFlinger");
+    if (cr == NULL) {
         log_msg("Failed to run dumpsys SurfaceFlinger / 执行 dumpsys SurfaceFlinger 失败");
         return;
     }
 
     mode_count = 0;
-    while (fgets(line, sizeof(line), fp) != NULL && mode_count < MAX_MODES) {
-        // 查找关键字段: id=, resolution=, vsyncRate=
-        // 示例: 
-        // Display 0 HWC layers:
-        // ... id=0, ... resolution=1264x2780 ... vsyncRate=120.000000
-        // 注意：不同设备输出格式可能略有不同，但这些关键字通常存在
-        
-        char *p_id = strstr(line, "id=");
-        char *p_res = strstr(line, "resolution=");
-        char *p_fps = strstr(line, "vsyncRate=");
-        
-        if (p_id && p_res && p_fps) {
-            int id = atoi(p_id + 3);
-            
-            // 解析分辨率 resolution=WxH
-            int w = 0, h = 0;
-            sscanf(p_res + 11, "%dx%d", &w, &h);
-            
-            float fps_f = atof(p_fps + 10);
-            
-            if (w > 0 && h > 0 && fps_f > 0) {
-                // 查重
-                int exists = 0;
-                for(int k=0; k<mode_count; k++) {
-                    if(modes[k].id == id) { exists=1; break; }
-                }
-                if(!exists) {
-                    modes[mode_count].id = id;
-                    modes[mode_count].width = w;
-                    modes[mode_count].height = h;
-                    modes[mode_count].fps = (int)(fps_f + 0.5);
-                    mode_count++;
-                }
-            }
+    while (cmd_read_line(cr, line, sizeof(line))) {
+        policy_parse_mode_line(line);
+    }
+    cmd_close(cr);
+    metric_observe(M_CMD_SF_DUMP_US, monotonic_us() - t0);
+    
+    policy_sort_modes();
+
+    log_msg("Loaded %d display modes (HWC) / 已加载 %d 个显示模式 (HWC):", mode_count, mode_count);
+    for(int i=0; i<mode_count; i++) {
+        log_msg("ID: %d, FPS: %d, Res: %dx%d", modes[i].id, modes[i].fps, modes[i].width, modes[i].height);
+    }
+}
+
+// 只读取规则用到的条件
+void rule_context_read(RuleContext *ctx) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->battery = -1;
+    ctx->temp = -1000;
+    ctx->landscape = display_rotation == 90 || display_rotation == 270;
+
+    long v;
+    if (rule_cond_used & (COND_CHARGING | COND_NOT_CHARGING)) {
+        char status[32] = "";
+        read_small_file(BATTERY_DIR "/status", status, sizeof(status));
+        ctx->charging = strncmp(status, "Charging", 8) == 0 || strncmp(status, "Full", 4) == 0;
+    }
+    if ((rule_cond_used & (COND_BATTERY_BELOW | COND_BATTERY_ABOVE)) &&
+        read_sysfs_long(BATTERY_DIR "/capacity", &v)) ctx->battery = (int)v;
+    if ((rule_cond_used & (COND_TEMP_ABOVE | COND_TEMP_BELOW)) &&
+        read_sysfs_long(BATTERY_DIR "/temp", &v)) ctx->temp = (int)(v / 10);
+}
+
+// 读取守护进程选项 (key=value，缺省文件时保持默认值)
+void load_daemon_options(const char* base_path) {
+    char conf_path[512];
+    snprintf(conf_path, sizeof(conf_path), "%s/config/daemon.conf", base_path);
+
+    char *cursor = io_storage;
+    if (read_small_file(conf_path, io_storage, IO_BUF_SIZE) < 0) return;
+
+    char *line;
+    while ((line = next_line(&cursor)) != NULL) {
+        char *trimmed = trim(line);
+        if (strlen(trimmed) == 0 || trimmed[0] == '#') continue;
+
+        char *eq = strchr(trimmed, '=');
+        if (!eq) continue;
+        *eq = '\0';
+        char *key = trim(trimmed);
+        char *val = trim(eq + 1);
+
+        if (strcmp(key, "learn") == 0) {
+            if (strcmp(val, "off") == 0) learn_mode = LEARN_OFF;
+            else if (strcmp(val, "auto") == 0) learn_mode = LEARN_AUTO;
+            else learn_mode = LEARN_SUGGEST;
+        } else if (strcmp(key, "learn_interval") == 0) {
+            int v = atoi(val);
+            if (v >= 1) learn_interval = v;
+        } else if (strcmp(key, "telemetry") == 0) {
+            telemetry_enabled = (strcmp(val, "1") == 0 || strcmp(val, "on") == 0);
+        } else if (strcmp(key, "residency") == 0) {
+            residency_enabled = !(strcmp(val, "0") == 0 || strcmp(val, "off") == 0);
+        } else if (strcmp(key, "poll_interval_ms") == 0) {
+            int v = atoi(val);
+            if (v >= 50) poll_interval_ms = v;
+        } else if (strcmp(key, "trace") == 0) {
+            trace_enabled = (strcmp(val, "1") == 0 || strcmp(val, "on") == 0);
+        } else if (strcmp(key, "reconcile_interval") == 0) {
+            int v = atoi(val);
+            if (v >= 0) reconcile_interval = v;
+        } else if (strcmp(key, "metrics_interval") == 0) {
+            int v = atoi(val);
+            if (v >= 0) metrics_interval = v;
+        } else if (strcmp(key, "sched") == 0) {
+            if (strcmp(val, "idle") == 0) sched_mode = SCHED_MODE_IDLE;
+            else if (strcmp(val, "nice") == 0) sched_mode = SCHED_MODE_NICE;
+            else sched_mode = SCHED_MODE_NORMAL;
+        } else if (strcmp(key, "sched_nice") == 0) {
+            int v = atoi(val);
+            if (v >= -20 && v <= 19) sched_nice = v;
+        } else if (strcmp(key, "cpu_affinity") == 0) {
+            snprintf(cpu_affinity, sizeof(cpu_affinity), "%s", val);
+        } else if (strcmp(key, "switch_boost") == 0) {
+            switch_boost = !(strcmp(val, "0") == 0 || strcmp(val, "off") == 0);
         }
     }
-    pclose(fp);
-    
-    // 按 ID 排序 (冒泡排序)
-    for (int i = 0; i < mode_count - 1; i++) {
-        for (int j = 0; j < mode_count - i - 1; j++) {
-            if (modes[j].id > modes[j+1].id) {
-                DisplayMode temp = modes[j];
-                modes[j] = modes[j+1];
-                modes[j+1] = temp;
-            }
+}
+
+// 读取配置文件
+void load_config(const char* base_path) {
+    load_daemon_options(base_path);
+    trace_setup(base_path);
+    sched_setup();
+    TRACE_BEGIN("load_config");
+
+    char config_path[512];
+    snprintf(config_path, sizeof(config_path), "%s/config/mode.txt", base_path);
+    
+    if (read_small_file(config_path, io_storage, IO_BUF_SIZE) < 0) {
+        TRACE_END();
+        return;
+    }
+
+    policy_parse_config(io_storage);
+    metric_inc(M_CONFIG_RELOADS, 1);
+    log_msg("Config loaded / 配置已加载. Default: %d, Apps: %d", default_mode_id, app_config_count);
+    TRACE_END();
+}
+
+// 获取当前系统模式ID
+// 取自 SurfaceFlinger 显示设备段的 "activeMode={id=N, hwcId=..., ...}"，与
+// init_display_modes 解析的 displayModes 使用同一套 ID (service call 1035 的参数)。
+// 核对每 reconcile_interval 秒才调用一次。先用 --displays 只输出显示设备段；
+// 不认识该参数的系统会输出完整 dump，同样含 activeMode。grep -m 1 读到第一处即结束。
+// --displays 的输出里找不到 activeMode 时，之后直接使用完整 dump
+int sf_displays_dump = 1;
+
+int get_current_system_mode() {
+    for (;;) {
+        long long t0 = monotonic_us();
+        CmdReader *cr = cmd_open(sf_displays_dump
+                                     ? "dumpsys SurfaceFlinger --displays | grep -m 1 \"activeMode={id=\""
+                                     : "dumpsys SurfaceFlinger | grep -m 1 \"activeMode={id=\"");
+        if (cr == NULL) return -1;
+
+        char line[256];
+        int id = -1;
+        if (cmd_read_line(cr, line, sizeof(line))) {
+            const char *p = strstr(trim(line), "activeMode={id=");
+            if (p == NULL || sscanf(p + 15, "%d", &id) != 1) id = -1;
+        }
+        cmd_close(cr);
+        metric_observe(M_CMD_SF_DUMP_US, monotonic_us() - t0);
+
+        if (id != -1 || !sf_displays_dump) return id;
+        sf_displays_dump = 0;
+        log_msg("No activeMode in dumpsys SurfaceFlinger --displays, using full dump / --displays 无 activeMode，改用完整 dump");
+    }
+}
+
+// 更新当前模式，并把上一段驻留时间计入旧模式
+void set_current_mode(int id) {
+    metrics_account_mode();
+    current_mode_id = id;
+    metric_set(M_CURRENT_MODE, id);
+    TRACE_COUNTER("current_mode", id);
+    TRACE_COUNTER("current_fps", get_mode_fps(id));
+    checkpoint_save(NULL);
+}
+
+// 直接切换到目标模式 (不经过中间档位)
+void direct_switch(int target_id) {
+    set_surface_flinger(target_id);
+    sync_android_settings(target_id);
+    set_current_mode(target_id);
+    metrics_note_switch(1);
+}
+
+// 平滑切换核心逻辑
+void smooth_switch(int target_id) {
+    if (current_mode_id == -1) {
+        // 首次启动，尝试获取当前系统状态
+        int actual = get_current_system_mode();
+        if (actual != -1) {
+            set_current_mode(actual);
+            log_msg("Initialized current mode from system / 从系统初始化当前模式: %d", current_mode_id);
+        } else {
+            // 获取失败，直接设置并假设成功
+            log_msg("First switch (unknown current) / 首次切换 (当前未知): -> %d", target_id);
+            sched_boost_begin();
+            direct_switch(target_id);
+            sched_boost_end();
+            return;
+        }
+    }
+
+    if (current_mode_id == target_id) return;
+
+    TRACE_BEGIN("smooth_switch %d->%d", current_mode_id, target_id);
+    sched_boost_begin();
+    smooth_switch_steps(target_id);
+    sched_boost_end();
+    TRACE_END();
+}
+
+// 平滑切换的实际执行部分 (已确定当前模式且与目标不同)
+void smooth_switch_steps(int target_id) {
+    SwitchPlan plan;
+    plan_switch(current_mode_id, target_id, &plan);
+
+    switch (plan.kind) {
+    case PLAN_DIRECT_INVALID_WIDTH:
+        // 如果无法获取宽度（无效ID），直接切换
+        log_msg("Invalid width / 无效宽度 (curr=%d, target=%d). Direct switch / 直接切换.",
+                get_mode_width(current_mode_id), get_mode_width(target_id));
+        direct_switch(target_id);
+        return;
+    case PLAN_DIRECT_RESOLUTION:
+        log_msg("Resolution change / 分辨率变更: %d -> %d. Direct switch / 直接切换.", current_mode_id, target_id);
+        direct_switch(target_id);
+        return;
+    case PLAN_DIRECT_CURRENT_UNLISTED:
+        log_msg("Current mode %d not in sorted list / 当前模式不在排序列表中. Direct switch / 直接切换.", current_mode_id);
+        direct_switch(target_id);
+        return;
+    case PLAN_DIRECT_TARGET_UNLISTED:
+        log_msg("Target mode %d not in sorted list / 目标模式不在排序列表中. Direct switch / 直接切换.", target_id);
+        direct_switch(target_id);
+        return;
+    }
+
+    log_msg("Smooth Switch / 平滑切换: %d -> %d", current_mode_id, target_id);
+
+    // 逐步切换
+    for (int i = 0; i < plan.count; i++) {
+        int id = plan.ids[i];
+        if (plan.up) {
+            log_msg("Step UP / 升频: %d", id);
+            TRACE_BEGIN("step_up %d", id);
+        } else {
+            log_msg("Step DOWN / 降频: %d", id);
+            TRACE_BEGIN("step_down %d", id);
+        }
+        set_surface_flinger(id);
+        TRACE_COUNTER("current_fps", get_mode_fps(id));
+        TRACE_BEGIN("step_sleep");
+        usleep(SWITCH_STEP_SLEEP_MS * 1000);
+        TRACE_END();
+        TRACE_END();
+    }
+    
+    set_current_mode(target_id);
+    metrics_note_switch(plan.count);
+    sync_android_settings(target_id);
+}
+
+// 获取前台应用 (使用用户提供的优化逻辑)
+void get_foreground_app(char *buffer, int size) {
+    // 优先尝试 dumpsys window | grep mCurrentFocus
+    long long t0 = monotonic_us();
+    CmdReader* cr = cmd_open("dumpsys window | grep -E 'mCurrentFocus|mCurrentRotation'");
+    if (!cr) {
+        log_msg("get_foreground_app: spawn failed / 启动命令失败");
+        strncpy(buffer, "unknown", size);
+        return;
+    }
+
+    char line[1024];
+    char last_valid[MAX_PKG_LEN] = "";
+    char last_activity[MAX_PATTERN_LEN] = "";
+
+    while (cmd_read_line(cr, line, sizeof(line))) {
+        // 确保字符串以null结尾
+        line[sizeof(line) - 1] = '\0';
+
+        // 屏幕方向: mCurrentRotation=ROTATION_90 (旧版本为数字 0~3)
+        char *rot = strstr(line, "mCurrentRotation=");
+        if (rot) {
+            rot += 17;
+            if (strncmp(rot, "ROTATION_", 9) == 0) display_rotation = atoi(rot + 9);
+            else display_rotation = atoi(rot) * 90;
+            continue;
+        }
+        
+        char* start = strchr(line, '{');
+        char* end = strrchr(line, '}');  // 使用最后一个 } 作为结束点
+
+        if (start && end && end > start) {
+            // 提取 {} 之间的内容
+            size_t len = end - start - 1;
+            char inner[256];
+            if (len > 0 && len < sizeof(inner) - 1) {  // 预留null终止符空间
+                strncpy(inner, start + 1, len);
+                inner[len] = '\0';
+
+                // 提取最后一个空格后的内容
+                char* last_space = strrchr(inner, ' ');
+                char* candidate = last_space ? last_space + 1 : inner;
+
+                // 处理 PopupWindow: 前缀
+                char* popup_prefix = strstr(candidate, "PopupWindow:");
+                if (popup_prefix) {
+                    candidate = popup_prefix + 12;  // 跳过 "PopupWindow:"
+                }
+
+                // 处理斜杠后的 activity 名
+                char* slash = strchr(candidate, '/');
+                const char* activity = "";
+                if (slash) {
+                    *slash = '\0';
+                    activity = slash + 1;
+                }
+
+                // 验证包名格式 - 必须包含点号且长度合理
+                size_t candidate_len = strlen(candidate);
+                if (candidate_len > 0 && candidate_len < MAX_PKG_LEN) {
+                    // 检查是否包含点号（有效包名特征）
+                    int has_dot = 0;
+                    int has_valid_chars = 1;
+
+                    for (char* p = candidate; *p; p++) {
+                        if (*p == '.') has_dot = 1;
+                        // 检查是否只包含合法字符（字母、数字、点、下划线）
+                        if (!isalnum((unsigned char)*p) && *p != '.' && *p != '_') {
+                            has_valid_chars = 0;
+                            break;
+                        }
+                    }
+
+                    // 有效包名必须包含点号，长度至少为3，且包含合法字符
+                    if (has_dot && has_valid_chars && candidate_len >= 3) {
+                        memcpy(last_valid, candidate, candidate_len + 1);
+                        snprintf(last_activity, sizeof(last_activity), "%s", activity);
+                    }
+                }
+            }
+        }
+    }
+    cmd_close(cr);
+    metric_observe(M_CMD_WINDOW_DUMP_US, monotonic_us() - t0);
+
+    memcpy(current_activity, last_activity, sizeof(current_activity));
+
+    // 返回最后一个有效包名或 unknown
+    if (last_valid[0]) {
+        strncpy(buffer, last_valid, size);
+        buffer[size - 1] = '\0';
+    } else {
+        strncpy(buffer, "unknown", size);
+        buffer[size - 1] = '\0';
+    }
+}
+
+// 执行 SurfaceFlinger 调用
+void set_surface_flinger(int id) {
+    char cmd[64];
+    // 现在的 ID 直接来自 HWC (dumpsys SurfaceFlinger)，不需要 -1
+    // service call SurfaceFlinger 1035 i32 <HWC_ID>
+    int sf_id = id; 
+    
+    snprintf(cmd, sizeof(cmd), "service call SurfaceFlinger 1035 i32 %d > /dev/null", sf_id);
+    TRACE_BEGIN("set_surface_flinger %d", id);
+    long long t0 = monotonic_us();
+    run_cmd(cmd);
+    metric_observe(M_CMD_SERVICE_CALL_US, monotonic_us() - t0);
+    TRACE_END();
+}
+
+// 同步 Android 系统设置 (User Request)
+void sync_android_settings(int id) {
+    int fps = get_mode_fps(id);
+    
+    if(fps > 0) {
+        // 范围策略只设上下限，让系统在范围内空闲降频；固定模式上下限都锁定
+        int peak = fps, min = fps;
+        if (active_policy.candidates && policy_accepts(&active_policy, id)) {
+            peak = active_policy.max_fps;
+            min = active_policy.min_fps;
+        }
+
+        // 设置缓存: 与上次写入相同时跳过
+        if (peak == settings_synced_fps && min == settings_synced_min_fps) return;
+
+        char cmd[1024];
+        snprintf(cmd, sizeof(cmd), 
+            "settings put secure support_highfps 1;"
+            "settings put system peak_refresh_rate %d;"
+            "settings put system user_refresh_rate %d;"
+            "settings put system min_refresh_rate %d;"
+            "settings put system default_refresh_rate %d;"
+            "settings put global debug.cpurend.vsync true;"
+            "settings put global hwui.disable_vsync false",
+            peak, peak, min, peak);
+        TRACE_BEGIN("sync_android_settings %d-%d", min, peak);
+        long long t0 = monotonic_us();
+        run_cmd(cmd);
+        metric_observe(M_CMD_SETTINGS_US, monotonic_us() - t0);
+        TRACE_END();
+        metric_inc(M_SETTINGS_WRITES, 1);
+        settings_synced_fps = peak;
+        settings_synced_min_fps = min;
+        checkpoint_save(NULL);
+        if (min == peak) log_msg("Synced system settings to %dHz / 已同步系统设置到 %dHz", peak, peak);
+        else log_msg("Synced system settings to %d-%dHz / 已同步系统设置到 %d-%dHz", min, peak, min, peak);
+    }
+}
+
+
+// ==================== 帧数据采样 ====================
+// 前台应用运行时定期读取 dumpsys gfxinfo 的累计帧统计，与上一次的基线求差，
+// 得到这段时间内的交付帧数、卡顿帧数和帧耗时分布。样本同时供给自学习档案
+// 和帧耗时遥测两个消费者，应用或模式切换时先结算上一段再重建基线。
+
+// 帧耗时固定分档上界 (ms)，最后一档为溢出
+#define FT_BUCKETS 13
+const int ft_bucket_ms[FT_BUCKETS] = {6, 8, 10, 12, 14, 17, 20, 25, 33, 50, 100, 200, 0};
+
+typedef struct {
+    long total_frames;
+    long janky_frames;
+    unsigned long hist[FT_BUCKETS];
+} FrameStats;
+
+char sample_pkg[MAX_PKG_LEN] = "";
+FrameStats sample_base;
+int sample_have_base = 0;
+int sample_base_mode = -1;
+long long sample_base_ms = 0;
+long long learn_last_export_ms = 0;
+int learn_dirty = 0;
+
+int ft_bucket_of(int ms) {
+    for (int b=0; b<FT_BUCKETS - 1; b++) {
+        if (ms <= ft_bucket_ms[b]) return b;
+    }
+    return FT_BUCKETS - 1;
+}
+
+// 解析 "HISTOGRAM: 5ms=12 6ms=3 ..." 并折算到固定分档
+void parse_gfx_histogram(const char *p, unsigned long *hist) {
+    while (*p) {
+        while (*p == ' ' || *p == '\t') p++;
+        char *end;
+        long ms = strtol(p, &end, 10);
+        if (end == p || strncmp(end, "ms=", 3) != 0) break;
+        p = end + 3;
+        unsigned long count = strtoul(p, &end, 10);
+        if (end == p) break;
+        p = end;
+        hist[ft_bucket_of((int)ms)] += count;
+    }
+}
+
+// 读取应用自进程启动以来的累计帧统计，成功返回 1
+int read_frame_stats(const char *pkg, FrameStats *out) {
+    char cmd[256];
+    snprintf(cmd, sizeof(cmd), "dumpsys gfxinfo %s", pkg);
+
+    long long t0 = monotonic_us();
+    CmdReader *cr = cmd_open(cmd);
+    if (!cr) return 0;
+
+    char line[4096];
+    int got_total = 0, got_janky = 0, got_hist = 0;
+    memset(out, 0, sizeof(*out));
+
+    // 只取第一段统计 (多进程时为主进程)，但要读完输出以免 dumpsys 收到 SIGPIPE
+    while (cmd_read_line(cr, line, sizeof(line))) {
+        char *p;
+        if (!got_total && (p = strstr(line, "Total frames rendered:")) != NULL) {
+            out->total_frames = atol(p + 22);
+            got_total = 1;
+        } else if (!got_janky && (p = strstr(line, "Janky frames:")) != NULL) {
+            out->janky_frames = atol(p + 13);
+            got_janky = 1;
+        } else if (!got_hist && (p = strstr(line, "HISTOGRAM:")) != NULL) {
+            parse_gfx_histogram(p + 10, out->hist);
+            got_hist = 1;
+        }
+    }
+    cmd_close(cr);
+    metric_observe(M_CMD_GFXINFO_US, monotonic_us() - t0);
+    return got_total;
+}
+
+LearnedProfile* learn_find(const char *pkg, int create) {
+    for (int i=0; i<learned_count; i++) {
+        if (strcmp(learned[i].package, pkg) == 0) return &learned[i];
+    }
+    if (!create || learned_count >= MAX_APPS) return NULL;
+
+    LearnedProfile *lp = &learned[learned_count++];
+    memset(lp, 0, sizeof(*lp));
+    snprintf(lp->package, sizeof(lp->package), "%s", pkg);
+    return lp;
+}
+
+void learn_apply_sample(LearnedProfile *lp, int fps, int mode_fps, int jank_pct) {
+    int bucket = (fps + LEARN_BUCKET_HZ / 2) / LEARN_BUCKET_HZ;
+    if (bucket < 0) bucket = 0;
+    if (bucket >= LEARN_FPS_BUCKETS) bucket = LEARN_FPS_BUCKETS - 1;
+
+    lp->hist[bucket]++;
+    lp->samples++;
+    if (jank_pct > LEARN_MAX_JANK_PCT) lp->jank_samples++;
+
+    // 交付帧率接近模式上限说明被模式卡住，真实需求未知
+    if (mode_fps > 0) {
+        if (fps * 100 >= mode_fps * 95) {
+            if (mode_fps > lp->saturated_fps) lp->saturated_fps = mode_fps;
+        } else {
+            if (mode_fps > lp->unsaturated_fps) lp->unsaturated_fps = mode_fps;
+        }
+    }
+}
+
+// 计算能承载该应用实际输出的最低模式，样本不足返回 -1
+int learn_suggest_mode(const LearnedProfile *lp) {
+    if (lp->samples < LEARN_MIN_SAMPLES) return -1;
+
+    // P95 交付帧率
+    unsigned int need = (lp->samples * 95 + 99) / 100;
+    unsigned int acc = 0;
+    int need_fps = 0;
+    for (int b=0; b<LEARN_FPS_BUCKETS; b++) {
+        acc += lp->hist[b];
+        if (acc >= need) {
+            need_fps = b * LEARN_BUCKET_HZ;
+            break;
+        }
+    }
+
+    // 仅在从未在更高模式下观察到余量时，才认为顶满的模式不够用
+    if (lp->saturated_fps > 0 && lp->saturated_fps >= lp->unsaturated_fps &&
+        need_fps <= lp->saturated_fps) {
+        need_fps = lp->saturated_fps + 1;
+    }
+
+    int width = get_mode_width(default_mode_id);
+    if (width == 0) width = get_mode_width(current_mode_id);
+
+    int sorted_ids[MAX_MODES];
+    int count = 0;
+    get_sorted_fps_modes(width, sorted_ids, &count);
+    if (count == 0) return -1;
+
+    for (int i=0; i<count; i++) {
+        if (get_mode_fps(sorted_ids[i]) >= need_fps) return sorted_ids[i];
+    }
+    return sorted_ids[count - 1];
+}
+
+// 自动模式下应用学习结果，卡顿过多的档案不自动应用
+int learn_auto_mode(const char *pkg) {
+    LearnedProfile *lp = learn_find(pkg, 0);
+    if (!lp) return -1;
+    if (lp->jank_samples * 100 > lp->samples * LEARN_MAX_JANK_PCT) return -1;
+    return learn_suggest_mode(lp);
+}
+
+void learn_load(const char *base_path) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/learned.log", base_path);
+
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) return;
+
+    char line[512];
+    learned_count = 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        char pkg[MAX_PKG_LEN];
+        int n = 0;
+        if (line[0] == 'S') {
+            // S <pkg> <fps> <mode_fps> <jank_pct>
+            int fps, mode_fps, jank;
+            if (sscanf(line, "S %127s %d %d %d", pkg, &fps, &mode_fps, &jank) == 4) {
+                LearnedProfile *lp = learn_find(pkg, 1);
+                if (lp) learn_apply_sample(lp, fps, mode_fps, jank);
+            }
+        } else if (line[0] == 'H') {
+            // H <pkg> <samples> <jank_samples> <saturated> <unsaturated> <hist...>
+            LearnedProfile tmp;
+            memset(&tmp, 0, sizeof(tmp));
+            if (sscanf(line, "H %127s %u %u %d %d%n", pkg, &tmp.samples, &tmp.jank_samples,
+                       &tmp.saturated_fps, &tmp.unsaturated_fps, &n) != 5) continue;
+            char *p = line + n;
+            for (int b=0; b<LEARN_FPS_BUCKETS; b++) {
+                tmp.hist[b] = (unsigned int)strtoul(p, &p, 10);
+            }
+            LearnedProfile *lp = learn_find(pkg, 1);
+            if (lp) {
+                strncpy(tmp.package, lp->package, MAX_PKG_LEN);
+                *lp = tmp;
+            }
+        }
+    }
+    fclose(fp);
+    log_msg("Learned profiles loaded / 已加载学习档案: %d", learned_count);
+}
+
+// 日志过大时改写为每包一行的聚合记录
+void learn_compact(const char *base_path) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/learned.log", base_path);
+
+    OutBuf ob = ob_begin();
+    for (int i=0; i<learned_count; i++) {
+        LearnedProfile *lp = &learned[i];
+        ob_printf(&ob, "H %s %u %u %d %d", lp->package, lp->samples, lp->jank_samples,
+                lp->saturated_fps, lp->unsaturated_fps);
+        for (int b=0; b<LEARN_FPS_BUCKETS; b++) ob_printf(&ob, " %u", lp->hist[b]);
+        ob_printf(&ob, "\n");
+    }
+    ob_commit(&ob, path);
+}
+
+void learn_export_json(const char *base_path) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/learned.json", base_path);
+
+    OutBuf ob = ob_begin();
+
+    const char *mode_name = learn_mode == LEARN_AUTO ? "auto" :
+                            (learn_mode == LEARN_OFF ? "off" : "suggest");
+    ob_printf(&ob, "{\"mode\":\"%s\",\"bucket_hz\":%d,\"apps\":[", mode_name, LEARN_BUCKET_HZ);
+    for (int i=0; i<learned_count; i++) {
+        LearnedProfile *lp = &learned[i];
+        int sid = learn_suggest_mode(lp);
+        ob_printf(&ob, "%s{\"package\":\"%s\",\"samples\":%u,\"jank_samples\":%u,"
+                    "\"saturated_fps\":%d,\"suggested_mode\":%d,\"suggested_fps\":%d,\"hist\":[",
+                i ? "," : "", lp->package, lp->samples, lp->jank_samples,
+                lp->saturated_fps, sid, sid == -1 ? 0 : get_mode_fps(sid));
+        for (int b=0; b<LEARN_FPS_BUCKETS; b++) ob_printf(&ob, "%s%u", b ? "," : "", lp->hist[b]);
+        ob_printf(&ob, "]}");
+    }
+    ob_printf(&ob, "]}\n");
+    ob_commit(&ob, path);
+}
+
+void learn_record(const char *base_path, const char *pkg, int fps, int mode_fps, int jank_pct) {
+    LearnedProfile *lp = learn_find(pkg, 1);
+    if (!lp) return;
+    learn_apply_sample(lp, fps, mode_fps, jank_pct);
+    learn_dirty = 1;
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/learned.log", base_path);
+    char line[MAX_PKG_LEN + 64];
+    int len = snprintf(line, sizeof(line), "S %s %d %d %d\n", pkg, fps, mode_fps, jank_pct);
+    long size = append_file(path, line, len);
+    if (size > LEARN_LOG_MAX_BYTES) learn_compact(base_path);
+}
+
+// ==================== 帧耗时遥测 ====================
+// 按 (包名, 模式) 累计固定分档的帧耗时直方图，定期写入 telemetry.bin。
+// 文件格式: "RDFT" + 版本 + 分档数，随后每条记录为
+// u8 包名长度 + 包名 + i32 模式ID + u32 帧数 + u32 卡顿帧数 + u32 分档计数[FT_BUCKETS]
+
+#define MAX_TELEMETRY 256
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_FLUSH_INTERVAL_MS 300000
+
+typedef struct {
+    char package[MAX_PKG_LEN];
+    int mode_id;
+    unsigned int frames;
+    unsigned int janky;
+    unsigned int hist[FT_BUCKETS];
+} FrameTimeEntry;
+
+FrameTimeEntry telemetry[MAX_TELEMETRY];
+int telemetry_count = 0;
+int telemetry_dirty = 0;
+long long telemetry_last_flush_ms = 0;
+
+FrameTimeEntry* telemetry_find(const char *pkg, int mode_id, int create) {
+    for (int i=0; i<telemetry_count; i++) {
+        if (telemetry[i].mode_id == mode_id && strcmp(telemetry[i].package, pkg) == 0) {
+            return &telemetry[i];
+        }
+    }
+    if (!create || telemetry_count >= MAX_TELEMETRY) return NULL;
+
+    FrameTimeEntry *e = &telemetry[telemetry_count++];
+    memset(e, 0, sizeof(*e));
+    strncpy(e->package, pkg, MAX_PKG_LEN - 1);
+    e->mode_id = mode_id;
+    return e;
+}
+
+void telemetry_record(const char *pkg, int mode_id, long frames, long janky, const unsigned long *hist) {
+    FrameTimeEntry *e = telemetry_find(pkg, mode_id, 1);
+    if (!e) return;
+    e->frames += (unsigned int)frames;
+    e->janky += (unsigned int)janky;
+    for (int b=0; b<FT_BUCKETS; b++) e->hist[b] += (unsigned int)hist[b];
+    telemetry_dirty = 1;
+}
+
+// 返回第 pct 百分位所在分档的上界 (ms)，落在溢出档返回 -1，无数据返回 0
+int telemetry_percentile(const FrameTimeEntry *e, int pct) {
+    unsigned int total = 0;
+    for (int b=0; b<FT_BUCKETS; b++) total += e->hist[b];
+    if (total == 0) return 0;
+
+    unsigned int need = (unsigned int)(((unsigned long long)total * pct + 99) / 100);
+    unsigned int acc = 0;
+    for (int b=0; b<FT_BUCKETS; b++) {
+        acc += e->hist[b];
+        if (acc >= need) return b == FT_BUCKETS - 1 ? -1 : ft_bucket_ms[b];
+    }
+    return -1;
+}
+
+int telemetry_load(const char *base_path) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/telemetry.bin", base_path);
+
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) return 0;
+
+    unsigned char hdr[6];
+    if (fread(hdr, 1, sizeof(hdr), fp) != sizeof(hdr) || memcmp(hdr, "RDFT", 4) != 0 ||
+        hdr[4] != TELEMETRY_VERSION || hdr[5] != FT_BUCKETS) {
+        // 版本或分档不一致时丢弃旧数据
+        fclose(fp);
+        return 0;
+    }
+
+    telemetry_count = 0;
+    unsigned char len;
+    while (fread(&len, 1, 1, fp) == 1 && telemetry_count < MAX_TELEMETRY) {
+        FrameTimeEntry *e = &telemetry[telemetry_count];
+        memset(e, 0, sizeof(*e));
+        if (len >= MAX_PKG_LEN || fread(e->package, 1, len, fp) != len) break;
+        if (fread(&e->mode_id, sizeof(int), 1, fp) != 1 ||
+            fread(&e->frames, sizeof(unsigned int), 1, fp) != 1 ||
+            fread(&e->janky, sizeof(unsigned int), 1, fp) != 1 ||
+            fread(e->hist, sizeof(unsigned int), FT_BUCKETS, fp) != FT_BUCKETS) break;
+        telemetry_count++;
+    }
+    fclose(fp);
+    return telemetry_count;
+}
+
+void telemetry_flush(const char *base_path) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/telemetry.bin", base_path);
+
+    OutBuf ob = ob_begin();
+
+    unsigned char hdr[6] = {'R', 'D', 'F', 'T', TELEMETRY_VERSION, FT_BUCKETS};
+    ob_write(&ob, hdr, sizeof(hdr));
+    for (int i=0; i<telemetry_count; i++) {
+        FrameTimeEntry *e = &telemetry[i];
+        unsigned char len = (unsigned char)strlen(e->package);
+        ob_write(&ob, &len, 1);
+        ob_write(&ob, e->package, len);
+        ob_write(&ob, &e->mode_id, sizeof(int));
+        ob_write(&ob, &e->frames, sizeof(unsigned int));
+        ob_write(&ob, &e->janky, sizeof(unsigned int));
+        ob_write(&ob, e->hist, sizeof(unsigned int) * FT_BUCKETS);
+    }
+    if (!ob_commit(&ob, path)) return;
+    telemetry_dirty = 0;
+}
+
+// rate_daemon --telemetry <module_path> [package]: 打印各模式的帧耗时百分位
+int telemetry_report(const char *base_path, const char *filter_pkg) {
+    if (telemetry_load(base_path) == 0) {
+        printf("No telemetry data / 暂无遥测数据\n");
+        return 1;
+    }
+
+    const int pcts[4] = {50, 90, 95, 99};
+    printf("%-40s %5s %10s %7s %6s %6s %6s %6s\n",
+           "package", "mode", "frames", "jank%", "p50", "p90", "p95", "p99");
+    for (int i=0; i<telemetry_count; i++) {
+        FrameTimeEntry *e = &telemetry[i];
+        if (filter_pkg && strcmp(e->package, filter_pkg) != 0) continue;
+
+        printf("%-40s %5d %10u %6.2f%%", e->package, e->mode_id, e->frames,
+               e->frames ? e->janky * 100.0 / e->frames : 0.0);
+        for (int k=0; k<4; k++) {
+            int ms = telemetry_percentile(e, pcts[k]);
+            if (ms < 0) printf(" %6s", ">200");
+            else printf(" %4dms", ms);
+        }
+        printf("\n");
+    }
+    return 0;
+}
+
+// 以当前基线结算一段样本并分发给各消费者
+void frame_sample_take(const char *base_path, long long now) {
+    FrameStats cur;
+    if (!read_frame_stats(sample_pkg, &cur)) {
+        sample_have_base = 0;
+        sample_base_ms = now;
+        return;
+    }
+
+    // 计数回退说明进程重启，丢弃本次样本
+    if (sample_have_base && now > sample_base_ms &&
+        cur.total_frames >= sample_base.total_frames &&
+        cur.janky_frames >= sample_base.janky_frames) {
+        long frames = cur.total_frames - sample_base.total_frames;
+        long janky = cur.janky_frames - sample_base.janky_frames;
+
+        if (learn_mode != LEARN_OFF) {
+            int fps = (int)(frames * 1000 / (now - sample_base_ms));
+            int jank_pct = frames > 0 ? (int)(janky * 100 / frames) : 0;
+            learn_record(base_path, sample_pkg, fps, get_mode_fps(sample_base_mode), jank_pct);
+        }
+
+        if (telemetry_enabled && frames > 0) {
+            unsigned long delta[FT_BUCKETS];
+            for (int b=0; b<FT_BUCKETS; b++) {
+                delta[b] = cur.hist[b] >= sample_base.hist[b] ? cur.hist[b] - sample_base.hist[b] : 0;
+            }
+            telemetry_record(sample_pkg, sample_base_mode, frames, janky, delta);
+        }
+    }
+
+    sample_base = cur;
+    sample_have_base = 1;
+    sample_base_ms = now;
+}
+
+// 每轮主循环调用: 应用或模式切换时结算上一段并重建基线，之后每 learn_interval 秒采样一次
+void frame_sample_tick(const char *base_path, const char *pkg) {
+    if (learn_mode == LEARN_OFF && !telemetry_enabled) return;
+    if (strcmp(pkg, "unknown") == 0) return;
+
+    long long now = monotonic_ms();
+
+    if (strcmp(pkg, sample_pkg) != 0 || sample_base_mode != current_mode_id) {
+        if (sample_have_base && sample_pkg[0] && now - sample_base_ms >= 1000) {
+            frame_sample_take(base_path, now);
+        }
+        strncpy(sample_pkg, pkg, MAX_PKG_LEN - 1);
+        sample_pkg[MAX_PKG_LEN - 1] = '\0';
+        sample_have_base = read_frame_stats(pkg, &sample_base);
+        sample_base_mode = current_mode_id;
+        sample_base_ms = now;
+    } else if (now - sample_base_ms >= (long long)learn_interval * 1000) {
+        frame_sample_take(base_path, now);
+    }
+
+    if (learn_dirty && now - learn_last_export_ms >= LEARN_EXPORT_INTERVAL_MS) {
+        learn_export_json(base_path);
+        learn_last_export_ms = now;
+        learn_dirty = 0;
+    }
+
+    if (telemetry_dirty && now - telemetry_last_flush_ms >= TELEMETRY_FLUSH_INTERVAL_MS) {
+        telemetry_flush(base_path);
+        telemetry_last_flush_ms = now;
+    }
+}
+
+// ==================== 模式驻留与能耗统计 ====================
+// 每轮主循环把上一段时间计入 (日期, 包名, 模式)，同时读取 power_supply 的
+// 瞬时电流积分出耗电量 (充电时不计)。亮屏按包名统计，熄屏统一记到
+// RESIDENCY_SCREEN_OFF 下。数据每 5 分钟写入 residency.bin，只保留最近
+// RESIDENCY_DAYS 天。
+// 文件格式: "RDRS" + 版本，随后每条记录为
+// u16 日期 + u8 包名长度 + 包名 + i32 模式ID + u32 毫秒 + u32 耗电(uAh)
+
+#define MAX_RESIDENCY 512
+#define RESIDENCY_VERSION 1
+#define RESIDENCY_DAYS 7
+#define RESIDENCY_FLUSH_INTERVAL_MS 300000
+#define RESIDENCY_SCREEN_OFF "<screen_off>"
+
+typedef struct {
+    unsigned short day;
+    char package[MAX_PKG_LEN];
+    int mode_id;
+    unsigned int time_ms;
+    unsigned int charge_uah;
+} ResidencyEntry;
+
+ResidencyEntry residency[MAX_RESIDENCY];
+int residency_count = 0;
+int residency_dirty = 0;
+char residency_pkg[MAX_PKG_LEN] = "";
+long long residency_last_ms = 0;
+long long residency_last_flush_ms = 0;
+char backlight_path[512] = "";
+
+// 查找第一个可读的背光节点，找不到时视为常亮
+void residency_init() {
+    DIR *dir = opendir("/sys/class/backlight");
+    if (dir == NULL) return;
+
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        if (ent->d_name[0] == '.') continue;
+        char path[512];
+        long v;
+        snprintf(path, sizeof(path), "/sys/class/backlight/%s/brightness", ent->d_name);
+        if (read_sysfs_long(path, &v)) {
+            snprintf(backlight_path, sizeof(backlight_path), "%s", path);
+            break;
+        }
+    }
+    closedir(dir);
+    if (backlight_path[0]) log_msg("Backlight / 背光节点: %s", backlight_path);
+}
+
+int screen_is_on() {
+    long v;
+    if (!backlight_path[0] || !read_sysfs_long(backlight_path, &v)) return 1;
+    return v > 0;
+}
+
+// 放电电流 (mA)，充电或无法读取时返回 -1
+long battery_discharge_ma() {
+    char status[32] = "";
+    if (read_small_file(BATTERY_DIR "/status", status, sizeof(status)) < 0) status[0] = '\0';
+    if (strncmp(status, "Charging", 8) == 0 || strncmp(status, "Full", 4) == 0) return -1;
+
+    long cur;
+    if (!read_sysfs_long(BATTERY_DIR "/current_now", &cur)) return -1;
+    if (cur < 0) cur = -cur;
+    // 多数内核以 uA 上报，部分 OPLUS 内核以 mA 上报
+    return cur >= 20000 ? cur / 1000 : cur;
+}
+
+unsigned short local_day() {
+    time_t now = time(NULL);
+    struct tm t;
+    localtime_r(&now, &t);
+    return (unsigned short)((now + t.tm_gmtoff) / 86400);
+}
+
+ResidencyEntry* residency_find(unsigned short day, const char *pkg, int mode_id) {
+    for (int i=0; i<residency_count; i++) {
+        ResidencyEntry *e = &residency[i];
+        if (e->day == day && e->mode_id == mode_id && strcmp(e->package, pkg) == 0) return e;
+    }
+
+    if (residency_count >= MAX_RESIDENCY) {
+        // 表满时淘汰最旧的一条
+        int oldest = 0;
+        for (int i=1; i<residency_count; i++) {
+            if (residency[i].day < residency[oldest].day) oldest = i;
+        }
+        residency[oldest] = residency[--residency_count];
+    }
+
+    ResidencyEntry *e = &residency[residency_count++];
+    memset(e, 0, sizeof(*e));
+    e->day = day;
+    strncpy(e->package, pkg, MAX_PKG_LEN - 1);
+    e->mode_id = mode_id;
+    return e;
+}
+
+// 丢弃超出保留天数的记录
+void residency_expire(unsigned short today) {
+    int n = 0;
+    for (int i=0; i<residency_count; i++) {
+        if (today - residency[i].day < RESIDENCY_DAYS) residency[n++] = residency[i];
+    }
+    residency_count = n;
+}
+
+void residency_load(const char *base_path) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/residency.bin", base_path);
+
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) return;
+
+    unsigned char hdr[5];
+    if (fread(hdr, 1, sizeof(hdr), fp) != sizeof(hdr) || memcmp(hdr, "RDRS", 4) != 0 ||
+        hdr[4] != RESIDENCY_VERSION) {
+        fclose(fp);
+        return;
+    }
+
+    residency_count = 0;
+    unsigned short day;
+    while (fread(&day, sizeof(day), 1, fp) == 1 && residency_count < MAX_RESIDENCY) {
+        ResidencyEntry *e = &residency[residency_count];
+        unsigned char len;
+        memset(e, 0, sizeof(*e));
+        e->day = day;
+        if (fread(&len, 1, 1, fp) != 1 || len >= MAX_PKG_LEN ||
+            fread(e->package, 1, len, fp) != len ||
+            fread(&e->mode_id, sizeof(int), 1, fp) != 1 ||
+            fread(&e->time_ms, sizeof(unsigned int), 1, fp) != 1 ||
+            fread(&e->charge_uah, sizeof(unsigned int), 1, fp) != 1) break;
+        residency_count++;
+    }
+    fclose(fp);
+    residency_expire(local_day());
+}
+
+void residency_flush(const char *base_path) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/residency.bin", base_path);
+
+    residency_expire(local_day());
+
+    OutBuf ob = ob_begin();
+
+    unsigned char hdr[5] = {'R', 'D', 'R', 'S', RESIDENCY_VERSION};
+    ob_write(&ob, hdr, sizeof(hdr));
+    for (int i=0; i<residency_count; i++) {
+        ResidencyEntry *e = &residency[i];
+        unsigned char len = (unsigned char)strlen(e->package);
+        ob_write(&ob, &e->day, sizeof(e->day));
+        ob_write(&ob, &len, 1);
+        ob_write(&ob, e->package, len);
+        ob_write(&ob, &e->mode_id, sizeof(int));
+        ob_write(&ob, &e->time_ms, sizeof(unsigned int));
+        ob_write(&ob, &e->charge_uah, sizeof(unsigned int));
+    }
+    if (!ob_commit(&ob, path)) return;
+    residency_dirty = 0;
+}
+
+// 每轮主循环在决定切换前调用: 把上一段时间计入上一个应用和当前模式
+void residency_tick(const char *base_path, const char *pkg) {
+    if (!residency_enabled) return;
+
+    long long now = monotonic_ms();
+    long long elapsed = now - residency_last_ms;
+
+    // 间隔异常 (首次调用或长时间休眠) 时只重置起点
+    if (residency_last_ms > 0 && elapsed > 0 && elapsed < 60000 &&
+        current_mode_id != -1 && residency_pkg[0]) {
+        int on = screen_is_on();
+        ResidencyEntry *e = residency_find(local_day(), on ? residency_pkg : RESIDENCY_SCREEN_OFF,
+                                           current_mode_id);
+        e->time_ms += (unsigned int)elapsed;
+
+        long ma = battery_discharge_ma();
+        if (ma > 0) e->charge_uah += (unsigned int)(ma * elapsed / 3600);
+        residency_dirty = 1;
+    }
+
+    residency_last_ms = now;
+    strncpy(residency_pkg, pkg, MAX_PKG_LEN - 1);
+    residency_pkg[MAX_PKG_LEN - 1] = '\0';
+
+    if (residency_dirty && now - residency_last_flush_ms >= RESIDENCY_FLUSH_INTERVAL_MS) {
+        residency_flush(base_path);
+        residency_last_flush_ms = now;
+    }
+}
+
+// rate_daemon --residency <module_path> [package]: 汇总最近几天各应用各模式的驻留与耗电
+int residency_report(const char *base_path, const char *filter_pkg) {
+    residency_load(base_path);
+    if (residency_count == 0) {
+        printf("No residency data / 暂无驻留数据\n");
+        return 1;
+    }
+
+    // 跨天合并到第 0 天
+    ResidencyEntry sum[MAX_RESIDENCY];
+    int n = 0;
+    for (int i=0; i<residency_count; i++) {
+        ResidencyEntry *e = &residency[i];
+        if (filter_pkg && strcmp(e->package, filter_pkg) != 0) continue;
+        int k;
+        for (k=0; k<n; k++) {
+            if (sum[k].mode_id == e->mode_id && strcmp(sum[k].package, e->package) == 0) break;
+        }
+        if (k == n) {
+            sum[n] = *e;
+            sum[n].day = 0;
+            n++;
+        } else {
+            sum[k].time_ms += e->time_ms;
+            sum[k].charge_uah += e->charge_uah;
         }
     }
 
-    log_msg("Loaded %d display modes (HWC) / 已加载 %d 个显示模式 (HWC):", mode_count);
-    for(int i=0; i<mode_count; i++) {
-        log_msg("ID: %d, FPS: %d, Res: %dx%d", modes[i].id, modes[i].fps, modes[i].width, modes[i].height);
+    printf("%-40s %5s %10s %10s %8s\n", "package", "mode", "minutes", "mAh", "avg_mA");
+    for (int k=0; k<n; k++) {
+        double hours = sum[k].time_ms / 3600000.0;
+        printf("%-40s %5d %10.1f %10.2f %8.1f\n", sum[k].package, sum[k].mode_id,
+               sum[k].time_ms / 60000.0, sum[k].charge_uah / 1000.0,
+               hours > 0 ? sum[k].charge_uah / 1000.0 / hours : 0.0);
     }
+    return 0;
 }
 
-// 读取配置文件
-void load_config(const char* base_path) {
-    char config_path[512];
-    snprintf(config_path, sizeof(config_path), "%s/config/mode.txt", base_path);
-    
-    FILE *fp = fopen(config_path, "r");
-    if (fp == NULL) return;
+// ==================== 启动就绪等待 ====================
+// service.sh 在开机早期就启动守护进程。先阻塞等待 SurfaceFlinger 就绪并读到
+// 显示模式，立即通过 service call 应用默认模式；settings 依赖 system_server，
+// 等 sys.boot_completed 后再同步。等待使用属性服务的 futex 通知而非 shell 轮询。
 
-    char line[256];
-    app_config_count = 0;
-    int line_num = 0;
+#define BOOT_SF_TIMEOUT_MS 120000
 
-    while (fgets(line, sizeof(line), fp) != NULL) {
-        char *trimmed = trim(line);
-        if (strlen(trimmed) == 0 || trimmed[0] == '#') continue;
+long long boottime_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
 
-        line_num++;
-        if (line_num == 1) {
-            // 第一行：全局默认ID
-            default_mode_id = atoi(trimmed);
-        } else {
-            // 后续行：包名 模式ID
-            // 支持 pkg=id 或 pkg id 格式
-            char *eq = strchr(trimmed, '=');
-            if (eq) *eq = ' '; // 将等号替换为空格以便 sscanf 解析
-
-            char pkg[MAX_PKG_LEN];
-            int mid;
-            if (sscanf(trimmed, "%s %d", pkg, &mid) == 2) {
-                if (app_config_count < MAX_APPS) {
-                    strncpy(app_configs[app_config_count].package, pkg, MAX_PKG_LEN);
-                    app_configs[app_config_count].mode_id = mid;
-                    app_config_count++;
-                }
-            }
+#ifdef __ANDROID__
+// 等待属性变为指定值，timeout_ms < 0 表示一直等待；超时返回 0
+int wait_for_property(const char *name, const char *value, int timeout_ms) {
+    long long deadline = timeout_ms < 0 ? -1 : monotonic_ms() + timeout_ms;
+
+    for (;;) {
+        // 先取序号再读值，避免错过两者之间的修改
+        const prop_info *pi = __system_property_find(name);
+        uint32_t serial = pi ? __system_property_serial(pi) : __system_property_area_serial();
+        char buf[PROP_VALUE_MAX] = "";
+        if (pi) __system_property_get(name, buf);
+        if (strcmp(buf, value) == 0) return 1;
+
+        struct timespec ts, *tsp = NULL;
+        if (deadline >= 0) {
+            long long left = deadline - monotonic_ms();
+            if (left <= 0) return 0;
+            ts.tv_sec = left / 1000;
+            ts.tv_nsec = (left % 1000) * 1000000;
+            tsp = &ts;
         }
+        // 属性尚未创建时等待整个属性区的序号变化
+        uint32_t new_serial;
+        __system_property_wait(pi, serial, &new_serial, tsp);
     }
-    fclose(fp);
-    log_msg("Config loaded / 配置已加载. Default: %d, Apps: %d", default_mode_id, app_config_count);
 }
+#else
+// 主机上用 getprop 轮询；没有 getprop (无属性服务) 时视为已就绪，便于基准测试
+int wait_for_property(const char *name, const char *value, int timeout_ms) {
+    long long deadline = timeout_ms < 0 ? -1 : monotonic_ms() + timeout_ms;
+    char cmd[160];
+    snprintf(cmd, sizeof(cmd), "getprop %s 2>/dev/null", name);
 
-// 获取当前系统模式ID
-int get_current_system_mode() {
-    // 匹配 HWC 输出的当前活动配置
-    // HWC 通常不直接标记 "mActiveMode"，我们需要找到 config=... 或类似的
-    // 但 service call 需要的 ID 就是 HWC ID
-    // 简单起见，我们假设 dumpsys SurfaceFlinger 中 activeConfig=ID
-    // 或者直接返回 -1 让 smooth_switch 初始化
-    
-    // 尝试解析 dumpsys SurfaceFlinger | grep "activeConfig"
-    // 示例: activeConfig=0
-    FILE *fp = popen("dumpsys SurfaceFlinger | grep \"activeConfig=\"", "r");
-    if (fp) {
-        char line[64];
-        if (fgets(line, sizeof(line), fp)) {
-            int id;
-            if (sscanf(line, "activeConfig=%d", &id) == 1) {
-                pclose(fp);
-                // 此时获取的是 config ID (即 HWC ID)
-                // 我们的 modes[i].id 也是 HWC ID，所以直接返回
-                return id;
-            }
-        }
-        pclose(fp);
+    for (;;) {
+        CmdReader *cr = cmd_open(cmd);
+        if (cr == NULL) return 1;
+        char line[PROP_VALUE_MAX] = "";
+        cmd_read_line(cr, line, sizeof(line));
+        if (cmd_close(cr) == 127) return 1;
+        if (strcmp(trim(line), value) == 0) return 1;
+
+        if (deadline >= 0 && monotonic_ms() >= deadline) return 0;
+        usleep(250000);
     }
-    
-    // 如果找不到 activeConfig，尝试旧方法或直接返回 -1
-    // 旧方法: dumpsys display | grep mActiveMode (针对 Android Framework 层 ID)
-    // 注意：Framework ID = HWC ID + 1 (通常)
-    // 如果我们现在全面转为 HWC ID，则需要小心
-    
-    return -1;
 }
+#endif
 
-// 平滑切换核心逻辑
-void smooth_switch(int target_id) {
-    if (current_mode_id == -1) {
-        // 首次启动，尝试获取当前系统状态
-        int actual = get_current_system_mode();
-        if (actual != -1) {
-            current_mode_id = actual;
-            log_msg("Initialized current mode from system / 从系统初始化当前模式: %d", current_mode_id);
-        } else {
-            // 获取失败，直接设置并假设成功
-            log_msg("First switch (unknown current) / 首次切换 (当前未知): -> %d", target_id);
-            set_surface_flinger(target_id);
-            sync_android_settings(target_id);
-            current_mode_id = target_id;
-            return;
-        }
+// 等待 SurfaceFlinger 就绪并读到显示模式，超时返回 0
+int wait_for_display_modes() {
+    if (!wait_for_property("init.svc.surfaceflinger", "running", BOOT_SF_TIMEOUT_MS)) {
+        log_msg("SurfaceFlinger not running / SurfaceFlinger 未启动");
     }
 
-    if (current_mode_id == target_id) return;
-    
-    int current_width = get_mode_width(current_mode_id);
-    int target_width = get_mode_width(target_id);
-    
-    // 如果无法获取宽度（无效ID），直接切换
-    if (current_width == 0 || target_width == 0) {
-        log_msg("Invalid width / 无效宽度 (curr=%d, target=%d). Direct switch / 直接切换.", current_width, target_width);
-        set_surface_flinger(target_id);
-        sync_android_settings(target_id);
-        current_mode_id = target_id;
-        return;
+    // 服务进程启动后还要等它向 servicemanager 注册，dumpsys 才有输出
+    long long deadline = monotonic_ms() + BOOT_SF_TIMEOUT_MS;
+    int delay_ms = 100;
+    for (;;) {
+        init_display_modes();
+        if (mode_count > 0) return 1;
+        if (monotonic_ms() >= deadline) return 0;
+        usleep(delay_ms * 1000);
+        if (delay_ms < 2000) delay_ms *= 2;
     }
+}
 
-    if (current_width != target_width) {
-        log_msg("Resolution change / 分辨率变更: %d -> %d. Direct switch / 直接切换.", current_mode_id, target_id);
-        set_surface_flinger(target_id);
-        sync_android_settings(target_id);
-        current_mode_id = target_id;
-        return;
-    }
+// 开机阶段尽早应用模式: 只调用 SurfaceFlinger，settings 留到开机完成后
+void boot_apply_mode(int id) {
+    set_surface_flinger(id);
+    set_current_mode(id);
+    metrics_note_switch(1);
+    metric_set(M_BOOT_FIRST_MODE_MS, boottime_ms());
+    log_msg("Boot: applied mode %d at %lldms / 开机阶段已应用模式", id, boottime_ms());
+}
 
-    log_msg("Smooth Switch / 平滑切换: %d -> %d", current_mode_id, target_id);
+// 阻塞到开机完成，再补上被推迟的 settings 同步
+void boot_wait_completed() {
+    wait_for_property("sys.boot_completed", "1", -1);
+    long long now = boottime_ms();
+    metric_set(M_BOOT_COMPLETED_MS, now);
+    log_msg("Boot completed at %lldms / 开机完成", now);
+    if (current_mode_id != -1) sync_android_settings(current_mode_id);
+}
 
-    // 获取按 FPS 排序的模式列表
-    int sorted_ids[MAX_MODES];
-    int count = 0;
-    get_sorted_fps_modes(target_width, sorted_ids, &count);
-    
-    // 查找当前和目标在排序列表中的位置
-    int idx_curr = -1;
-    int idx_target = -1;
-    
-    for (int i=0; i<count; i++) {
-        if (sorted_ids[i] == current_mode_id) idx_curr = i;
-        if (sorted_ids[i] == target_id) idx_target = i;
-    }
-    
-    if (idx_curr == -1) {
-        log_msg("Current mode %d not in sorted list / 当前模式不在排序列表中. Direct switch / 直接切换.", current_mode_id);
-        set_surface_flinger(target_id);
-        sync_android_settings(target_id);
-        current_mode_id = target_id;
-        return;
-    }
-    
-    if (idx_target == -1) {
-        log_msg("Target mode %d not in sorted list / 目标模式不在排序列表中. Direct switch / 直接切换.", target_id);
-        set_surface_flinger(target_id);
-        sync_android_settings(target_id);
-        current_mode_id = target_id;
-        return;
-    }
-    
-    // 逐步切换
-    if (idx_target > idx_curr) {
-        // 升频: current -> target
-        for (int i = idx_curr + 1; i <= idx_target; i++) {
-            log_msg("Step UP / 升频: %d", sorted_ids[i]); 
-            set_surface_flinger(sorted_ids[i]);
-            usleep(50000); // 50ms
-        }
-    } else {
-        // 降频: current -> target
-        for (int i = idx_curr - 1; i >= idx_target; i--) {
-            log_msg("Step DOWN / 降频: %d", sorted_ids[i]); 
-            set_surface_flinger(sorted_ids[i]);
-            usleep(50000); // 50ms
+// ==================== 漂移校正 ====================
+// 系统或用户绕过守护进程改了刷新率时，current_mode_id 会过期。这里低频核对
+// SurfaceFlinger 的实际模式，并在可疑事件 (亮屏、设备休眠后、面板实测帧率
+// 明显高于当前模式) 后立即核对。发现漂移时同步内部状态并计数；短时间内反复
+// 漂移说明在与系统策略拉锯，此时按指数退避暂停重新应用目标模式。
+
+#define DRIFT_FPS_TOLERANCE 5
+#define DRIFT_PINGPONG_WINDOW_MS 120000
+#define DRIFT_BACKOFF_BASE_MS 30000
+#define DRIFT_BACKOFF_MAX_MS 600000
+
+// 面板实测帧率节点 (高通 SDE / 旧 fb 驱动)，读取只需一次 open/read
+const char *fps_probe_candidates[] = {
+    "/sys/class/drm/sde-crtc-0/measured_fps",
+    "/sys/class/graphics/fb0/measured_fps",
+};
+char fps_probe_path[128] = "";
+
+long long reconcile_last_ms = 0;
+int reconcile_pending = 0;
+int reconcile_screen_on = 1;
+long long drift_last_ms = 0;
+int drift_streak = 0;
+long long drift_holdoff_until_ms = 0;
+
+// 读取面板实测帧率 (如 "fps: 119.9 duration:500000 frame_count:60")，失败返回 -1
+int probe_measured_fps() {
+    char buf[128];
+    if (!fps_probe_path[0] || read_small_file(fps_probe_path, buf, sizeof(buf)) <= 0) return -1;
+    char *p = buf;
+    while (*p && !isdigit((unsigned char)*p)) p++;
+    if (!*p) return -1;
+    return (int)(strtod(p, NULL) + 0.5);
+}
+
+void reconcile_init() {
+    for (size_t i=0; i<sizeof(fps_probe_candidates) / sizeof(fps_probe_candidates[0]); i++) {
+        snprintf(fps_probe_path, sizeof(fps_probe_path), "%s", fps_probe_candidates[i]);
+        if (probe_measured_fps() > 0) {
+            log_msg("Measured fps probe / 实测帧率节点: %s", fps_probe_path);
+            return;
         }
     }
-    
-    current_mode_id = target_id;
-    sync_android_settings(target_id);
+    fps_probe_path[0] = '\0';
 }
 
-// 获取前台应用 (使用用户提供的优化逻辑)
-void get_foreground_app(char *buffer, int size) {
-    // 优先尝试 dumpsys window | grep mCurrentFocus
-    FILE* fp = popen("dumpsys window | grep mCurrentFocus", "r");
-    if (!fp) {
-        log_msg("get_foreground_app: popen failed / popen 失败");
-        strncpy(buffer, "unknown", size);
-        return;
+// 应用切换后目标变了，不再视为拉锯
+void drift_reset() {
+    drift_streak = 0;
+    drift_holdoff_until_ms = 0;
+}
+
+int drift_holdoff_active() {
+    return drift_holdoff_until_ms > 0 && monotonic_ms() < drift_holdoff_until_ms;
+}
+
+// 每轮主循环调用，loop_gap_ms 为距上一轮的时间。检测到漂移返回 1
+int reconcile_tick(long long loop_gap_ms) {
+    if (reconcile_interval <= 0 || current_mode_id == -1) return 0;
+
+    int on = screen_is_on();
+    if (on && !reconcile_screen_on) reconcile_pending = 1; // 亮屏时系统常会重置刷新率
+    reconcile_screen_on = on;
+    if (!on) return 0;
+
+    // 间隔远大于轮询周期说明设备休眠过
+    if (loop_gap_ms > poll_interval_ms * 3 + 1000) reconcile_pending = 1;
+
+    // 实测帧率可能因内容静止而低于模式帧率，只有明显偏高才可疑
+    int measured = probe_measured_fps();
+    if (measured > get_mode_fps(current_mode_id) + DRIFT_FPS_TOLERANCE) reconcile_pending = 1;
+
+    long long now = monotonic_ms();
+    if (!reconcile_pending && now - reconcile_last_ms < (long long)reconcile_interval * 1000) return 0;
+    reconcile_last_ms = now;
+    reconcile_pending = 0;
+
+    metric_inc(M_RECONCILE_CHECKS, 1);
+    int actual = get_current_system_mode();
+    if (actual == -1 || actual == current_mode_id || !is_valid_mode(actual)) return 0;
+
+    // 系统在范围策略内自行调整不算漂移
+    if (active_policy.candidates && policy_accepts(&active_policy, actual)) {
+        set_current_mode(actual);
+        return 0;
     }
 
-    char line[1024];
-    char* last_valid = NULL;
+    metric_inc(M_DRIFTS, 1);
+    drift_streak = (drift_last_ms > 0 && now - drift_last_ms < DRIFT_PINGPONG_WINDOW_MS) ? drift_streak + 1 : 1;
+    drift_last_ms = now;
+    log_msg("Mode drift / 模式漂移: expected %d, actual %d (streak %d)", current_mode_id, actual, drift_streak);
 
-    while (fgets(line, sizeof(line), fp)) {
-        // 确保字符串以null结尾
-        line[sizeof(line) - 1] = '\0';
-        
-        char* start = strchr(line, '{');
-        char* end = strrchr(line, '}');  // 使用最后一个 } 作为结束点
+    if (drift_streak >= 2) {
+        int shift = drift_streak - 2 < 5 ? drift_streak - 2 : 5;
+        long long backoff = (long long)DRIFT_BACKOFF_BASE_MS << shift;
+        if (backoff > DRIFT_BACKOFF_MAX_MS) backoff = DRIFT_BACKOFF_MAX_MS;
+        drift_holdoff_until_ms = now + backoff;
+        log_msg("Repeated drift, holding off %llds / 反复漂移，暂停重新应用 %lld 秒", backoff / 1000, backoff / 1000);
+    }
 
-        if (start && end && end > start) {
-            // 提取 {} 之间的内容
-            size_t len = end - start - 1;
-            char inner[256];
-            if (len > 0 && len < sizeof(inner) - 1) {  // 预留null终止符空间
-                strncpy(inner, start + 1, len);
-                inner[len] = '\0';
+    // 外部修改后 settings 的值也不再可信
+    settings_synced_fps = -1;
+    settings_synced_min_fps = -1;
+    set_current_mode(actual);
+    return 1;
+}
 
-                // 提取最后一个空格后的内容
-                char* last_space = strrchr(inner, ' ');
-                char* candidate = last_space ? last_space + 1 : inner;
+// ==================== 控制套接字 ====================
+// 模块目录下的 rate_daemon.sock (Unix 流套接字)，供 WebUI 和 ratectl 查询状态、
+// 下发命令，无需改写配置文件再等 inotify。每个连接一问一答: 客户端发送一行
+// 命令，守护进程回复一行 JSON ({"ok":true,...} 或 {"ok":false,"error":"..."})
+// 后关闭连接。命令:
+//   state                  当前模式、前台应用、生效策略和临时覆盖
+//   modes                  显示模式表
+//   preview <id> <秒>      临时切到某个模式，到时恢复策略
+//   override <id> [秒]     临时覆盖策略 (不写时间则直到 override off)
+//   override off           取消覆盖或预览
+//   reload                 立即重载配置
+//   metrics                指标快照 (同 metrics.json)
 
-                // 处理 PopupWindow: 前缀
-                char* popup_prefix = strstr(candidate, "PopupWindow:");
-                if (popup_prefix) {
-                    candidate = popup_prefix + 12;  // 跳过 "PopupWindow:"
-                }
+#define CONTROL_SOCKET_NAME "rate_daemon.sock"
+#define CONTROL_MAX_REQUEST 256
+#define CONTROL_IO_TIMEOUT_MS 200
+#define CONTROL_PREVIEW_MAX_S 300
 
-                // 处理斜杠后的 activity 名
-                char* slash = strchr(candidate, '/');
-                if (slash) *slash = '\0';
+int control_override_id = -1;          // 临时覆盖的模式，-1 为无
+long long control_override_until_ms = 0; // 到期时间，0 为直到取消
+int control_override_preview = 0;
 
-                // 验证包名格式 - 必须包含点号且长度合理
-                size_t candidate_len = strlen(candidate);
-                if (candidate_len > 0 && candidate_len < MAX_PKG_LEN) {
-                    // 检查是否包含点号（有效包名特征）
-                    int has_dot = 0;
-                    int has_valid_chars = 1;
+// 当前生效的临时覆盖模式，没有或已到期返回 -1
+int control_override_mode() {
+    if (control_override_id != -1 && control_override_until_ms > 0 &&
+        monotonic_ms() >= control_override_until_ms) {
+        log_msg("%s of mode %d ended / 临时模式结束", control_override_preview ? "Preview" : "Override",
+                control_override_id);
+        control_override_id = -1;
+    }
+    return control_override_id;
+}
 
-                    for (char* p = candidate; *p; p++) {
-                        if (*p == '.') has_dot = 1;
-                        // 检查是否只包含合法字符（字母、数字、点、下划线）
-                        if (!isalnum((unsigned char)*p) && *p != '.' && *p != '_') {
-                            has_valid_chars = 0;
-                            break;
-                        }
-                    }
+int control_open(const char *base_path) {
+    // 下面会删除残留的套接字文件，未持有实例锁时可能删掉正在运行的实例的套接字
+    if (lock_fd < 0) {
+        log_msg("Control socket skipped, instance lock not held / 未持有实例锁，不创建控制套接字");
+        return -1;
+    }
 
-                    // 有效包名必须包含点号，长度至少为3，且包含合法字符
-                    if (has_dot && has_valid_chars && candidate_len >= 3) {
-                        // 安全地分配新内存
-                        char* new_valid = strdup(candidate);
-                        if (new_valid) {
-                            // 释放之前的内存
-                            if (last_valid) free(last_valid);
-                            last_valid = new_valid;
-                        }
-                    }
-                }
-            }
-        }
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    int n = snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/%s", base_path, CONTROL_SOCKET_NAME);
+    if (n >= (int)sizeof(addr.sun_path)) {
+        log_msg("Control socket path too long / 控制套接字路径过长");
+        return -1;
     }
-    pclose(fp);
 
-    // 返回最后一个有效包名或 unknown
-    if (last_valid) {
-        strncpy(buffer, last_valid, size);
-        buffer[size - 1] = '\0';
-        free(last_valid);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+
+    // 持有实例锁，残留的套接字文件一定来自已退出的进程
+    unlink(addr.sun_path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 4) != 0) {
+        log_msg("Control socket unavailable / 控制套接字不可用: %s", strerror(errno));
+        close(fd);
+        return -1;
+    }
+    chmod(addr.sun_path, 0660);
+    log_msg("Control socket / 控制套接字: %s", addr.sun_path);
+    return fd;
+}
+
+void ob_json_string(OutBuf *ob, const char *str) {
+    ob_printf(ob, "\"");
+    for (const char *p = str; *p; p++) {
+        if (*p == '"' || *p == '\\') ob_printf(ob, "\\%c", *p);
+        else if ((unsigned char)*p < 0x20) ob_printf(ob, "\\u%04x", *p);
+        else ob_write(ob, p, 1);
+    }
+    ob_printf(ob, "\"");
+}
+
+void control_reply_error(OutBuf *ob, const char *msg) {
+    ob->len = 0;
+    ob->overflow = 0;
+    ob_printf(ob, "{\"ok\":false,\"error\":");
+    ob_json_string(ob, msg);
+    ob_printf(ob, "}");
+}
+
+void control_state(OutBuf *ob) {
+    ob_printf(ob, "{\"ok\":true,\"mode\":%d,\"fps\":%d,\"default_mode\":%d,\"package\":",
+              current_mode_id, get_mode_fps(current_mode_id), default_mode_id);
+    ob_json_string(ob, foreground_pkg);
+    ob_printf(ob, ",\"activity\":");
+    ob_json_string(ob, current_activity);
+    ob_printf(ob, ",\"policy\":{\"mode\":%d,\"min_fps\":%d,\"max_fps\":%d}",
+              active_policy.mode_id, active_policy.min_fps, active_policy.max_fps);
+    int forced = control_override_mode();
+    if (forced != -1) {
+        long long left = control_override_until_ms > 0 ? control_override_until_ms - monotonic_ms() : -1;
+        ob_printf(ob, ",\"override\":{\"mode\":%d,\"preview\":%d,\"remaining_ms\":%lld}",
+                  forced, control_override_preview, left);
     } else {
-        strncpy(buffer, "unknown", size);
-        buffer[size - 1] = '\0';
+        ob_printf(ob, ",\"override\":null");
     }
+    ob_printf(ob, "}");
 }
 
-// 检查模式是否有效
-int is_valid_mode(int id) {
+void control_modes(OutBuf *ob) {
+    ob_printf(ob, "{\"ok\":true,\"current\":%d,\"default\":%d,\"modes\":[", current_mode_id, default_mode_id);
     for (int i=0; i<mode_count; i++) {
-        if (modes[i].id == id) return 1;
+        ob_printf(ob, "%s{\"id\":%d,\"fps\":%d,\"width\":%d,\"height\":%d}", i ? "," : "",
+                  modes[i].id, modes[i].fps, modes[i].width, modes[i].height);
     }
-    return 0;
+    ob_printf(ob, "]}");
 }
 
-// 获取模式的宽度
-int get_mode_width(int id) {
-    for (int i=0; i<mode_count; i++) {
-        if (modes[i].id == id) return modes[i].width;
+// 执行一条命令，回复写入 ob。返回 1 表示状态已变，需要立即执行一轮检查
+int control_dispatch(char *request, OutBuf *ob, const char *base_path) {
+    char *save = NULL;
+    char *cmd = strtok_r(request, " \t", &save);
+    char *arg1 = cmd ? strtok_r(NULL, " \t", &save) : NULL;
+    char *arg2 = arg1 ? strtok_r(NULL, " \t", &save) : NULL;
+
+    if (!cmd) {
+        control_reply_error(ob, "empty request");
+        return 0;
+    }
+    if (strcmp(cmd, "state") == 0) {
+        control_state(ob);
+        return 0;
+    }
+    if (strcmp(cmd, "modes") == 0) {
+        control_modes(ob);
+        return 0;
+    }
+    if (strcmp(cmd, "metrics") == 0) {
+        ob_printf(ob, "{\"ok\":true,\"metrics\":");
+        metrics_format_json(ob);
+        ob_printf(ob, "}");
+        return 0;
+    }
+    if (strcmp(cmd, "reload") == 0) {
+        load_config(base_path);
+        ob->len = 0;
+        ob->overflow = 0;
+        ob_printf(ob, "{\"ok\":true,\"default_mode\":%d,\"rules\":%d}", default_mode_id, app_config_count);
+        return 1;
+    }
+    if (strcmp(cmd, "override") == 0 && arg1 && strcmp(arg1, "off") == 0) {
+        if (control_override_id != -1) log_msg("Override cleared / 已取消临时模式");
+        control_override_id = -1;
+        ob_printf(ob, "{\"ok\":true}");
+        return 1;
+    }
+    if (strcmp(cmd, "preview") == 0 || strcmp(cmd, "override") == 0) {
+        int preview = cmd[0] == 'p';
+        if (!arg1 || (preview && !arg2)) {
+            control_reply_error(ob, preview ? "usage: preview <id> <seconds>" : "usage: override <id>|off [seconds]");
+            return 0;
+        }
+        int id = atoi(arg1);
+        int secs = arg2 ? atoi(arg2) : 0;
+        if (!is_valid_mode(id)) {
+            control_reply_error(ob, "unknown mode");
+            return 0;
+        }
+        if (secs < 0 || (preview && (secs < 1 || secs > CONTROL_PREVIEW_MAX_S))) {
+            control_reply_error(ob, "bad duration");
+            return 0;
+        }
+        control_override_id = id;
+        control_override_preview = preview;
+        control_override_until_ms = secs > 0 ? monotonic_ms() + secs * 1000LL : 0;
+        log_msg("%s mode %d for %ds / 临时切换到模式 %d (%d 秒，0 为直到取消)",
+                preview ? "Preview" : "Override", id, secs, id, secs);
+        ob_printf(ob, "{\"ok\":true,\"mode\":%d,\"seconds\":%d}", id, secs);
+        return 1;
     }
+    control_reply_error(ob, "unknown command");
     return 0;
 }
 
-// 执行 SurfaceFlinger 调用
-void set_surface_flinger(int id) {
-    char cmd[64];
-    // 现在的 ID 直接来自 HWC (dumpsys SurfaceFlinger)，不需要 -1
-    // service call SurfaceFlinger 1035 i32 <HWC_ID>
-    int sf_id = id; 
-    
-    snprintf(cmd, sizeof(cmd), "service call SurfaceFlinger 1035 i32 %d > /dev/null", sf_id);
-    system(cmd);
-}
+// 处理所有待接受的连接，返回 1 表示需要立即执行一轮检查
+int control_handle(int listen_fd, const char *base_path) {
+    int need_tick = 0;
+    int client;
+    while ((client = accept(listen_fd, NULL, NULL)) >= 0) {
+        fcntl(client, F_SETFD, FD_CLOEXEC);
+        struct timeval tv = { 0, CONTROL_IO_TIMEOUT_MS * 1000 };
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
 
-// 同步 Android 系统设置 (User Request)
-void sync_android_settings(int id) {
-    int fps = 0;
-    for(int i=0; i<mode_count; i++) {
-        if(modes[i].id == id) {
-            fps = modes[i].fps;
-            break;
+        // 读到换行或对端关闭写端为止
+        char request[CONTROL_MAX_REQUEST];
+        int len = 0;
+        while (len < (int)sizeof(request) - 1) {
+            ssize_t n = read(client, request + len, sizeof(request) - 1 - len);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            len += (int)n;
+            if (memchr(request, '\n', len)) break;
         }
+        request[len] = '\0';
+        char *nl = strchr(request, '\n');
+        if (nl) *nl = '\0';
+
+        TRACE_BEGIN("control %s", request);
+        OutBuf ob = ob_begin();
+        need_tick |= control_dispatch(trim(request), &ob, base_path);
+        if (ob.overflow) control_reply_error(&ob, "response too large");
+        ob_printf(&ob, "\n");
+        write_all(client, ob.data, ob.len);
+        TRACE_END();
+        close(client);
     }
-    
-    if(fps > 0) {
-        char cmd[1024];
-        snprintf(cmd, sizeof(cmd), 
-            "settings put secure support_highfps 1;"
-            "settings put system peak_refresh_rate %d;"
-            "settings put system user_refresh_rate %d;"
-            "settings put system min_refresh_rate %d;"
-            "settings put system default_refresh_rate %d;"
-            "settings put global debug.cpurend.vsync true;"
-            "settings put global hwui.disable_vsync false",
-            fps, fps, fps, fps);
-        system(cmd);
-        log_msg("Synced system settings to %dHz / 已同步系统设置到 %dHz", fps, fps);
-    }
+    return need_tick;
 }
 
-// 获取指定分辨率下按FPS排序的模式列表
-void get_sorted_fps_modes(int width, int *out_ids, int *out_count) {
-    typedef struct {
-        int id;
-        int fps;
-    } ModeInfo;
-    
-    ModeInfo temp_modes[MAX_MODES];
-    int count = 0;
-    
-    // 1. 筛选符合分辨率的模式
-    for (int i=0; i<mode_count; i++) {
-        if (modes[i].width == width) {
-            temp_modes[count].id = modes[i].id;
-            temp_modes[count].fps = modes[i].fps;
-            count++;
-        }
+// ==================== 实时状态页 ====================
+// 每轮检查结束时把状态发布到 status.shm (格式见 rate_shm.h)，WebUI 通过
+// ratectl status 直接读取，打开页面时不必再跑 dumpsys。发布只是改写映射页，
+// 没有系统调用。
+
+RateShmStatus *status_page = NULL;
+RateShmVote status_votes[RATE_SHM_MAX_VOTES]; // 本轮检查收集的投票
+int status_vote_count = 0;
+
+void status_open(const char *base_path) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", base_path, RATE_SHM_FILE);
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return;
+    if (ftruncate(fd, sizeof(RateShmStatus)) != 0) {
+        close(fd);
+        return;
     }
-    
-    // 2. 按 FPS 升序排序
-    for (int i = 0; i < count - 1; i++) {
-        for (int j = 0; j < count - i - 1; j++) {
-            if (temp_modes[j].fps > temp_modes[j+1].fps) {
-                ModeInfo temp = temp_modes[j];
-                temp_modes[j] = temp_modes[j+1];
-                temp_modes[j+1] = temp;
-            }
-        }
+    void *map = mmap(NULL, sizeof(RateShmStatus), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        log_msg("Status page mmap failed / 状态页映射失败: %s", strerror(errno));
+        return;
     }
-    
-    // 3. 输出 ID
-    *out_count = count;
-    for (int i=0; i<count; i++) {
-        out_ids[i] = temp_modes[i].id;
+    status_page = (RateShmStatus *)map;
+
+    // 上一个进程可能停在写入中途，从偶数重新开始
+    status_page->seq = 0;
+    rate_shm_write_begin(status_page);
+    memset((char *)status_page + offsetof(RateShmStatus, pid), 0,
+           sizeof(RateShmStatus) - offsetof(RateShmStatus, pid));
+    status_page->magic = RATE_SHM_MAGIC;
+    status_page->version = RATE_SHM_VERSION;
+    status_page->pid = (int)getpid();
+    status_page->current_mode_id = -1;
+    rate_shm_write_end(status_page);
+}
+
+void status_votes_reset() {
+    status_vote_count = 0;
+}
+
+// 记录一票，后加入的覆盖之前的，最后一票即生效的一票
+void status_vote(int source, const AppConfig *p) {
+    if (status_vote_count >= RATE_SHM_MAX_VOTES) return;
+    for (int i=0; i<status_vote_count; i++) status_votes[i].chosen = 0;
+    RateShmVote *v = &status_votes[status_vote_count++];
+    v->source = source;
+    v->mode_id = p->mode_id;
+    v->min_fps = p->min_fps;
+    v->max_fps = p->max_fps;
+    v->chosen = 1;
+}
+
+void status_publish() {
+    if (status_page == NULL) return;
+    RateShmStatus *s = status_page;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    rate_shm_write_begin(s);
+    s->updated_ms = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    s->current_mode_id = current_mode_id;
+    s->default_mode_id = default_mode_id;
+    s->settings_fps = settings_synced_fps;
+    s->settings_min_fps = settings_synced_min_fps;
+    snprintf(s->package, sizeof(s->package), "%s", foreground_pkg);
+    snprintf(s->activity, sizeof(s->activity), "%s", current_activity);
+
+    s->mode_count = mode_count < RATE_SHM_MAX_MODES ? mode_count : RATE_SHM_MAX_MODES;
+    for (int i=0; i<s->mode_count; i++) {
+        s->modes[i].id = modes[i].id;
+        s->modes[i].fps = modes[i].fps;
+        s->modes[i].width = modes[i].width;
+        s->modes[i].height = modes[i].height;
     }
+    s->vote_count = status_vote_count;
+    memcpy(s->votes, status_votes, sizeof(RateShmVote) * status_vote_count);
+
+    s->loop_iterations = metrics[M_LOOP_ITERATIONS].value;
+    s->switches = metrics[M_SWITCHES].value;
+    s->settings_writes = metrics[M_SETTINGS_WRITES].value;
+    s->config_reloads = metrics[M_CONFIG_RELOADS].value;
+    s->drifts = metrics[M_DRIFTS].value;
+    rate_shm_write_end(s);
 }
 
+// 从检查点恢复运行状态，成功时无需初始切换
+int checkpoint_resume(const Checkpoint *ck, char *last_pkg, int size) {
+    if (!is_valid_mode(ck->current_mode_id)) return 0;
 
+    // 以系统实际模式为准: 守护进程停止期间可能有其他程序改过刷新率
+    int actual = get_current_system_mode();
+    if (actual != -1 && actual != ck->current_mode_id) {
+        log_msg("Checkpoint mode %d differs from system %d, ignored / 检查点模式与系统不一致，已忽略",
+                ck->current_mode_id, actual);
+        return 0;
+    }
+
+    settings_synced_fps = ck->settings_fps;
+    settings_synced_min_fps = ck->settings_min_fps;
+    set_current_mode(ck->current_mode_id);
+    snprintf(last_pkg, size, "%s", ck->last_pkg);
+    log_msg("Resumed from checkpoint / 从检查点恢复: mode %d, app %s (pid %d)",
+            ck->current_mode_id, ck->last_pkg[0] ? ck->last_pkg : "-", ck->pid);
+    return 1;
+}
 
 int main(int argc, char *argv[]) {
     if (argc < 2) {
         printf("Usage: %s <module_path>\n", argv[0]);
+        printf("       %s --telemetry <module_path> [package]\n", argv[0]);
+        printf("       %s --residency <module_path> [package]\n", argv[0]);
         return 1;
     }
+
+    if (strcmp(argv[1], "--residency") == 0) {
+        if (argc < 3) {
+            printf("Usage: %s --residency <module_path> [package]\n", argv[0]);
+            return 1;
+        }
+        return residency_report(argv[2], argc > 3 ? argv[3] : NULL);
+    }
+
+    if (strcmp(argv[1], "--telemetry") == 0) {
+        if (argc < 3) {
+            printf("Usage: %s --telemetry <module_path> [package]\n", argv[0]);
+            return 1;
+        }
+        return telemetry_report(argv[2], argc > 3 ? argv[3] : NULL);
+    }
     
     char *base_path = argv[1];
+    snprintf(log_path, sizeof(log_path), "%s/daemon.log", base_path);
     printf("Rate Daemon started. Path: %s\n", base_path);
+
+    // 同一模块目录只允许一个实例，避免两个守护进程互相切换
+    if (!acquire_instance_lock(base_path)) return 1;
     
-    // 1. 初始化
-    init_display_modes();
-    if (mode_count == 0) {
-        printf("Error: No display modes found.\n");
-        // 如果失败，尝试稍后重试或退出
+    // 1. 初始化 (开机早期启动时阻塞到 SurfaceFlinger 就绪)
+    metrics_start_ms = monotonic_ms();
+    int booting = !wait_for_property("sys.boot_completed", "1", 0);
+    if (booting) log_msg("Started during boot / 开机阶段启动 (%lldms)", boottime_ms());
+    if (!wait_for_display_modes()) {
+        log_msg("Error: No display modes found / 未找到显示模式");
         return 1;
     }
 
     // 2. 初始加载配置
     load_config(base_path);
+    learn_load(base_path);
+    telemetry_load(base_path);
+    residency_load(base_path);
+    residency_init();
+    reconcile_init();
     
-    // 3. 初始设置
-    if (is_valid_mode(default_mode_id)) {
-        smooth_switch(default_mode_id);
-    } else {
-        if (mode_count > 0) {
-            default_mode_id = modes[0].id;
-            smooth_switch(default_mode_id);
-        }
+    // 3. 初始设置 (有有效检查点时沿用上次状态，不做初始切换)
+    if (!is_valid_mode(default_mode_id) && mode_count > 0) {
+        default_mode_id = modes[0].id;
     }
 
     char last_pkg[MAX_PKG_LEN] = "";
+    long long last_tick_ms = 0;
+    Checkpoint restored;
+    if (!checkpoint_open(base_path, &restored) ||
+        !checkpoint_resume(&restored, last_pkg, sizeof(last_pkg))) {
+        if (booting) boot_apply_mode(default_mode_id);
+        else smooth_switch(default_mode_id);
+    }
+    // 前台检测和 settings 都依赖 system_server，开机完成前不进入主循环
+    if (booting) boot_wait_completed();
     
     // 初始化 inotify
-    int inotify_fd = inotify_init();
+    int inotify_fd = inotify_init1(IN_CLOEXEC);
     if (inotify_fd < 0) {
         log_msg("Error initializing inotify / 初始化 inotify 失败: %s", strerror(errno));
         // 降级为纯轮询模式，不退出
@@ -552,21 +2688,36 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    int control_fd = control_open(base_path);
+    status_open(base_path);
+    status_publish();
+
     // 4. 主循环
+    long long next_tick_us = monotonic_us() + poll_interval_ms * 1000LL;
     while (1) {
         // 使用 select 实现 "等待事件 或 超时"
-        if (inotify_fd >= 0) {
+        int max_fd = inotify_fd > control_fd ? inotify_fd : control_fd;
+        int need_tick = 0;
+        if (max_fd >= 0) {
             fd_set fds;
             FD_ZERO(&fds);
-            FD_SET(inotify_fd, &fds);
+            if (inotify_fd >= 0) FD_SET(inotify_fd, &fds);
+            if (control_fd >= 0) FD_SET(control_fd, &fds);
 
+            // 默认 1 秒超时，用于检查前台应用；控制命令唤醒后等待剩余时间
+            long long wait_us = next_tick_us - monotonic_us();
+            if (wait_us < 0) wait_us = 0;
             struct timeval timeout;
-            timeout.tv_sec = 1;  // 1秒超时，用于检查前台应用
-            timeout.tv_usec = 0;
+            timeout.tv_sec = wait_us / 1000000;
+            timeout.tv_usec = wait_us % 1000000;
 
-            int ret = select(inotify_fd + 1, &fds, NULL, NULL, &timeout);
+            TRACE_BEGIN("wait");
+            int ret = select(max_fd + 1, &fds, NULL, NULL, &timeout);
+            // 超时醒来时，超出预定时间的部分即唤醒延迟
+            if (ret == 0) wakeup_observe(monotonic_us() - next_tick_us);
+            TRACE_END();
 
-            if (ret > 0 && FD_ISSET(inotify_fd, &fds)) {
+            if (ret > 0 && inotify_fd >= 0 && FD_ISSET(inotify_fd, &fds)) {
                 // 有文件变化事件
                 char buffer[1024];
                 // 读取事件以清空缓冲区
@@ -579,12 +2730,25 @@ int main(int argc, char *argv[]) {
                     load_config(base_path);
                     // 稍微延时一点点，防止文件写入未完成
                     usleep(10000); 
+                    need_tick = 1;
                 }
             }
-            // 如果 ret == 0 (超时)，则继续执行下方的应用检查
+            if (ret > 0 && control_fd >= 0 && FD_ISSET(control_fd, &fds)) {
+                need_tick |= control_handle(control_fd, base_path);
+            }
+            // 只有查询命令时不提前检查，回到等待
+            if (!need_tick && monotonic_us() < next_tick_us) continue;
         } else {
             // 降级模式：简单的 sleep
-            sleep(1);
+            TRACE_BEGIN("wait");
+            long long wait_t0 = monotonic_us();
+            usleep(poll_interval_ms * 1000);
+            wakeup_observe(monotonic_us() - wait_t0 - poll_interval_ms * 1000LL);
+            TRACE_END();
+        }
+        next_tick_us = monotonic_us() + poll_interval_ms * 1000LL;
+
+        if (inotify_fd < 0) {
             // 只有在轮询模式下才需要定时检查配置
             static time_t last_config_check = 0;
             time_t now = time(NULL);
@@ -594,36 +2758,98 @@ int main(int argc, char *argv[]) {
             }
         }
 
+        TRACE_BEGIN("tick");
+
         // 获取前台应用
         char current_pkg[MAX_PKG_LEN] = "";
+        TRACE_BEGIN("fg_detect");
+        long long fg_t0 = monotonic_us();
         get_foreground_app(current_pkg, sizeof(current_pkg));
+        metric_observe(M_FG_DETECT_US, monotonic_us() - fg_t0);
+        TRACE_END();
 
         if (strlen(current_pkg) > 0) {
             // 记录应用切换
             if (strcmp(current_pkg, last_pkg) != 0) {
                  log_msg("Detected App Change / 检测到应用切换: %s", current_pkg);
                  strncpy(last_pkg, current_pkg, MAX_PKG_LEN);
+                 checkpoint_save(last_pkg);
+                 drift_reset();
             }
+            snprintf(foreground_pkg, sizeof(foreground_pkg), "%s", current_pkg);
+
+            // 切换前先结算上一段驻留时间
+            residency_tick(base_path, current_pkg);
+
+            // 核对系统实际模式，外部修改过则先同步内部状态
+            TRACE_BEGIN("reconcile");
+            long long tick_ms = monotonic_ms();
+            reconcile_tick(last_tick_ms > 0 ? tick_ms - last_tick_ms : 0);
+            last_tick_ms = tick_ms;
+            TRACE_END();
 
             // 总是检查是否需要切换，因为可能配置变了但应用没变
-            int target_id = default_mode_id;
-            for (int i=0; i<app_config_count; i++) {
-                if (strcmp(app_configs[i].package, current_pkg) == 0) {
-                    target_id = app_configs[i].mode_id;
-                    break;
+            TRACE_BEGIN("config_lookup");
+            AppConfig policy;
+            policy_pin(&policy, default_mode_id);
+            status_votes_reset();
+            status_vote(RATE_VOTE_DEFAULT, &policy);
+            RuleContext rule_ctx;
+            rule_context_read(&rule_ctx);
+            int rule = rules_match(current_pkg, current_activity, &rule_ctx);
+            int configured = rule != -1;
+            if (configured) {
+                policy = app_configs[rule];
+                status_vote(RATE_VOTE_RULE, &policy);
+            }
+
+            // 未手动配置的应用使用学习结果
+            if (!configured && learn_mode == LEARN_AUTO) {
+                int learned_id = learn_auto_mode(current_pkg);
+                if (learned_id != -1) {
+                    policy_pin(&policy, learned_id);
+                    status_vote(RATE_VOTE_LEARNED, &policy);
                 }
             }
+            // 控制套接字下发的预览/临时覆盖优先
+            int forced = control_override_mode();
+            if (forced != -1) {
+                policy_pin(&policy, forced);
+                status_vote(control_override_preview ? RATE_VOTE_PREVIEW : RATE_VOTE_OVERRIDE, &policy);
+            }
+            active_policy = policy;
+            int holdoff = forced == -1 && drift_holdoff_active();
+            if (holdoff) {
+                AppConfig keep;
+                policy_pin(&keep, current_mode_id);
+                status_vote(RATE_VOTE_HOLDOFF, &keep);
+            }
+            TRACE_END();
             
-                if (is_valid_mode(target_id) && target_id != current_mode_id) {
-                     smooth_switch(target_id);
+            if (is_valid_mode(policy.mode_id) && !holdoff) {
+                if (!policy_accepts(&policy, current_mode_id)) {
+                    smooth_switch(policy.mode_id);
+                } else if (policy.candidates) {
+                    // 已在范围内，不切换，只按需更新 settings 上下限
+                    sync_android_settings(current_mode_id);
                 }
-            
+            }
+
+            TRACE_BEGIN("frame_sample");
+            frame_sample_tick(base_path, current_pkg);
+            TRACE_END();
         }
+
+        metrics_tick(base_path);
+        status_publish();
+        TRACE_END();
+        alloc_check_iteration();
     }
     // while loop end
     
     // Cleanup (unreachable usually)
     if (inotify_fd >= 0) close(inotify_fd);
+    if (control_fd >= 0) close(control_fd);
     
     return 0;
 }
@@ -0,0 +1,496 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "rate_policy.h"
+
+DisplayMode modes[MAX_MODES];
+int mode_count = 0;
+
+AppConfig app_configs[MAX_APPS];
+int app_config_count = 0;
+int default_mode_id = 1;
+
+// 工具函数：去除字符串两端空白
+char* trim(char* str) {
+    char* end;
+    while(isspace((unsigned char)*str)) str++;
+    if(*str == 0) return str;
+    end = str + strlen(str) - 1;
+    while(end > str && isspace((unsigned char)*end)) end--;
+    *(end+1) = 0;
+    return str;
+}
+
+// 在 buf 中原地切分下一行，返回行首 (已去掉换行)，没有更多行返回 NULL
+char* next_line(char **cursor) {
+    char *p = *cursor;
+    if (*p == '\0') return NULL;
+    char *nl = strchr(p, '\n');
+    if (nl) {
+        *nl = '\0';
+        *cursor = nl + 1;
+    } else {
+        *cursor = p + strlen(p);
+    }
+    return p;
+}
+
+// ==================== 显示模式 ====================
+
+// 解析 dumpsys SurfaceFlinger 中的一行，含完整模式信息时加入模式表
+void policy_parse_mode_line(const char *line) {
+    // 查找关键字段: id=, resolution=, vsyncRate=
+    // 示例: 
+    // Display 0 HWC layers:
+    // ... id=0, ... resolution=1264x2780 ... vsyncRate=120.000000
+    // 注意：不同设备输出格式可能略有不同，但这些关键字通常存在
+    if (mode_count >= MAX_MODES) return;
+
+    const char *p_id = strstr(line, "id=");
+    const char *p_res = strstr(line, "resolution=");
+    const char *p_fps = strstr(line, "vsyncRate=");
+    
+    if (p_id && p_res && p_fps) {
+        int id = atoi(p_id + 3);
+        
+        // 解析分辨率 resolution=WxH
+        int w = 0, h = 0;
+        sscanf(p_res + 11, "%dx%d", &w, &h);
+        
+        float fps_f = atof(p_fps + 10);
+        
+        if (w > 0 && h > 0 && fps_f > 0) {
+            // 查重
+            int exists = 0;
+            for(int k=0; k<mode_count; k++) {
+                if(modes[k].id == id) { exists=1; break; }
+            }
+            if(!exists) {
+                modes[mode_count].id = id;
+                modes[mode_count].width = w;
+                modes[mode_count].height = h;
+                modes[mode_count].fps = (int)(fps_f + 0.5);
+                mode_count++;
+            }
+        }
+    }
+}
+
+// 按 ID 排序 (冒泡排序)
+void policy_sort_modes(void) {
+    for (int i = 0; i < mode_count - 1; i++) {
+        for (int j = 0; j < mode_count - i - 1; j++) {
+            if (modes[j].id > modes[j+1].id) {
+                DisplayMode temp = modes[j];
+                modes[j] = modes[j+1];
+                modes[j+1] = temp;
+            }
+        }
+    }
+}
+
+// 检查模式是否有效
+int is_valid_mode(int id) {
+    for (int i=0; i<mode_count; i++) {
+        if (modes[i].id == id) return 1;
+    }
+    return 0;
+}
+
+// 获取模式的宽度
+int get_mode_width(int id) {
+    for (int i=0; i<mode_count; i++) {
+        if (modes[i].id == id) return modes[i].width;
+    }
+    return 0;
+}
+
+// 获取模式的帧率
+int get_mode_fps(int id) {
+    for (int i=0; i<mode_count; i++) {
+        if (modes[i].id == id) return modes[i].fps;
+    }
+    return 0;
+}
+
+// 固定到单个模式的策略
+void policy_pin(AppConfig *p, int id) {
+    memset(p, 0, sizeof(*p));
+    p->mode_id = id;
+}
+
+// 当前处于该模式时是否满足策略 (无需切换)
+int policy_accepts(const AppConfig *p, int id) {
+    if (!p->candidates) return id == p->mode_id;
+    for (int i=0; i<mode_count; i++) {
+        if (modes[i].id == id) return (p->candidates >> i) & 1;
+    }
+    return 0;
+}
+
+// 获取指定分辨率下按FPS排序的模式列表
+void get_sorted_fps_modes(int width, int *out_ids, int *out_count) {
+    typedef struct {
+        int id;
+        int fps;
+    } ModeInfo;
+    
+    ModeInfo temp_modes[MAX_MODES];
+    int count = 0;
+    
+    // 1. 筛选符合分辨率的模式
+    for (int i=0; i<mode_count; i++) {
+        if (modes[i].width == width) {
+            temp_modes[count].id = modes[i].id;
+            temp_modes[count].fps = modes[i].fps;
+            count++;
+        }
+    }
+    
+    // 2. 按 FPS 升序排序
+    for (int i = 0; i < count - 1; i++) {
+        for (int j = 0; j < count - i - 1; j++) {
+            if (temp_modes[j].fps > temp_modes[j+1].fps) {
+                ModeInfo temp = temp_modes[j];
+                temp_modes[j] = temp_modes[j+1];
+                temp_modes[j+1] = temp;
+            }
+        }
+    }
+    
+    // 3. 输出 ID
+    *out_count = count;
+    for (int i=0; i<count; i++) {
+        out_ids[i] = temp_modes[i].id;
+    }
+}
+
+// 规划 from -> to 的切换路径。同分辨率时按帧率排序逐档经过中间模式，
+// 宽度未知、分辨率不同或不在排序列表中时直接切换
+void plan_switch(int from_id, int to_id, SwitchPlan *plan) {
+    int current_width = get_mode_width(from_id);
+    int target_width = get_mode_width(to_id);
+
+    plan->up = 0;
+    plan->count = 1;
+    plan->ids[0] = to_id;
+
+    if (current_width == 0 || target_width == 0) {
+        plan->kind = PLAN_DIRECT_INVALID_WIDTH;
+        return;
+    }
+    if (current_width != target_width) {
+        plan->kind = PLAN_DIRECT_RESOLUTION;
+        return;
+    }
+
+    // 获取按 FPS 排序的模式列表
+    int sorted_ids[MAX_MODES];
+    int count = 0;
+    get_sorted_fps_modes(target_width, sorted_ids, &count);
+
+    // 查找当前和目标在排序列表中的位置
+    int idx_curr = -1;
+    int idx_target = -1;
+    for (int i=0; i<count; i++) {
+        if (sorted_ids[i] == from_id) idx_curr = i;
+        if (sorted_ids[i] == to_id) idx_target = i;
+    }
+    if (idx_curr == -1) {
+        plan->kind = PLAN_DIRECT_CURRENT_UNLISTED;
+        return;
+    }
+    if (idx_target == -1) {
+        plan->kind = PLAN_DIRECT_TARGET_UNLISTED;
+        return;
+    }
+
+    plan->kind = PLAN_LADDER;
+    plan->up = idx_target > idx_curr;
+    plan->count = 0;
+    if (plan->up) {
+        for (int i = idx_curr + 1; i <= idx_target; i++) plan->ids[plan->count++] = sorted_ids[i];
+    } else {
+        for (int i = idx_curr - 1; i >= idx_target; i--) plan->ids[plan->count++] = sorted_ids[i];
+    }
+}
+
+// 把 min-max[@width] 解析为候选模式集合，未指定分辨率时沿用默认模式的分辨率
+int resolve_range_policy(AppConfig *cfg, int min_fps, int max_fps, int width) {
+    if (min_fps > max_fps) {
+        int t = min_fps;
+        min_fps = max_fps;
+        max_fps = t;
+    }
+    if (width <= 0) width = get_mode_width(default_mode_id);
+
+    policy_pin(cfg, -1);
+    int best_fps = 0, low_fps = 0;
+    for (int i=0; i<mode_count; i++) {
+        DisplayMode *m = &modes[i];
+        if (m->fps < min_fps || m->fps > max_fps) continue;
+        if (width > 0 && m->width != width) continue;
+
+        cfg->candidates |= 1ULL << i;
+        if (m->fps > best_fps) {
+            best_fps = m->fps;
+            cfg->mode_id = m->id;
+        }
+        if (low_fps == 0 || m->fps < low_fps) low_fps = m->fps;
+    }
+    cfg->min_fps = low_fps;
+    cfg->max_fps = best_fps;
+    return cfg->candidates != 0;
+}
+
+// ==================== 规则引擎 ====================
+// mode.txt 中每条规则的匹配式编译进一棵字符 trie，每次加载配置只编译一次。
+// 匹配式统一展开为 "包名/Activity"，只写包名时 Activity 部分为 "*"，
+// "*" 匹配除 '/' 外的任意字符串 (com.tencent.* 即前缀匹配)，".Main" 形式的
+// Activity 按包名补全。匹配时在 trie 上模拟 NFA，活跃状态只与匹配式中
+// "*" 的分布有关，开销与名称长度成正比、与规则数量无关。
+// 多条规则同时命中时取最具体的: 指定 Activity > 字面字符多 > 无通配 > 条件多。
+// 条件写在匹配式后的方括号里，如 com.tencent.*[charging,landscape,battery<20]=90
+
+#define RULE_TRIE_NODES 16384
+#define RULE_MAX_ACTIVE 256
+
+typedef struct {
+    char c;
+    int child;    // 第一个子节点
+    int sibling;  // 下一个兄弟节点
+    int rule;     // 在此结束的第一条规则 (经 AppConfig.next_rule 串联)，-1 为无
+} TrieNode;
+
+TrieNode rule_trie[RULE_TRIE_NODES];
+int rule_trie_count = 0;
+unsigned int rule_cond_used = 0; // 所有规则用到的条件，只读取需要的 sysfs
+int rule_active[2][RULE_MAX_ACTIVE];
+unsigned int rule_seen[RULE_TRIE_NODES]; // NFA 状态去重的代数戳
+unsigned int rule_seen_gen = 0;
+
+// 上次匹配结果缓存: 名称和条件都没变时直接复用
+char rule_cache_name[MAX_PATTERN_LEN * 2] = "";
+RuleContext rule_cache_ctx;
+int rule_cache_result = -1;
+int rule_cache_valid = 0;
+
+int trie_new_node(char c) {
+    if (rule_trie_count >= RULE_TRIE_NODES) return -1;
+    TrieNode *n = &rule_trie[rule_trie_count];
+    n->c = c;
+    n->child = n->sibling = n->rule = -1;
+    return rule_trie_count++;
+}
+
+void rules_reset() {
+    rule_trie_count = 0;
+    rule_cond_used = 0;
+    rule_cache_valid = 0;
+    trie_new_node('\0');
+}
+
+// 解析方括号中的条件列表，失败返回 0
+int rule_parse_conditions(AppConfig *cfg, char *list) {
+    char *save = NULL;
+    for (char *tok = strtok_r(list, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        tok = trim(tok);
+        if (strcmp(tok, "charging") == 0) cfg->conds |= COND_CHARGING;
+        else if (strcmp(tok, "!charging") == 0) cfg->conds |= COND_NOT_CHARGING;
+        else if (strcmp(tok, "landscape") == 0) cfg->conds |= COND_LANDSCAPE;
+        else if (strcmp(tok, "portrait") == 0) cfg->conds |= COND_PORTRAIT;
+        else if (strncmp(tok, "battery<", 8) == 0) { cfg->conds |= COND_BATTERY_BELOW; cfg->battery_below = atoi(tok + 8); }
+        else if (strncmp(tok, "battery>", 8) == 0) { cfg->conds |= COND_BATTERY_ABOVE; cfg->battery_above = atoi(tok + 8); }
+        else if (strncmp(tok, "temp>", 5) == 0) { cfg->conds |= COND_TEMP_ABOVE; cfg->temp_above = atoi(tok + 5); }
+        else if (strncmp(tok, "temp<", 5) == 0) { cfg->conds |= COND_TEMP_BELOW; cfg->temp_below = atoi(tok + 5); }
+        else return 0;
+    }
+    return 1;
+}
+
+// 把规则 idx 的匹配式编译进 trie，失败返回 0
+int rule_compile(int idx) {
+    AppConfig *cfg = &app_configs[idx];
+    char expanded[MAX_PATTERN_LEN * 2];
+
+    // 展开为 包名/Activity
+    char pkg_part[MAX_PATTERN_LEN];
+    snprintf(pkg_part, sizeof(pkg_part), "%s", cfg->pattern);
+    char *slash = strchr(pkg_part, '/');
+    const char *act = "*";
+    if (slash) {
+        *slash = '\0';
+        act = slash + 1;
+    }
+    if (act[0] == '.') {
+        // .Main 形式按包名补全，包名含通配时只能匹配后缀
+        if (strchr(pkg_part, '*')) snprintf(expanded, sizeof(expanded), "%s/*%s", pkg_part, act);
+        else snprintf(expanded, sizeof(expanded), "%s/%s%s", pkg_part, pkg_part, act);
+    } else {
+        snprintf(expanded, sizeof(expanded), "%s/%s", pkg_part, act);
+    }
+
+    // 具体程度评分
+    int literals = 0, wildcards = 0, conds = 0;
+    for (const char *p = expanded; *p; p++) {
+        if (*p == '*') wildcards++;
+        else literals++;
+    }
+    for (unsigned int c = cfg->conds; c; c &= c - 1) conds++;
+    cfg->score = (slash ? 100000 : 0) + literals * 8 + (wildcards <= (slash ? 0 : 1) ? 4 : 0) + (conds < 3 ? conds : 3);
+
+    // 插入 trie (连续的 * 合并)
+    int node = 0;
+    for (const char *p = expanded; *p; p++) {
+        if (*p == '*' && p[1] == '*') continue;
+        int child = rule_trie[node].child;
+        while (child != -1 && rule_trie[child].c != *p) child = rule_trie[child].sibling;
+        if (child == -1) {
+            child = trie_new_node(*p);
+            if (child == -1) return 0;
+            rule_trie[child].sibling = rule_trie[node].child;
+            rule_trie[node].child = child;
+        }
+        node = child;
+    }
+    cfg->next_rule = rule_trie[node].rule;
+    rule_trie[node].rule = idx;
+    rule_cond_used |= cfg->conds;
+    return 1;
+}
+
+// 把节点及其 * 子节点 (* 可匹配空串) 加入状态集
+void rule_add_state(int *set, int *count, int node) {
+    while (node != -1) {
+        if (rule_seen[node] == rule_seen_gen || *count >= RULE_MAX_ACTIVE) return;
+        rule_seen[node] = rule_seen_gen;
+        set[(*count)++] = node;
+
+        int star = rule_trie[node].child;
+        while (star != -1 && rule_trie[star].c != '*') star = rule_trie[star].sibling;
+        node = star;
+    }
+}
+
+int rule_conditions_hold(const AppConfig *cfg, const RuleContext *ctx) {
+    unsigned int c = cfg->conds;
+    if ((c & COND_CHARGING) && !ctx->charging) return 0;
+    if ((c & COND_NOT_CHARGING) && ctx->charging) return 0;
+    if ((c & COND_LANDSCAPE) && !ctx->landscape) return 0;
+    if ((c & COND_PORTRAIT) && ctx->landscape) return 0;
+    if ((c & COND_BATTERY_BELOW) && !(ctx->battery >= 0 && ctx->battery < cfg->battery_below)) return 0;
+    if ((c & COND_BATTERY_ABOVE) && !(ctx->battery >= 0 && ctx->battery > cfg->battery_above)) return 0;
+    if ((c & COND_TEMP_ABOVE) && !(ctx->temp > -1000 && ctx->temp > cfg->temp_above)) return 0;
+    if ((c & COND_TEMP_BELOW) && !(ctx->temp > -1000 && ctx->temp < cfg->temp_below)) return 0;
+    return 1;
+}
+
+// 按前台 包名/Activity 匹配规则，返回 app_configs 下标，未命中返回 -1
+int rules_match(const char *pkg, const char *activity, const RuleContext *ctx) {
+    char name[MAX_PATTERN_LEN * 2];
+    if (activity[0] == '.') snprintf(name, sizeof(name), "%s/%s%s", pkg, pkg, activity);
+    else snprintf(name, sizeof(name), "%s/%s", pkg, activity);
+
+    if (rule_cache_valid && strcmp(name, rule_cache_name) == 0 &&
+        memcmp(ctx, &rule_cache_ctx, sizeof(*ctx)) == 0) {
+        return rule_cache_result;
+    }
+
+    int *cur = rule_active[0], *next = rule_active[1];
+    int cur_count = 0, next_count;
+    rule_seen_gen++;
+    rule_add_state(cur, &cur_count, 0);
+
+    for (const char *p = name; *p && cur_count > 0; p++) {
+        rule_seen_gen++;
+        next_count = 0;
+        for (int i=0; i<cur_count; i++) {
+            int node = cur[i];
+            // * 停留在原状态继续吞字符，但不跨越 '/'
+            if (rule_trie[node].c == '*' && *p != '/') rule_add_state(next, &next_count, node);
+            for (int child = rule_trie[node].child; child != -1; child = rule_trie[child].sibling) {
+                if (rule_trie[child].c == *p) rule_add_state(next, &next_count, child);
+            }
+        }
+        int *t = cur; cur = next; next = t;
+        cur_count = next_count;
+    }
+
+    int best = -1;
+    for (int i=0; i<cur_count; i++) {
+        for (int r = rule_trie[cur[i]].rule; r != -1; r = app_configs[r].next_rule) {
+            if (!rule_conditions_hold(&app_configs[r], ctx)) continue;
+            // 同分时取配置文件中靠前的
+            if (best == -1 || app_configs[r].score > app_configs[best].score ||
+                (app_configs[r].score == app_configs[best].score && r < best)) best = r;
+        }
+    }
+
+    snprintf(rule_cache_name, sizeof(rule_cache_name), "%s", name);
+    rule_cache_ctx = *ctx;
+    rule_cache_result = best;
+    rule_cache_valid = 1;
+    return best;
+}
+
+// 解析 mode.txt 内容 (会被就地修改): 第一条有效行为默认模式，
+// 其余每行一条规则，重新编译规则 trie
+void policy_parse_config(char *text) {
+    char *cursor = text;
+    char *line;
+    app_config_count = 0;
+    rules_reset();
+    int line_num = 0;
+
+    while ((line = next_line(&cursor)) != NULL) {
+        char *trimmed = trim(line);
+        if (strlen(trimmed) == 0 || trimmed[0] == '#') continue;
+
+        line_num++;
+        if (line_num == 1) {
+            // 第一行：全局默认ID
+            default_mode_id = atoi(trimmed);
+        } else {
+            // 后续行：匹配式[条件] 模式ID 或 帧率范围
+            // 支持 pkg=id、pkg id 或 pkg=min-max[@width] 格式，
+            // 匹配式可以是 包名、含 * 的通配、包名/Activity
+            char *sep = strchr(trimmed, ']');
+            sep = strpbrk(sep ? sep : trimmed, "= \t");
+            if (!sep || app_config_count >= MAX_APPS) continue;
+            *sep = '\0';
+            char *pattern = trim(trimmed);
+            char *value = trim(sep + 1);
+
+            AppConfig *cfg = &app_configs[app_config_count];
+            int min_fps, max_fps, width = 0;
+            if (strchr(value, '-') &&
+                sscanf(value, "%d-%d@%d", &min_fps, &max_fps, &width) >= 2) {
+                if (!resolve_range_policy(cfg, min_fps, max_fps, width)) {
+                    log_msg("No mode in range / 范围内没有可用模式: %s=%s", pattern, value);
+                    continue;
+                }
+            } else {
+                policy_pin(cfg, atoi(value));
+            }
+
+            char *bracket = strchr(pattern, '[');
+            if (bracket) {
+                *bracket = '\0';
+                char *close_br = strchr(bracket + 1, ']');
+                if (close_br) *close_br = '\0';
+                if (!rule_parse_conditions(cfg, bracket + 1)) {
+                    log_msg("Bad rule condition / 规则条件无效: %s", pattern);
+                    continue;
+                }
+            }
+            snprintf(cfg->pattern, sizeof(cfg->pattern), "%s", trim(pattern));
+            if (!rule_compile(app_config_count)) {
+                log_msg("Rule table full / 规则表已满: %s", cfg->pattern);
+                continue;
+            }
+            app_config_count++;
+        }
+    }
+}
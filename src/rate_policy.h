@@ -0,0 +1,109 @@
+#ifndef RATE_POLICY_H
+#define RATE_POLICY_H
+
+// ==================== 刷新率策略 ====================
+// 守护进程与离线模拟器 (rate_sim) 共用的策略核心: 显示模式表、mode.txt 解析、
+// 规则匹配和平滑切换路径规划。这里不做任何 I/O，外部状态 (充电、方向、
+// 电量、温度) 由调用方填入 RuleContext，这样同一份逻辑可以在主机上回放。
+// 使用方需要提供 log_msg()。
+
+#define MAX_MODES 50
+#define MAX_APPS 200
+#define MAX_PKG_LEN 128
+#define MAX_PATTERN_LEN 256
+
+typedef struct {
+    int id;
+    int fps;
+    int width;
+    int height;
+} DisplayMode;
+
+// 规则条件
+#define COND_CHARGING      0x01
+#define COND_NOT_CHARGING  0x02
+#define COND_LANDSCAPE     0x04
+#define COND_PORTRAIT      0x08
+#define COND_BATTERY_BELOW 0x10
+#define COND_BATTERY_ABOVE 0x20
+#define COND_TEMP_ABOVE    0x40
+#define COND_TEMP_BELOW    0x80
+
+// 应用策略: 固定模式 (pkg=id) 或帧率范围 (pkg=min-max[@width])。
+// 范围在加载配置时解析为候选模式集合，当前模式在集合内时不切换，
+// settings 只设上下限，系统可以在范围内空闲降频
+typedef struct {
+    char pattern[MAX_PATTERN_LEN]; // 匹配式: 包名[/Activity]，可含 *
+    int mode_id;                   // 目标模式，范围策略取范围内帧率最高的候选
+    int min_fps;                   // 范围策略的实际帧率上下限，固定模式为 0
+    int max_fps;
+    unsigned long long candidates; // 候选模式 (modes[] 下标位图，MAX_MODES <= 64)，固定模式为 0
+    unsigned int conds;            // COND_* 条件
+    int battery_below;
+    int battery_above;
+    int temp_above;
+    int temp_below;
+    int score;                     // 具体程度，多条命中时取最高
+    int next_rule;                 // trie 同一终点上的下一条规则
+} AppConfig;
+
+// 规则条件的当前取值
+typedef struct {
+    int charging;
+    int landscape;
+    int battery;   // 电量百分比，-1 为未知
+    int temp;      // 电池温度 (°C)，-1000 为未知
+} RuleContext;
+
+// 平滑切换路径: 同分辨率下按帧率逐档经过 ids[0..count-1]，
+// 其余情况直接切到目标 (kind 说明原因，ids 只有目标一项)
+#define PLAN_LADDER                  0
+#define PLAN_DIRECT_INVALID_WIDTH    1
+#define PLAN_DIRECT_RESOLUTION       2
+#define PLAN_DIRECT_CURRENT_UNLISTED 3
+#define PLAN_DIRECT_TARGET_UNLISTED  4
+
+#define SWITCH_STEP_SLEEP_MS 50 // 逐档切换时每档停留的时间
+
+typedef struct {
+    int kind;
+    int up;               // 逐档时是否为升频
+    int count;
+    int ids[MAX_MODES];
+} SwitchPlan;
+
+extern DisplayMode modes[MAX_MODES];
+extern int mode_count;
+extern AppConfig app_configs[MAX_APPS];
+extern int app_config_count;
+extern int default_mode_id;
+extern unsigned int rule_cond_used; // 所有规则用到的条件，只读取需要的 sysfs
+
+// 由使用方提供
+void log_msg(const char *fmt, ...);
+
+char* trim(char* str);
+char* next_line(char **cursor);
+
+// 模式表
+int is_valid_mode(int id);
+int get_mode_width(int id);
+int get_mode_fps(int id);
+void get_sorted_fps_modes(int width, int *out_ids, int *out_count);
+void policy_parse_mode_line(const char *line);
+void policy_sort_modes(void);
+
+// 策略
+void policy_pin(AppConfig *p, int id);
+int policy_accepts(const AppConfig *p, int id);
+int resolve_range_policy(AppConfig *cfg, int min_fps, int max_fps, int width);
+void plan_switch(int from_id, int to_id, SwitchPlan *plan);
+
+// 规则
+void rules_reset(void);
+int rule_parse_conditions(AppConfig *cfg, char *list);
+int rule_compile(int idx);
+int rules_match(const char *pkg, const char *activity, const RuleContext *ctx);
+void policy_parse_config(char *text);
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef RATE_SHM_H
+#define RATE_SHM_H
+
+// ==================== 实时状态页 ====================
+// rate_daemon 把模式表、当前模式、前台应用、各方投票和计数器发布到模块目录下
+// 的 status.shm (共享映射)。读取方 (ratectl status) 直接映射该文件，不必经过
+// 守护进程或再跑 dumpsys。
+//
+// 并发用顺序锁 (seqlock): 写入前 seq 加一 (变为奇数)，写完再加一 (变回偶数)。
+// 读取方拷贝整页，拷贝前后 seq 相同且为偶数才算读到一致的快照，否则重试。
+// 写入方只有守护进程一个，不会被读取方阻塞。
+
+#include <stdint.h>
+#include <string.h>
+#include <sched.h>
+
+#define RATE_SHM_FILE "status.shm"
+#define RATE_SHM_MAGIC 0x53504452 // "RDPS"
+#define RATE_SHM_VERSION 1
+#define RATE_SHM_MAX_MODES 64
+#define RATE_SHM_MAX_VOTES 8
+#define RATE_SHM_PKG_LEN 128
+#define RATE_SHM_ACTIVITY_LEN 256
+#define RATE_SHM_READ_RETRIES 1000
+
+// 投票来源
+#define RATE_VOTE_DEFAULT  0 // 全局默认模式
+#define RATE_VOTE_RULE     1 // mode.txt 规则
+#define RATE_VOTE_LEARNED  2 // 自学习建议 (learn=auto)
+#define RATE_VOTE_OVERRIDE 3 // 控制套接字的临时覆盖
+#define RATE_VOTE_PREVIEW  4 // 控制套接字的预览
+#define RATE_VOTE_HOLDOFF  5 // 漂移退避期间保持系统当前模式
+
+typedef struct {
+    int32_t id;
+    int32_t fps;
+    int32_t width;
+    int32_t height;
+} RateShmMode;
+
+typedef struct {
+    int32_t source;   // RATE_VOTE_*
+    int32_t mode_id;
+    int32_t min_fps;  // 范围策略的上下限，固定模式为 0
+    int32_t max_fps;
+    int32_t chosen;   // 是否为最终生效的一票
+} RateShmVote;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t seq;             // 奇数表示正在写入
+    int32_t pid;
+    int64_t updated_ms;       // 发布时间 (CLOCK_REALTIME 毫秒)，用于判断守护进程是否存活
+
+    int32_t current_mode_id;
+    int32_t default_mode_id;
+    int32_t settings_fps;     // 已写入 settings 的峰值/最低帧率，-1 为未知
+    int32_t settings_min_fps;
+    char package[RATE_SHM_PKG_LEN];
+    char activity[RATE_SHM_ACTIVITY_LEN];
+
+    int32_t mode_count;
+    RateShmMode modes[RATE_SHM_MAX_MODES];
+
+    int32_t vote_count;
+    RateShmVote votes[RATE_SHM_MAX_VOTES];
+
+    uint64_t loop_iterations;
+    uint64_t switches;
+    uint64_t settings_writes;
+    uint64_t config_reloads;
+    uint64_t drifts;
+} RateShmStatus;
+
+static inline void rate_shm_write_begin(RateShmStatus *s) {
+    __atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void rate_shm_write_end(RateShmStatus *s) {
+    __atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELEASE);
+}
+
+// 读取一致的快照，写入方长时间处于写入中 (如写到一半崩溃) 时返回 0
+static inline int rate_shm_read(const RateShmStatus *s, RateShmStatus *out) {
+    for (int i = 0; i < RATE_SHM_READ_RETRIES; i++) {
+        uint32_t before = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+        if (!(before & 1)) {
+            memcpy(out, (const void *)s, sizeof(*out));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&s->seq, __ATOMIC_RELAXED) == before) return 1;
+        }
+        sched_yield();
+    }
+    return 0;
+}
+
+#endif
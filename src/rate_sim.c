@@ -0,0 +1,499 @@
+// rate_daemon 策略离线模拟器
+//
+// 链接守护进程的策略核心 (rate_policy.c: mode.txt 解析、规则匹配、平滑切换
+// 路径规划)，按时间线回放前台应用、触摸、温度、电量、充电和屏幕方向事件，
+// 统计一份新的 mode.txt 会带来多少次切换、逐档步数、逐档耗时、settings 写入
+// 次数以及各模式的驻留时间，用于下发配置前评估。
+//
+// 模拟按守护进程的行为建模:
+//   - 守护进程每 poll-ms 检查一次，两次检查之间的事件合并到下一次检查生效
+//   - 切换路径与 smooth_switch_steps 相同，逐档每档停留 SWITCH_STEP_SLEEP_MS
+//   - settings 写入与 sync_android_settings 的缓存一致，上下限不变时不写
+//   - 范围策略下系统自行空闲降频: 触摸或切换应用后显示范围内最高帧率，
+//     空闲 idle-ms 后降到范围内最低帧率 (只影响驻留时间，不算守护进程切换)
+// 不模拟自学习 (learn=auto) 和漂移核对。
+//
+// 时间线格式 (每行一个事件，时间单位秒，可带小数，须非递减):
+//   <秒> fg <包名>[/Activity]
+//   <秒> touch
+//   <秒> temp <°C>
+//   <秒> battery <百分比>
+//   <秒> charging <0|1>
+//   <秒> rotation <0|90|180|270>
+//
+// 编译 (主机):
+//   gcc -O2 -o rate_sim rate_sim.c rate_policy.c
+// 运行 (在 src 目录下):
+//   ./rate_sim --config ../config/mode.txt --trace bench/fixtures/sim_trace.txt
+//   ./rate_sim --config ../config/mode.txt --gen-hours 10000 [--seed 1]
+//   [--modes bench/fixtures/surfaceflinger.txt] [--poll-ms 1000] [--idle-ms 3000]
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rate_policy.h"
+
+#define EV_FG       0
+#define EV_TOUCH    1
+#define EV_TEMP     2
+#define EV_BATTERY  3
+#define EV_CHARGING 4
+#define EV_ROTATION 5
+
+typedef struct {
+    long long t_ms;
+    int kind;
+    int value;
+    char name[MAX_PATTERN_LEN * 2]; // EV_FG: 包名[/Activity]
+} SimEvent;
+
+// 策略核心只在配置有误时输出日志
+void log_msg(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+// ==================== 模拟状态 ====================
+
+long long poll_ms = 1000;
+long long idle_ms = 3000;
+
+// 守护进程看到的外部状态
+char fg_pkg[MAX_PKG_LEN] = "";
+char fg_activity[MAX_PATTERN_LEN] = "";
+int rotation = 0;
+RuleContext ctx = { 0, 0, -1, -1000 };
+
+// 守护进程内部状态
+int current_mode_id = -1;
+AppConfig active_policy;
+int settings_synced_fps = -1;
+int settings_synced_min_fps = -1;
+
+// 显示状态 (范围策略下由系统决定)
+long long now_ms = 0;
+long long last_activity_ms = 0;
+
+// 统计
+long long time_in_mode_ms[MAX_MODES];
+long long unknown_ms = 0;
+long long stat_events = 0;
+long long stat_ticks = 0;
+long long stat_switches = 0;
+long long stat_ladder_switches = 0;
+long long stat_direct_switches = 0;
+long long stat_steps = 0;
+long long stat_ladder_steps = 0;
+long long stat_settings_writes = 0;
+
+int mode_index(int id) {
+    for (int i=0; i<mode_count; i++) {
+        if (modes[i].id == id) return i;
+    }
+    return -1;
+}
+
+// 范围策略空闲时的模式: 候选中帧率最低的
+int range_idle_index(const AppConfig *p) {
+    int best = -1;
+    for (int i=0; i<mode_count; i++) {
+        if (!((p->candidates >> i) & 1)) continue;
+        if (best == -1 || modes[i].fps < modes[best].fps) best = i;
+    }
+    return best;
+}
+
+// 把 [now_ms, t) 这段时间计入当前显示的模式
+void advance_to(long long t) {
+    if (t <= now_ms) return;
+    int cur = mode_index(current_mode_id);
+    if (cur == -1) {
+        unknown_ms += t - now_ms;
+    } else if (active_policy.candidates && policy_accepts(&active_policy, current_mode_id)) {
+        // 活跃时显示范围内最高帧率，空闲超时后降到最低帧率
+        int peak = mode_index(active_policy.mode_id);
+        int low = range_idle_index(&active_policy);
+        long long idle_at = last_activity_ms + idle_ms;
+        if (idle_at > now_ms) {
+            long long end = idle_at < t ? idle_at : t;
+            time_in_mode_ms[peak] += end - now_ms;
+            now_ms = end;
+        }
+        if (t > now_ms) time_in_mode_ms[low] += t - now_ms;
+    } else {
+        time_in_mode_ms[cur] += t - now_ms;
+    }
+    now_ms = t;
+}
+
+// 与 sync_android_settings 相同的上下限和写入缓存
+void sim_sync_settings(int id) {
+    int fps = get_mode_fps(id);
+    if (fps <= 0) return;
+    int peak = fps, min = fps;
+    if (active_policy.candidates && policy_accepts(&active_policy, id)) {
+        peak = active_policy.max_fps;
+        min = active_policy.min_fps;
+    }
+    if (peak == settings_synced_fps && min == settings_synced_min_fps) return;
+    stat_settings_writes++;
+    settings_synced_fps = peak;
+    settings_synced_min_fps = min;
+}
+
+void sim_switch(int target_id) {
+    stat_switches++;
+    if (current_mode_id == -1) {
+        // 首次切换，当前模式未知时守护进程直接切换
+        stat_direct_switches++;
+        stat_steps++;
+    } else {
+        SwitchPlan plan;
+        plan_switch(current_mode_id, target_id, &plan);
+        if (plan.kind == PLAN_LADDER) {
+            stat_ladder_switches++;
+            stat_ladder_steps += plan.count;
+        } else {
+            stat_direct_switches++;
+        }
+        stat_steps += plan.count;
+    }
+    current_mode_id = target_id;
+    sim_sync_settings(target_id);
+}
+
+// 一次守护进程检查: 与主循环中的规则查找和切换判断相同
+void daemon_tick() {
+    stat_ticks++;
+    if (!fg_pkg[0]) return;
+
+    ctx.landscape = rotation == 90 || rotation == 270;
+    AppConfig policy;
+    policy_pin(&policy, default_mode_id);
+    int rule = rules_match(fg_pkg, fg_activity, &ctx);
+    if (rule != -1) policy = app_configs[rule];
+
+    active_policy = policy;
+    if (!is_valid_mode(policy.mode_id)) return;
+    if (!policy_accepts(&policy, current_mode_id)) {
+        sim_switch(policy.mode_id);
+    } else if (policy.candidates) {
+        sim_sync_settings(current_mode_id);
+    }
+}
+
+// 事件作用到外部状态，返回守护进程下次检查时是否可能看到变化
+int apply_event(const SimEvent *ev) {
+    switch (ev->kind) {
+    case EV_FG: {
+        const char *slash = strchr(ev->name, '/');
+        int pkg_len = slash ? (int)(slash - ev->name) : (int)strlen(ev->name);
+        snprintf(fg_pkg, sizeof(fg_pkg), "%.*s", pkg_len, ev->name);
+        snprintf(fg_activity, sizeof(fg_activity), "%s", slash ? slash + 1 : "");
+        last_activity_ms = ev->t_ms;
+        return 1;
+    }
+    case EV_TOUCH:
+        // 触摸只影响系统的空闲降频，守护进程看不到
+        last_activity_ms = ev->t_ms;
+        return 0;
+    case EV_TEMP:
+        ctx.temp = ev->value;
+        return 1;
+    case EV_BATTERY:
+        ctx.battery = ev->value;
+        return 1;
+    case EV_CHARGING:
+        ctx.charging = ev->value != 0;
+        return 1;
+    case EV_ROTATION:
+        rotation = ev->value;
+        return 1;
+    }
+    return 0;
+}
+
+// ==================== 事件来源 ====================
+
+FILE *trace_fp = NULL;
+long long trace_line = 0;
+
+// 从时间线文件读取下一个事件，文件结束返回 0
+int trace_next(SimEvent *ev) {
+    char line[1024];
+    while (fgets(line, sizeof(line), trace_fp)) {
+        trace_line++;
+        char *p = trim(line);
+        if (!*p || *p == '#') continue;
+
+        char *end;
+        double sec = strtod(p, &end);
+        if (end == p) goto bad;
+        char *kind = trim(end);
+        char *arg = kind;
+        while (*arg && *arg != ' ' && *arg != '\t') arg++;
+        if (*arg) *arg++ = '\0';
+        arg = trim(arg);
+
+        ev->t_ms = (long long)(sec * 1000.0 + 0.5);
+        ev->value = atoi(arg);
+        ev->name[0] = '\0';
+        if (strcmp(kind, "fg") == 0) {
+            if (!*arg) goto bad;
+            ev->kind = EV_FG;
+            snprintf(ev->name, sizeof(ev->name), "%s", arg);
+        } else if (strcmp(kind, "touch") == 0) ev->kind = EV_TOUCH;
+        else if (strcmp(kind, "temp") == 0) ev->kind = EV_TEMP;
+        else if (strcmp(kind, "battery") == 0) ev->kind = EV_BATTERY;
+        else if (strcmp(kind, "charging") == 0) ev->kind = EV_CHARGING;
+        else if (strcmp(kind, "rotation") == 0) ev->kind = EV_ROTATION;
+        else goto bad;
+        return 1;
+bad:
+        fprintf(stderr, "trace:%lld: bad event, skipped\n", trace_line);
+    }
+    return 0;
+}
+
+// 合成时间线: 按固定种子生成，边生成边回放，不占内存
+#define GEN_APPS 10
+const char *gen_apps[GEN_APPS] = {
+    "com.oplus.launcher/com.android.launcher.Launcher",
+    "com.tencent.mm/com.tencent.mm.ui.LauncherUI",
+    "com.tencent.mm/.plugin.webview.ui.tools.WebViewUI",
+    "com.ss.android.ugc.aweme/.main.MainActivity",
+    "com.miHoYo.Yuanshen/com.miHoYo.GetMobileInfo.MainActivity",
+    "com.tencent.tmgp.sgame/.SGameActivity",
+    "com.android.chrome/com.google.android.apps.chrome.Main",
+    "com.taobao.taobao/com.taobao.tao.TBMainActivity",
+    "com.android.settings/.Settings",
+    "tv.danmaku.bili/.MainActivityV2",
+};
+
+unsigned long long gen_rng = 1;
+long long gen_end_ms = 0;
+long long gen_t_ms = 0;
+long long gen_session_end = 0; // 首个事件即开始会话
+long long gen_next_env = 0;
+int gen_app = 0;
+int gen_battery = 80;
+int gen_charging = 0;
+int gen_temp = 32;
+int gen_env_phase = 0;
+
+unsigned int gen_rand() {
+    // xorshift64*
+    gen_rng ^= gen_rng >> 12;
+    gen_rng ^= gen_rng << 25;
+    gen_rng ^= gen_rng >> 27;
+    return (unsigned int)((gen_rng * 2685821657736338717ULL) >> 32);
+}
+
+int gen_range(int lo, int hi) {
+    return lo + (int)(gen_rand() % (unsigned int)(hi - lo + 1));
+}
+
+// 生成下一个应用或触摸事件
+void gen_activity(SimEvent *ev) {
+    ev->name[0] = '\0';
+    ev->value = 0;
+    // 会话内: 成串的触摸，偶尔旋转屏幕 (游戏和视频)
+    gen_t_ms += gen_rand() % 4 == 0 ? gen_range(2000, 15000) : gen_range(100, 1500);
+    if (gen_t_ms >= gen_session_end) {
+        // 新的应用会话: 30 秒到 20 分钟
+        gen_t_ms = gen_session_end;
+        gen_app = (int)(gen_rand() % GEN_APPS);
+        gen_session_end = gen_t_ms + gen_range(30, 1200) * 1000LL;
+        ev->t_ms = gen_t_ms;
+        ev->kind = EV_FG;
+        snprintf(ev->name, sizeof(ev->name), "%s", gen_apps[gen_app]);
+        return;
+    }
+    ev->t_ms = gen_t_ms;
+    if (gen_app >= 3 && gen_app <= 5 && gen_rand() % 200 == 0) {
+        ev->kind = EV_ROTATION;
+        ev->value = gen_rand() % 2 ? 90 : 0;
+    } else {
+        ev->kind = EV_TOUCH;
+    }
+}
+
+SimEvent gen_pending;
+int gen_have_pending = 0;
+
+int gen_next(SimEvent *ev) {
+    if (!gen_have_pending) {
+        gen_activity(&gen_pending);
+        gen_have_pending = 1;
+    }
+
+    // 每分钟更新一次环境: 电量、充电、温度
+    if (gen_next_env <= gen_pending.t_ms) {
+        ev->t_ms = gen_next_env;
+        ev->name[0] = '\0';
+        switch (gen_env_phase++ % 3) {
+        case 0:
+            if (gen_charging) gen_battery += 2;
+            else if (gen_rand() % 3 == 0) gen_battery--;
+            if (gen_battery <= 15) gen_charging = 1;
+            if (gen_battery >= 100) { gen_battery = 100; gen_charging = 0; }
+            ev->kind = EV_BATTERY;
+            ev->value = gen_battery;
+            break;
+        case 1:
+            ev->kind = EV_CHARGING;
+            ev->value = gen_charging;
+            break;
+        default:
+            gen_temp += gen_range(-1, 1);
+            if (gen_temp < 25) gen_temp = 25;
+            if (gen_temp > 48) gen_temp = 48;
+            ev->kind = EV_TEMP;
+            ev->value = gen_temp;
+            gen_next_env += 60000;
+            break;
+        }
+    } else {
+        *ev = gen_pending;
+        gen_have_pending = 0;
+    }
+    return ev->t_ms < gen_end_ms;
+}
+
+// ==================== 入口 ====================
+
+int load_modes(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), fp)) policy_parse_mode_line(line);
+    fclose(fp);
+    policy_sort_modes();
+    return mode_count > 0;
+}
+
+int load_config(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return 0;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *text = malloc(size + 1);
+    if (!text) {
+        fclose(fp);
+        return 0;
+    }
+    size_t n = fread(text, 1, size, fp);
+    text[n] = '\0';
+    fclose(fp);
+    policy_parse_config(text);
+    free(text);
+    return 1;
+}
+
+void report(double wall_s) {
+    double hours = now_ms / 3600000.0;
+    printf("Simulated / 模拟时长: %.2f h, %lld events, %lld daemon checks\n", hours, stat_events, stat_ticks);
+    printf("Switches / 切换: %lld (ladder %lld, direct %lld), %.2f per hour\n",
+           stat_switches, stat_ladder_switches, stat_direct_switches, hours > 0 ? stat_switches / hours : 0.0);
+    printf("Steps / 步数: %lld, stepping time / 逐档耗时: %.1f s\n",
+           stat_steps, (double)stat_ladder_steps * SWITCH_STEP_SLEEP_MS / 1000.0);
+    printf("Settings writes / settings 写入: %lld\n", stat_settings_writes);
+    printf("Time in mode / 模式驻留:\n");
+    for (int i=0; i<mode_count; i++) {
+        if (!time_in_mode_ms[i]) continue;
+        printf("  id %-3d %4dHz %4dx%-4d %12.2f h %6.2f%%\n", modes[i].id, modes[i].fps, modes[i].width,
+               modes[i].height, time_in_mode_ms[i] / 3600000.0,
+               now_ms > 0 ? 100.0 * time_in_mode_ms[i] / now_ms : 0.0);
+    }
+    if (unknown_ms) printf("  unknown              %12.2f h\n", unknown_ms / 3600000.0);
+    printf("Wall time / 耗时: %.3f s, %.0f simulated hours per second\n",
+           wall_s, wall_s > 0 ? hours / wall_s : 0.0);
+}
+
+void usage(const char *prog) {
+    fprintf(stderr,
+        "Usage: %s --config mode.txt (--trace file | --gen-hours H [--seed S])\n"
+        "          [--modes surfaceflinger.txt] [--poll-ms 1000] [--idle-ms 3000]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    const char *modes_path = "bench/fixtures/surfaceflinger.txt";
+    const char *config_path = NULL;
+    const char *trace_path = NULL;
+    double gen_hours = 0;
+
+    for (int i=1; i<argc; i++) {
+        const char *a = argv[i];
+        if (i + 1 >= argc) { usage(argv[0]); return 1; }
+        if (strcmp(a, "--modes") == 0) modes_path = argv[++i];
+        else if (strcmp(a, "--config") == 0) config_path = argv[++i];
+        else if (strcmp(a, "--trace") == 0) trace_path = argv[++i];
+        else if (strcmp(a, "--poll-ms") == 0) poll_ms = atoll(argv[++i]);
+        else if (strcmp(a, "--idle-ms") == 0) idle_ms = atoll(argv[++i]);
+        else if (strcmp(a, "--gen-hours") == 0) gen_hours = atof(argv[++i]);
+        else if (strcmp(a, "--seed") == 0) gen_rng = strtoull(argv[++i], NULL, 10) | 1;
+        else { usage(argv[0]); return 1; }
+    }
+    if (!config_path || (!trace_path && gen_hours <= 0) || poll_ms <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (!load_modes(modes_path)) {
+        fprintf(stderr, "No display modes in %s\n", modes_path);
+        return 1;
+    }
+    if (!load_config(config_path)) {
+        fprintf(stderr, "Cannot read %s\n", config_path);
+        return 1;
+    }
+    int (*next_event)(SimEvent *) = gen_next;
+    if (trace_path) {
+        trace_fp = fopen(trace_path, "r");
+        if (!trace_fp) {
+            fprintf(stderr, "Cannot read %s\n", trace_path);
+            return 1;
+        }
+        next_event = trace_next;
+    } else {
+        gen_end_ms = (long long)(gen_hours * 3600000.0);
+    }
+
+    struct timespec ts0, ts1;
+    clock_gettime(CLOCK_MONOTONIC, &ts0);
+
+    // 事件驱动: 只在有事件的检查周期运行守护进程逻辑，其余周期状态不变
+    SimEvent ev;
+    int pending = 0;
+    long long next_tick = 0;
+    while (next_event(&ev)) {
+        stat_events++;
+        if (ev.t_ms < now_ms) ev.t_ms = now_ms;
+        if (pending && ev.t_ms >= next_tick) {
+            advance_to(next_tick);
+            daemon_tick();
+            pending = 0;
+        }
+        advance_to(ev.t_ms);
+        if (apply_event(&ev) && !pending) {
+            pending = 1;
+            next_tick = (ev.t_ms / poll_ms + 1) * poll_ms;
+        }
+    }
+    if (pending) {
+        advance_to(next_tick);
+        daemon_tick();
+    }
+    if (gen_end_ms > now_ms) advance_to(gen_end_ms);
+    if (trace_fp) fclose(trace_fp);
+
+    clock_gettime(CLOCK_MONOTONIC, &ts1);
+    report((ts1.tv_sec - ts0.tv_sec) + (ts1.tv_nsec - ts0.tv_nsec) / 1e9);
+    return 0;
+}
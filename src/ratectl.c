@@ -0,0 +1,220 @@
+// rate_daemon 控制套接字客户端
+//
+// 把命令行参数拼成一行发给守护进程的 rate_daemon.sock，原样输出回复的 JSON。
+// 回复为 {"ok":true,...} 时返回 0，守护进程报错返回 1，连接失败返回 2，
+// 便于在脚本和 WebUI 中判断守护进程是否在运行。
+// status 不经过套接字: 直接映射同目录下的 status.shm (rate_shm.h) 转成 JSON，
+// 守护进程正忙于切换时也能立即返回。
+//
+// 用法:
+//   ratectl [-s <socket>] status
+//   ratectl state
+//   ratectl modes
+//   ratectl preview <id> <秒>
+//   ratectl override <id> [秒] | override off
+//   ratectl reload
+//   ratectl metrics
+//
+// 编译 (主机): gcc -O2 -o ratectl ratectl.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "rate_shm.h"
+
+#define DEFAULT_SOCKET "/data/adb/modules/murongchaopin/rate_daemon.sock"
+#define MAX_REQUEST 256
+
+int write_all(int fd, const char *data, int len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        data += n;
+        len -= (int)n;
+    }
+    return 1;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr,
+        "Usage: %s [-s socket] <command> [args]\n"
+        "Commands:\n"
+        "  status                 live status page (read from status.shm, no round-trip)\n"
+        "  state                  current mode, foreground app, policy and override\n"
+        "  modes                  display mode table\n"
+        "  preview <id> <sec>     switch to a mode for a few seconds\n"
+        "  override <id> [sec]    override the policy (until 'override off' without sec)\n"
+        "  override off           clear override or preview\n"
+        "  reload                 reload config now\n"
+        "  metrics                metrics snapshot\n", prog);
+}
+
+const char *vote_names[] = { "default", "rule", "learned", "override", "preview", "holdoff" };
+
+void print_json_string(const char *str) {
+    putchar('"');
+    for (const char *p = str; *p; p++) {
+        if (*p == '"' || *p == '\\') printf("\\%c", *p);
+        else if ((unsigned char)*p < 0x20) printf("\\u%04x", *p);
+        else putchar(*p);
+    }
+    putchar('"');
+}
+
+int mode_fps(const RateShmStatus *s, int id) {
+    for (int i = 0; i < s->mode_count; i++) {
+        if (s->modes[i].id == id) return s->modes[i].fps;
+    }
+    return 0;
+}
+
+// 读取状态页并输出 JSON
+int print_status(const char *sock_path) {
+    char path[512];
+    const char *slash = strrchr(sock_path, '/');
+    int dir_len = slash ? (int)(slash - sock_path) : 1;
+    snprintf(path, sizeof(path), "%.*s/%s", dir_len, slash ? sock_path : ".", RATE_SHM_FILE);
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        printf("{\"ok\":false,\"error\":\"no status page\"}\n");
+        return 2;
+    }
+    void *map = mmap(NULL, sizeof(RateShmStatus), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        printf("{\"ok\":false,\"error\":\"mmap failed\"}\n");
+        return 2;
+    }
+
+    RateShmStatus s;
+    int ok = rate_shm_read((const RateShmStatus *)map, &s);
+    munmap(map, sizeof(RateShmStatus));
+    if (!ok || s.magic != RATE_SHM_MAGIC || s.version != RATE_SHM_VERSION) {
+        printf("{\"ok\":false,\"error\":\"status page unreadable\"}\n");
+        return 1;
+    }
+    s.package[sizeof(s.package) - 1] = '\0';
+    s.activity[sizeof(s.activity) - 1] = '\0';
+    if (s.mode_count < 0 || s.mode_count > RATE_SHM_MAX_MODES) s.mode_count = 0;
+    if (s.vote_count < 0 || s.vote_count > RATE_SHM_MAX_VOTES) s.vote_count = 0;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    long long now_ms = (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    int alive = s.pid > 0 && kill(s.pid, 0) == 0;
+
+    printf("{\"ok\":true,\"pid\":%d,\"alive\":%s,\"age_ms\":%lld,\"mode\":%d,\"fps\":%d,\"default_mode\":%d,",
+           s.pid, alive ? "true" : "false", now_ms - (long long)s.updated_ms,
+           s.current_mode_id, mode_fps(&s, s.current_mode_id), s.default_mode_id);
+    printf("\"settings\":{\"peak_fps\":%d,\"min_fps\":%d},\"package\":", s.settings_fps, s.settings_min_fps);
+    print_json_string(s.package);
+    printf(",\"activity\":");
+    print_json_string(s.activity);
+
+    printf(",\"modes\":[");
+    for (int i = 0; i < s.mode_count; i++) {
+        printf("%s{\"id\":%d,\"fps\":%d,\"width\":%d,\"height\":%d}", i ? "," : "",
+               s.modes[i].id, s.modes[i].fps, s.modes[i].width, s.modes[i].height);
+    }
+    printf("],\"votes\":[");
+    for (int i = 0; i < s.vote_count; i++) {
+        RateShmVote *v = &s.votes[i];
+        int known = v->source >= 0 && v->source < (int)(sizeof(vote_names) / sizeof(vote_names[0]));
+        printf("%s{\"source\":\"%s\",\"mode\":%d,\"min_fps\":%d,\"max_fps\":%d,\"chosen\":%s}", i ? "," : "",
+               known ? vote_names[v->source] : "unknown", v->mode_id, v->min_fps, v->max_fps,
+               v->chosen ? "true" : "false");
+    }
+    printf("],\"counters\":{\"loop_iterations\":%llu,\"switches\":%llu,\"settings_writes\":%llu,"
+           "\"config_reloads\":%llu,\"drifts\":%llu}}\n",
+           (unsigned long long)s.loop_iterations, (unsigned long long)s.switches,
+           (unsigned long long)s.settings_writes, (unsigned long long)s.config_reloads,
+           (unsigned long long)s.drifts);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *sock_path = DEFAULT_SOCKET;
+    int argi = 1;
+    if (argi + 1 < argc && strcmp(argv[argi], "-s") == 0) {
+        sock_path = argv[argi + 1];
+        argi += 2;
+    }
+    if (argi >= argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (strcmp(argv[argi], "status") == 0) return print_status(sock_path);
+
+    char request[MAX_REQUEST];
+    int len = 0;
+    for (int i = argi; i < argc; i++) {
+        int n = snprintf(request + len, sizeof(request) - len, "%s%s", i > argi ? " " : "", argv[i]);
+        if (n < 0 || n >= (int)sizeof(request) - len - 1) {
+            fprintf(stderr, "Request too long\n");
+            return 2;
+        }
+        len += n;
+    }
+    request[len++] = '\n';
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", sock_path) >= (int)sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long\n");
+        return 2;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "Cannot connect to %s: %s\n", sock_path, strerror(errno));
+        if (fd >= 0) close(fd);
+        return 2;
+    }
+    // 守护进程最多在一轮检查之后处理请求，留足余量
+    struct timeval tv = { 5, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    if (!write_all(fd, request, len)) {
+        fprintf(stderr, "Send failed: %s\n", strerror(errno));
+        close(fd);
+        return 2;
+    }
+    shutdown(fd, SHUT_WR);
+
+    // 回复只检查开头是否为 {"ok":true，其余直接转发到 stdout
+    char buf[4096];
+    char head[16] = "";
+    int head_len = 0;
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "Receive failed: %s\n", strerror(errno));
+            close(fd);
+            return 2;
+        }
+        for (int i = 0; i < n && head_len < (int)sizeof(head) - 1; i++) head[head_len++] = buf[i];
+        fwrite(buf, 1, n, stdout);
+    }
+    close(fd);
+    head[head_len] = '\0';
+
+    if (head_len == 0) {
+        fprintf(stderr, "Empty reply\n");
+        return 2;
+    }
+    return strncmp(head, "{\"ok\":true", 10) == 0 ? 0 : 1;
+}
@@ -6,6 +6,10 @@
 #include <sys/stat.h>
 #include <errno.h>
 #include <ctype.h>
+#include <signal.h>
+
+#include "dtbo_img.h"
+#include "dtc_pool.h"
 
 #define MAX_PATH 1024
 
@@ -27,13 +31,36 @@ void ensure_dir(const char *path) {
     }
 }
 
+typedef struct {
+    const DtboImage *img;
+} UnpackJob;
+
+// 把第 index 个条目经管道交给 dtc，输出 dtbo_dts/dtb_temp.N.dts
+int convert_entry(int index, void *ctx) {
+    const DtboImage *img = ((UnpackJob *)ctx)->img;
+    char dts_name[MAX_PATH];
+    snprintf(dts_name, sizeof(dts_name), "dtbo_dts/dtb_temp.%d.dts", index);
+    const char *args[] = { "./dtc", "-I", "dtb", "-O", "dts", "-o", dts_name, "-", NULL };
+    if (!dtc_run(args, img->entries[index].data, img->entries[index].size, NULL, NULL)) {
+        remove(dts_name);
+        return 0;
+    }
+    return 1;
+}
+
 int main(int argc, char *argv[]) {
     char input_img[MAX_PATH] = "./dtbo.img";
-    
-    // 如果提供了参数，使用参数作为输入文件路径
-    if (argc > 1) {
-        strncpy(input_img, argv[1], MAX_PATH - 1);
+    int jobs = 0;
+
+    // 用法: unpack_dtbo [-j 线程数] [输入文件]
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+        } else {
+            strncpy(input_img, argv[i], MAX_PATH - 1);
+        }
     }
+    jobs = dtc_pool_jobs(jobs);
 
     printf("开始解包DTBO镜像...\n");
     printf("输入文件: %s\n", input_img);
@@ -46,54 +73,46 @@ int main(int argc, char *argv[]) {
         printf("错误: 找不到 ./dtc 工具\n");
         return 1;
     }
-    if (!is_file_exist("./mkdtimg")) {
-        printf("错误: 找不到 ./mkdtimg 工具\n");
-        return 1;
-    }
 
     // 创建输出目录
     ensure_dir("dtbo_dts");
 
-    printf("步骤1: 解包DTBO镜像...\n");
-    // 使用 dtb_temp 前缀，生成 dtb_temp.0, dtb_temp.1 等
-    char dump_cmd[MAX_PATH * 2];
-    snprintf(dump_cmd, sizeof(dump_cmd), "./mkdtimg dump \"%s\" -b ./dtb_temp", input_img);
-    
-    if (system(dump_cmd) != 0) {
-        printf("错误: 解包DTBO失败\n");
+    printf("步骤1: 读取DTBO镜像...\n");
+    double t0 = dtc_pool_now_ms();
+    DtboImage img;
+    if (!dtbo_open(&img, input_img)) {
+        printf("错误: 解析DTBO失败 (%s)\n", img.error);
         return 1;
     }
+    printf("共 %d 个条目 (page_size=%u, version=%u)\n", img.entry_count, img.page_size, img.version);
+    if (!dtbo_save_info("dtbo_dts/" DTBO_INFO_FILE, &img)) {
+        printf("警告: 无法保存 dtbo_dts/%s，重新打包时 id/rev 将为 0\n", DTBO_INFO_FILE);
+    }
+    double t1 = dtc_pool_now_ms();
+    printf("步骤1 耗时: %.1f ms\n", t1 - t0);
+
+    printf("步骤2: 转换DTB为DTS (输出到 dtbo_dts 目录，%d 线程)...\n", jobs);
+    // DTB 直接从镜像映射区经管道交给 dtc，不再生成 dtb_temp.N 临时文件；
+    // DTS 文件名保持 dtb_temp.N.dts，打包时按 N 排序
+    signal(SIGPIPE, SIG_IGN);
+    UnpackJob job = { &img };
+    int failed = dtc_pool_run(img.entry_count, jobs, convert_entry, &job);
+    int count = failed == -1 ? img.entry_count : failed == DTC_POOL_NOMEM ? 0 : failed;
+    for (int i = 0; i < count; i++) {
+        printf("转换: 条目 %d (%u 字节) -> dtbo_dts/dtb_temp.%d.dts\n", i, img.entries[i].size, i);
+    }
+    dtbo_close(&img);
+    printf("步骤2 耗时: %.1f ms\n", dtc_pool_now_ms() - t1);
 
-    printf("步骤2: 转换DTB为DTS (输出到 dtbo_dts 目录)...\n");
-    DIR *d = opendir(".");
-    if (!d) {
-        perror("无法打开当前目录");
+    if (failed == DTC_POOL_NOMEM) {
+        printf("错误: 内存不足\n");
         return 1;
     }
-
-    struct dirent *dir;
-    char cmd[MAX_PATH * 2];
-    int count = 0;
-
-    while ((dir = readdir(d)) != NULL) {
-        if (strncmp(dir->d_name, "dtb_temp.", 9) == 0) {
-            char dts_name[MAX_PATH];
-            // Output to dtbo_dts directory
-            snprintf(dts_name, sizeof(dts_name), "dtbo_dts/%s.dts", dir->d_name);
-            
-            printf("转换: %s -> %s\n", dir->d_name, dts_name);
-            snprintf(cmd, sizeof(cmd), "./dtc -I dtb -O dts -o \"%s\" \"%s\"", dts_name, dir->d_name);
-            
-            if (system(cmd) != 0) {
-                printf("警告: 转换 %s 失败\n", dir->d_name);
-            } else {
-                count++;
-                // 转换成功后删除临时dtb文件
-                remove(dir->d_name);
-            }
-        }
+    if (failed >= 0) {
+        // 缺少条目时重新打包会丢掉它，所以直接失败
+        printf("错误: 转换条目 %d 失败\n", failed);
+        return 1;
     }
-    closedir(d);
 
     printf("解包完成!\n");
     printf("总共生成 %d 个DTS文件，保存在 dtbo_dts 目录中\n", count);
@@ -5,6 +5,12 @@ const MOD_DIR = `/data/adb/modules/${MODULE_ID}`;
 // 配置文件路径
 const CONFIG_FILE = `${MOD_DIR}/config/mode.txt`;
 const LOG_FILE = `${MOD_DIR}/daemon.log`;
+// 守护进程导出的自学习档案
+const LEARNED_FILE = `${MOD_DIR}/learned.json`;
+// 守护进程指标快照
+const METRICS_FILE = `${MOD_DIR}/metrics.json`;
+// 守护进程控制套接字客户端
+const CTL_BIN = `${MOD_DIR}/bin/ratectl`;
 
 // 全局状态
 let currentMode = 1;
@@ -13,6 +19,9 @@ let appList = [];
 let appConfigs = {};
 let allPackages = []; // Store all packages for search
 let appLabels = {}; // Store app labels
+let learnedProfiles = {}; // 自学习建议 (包名 -> 档案)
+let daemonStatus = null; // 守护进程状态页 (未运行时为 null)
+let ctlAvailable = null; // ratectl 是否可执行 (首次调用 daemonCtl 时检测)
 let currentResFilter = '1080p'; // '1080p' or '2k'
 const labelQueue = [];
 let processingQueue = false;
@@ -190,6 +199,7 @@ function setupTabs() {
             // 自动刷新日志
             if (targetId === 'tab-logs') {
                 refreshLogs();
+                loadDaemonMetrics();
             }
 
             // FAB visibility
@@ -219,10 +229,16 @@ async function loadSystemStatus() {
         debugLog(`Slot error: ${e.message}`);
     }
 
-    // 2. FPS
+    // 2. FPS (守护进程在运行时直接读状态页)
     try {
-        const fpsRaw = await ksuExec("dumpsys display | grep -oE 'fps=[0-9.]+' | head -n1");
-        const fps = fpsRaw.split('=')[1] || "未知";
+        daemonStatus = await readDaemonStatus();
+        let fps;
+        if (daemonStatus && daemonStatus.fps > 0) {
+            fps = String(daemonStatus.fps);
+        } else {
+            const fpsRaw = await ksuExec("dumpsys display | grep -oE 'fps=[0-9.]+' | head -n1");
+            fps = fpsRaw.split('=')[1] || "未知";
+        }
         const fpsEl = document.getElementById('fps-info');
         if (fpsEl) fpsEl.innerText = fps;
         debugLog(`FPS loaded: ${fps}`);
@@ -292,23 +308,38 @@ function switchRes(res) {
     renderDisplayModes();
 }
 
-// 加载显示模式
-async function loadDisplayModes() {
-    const listEl = document.getElementById('mode-list');
-    if (!listEl) return;
-    
-    listEl.innerHTML = '<div class="loading">加载显示模式中...</div>';
+// 预览模式的时长 (秒)
+const PREVIEW_SECONDS = 5;
 
-    // 使用 dumpsys SurfaceFlinger 解析模式 (HWC)
-    // 匹配格式: id=0, ... resolution=1264x2780 ... vsyncRate=120.000000
-    const cmd = "dumpsys SurfaceFlinger";
-    const raw = await ksuExec(cmd);
-    
-    if (!raw) {
-        listEl.innerHTML = '<div class="error">无法获取显示模式</div>';
-        return;
+// 读取守护进程发布的状态页 (不经过 dumpsys)，守护进程未运行时返回 null
+async function readDaemonStatus() {
+    const res = await daemonCtl("status");
+    return res && res.ok && res.alive && Array.isArray(res.modes) ? res : null;
+}
+
+// 通过控制套接字向守护进程发送命令，返回解析后的回复；
+// 守护进程未运行、ratectl 缺失或出错时返回 null，调用方回退到 mode.txt / dumpsys
+async function daemonCtl(cmd) {
+    if (ctlAvailable === null) {
+        const probe = await ksuExec(`[ -x "${CTL_BIN}" ] && echo yes`);
+        ctlAvailable = probe.trim() === "yes";
+        if (!ctlAvailable) debugLog("ratectl 不可用，使用 mode.txt / dumpsys");
+    }
+    if (!ctlAvailable) return null;
+
+    const raw = await ksuExec(`"${CTL_BIN}" ${cmd} 2>/dev/null`);
+    if (!raw || !raw.trim()) return null;
+    try {
+        const res = JSON.parse(raw);
+        return res && typeof res === 'object' ? res : null;
+    } catch (e) {
+        return null;
     }
+}
 
+// 解析 dumpsys SurfaceFlinger 中的模式 (HWC)
+// 匹配格式: id=0, ... resolution=1264x2780 ... vsyncRate=120.000000
+function parseSurfaceFlingerModes(raw) {
     const lines = raw.split('\n');
     const modeMap = new Map();
 
@@ -350,7 +381,28 @@ async function loadDisplayModes() {
         }
     });
 
-    displayModes = Array.from(modeMap.values());
+    return Array.from(modeMap.values());
+}
+
+// 加载显示模式
+async function loadDisplayModes() {
+    const listEl = document.getElementById('mode-list');
+    if (!listEl) return;
+    
+    listEl.innerHTML = '<div class="loading">加载显示模式中...</div>';
+
+    // 守护进程已加载的模式表优先，未运行时再解析 dumpsys SurfaceFlinger
+    if (!daemonStatus) daemonStatus = await readDaemonStatus();
+    if (daemonStatus && daemonStatus.modes.length > 0) {
+        displayModes = daemonStatus.modes.map(m => ({ ...m, rawFps: m.fps }));
+    } else {
+        const raw = await ksuExec("dumpsys SurfaceFlinger");
+        if (!raw) {
+            listEl.innerHTML = '<div class="error">无法获取显示模式</div>';
+            return;
+        }
+        displayModes = parseSurfaceFlingerModes(raw);
+    }
 
     // 排序
     displayModes.sort((a, b) => a.fps - b.fps || a.width - b.width);
@@ -360,13 +412,13 @@ async function loadDisplayModes() {
     const configLines = configRaw.split('\n');
     const globalModeId = configLines[0] ? parseInt(configLines[0].trim()) : -1;
 
-    // 解析应用配置
+    // 解析应用配置 (值为模式 ID 或帧率范围 min-max[@width]，按原文保存)
     appConfigs = {};
     for (let i = 1; i < configLines.length; i++) {
         const line = configLines[i].trim();
         if (line.includes('=')) {
-            const [pkg, modeId] = line.split('=');
-            appConfigs[pkg] = parseInt(modeId);
+            const [pkg, value] = line.split('=');
+            appConfigs[pkg] = value.trim();
         }
     }
     
@@ -423,6 +475,12 @@ function selectMode(id) {
             item.classList.remove('active');
         }
     });
+
+    // 选中即预览几秒，不写配置文件
+    daemonCtl(`preview ${id} ${PREVIEW_SECONDS}`).then(res => {
+        const mode = displayModes.find(m => m.id === id);
+        if (res && res.ok && mode) showToast(`预览 ${mode.fps}Hz ${PREVIEW_SECONDS} 秒`);
+    });
 }
 
 // 保存全局模式
@@ -438,6 +496,9 @@ async function saveGlobalMode() {
     
     if (result.includes("Success")) {
         showToast("保存成功！");
+        // 结束预览并立即重载，不必等待 inotify (ratectl 不可用时守护进程仍通过 inotify 读取 mode.txt)
+        await daemonCtl("override off");
+        await daemonCtl("reload");
         await loadDisplayModes(); // 刷新
     } else {
         showToast("保存失败：" + result);
@@ -584,6 +645,8 @@ async function loadAppList() {
 
     // 存储所有包名，用于搜索
     allPackages = packages;
+
+    await loadLearnedProfiles();
     
     // 1. 尝试使用 KSU 批量 API 获取标签 (COPG 方式)
     if (typeof ksu !== 'undefined' && typeof ksu.getPackagesInfo !== 'undefined') {
@@ -619,6 +682,24 @@ async function loadAppList() {
     }, 1000);
 }
 
+// 读取自学习档案
+async function loadLearnedProfiles() {
+    learnedProfiles = {};
+    try {
+        const raw = await ksuExec(`cat "${LEARNED_FILE}" 2>/dev/null`);
+        if (!raw || !raw.trim()) return;
+        const data = JSON.parse(raw);
+        if (data && Array.isArray(data.apps)) {
+            data.apps.forEach(app => {
+                if (app.package) learnedProfiles[app.package] = app;
+            });
+        }
+        debugLog(`Learned profiles: ${Object.keys(learnedProfiles).length}`);
+    } catch (e) {
+        debugLog(`Learned profiles error: ${e.message}`);
+    }
+}
+
 // 筛选应用列表
 function filterAppList() {
     const input = document.getElementById('app-search');
@@ -638,10 +719,11 @@ function filterAppList() {
         // 匹配应用名
         if (appLabels[pkg] && appLabels[pkg].toLowerCase().includes(term)) return true;
         
-        // 匹配已配置的刷新率 (如 "120")
-        const modeId = appConfigs[pkg];
-        if (modeId) {
-            const mode = displayModes.find(m => m.id === modeId);
+        // 匹配已配置的刷新率 (如 "120" 或范围 "60-120")
+        const value = appConfigs[pkg];
+        if (value) {
+            if (/^\d+-\d+/.test(value)) return value.includes(term);
+            const mode = displayModes.find(m => String(m.id) === value);
             if (mode && mode.fps.toString().includes(term)) return true;
         }
         
@@ -726,15 +808,23 @@ function renderAppList(packages) {
         const item = document.createElement('div');
         item.className = 'app-item';
         
-        // 当前应用的配置模式
-        const modeId = appConfigs[pkg] || -1;
+        // 当前应用的配置 (模式 ID 或帧率范围)
+        const value = appConfigs[pkg] || "-1";
         
-        // 构建下拉选项
+        // 构建下拉选项: 固定模式，以及各分辨率下从最低帧率起的范围
         let optionsHtml = '<option value="-1">默认</option>';
         displayModes.forEach(m => {
-            const selected = m.id === modeId ? 'selected' : '';
+            const selected = String(m.id) === value ? 'selected' : '';
             optionsHtml += `<option value="${m.id}" ${selected}>${m.fps}Hz (${m.width < 1200 ? '1080P' : '2K'})</option>`;
         });
+        const rangeValues = buildRangeOptions();
+        rangeValues.forEach(r => {
+            const selected = r.value === value ? 'selected' : '';
+            optionsHtml += `<option value="${r.value}" ${selected}>${r.label}</option>`;
+        });
+        if (/^\d+-\d+/.test(value) && !rangeValues.some(r => r.value === value)) {
+            optionsHtml += `<option value="${value}" selected>${value} (自定义范围)</option>`;
+        }
 
         // 格式化包名显示：高亮最后一段
         const parts = pkg.split('.');
@@ -750,10 +840,18 @@ function renderAppList(packages) {
         }
         const label = appLabels[pkg] || "加载中...";
 
+        // 自学习建议
+        const learned = learnedProfiles[pkg];
+        let learnedHtml = '';
+        if (learned && learned.suggested_mode >= 0) {
+            learnedHtml = `<div class="app-pkg" style="font-size:12px; color:#4caf50;">建议: ${learned.suggested_fps}Hz (ID ${learned.suggested_mode}, ${learned.samples} 次采样)</div>`;
+        }
+
         item.innerHTML = `
             <div class="app-info">
                 <div class="app-name" id="label-${pkg}" style="font-weight:bold; margin-bottom:2px;">${label}</div>
                 <div class="app-pkg" style="font-size:12px;">${displayName}</div>
+                ${learnedHtml}
             </div>
             <div class="app-control">
                 <select onchange="saveAppConfig('${pkg}', this.value)">
@@ -767,6 +865,27 @@ function renderAppList(packages) {
     listEl.appendChild(fragment);
 }
 
+// 范围选项: 每个分辨率下 "最低帧率-更高帧率"，系统可在范围内空闲降频
+function buildRangeOptions() {
+    const byWidth = {};
+    displayModes.forEach(m => {
+        (byWidth[m.width] = byWidth[m.width] || []).push(m.fps);
+    });
+
+    const options = [];
+    Object.keys(byWidth).forEach(width => {
+        const fpsList = [...new Set(byWidth[width])].sort((a, b) => a - b);
+        const res = width < 1200 ? '1080P' : '2K';
+        for (let i = 1; i < fpsList.length; i++) {
+            options.push({
+                value: `${fpsList[0]}-${fpsList[i]}@${width}`,
+                label: `${fpsList[0]}-${fpsList[i]}Hz 范围 (${res})`
+            });
+        }
+    });
+    return options;
+}
+
 // 保存应用配置
 async function saveAppConfig(pkg, modeId) {
     showToast(`正在保存 ${pkg} 配置...`);
@@ -779,7 +898,7 @@ async function saveAppConfig(pkg, modeId) {
         if (modeId == -1) {
             delete appConfigs[pkg];
         } else {
-            appConfigs[pkg] = parseInt(modeId);
+            appConfigs[pkg] = String(modeId);
         }
     } else {
         showToast("保存失败");
@@ -805,6 +924,53 @@ async function refreshLogs() {
     }
 }
 
+// 读取守护进程指标
+async function loadDaemonMetrics() {
+    const el = document.getElementById('metrics-viewer');
+    if (!el) return;
+
+    // 优先直接向守护进程查询，失败时读取导出的快照
+    const res = await daemonCtl("metrics");
+    const raw = res && res.ok ? "" : await ksuExec(`cat "${METRICS_FILE}" 2>/dev/null`);
+    if (!(res && res.ok) && (!raw || !raw.trim())) {
+        el.innerText = "暂无指标 (守护进程未运行或已关闭导出)";
+        return;
+    }
+
+    try {
+        const m = res && res.ok ? res.metrics : JSON.parse(raw);
+        const avg = h => h && h.count ? (h.sum / h.count / 1000).toFixed(1) + "ms" : "-";
+        const lines = [
+            `运行时长: ${(m.uptime_ms / 3600000).toFixed(2)}h  CPU: ${m.cpu_ms}ms`,
+            `循环次数: ${m.loop_iterations}  配置重载: ${m.config_reloads}`,
+            `切换次数: ${m.switches} (近一小时 ${m.switches_last_hour})  设置写入: ${m.settings_writes}`,
+            `模式漂移: ${m.drifts || 0} (核对 ${m.reconcile_checks || 0} 次)`,
+            `前台检测: 平均 ${avg(m.fg_detect_us)}  service call: 平均 ${avg(m.cmd_service_call_us)}`
+        ];
+        if (m.sched) {
+            const s = m.sched;
+            const wake = m.wakeup_latency_us;
+            const wakeMax = wake && wake.count ? (wake.max / 1000).toFixed(1) + "ms" : "-";
+            lines.push(`调度: ${s.mode}${s.mode === "nice" ? " " + s.nice : ""} / ${s.affinity}${s.boost ? " +切换提升" : ""}` +
+                `  CPU: ${s.cpu_ms_per_hour}ms/h  唤醒延迟: 平均 ${avg(wake)} 最大 ${wakeMax}`);
+        }
+        if (m.boot_first_mode_ms) {
+            lines.push(`开机: ${(m.boot_first_mode_ms / 1000).toFixed(1)}s 应用首个模式, ${(m.boot_completed_ms / 1000).toFixed(1)}s 开机完成`);
+        }
+        if (m.mode_time_ms) {
+            const parts = Object.keys(m.mode_time_ms).map(id => {
+                const mode = displayModes.find(d => d.id === parseInt(id));
+                const name = mode ? `${mode.fps}Hz` : `ID ${id}`;
+                return `${name}: ${(m.mode_time_ms[id] / 60000).toFixed(1)}min`;
+            });
+            lines.push(`模式驻留: ${parts.join(", ")}`);
+        }
+        el.innerText = lines.join("\n");
+    } catch (e) {
+        el.innerText = "指标解析失败: " + e.message;
+    }
+}
+
 // 清空日志
 async function clearLogs() {
     // if (!confirm("确定要清空日志吗？")) return;
@@ -835,6 +1001,7 @@ async function donateWechat() {
 // 暴露给全局
 window.refreshLogs = refreshLogs;
 window.clearLogs = clearLogs;
+window.loadDaemonMetrics = loadDaemonMetrics;
 window.openUrl = openUrl;
 window.donateWechat = donateWechat;
 